@@ -0,0 +1,357 @@
+#include <benchmark/benchmark.h>
+#include "bench_helpers.hpp"
+#include <string>
+#include <vector>
+
+using namespace bytebucket;
+
+// Each benchmark takes the synthetic database's file count as range(0) and
+// picks its rows pseudo-randomly from a fixed seed, so runs are repeatable.
+
+template <typename Query>
+static void readBenchmark(benchmark::State &state, Query query)
+{
+  const int64_t files = state.range(0);
+  auto db = bench::syntheticDatabase(files);
+  if (!db)
+  {
+    state.SkipWithError("synthetic database unavailable");
+    return;
+  }
+
+  uint64_t seed = 1;
+  for (auto _ : state)
+  {
+    auto result = query(*db, files, seed);
+    if (!result.success())
+    {
+      state.SkipWithError(result.errorMessage.c_str());
+      break;
+    }
+    benchmark::DoNotOptimize(result);
+  }
+}
+
+// Writes run inside one transaction that's rolled back afterwards, so every
+// benchmark sees the database as generated. Commit cost is left to the load
+// tests; this measures the statements themselves.
+template <typename Mutation>
+static void writeBenchmark(benchmark::State &state, Mutation mutation)
+{
+  const int64_t files = state.range(0);
+  auto db = bench::syntheticDatabase(files);
+  if (!db || !db->beginTransaction(true))
+  {
+    state.SkipWithError("synthetic database unavailable");
+    return;
+  }
+
+  uint64_t seed = 1;
+  int64_t iteration = 0;
+  for (auto _ : state)
+  {
+    auto result = mutation(state, *db, files, seed, iteration++);
+    if (!result.success())
+    {
+      state.SkipWithError(result.errorMessage.c_str());
+      break;
+    }
+  }
+  db->rollbackTransaction();
+}
+
+// Reads
+
+static void BM_GetFileById(benchmark::State &state)
+{
+  readBenchmark(state, [](Database &db, int64_t files, uint64_t &seed)
+                { return db.getFileById(static_cast<int>(bench::pickFile(files, seed))); });
+}
+BENCHMARK(BM_GetFileById)->Apply(bench::rowCounts);
+
+static void BM_GetFileByStorageId(benchmark::State &state)
+{
+  readBenchmark(state, [](Database &db, int64_t files, uint64_t &seed)
+                { return db.getFileByStorageId("bench-" + std::to_string(bench::pickFile(files, seed))); });
+}
+BENCHMARK(BM_GetFileByStorageId)->Apply(bench::rowCounts);
+
+static void BM_GetFilesByFolder(benchmark::State &state)
+{
+  readBenchmark(state, [](Database &db, int64_t files, uint64_t &seed)
+                { return db.getFilesByFolder(static_cast<int>(bench::pickFolder(files, seed))); });
+}
+BENCHMARK(BM_GetFilesByFolder)->Apply(bench::rowCounts);
+
+static void BM_GetFolderById(benchmark::State &state)
+{
+  readBenchmark(state, [](Database &db, int64_t files, uint64_t &seed)
+                { return db.getFolderById(static_cast<int>(bench::pickFolder(files, seed))); });
+}
+BENCHMARK(BM_GetFolderById)->Apply(bench::rowCounts);
+
+static void BM_GetFoldersByParent(benchmark::State &state)
+{
+  readBenchmark(state, [](Database &db, int64_t files, uint64_t &seed)
+                { return db.getFoldersByParent(static_cast<int>(bench::pickFolder(files, seed))); });
+}
+BENCHMARK(BM_GetFoldersByParent)->Apply(bench::rowCounts);
+
+static void BM_GetRootFolders(benchmark::State &state)
+{
+  readBenchmark(state, [](Database &db, int64_t, uint64_t &)
+                { return db.getFoldersByParent(std::nullopt); });
+}
+BENCHMARK(BM_GetRootFolders)->Apply(bench::rowCounts);
+
+static void BM_GetFolderSubtree(benchmark::State &state)
+{
+  readBenchmark(state, [](Database &db, int64_t files, uint64_t &seed)
+                { return db.getFolderSubtree(static_cast<int>(bench::pickFolder(files, seed))); });
+}
+BENCHMARK(BM_GetFolderSubtree)->Apply(bench::rowCounts);
+
+static void BM_GetTagByName(benchmark::State &state)
+{
+  readBenchmark(state, [](Database &db, int64_t, uint64_t &seed)
+                { return db.getTagByName("tag-" + std::to_string(bench::pickFile(bench::TAG_COUNT, seed))); });
+}
+BENCHMARK(BM_GetTagByName)->Apply(bench::rowCounts);
+
+static void BM_GetTagById(benchmark::State &state)
+{
+  readBenchmark(state, [](Database &db, int64_t, uint64_t &seed)
+                { return db.getTagById(static_cast<int>(bench::pickFile(bench::TAG_COUNT, seed))); });
+}
+BENCHMARK(BM_GetTagById)->Apply(bench::rowCounts);
+
+static void BM_GetAllTags(benchmark::State &state)
+{
+  readBenchmark(state, [](Database &db, int64_t, uint64_t &)
+                { return db.getAllTags(); });
+}
+BENCHMARK(BM_GetAllTags)->Apply(bench::rowCounts);
+
+static void BM_GetFileTags(benchmark::State &state)
+{
+  readBenchmark(state, [](Database &db, int64_t files, uint64_t &seed)
+                { return db.getFileTags(static_cast<int>(bench::pickFile(files, seed))); });
+}
+BENCHMARK(BM_GetFileTags)->Apply(bench::rowCounts);
+
+static void BM_GetFileMetadata(benchmark::State &state)
+{
+  readBenchmark(state, [](Database &db, int64_t files, uint64_t &seed)
+                { return db.getFileMetadata(static_cast<int>(bench::pickFile(files, seed)), "rank"); });
+}
+BENCHMARK(BM_GetFileMetadata)->Apply(bench::rowCounts);
+
+static void BM_GetAllFileMetadata(benchmark::State &state)
+{
+  readBenchmark(state, [](Database &db, int64_t files, uint64_t &seed)
+                { return db.getAllFileMetadata(static_cast<int>(bench::pickFile(files, seed))); });
+}
+BENCHMARK(BM_GetAllFileMetadata)->Apply(bench::rowCounts);
+
+// a numeric range on the indexed value_num, sorted by it, one page of 100
+static void BM_FindFilesByMetadata(benchmark::State &state)
+{
+  readBenchmark(state, [](Database &db, int64_t files, uint64_t &seed)
+                {
+    int64_t low = bench::pickFile(files, seed);
+    FileQuery query;
+    query.predicates.push_back({"rank", MetadataOp::GreaterOrEqual, std::to_string(low)});
+    query.predicates.push_back({"rank", MetadataOp::LessThan, std::to_string(low + 1000)});
+    query.sortBy = FileSortField::Metadata;
+    query.sortKey = "rank";
+    return db.findFilesByMetadata(query); });
+}
+BENCHMARK(BM_FindFilesByMetadata)->Apply(bench::rowCounts);
+
+static void BM_GetTuningStatus(benchmark::State &state)
+{
+  readBenchmark(state, [](Database &db, int64_t, uint64_t &)
+                { return db.getTuningStatus(); });
+}
+BENCHMARK(BM_GetTuningStatus)->Apply(bench::rowCounts);
+
+// nothing left to migrate in a synthetic database, so this is the scan that finds that out
+static void BM_MigrateLegacyTimestamps(benchmark::State &state)
+{
+  readBenchmark(state, [](Database &db, int64_t, uint64_t &)
+                { return db.migrateLegacyTimestamps(500); });
+}
+BENCHMARK(BM_MigrateLegacyTimestamps)->Apply(bench::rowCounts);
+
+// Writes
+
+static void BM_AddFile(benchmark::State &state)
+{
+  writeBenchmark(state, [](benchmark::State &, Database &db, int64_t files, uint64_t &seed, int64_t iteration)
+                 {
+    std::string storage_id = "new-" + std::to_string(iteration);
+    return db.addFile("new.txt", static_cast<int>(bench::pickFolder(files, seed)), 1024, "text/plain", storage_id); });
+}
+BENCHMARK(BM_AddFile)->Apply(bench::rowCounts);
+
+// one multi-file upload's worth of rows
+static void BM_AddFiles(benchmark::State &state)
+{
+  writeBenchmark(state, [](benchmark::State &, Database &db, int64_t files, uint64_t &seed, int64_t iteration)
+                 {
+    std::vector<std::string> storage_ids;
+    for (int i = 0; i < 16; ++i)
+      storage_ids.push_back("new-" + std::to_string(iteration) + "-" + std::to_string(i));
+    int folder_id = static_cast<int>(bench::pickFolder(files, seed));
+    std::vector<NewFile> batch;
+    for (const auto &storage_id : storage_ids)
+      batch.push_back(NewFile{"new.txt", folder_id, 1024, "text/plain", storage_id});
+    return db.addFiles(batch); });
+}
+BENCHMARK(BM_AddFiles)->Apply(bench::rowCounts);
+
+static void BM_UpdateFileTimestamp(benchmark::State &state)
+{
+  writeBenchmark(state, [](benchmark::State &, Database &db, int64_t files, uint64_t &seed, int64_t)
+                 { return db.updateFileTimestamp(static_cast<int>(bench::pickFile(files, seed))); });
+}
+BENCHMARK(BM_UpdateFileTimestamp)->Apply(bench::rowCounts);
+
+static void BM_RenameFile(benchmark::State &state)
+{
+  writeBenchmark(state, [](benchmark::State &, Database &db, int64_t files, uint64_t &seed, int64_t iteration)
+                 { return db.renameFile(static_cast<int>(bench::pickFile(files, seed)), "renamed-" + std::to_string(iteration)); });
+}
+BENCHMARK(BM_RenameFile)->Apply(bench::rowCounts);
+
+static void BM_MoveFile(benchmark::State &state)
+{
+  writeBenchmark(state, [](benchmark::State &, Database &db, int64_t files, uint64_t &seed, int64_t)
+                 {
+    int file_id = static_cast<int>(bench::pickFile(files, seed));
+    return db.moveFile(file_id, static_cast<int>(bench::pickFolder(files, seed))); });
+}
+BENCHMARK(BM_MoveFile)->Apply(bench::rowCounts);
+
+// deletes a file added outside the timed region, along with its tag and metadata rows
+static void BM_DeleteFile(benchmark::State &state)
+{
+  writeBenchmark(state, [](benchmark::State &state, Database &db, int64_t files, uint64_t &seed, int64_t iteration)
+                 {
+    state.PauseTiming();
+    int folder_id = static_cast<int>(bench::pickFolder(files, seed));
+    auto added = db.addFile("doomed.txt", folder_id, 1, "text/plain", "doomed-" + std::to_string(iteration));
+    if (added.success())
+    {
+      db.addFileTag(added.value.value(), 1);
+      db.setFileMetadata(added.value.value(), "rank", "1");
+    }
+    state.ResumeTiming();
+    if (!added.success())
+      return DatabaseResult<bool>{std::nullopt, added.error, added.errorMessage};
+    return db.deleteFile(added.value.value()); });
+}
+BENCHMARK(BM_DeleteFile)->Apply(bench::rowCounts);
+
+static void BM_InsertFolder(benchmark::State &state)
+{
+  writeBenchmark(state, [](benchmark::State &, Database &db, int64_t files, uint64_t &seed, int64_t iteration)
+                 { return db.insertFolder("new-" + std::to_string(iteration), static_cast<int>(bench::pickFolder(files, seed))); });
+}
+BENCHMARK(BM_InsertFolder)->Apply(bench::rowCounts);
+
+static void BM_RenameFolder(benchmark::State &state)
+{
+  writeBenchmark(state, [](benchmark::State &, Database &db, int64_t files, uint64_t &seed, int64_t iteration)
+                 { return db.renameFolder(static_cast<int>(bench::pickFolder(files, seed)), "renamed-" + std::to_string(iteration)); });
+}
+BENCHMARK(BM_RenameFolder)->Apply(bench::rowCounts);
+
+// includes the walk up the destination's ancestors that rules out cycles
+static void BM_MoveFolder(benchmark::State &state)
+{
+  writeBenchmark(state, [](benchmark::State &, Database &db, int64_t files, uint64_t &seed, int64_t iteration)
+                 {
+    // a fresh leaf each time, so a move can't close a cycle and fail
+    auto folder_id = db.insertFolder("moving-" + std::to_string(iteration), 1);
+    if (!folder_id.success())
+      return DatabaseResult<bool>{std::nullopt, folder_id.error, folder_id.errorMessage};
+    return db.moveFolder(folder_id.value.value(), static_cast<int>(bench::pickFolder(files, seed))); });
+}
+BENCHMARK(BM_MoveFolder)->Apply(bench::rowCounts);
+
+// a folder of 16 files and their tags, built outside the timed region, deleted with its cascade
+static void BM_DeleteFolder(benchmark::State &state)
+{
+  writeBenchmark(state, [](benchmark::State &state, Database &db, int64_t files, uint64_t &seed, int64_t iteration)
+                 {
+    state.PauseTiming();
+    auto folder_id = db.insertFolder("doomed-" + std::to_string(iteration), static_cast<int>(bench::pickFolder(files, seed)));
+    if (folder_id.success())
+    {
+      for (int i = 0; i < 16; ++i)
+      {
+        auto file_id = db.addFile("doomed.txt", folder_id.value.value(), 1, "text/plain",
+                                  "doomed-" + std::to_string(iteration) + "-" + std::to_string(i));
+        if (file_id.success())
+          db.addFileTag(file_id.value.value(), 1);
+      }
+    }
+    state.ResumeTiming();
+    if (!folder_id.success())
+      return DatabaseResult<bool>{std::nullopt, folder_id.error, folder_id.errorMessage};
+    return db.deleteFolder(folder_id.value.value()); });
+}
+BENCHMARK(BM_DeleteFolder)->Apply(bench::rowCounts);
+
+static void BM_InsertTag(benchmark::State &state)
+{
+  writeBenchmark(state, [](benchmark::State &, Database &db, int64_t, uint64_t &, int64_t iteration)
+                 { return db.insertTag("new-tag-" + std::to_string(iteration)); });
+}
+BENCHMARK(BM_InsertTag)->Apply(bench::rowCounts);
+
+static void BM_AddFileTag(benchmark::State &state)
+{
+  writeBenchmark(state, [](benchmark::State &, Database &db, int64_t files, uint64_t &, int64_t iteration)
+                 {
+    // walks the files in order, one tag each pass that none of them has yet
+    int64_t file_id = iteration % files + 1;
+    int64_t pass = iteration / files;
+    int64_t tag_id = 1 + (file_id + 1 + pass) % bench::TAG_COUNT;
+    return db.addFileTag(static_cast<int>(file_id), static_cast<int>(tag_id)); });
+}
+BENCHMARK(BM_AddFileTag)->Apply(bench::rowCounts);
+
+static void BM_RemoveFileTag(benchmark::State &state)
+{
+  writeBenchmark(state, [](benchmark::State &state, Database &db, int64_t files, uint64_t &seed, int64_t)
+                 {
+    // put back outside the timed region, so a file drawn twice still has the tag to remove
+    int64_t file_id = bench::pickFile(files, seed);
+    int tag_id = static_cast<int>(1 + file_id % bench::TAG_COUNT);
+    state.PauseTiming();
+    db.addFileTag(static_cast<int>(file_id), tag_id);
+    state.ResumeTiming();
+    return db.removeFileTag(static_cast<int>(file_id), tag_id); });
+}
+BENCHMARK(BM_RemoveFileTag)->Apply(bench::rowCounts);
+
+static void BM_SetFileMetadata(benchmark::State &state)
+{
+  writeBenchmark(state, [](benchmark::State &, Database &db, int64_t files, uint64_t &seed, int64_t iteration)
+                 { return db.setFileMetadata(static_cast<int>(bench::pickFile(files, seed)), "rank", std::to_string(iteration)); });
+}
+BENCHMARK(BM_SetFileMetadata)->Apply(bench::rowCounts);
+
+static void BM_RemoveFileMetadata(benchmark::State &state)
+{
+  writeBenchmark(state, [](benchmark::State &state, Database &db, int64_t files, uint64_t &seed, int64_t)
+                 {
+    int file_id = static_cast<int>(bench::pickFile(files, seed));
+    state.PauseTiming();
+    db.setFileMetadata(file_id, "rank", "1");
+    state.ResumeTiming();
+    return db.removeFileMetadata(file_id, "rank"); });
+}
+BENCHMARK(BM_RemoveFileMetadata)->Apply(bench::rowCounts);
@@ -0,0 +1,137 @@
+#include <benchmark/benchmark.h>
+#include "bench_helpers.hpp"
+#include "request_handler.hpp"
+#include "connection_pool.hpp"
+#include "metrics.hpp"
+#include <sstream>
+
+using namespace bytebucket;
+
+// Sync write stream that throws the response away, so the benchmarks include
+// serialising it but not a socket
+struct DiscardStream
+{
+  template <class ConstBufferSequence>
+  size_t write_some(const ConstBufferSequence &buffers, boost::beast::error_code &ec)
+  {
+    ec = {};
+    return boost::asio::buffer_size(buffers);
+  }
+
+  template <class ConstBufferSequence>
+  size_t write_some(const ConstBufferSequence &buffers)
+  {
+    return boost::asio::buffer_size(buffers);
+  }
+};
+
+static boost::beast::http::request<boost::beast::http::string_body> makeRequest(boost::beast::http::verb method,
+                                                                                 const std::string &target)
+{
+  boost::beast::http::request<boost::beast::http::string_body> req{method, target, 11};
+  req.set(boost::beast::http::field::host, "localhost");
+  return req;
+}
+
+static void dispatch(benchmark::State &state, boost::beast::http::verb method, const std::string &target)
+{
+  DiscardStream stream;
+  for (auto _ : state)
+  {
+    Route route;
+    auto response = handle_request(makeRequest(method, target), route);
+    boost::beast::write(stream, response);
+    benchmark::DoNotOptimize(route);
+  }
+}
+
+static void BM_DispatchHealth(benchmark::State &state)
+{
+  dispatch(state, boost::beast::http::verb::get, "/health");
+}
+BENCHMARK(BM_DispatchHealth);
+
+static void BM_DispatchOptions(benchmark::State &state)
+{
+  dispatch(state, boost::beast::http::verb::options, "/folder");
+}
+BENCHMARK(BM_DispatchOptions);
+
+// falls through every route before the 404
+static void BM_DispatchUnmatched(benchmark::State &state)
+{
+  dispatch(state, boost::beast::http::verb::get, "/no/such/route");
+}
+BENCHMARK(BM_DispatchUnmatched);
+
+static void BM_DispatchGetFolder(benchmark::State &state)
+{
+  const int64_t files = state.range(0);
+  std::string path = bench::syntheticDatabasePath(files);
+  auto pool = path.empty() ? nullptr : ConnectionPool::create(path, 2);
+  if (!pool)
+  {
+    state.SkipWithError("synthetic database unavailable");
+    return;
+  }
+  setConnectionPool(pool);
+
+  DiscardStream stream;
+  uint64_t seed = 1;
+  for (auto _ : state)
+  {
+    Route route;
+    auto response = handle_request(
+        makeRequest(boost::beast::http::verb::get, "/folder/" + std::to_string(bench::pickFolder(files, seed))), route);
+    boost::beast::write(stream, response);
+  }
+  setConnectionPool(nullptr);
+}
+BENCHMARK(BM_DispatchGetFolder)->Apply(bench::rowCounts);
+
+static FileRecord sampleFile(int id)
+{
+  FileRecord file;
+  file.id = id;
+  file.name = "quarterly report " + std::to_string(id) + ".pdf";
+  file.folderId = 2;
+  file.createdAt = std::chrono::system_clock::now();
+  file.updatedAt = file.createdAt;
+  file.size = 123456;
+  file.contentType = "application/pdf";
+  file.storageId = "bench-" + std::to_string(id);
+  return file;
+}
+
+static void BM_BuildFileJson(benchmark::State &state)
+{
+  FileRecord file = sampleFile(1);
+  for (auto _ : state)
+  {
+    std::ostringstream json;
+    buildFileJson(json, file, nullptr);
+    benchmark::DoNotOptimize(json);
+  }
+}
+BENCHMARK(BM_BuildFileJson);
+
+// with the per-file tag and metadata lookups a folder listing makes
+static void BM_BuildFileJsonWithLookups(benchmark::State &state)
+{
+  const int64_t files = state.range(0);
+  auto db = bench::syntheticDatabase(files);
+  if (!db)
+  {
+    state.SkipWithError("synthetic database unavailable");
+    return;
+  }
+
+  uint64_t seed = 1;
+  for (auto _ : state)
+  {
+    std::ostringstream json;
+    buildFileJson(json, sampleFile(static_cast<int>(bench::pickFile(files, seed))), db);
+    benchmark::DoNotOptimize(json);
+  }
+}
+BENCHMARK(BM_BuildFileJsonWithLookups)->Apply(bench::rowCounts);
@@ -0,0 +1,180 @@
+#include "bench_helpers.hpp"
+#include <chrono>
+#include <cstdlib>
+#include <filesystem>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <sqlite3.h>
+
+namespace bytebucket
+{
+  namespace bench
+  {
+    void rowCounts(benchmark::internal::Benchmark *benchmark)
+    {
+      int64_t maxRows = 10000000;
+      if (const char *limit = std::getenv("BYTEBUCKET_BENCH_MAX_ROWS"))
+        maxRows = std::strtoll(limit, nullptr, 10);
+      for (int64_t rows : {10000LL, 1000000LL, 10000000LL})
+        if (rows <= maxRows)
+          benchmark->Arg(rows);
+    }
+
+    static bool exec(sqlite3 *db, const char *sql)
+    {
+      char *errMsg = nullptr;
+      if (sqlite3_exec(db, sql, nullptr, nullptr, &errMsg) != SQLITE_OK)
+      {
+        std::cerr << "Synthetic database: " << (errMsg ? errMsg : "unknown error") << std::endl;
+        sqlite3_free(errMsg);
+        return false;
+      }
+      return true;
+    }
+
+    // Prepares, runs bind(stmt, i) and steps once for every i in [first, last]
+    template <typename Bind>
+    static bool insertRows(sqlite3 *db, const char *sql, int64_t first, int64_t last, Bind bind)
+    {
+      sqlite3_stmt *stmt = nullptr;
+      if (sqlite3_prepare_v2(db, sql, -1, &stmt, nullptr) != SQLITE_OK)
+      {
+        std::cerr << "Synthetic database: " << sqlite3_errmsg(db) << std::endl;
+        return false;
+      }
+      for (int64_t i = first; i <= last; ++i)
+      {
+        bind(stmt, i);
+        if (sqlite3_step(stmt) != SQLITE_DONE)
+        {
+          std::cerr << "Synthetic database: " << sqlite3_errmsg(db) << std::endl;
+          sqlite3_finalize(stmt);
+          return false;
+        }
+        sqlite3_reset(stmt);
+      }
+      sqlite3_finalize(stmt);
+      return true;
+    }
+
+    static bool fillDatabase(sqlite3 *db, int64_t files)
+    {
+      const int64_t folders = folderCount(files);
+      const int64_t baseMs = 1700000000000LL;
+      static const char *CONTENT_TYPES[] = {"text/plain", "image/png", "application/pdf", "application/json"};
+
+      if (!exec(db, "PRAGMA journal_mode = OFF; PRAGMA synchronous = OFF; PRAGMA cache_size = -1048576; BEGIN;"))
+        return false;
+
+      bool filled =
+          insertRows(db, "INSERT INTO folders (id, name, parent_id) VALUES (?, ?, ?)", 2, folders + 1,
+                     [](sqlite3_stmt *stmt, int64_t id)
+                     {
+                       int64_t index = id - 2;
+                       std::string name = "folder-" + std::to_string(index);
+                       sqlite3_bind_int64(stmt, 1, id);
+                       sqlite3_bind_text(stmt, 2, name.c_str(), -1, SQLITE_TRANSIENT);
+                       sqlite3_bind_int64(stmt, 3, index < FOLDER_FANOUT ? 1 : 2 + index / FOLDER_FANOUT - 1);
+                     }) &&
+          insertRows(db, "INSERT INTO tags (id, name) VALUES (?, ?)", 1, TAG_COUNT,
+                     [](sqlite3_stmt *stmt, int64_t id)
+                     {
+                       std::string name = "tag-" + std::to_string(id);
+                       sqlite3_bind_int64(stmt, 1, id);
+                       sqlite3_bind_text(stmt, 2, name.c_str(), -1, SQLITE_TRANSIENT);
+                     }) &&
+          insertRows(db, R"(
+            INSERT INTO files (id, name, folder_id, created_at_ms, updated_at_ms, size, content_type, storage_id)
+            VALUES (?, ?, ?, ?, ?, ?, ?, ?))",
+                     1, files,
+                     [&](sqlite3_stmt *stmt, int64_t id)
+                     {
+                       std::string name = "file-" + std::to_string(id) + ".txt";
+                       std::string storageId = "bench-" + std::to_string(id);
+                       sqlite3_bind_int64(stmt, 1, id);
+                       sqlite3_bind_text(stmt, 2, name.c_str(), -1, SQLITE_TRANSIENT);
+                       sqlite3_bind_int64(stmt, 3, 2 + (id - 1) % folders);
+                       sqlite3_bind_int64(stmt, 4, baseMs + id * 1000);
+                       sqlite3_bind_int64(stmt, 5, baseMs + id * 1000);
+                       sqlite3_bind_int64(stmt, 6, id % 1000000);
+                       sqlite3_bind_text(stmt, 7, CONTENT_TYPES[id % 4], -1, SQLITE_STATIC);
+                       sqlite3_bind_text(stmt, 8, storageId.c_str(), -1, SQLITE_TRANSIENT);
+                     }) &&
+          insertRows(db, "INSERT INTO file_tags (file_id, tag_id) VALUES (?, ?)", 1, files,
+                     [](sqlite3_stmt *stmt, int64_t id)
+                     {
+                       sqlite3_bind_int64(stmt, 1, id);
+                       sqlite3_bind_int64(stmt, 2, 1 + id % TAG_COUNT);
+                     }) &&
+          insertRows(db, "INSERT INTO file_metadata (file_id, key, value, value_num) VALUES (?, 'rank', ?, ?)", 1, files,
+                     [](sqlite3_stmt *stmt, int64_t id)
+                     {
+                       std::string value = std::to_string(id);
+                       sqlite3_bind_int64(stmt, 1, id);
+                       sqlite3_bind_text(stmt, 2, value.c_str(), -1, SQLITE_TRANSIENT);
+                       sqlite3_bind_double(stmt, 3, static_cast<double>(id));
+                     });
+
+      if (!filled)
+      {
+        exec(db, "ROLLBACK;");
+        return false;
+      }
+      return exec(db, "COMMIT; ANALYZE; PRAGMA journal_mode = WAL;");
+    }
+
+    static bool buildDatabase(const std::string &path, int64_t files)
+    {
+      std::string building = path + ".building";
+      std::error_code ec;
+      std::filesystem::remove(building, ec);
+      std::filesystem::remove(building + "-wal", ec);
+      std::filesystem::remove(building + "-shm", ec);
+
+      // the schema comes from Database itself so the benchmarks track it
+      if (!Database::create(building))
+        return false;
+
+      std::cerr << "Building synthetic database with " << files << " files..." << std::endl;
+      auto started = std::chrono::steady_clock::now();
+      sqlite3 *db = nullptr;
+      bool built = sqlite3_open(building.c_str(), &db) == SQLITE_OK && fillDatabase(db, files);
+      sqlite3_close(db);
+      if (!built)
+        return false;
+
+      std::filesystem::rename(building, path, ec);
+      if (ec)
+        return false;
+      auto seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+      std::cerr << "Built " << path << " in " << seconds << " s" << std::endl;
+      return true;
+    }
+
+    std::string syntheticDatabasePath(int64_t files)
+    {
+      std::string path = "bench_db_" + std::to_string(files) + ".db";
+      if (!std::filesystem::exists(path) && !buildDatabase(path, files))
+        return "";
+      return path;
+    }
+
+    std::shared_ptr<Database> syntheticDatabase(int64_t files)
+    {
+      static std::mutex mutex;
+      static std::map<int64_t, std::shared_ptr<Database>> open;
+
+      std::lock_guard<std::mutex> lock(mutex);
+      auto found = open.find(files);
+      if (found != open.end())
+        return found->second;
+
+      std::string path = syntheticDatabasePath(files);
+      auto db = path.empty() ? nullptr : Database::create(path);
+      if (db)
+        open[files] = db;
+      return db;
+    }
+  }
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <benchmark/benchmark.h>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include "database.hpp"
+
+namespace bytebucket
+{
+  namespace bench
+  {
+    // Shape of the synthetic databases: files spread evenly over folders that
+    // form a tree with FOLDER_FANOUT children each, every file carrying one tag
+    // and one numeric "rank" metadata value
+    constexpr int64_t FILES_PER_FOLDER = 100;
+    constexpr int64_t FOLDER_FANOUT = 10;
+    constexpr int64_t TAG_COUNT = 64;
+
+    // Registers the row counts a database benchmark runs against: 10k, 1M and
+    // 10M files, skipping any above BYTEBUCKET_BENCH_MAX_ROWS
+    void rowCounts(benchmark::internal::Benchmark *benchmark);
+
+    // bench_db_{files}.db in the working directory, built on first use and
+    // reused afterwards since the larger ones take minutes to generate
+    std::string syntheticDatabasePath(int64_t files);
+
+    // A read-write connection to the synthetic database, shared between
+    // benchmarks of the same size; nullptr if it couldn't be built
+    std::shared_ptr<Database> syntheticDatabase(int64_t files);
+
+    inline int64_t folderCount(int64_t files)
+    {
+      return files / FILES_PER_FOLDER > 0 ? files / FILES_PER_FOLDER : 1;
+    }
+
+    // Ids of the synthetic rows, picked pseudo-randomly so reads don't all hit
+    // the same cached pages
+    inline int64_t pickFile(int64_t files, uint64_t &state)
+    {
+      state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+      return static_cast<int64_t>((state >> 33) % static_cast<uint64_t>(files)) + 1;
+    }
+
+    inline int64_t pickFolder(int64_t files, uint64_t &state)
+    {
+      state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+      return static_cast<int64_t>((state >> 33) % static_cast<uint64_t>(folderCount(files))) + 2;
+    }
+  }
+}
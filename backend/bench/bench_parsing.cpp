@@ -0,0 +1,72 @@
+#include <benchmark/benchmark.h>
+#include "multipart_parser.hpp"
+#include "database.hpp"
+#include <string>
+
+using namespace bytebucket;
+
+static const std::string BOUNDARY = "----ByteBucketBenchBoundary7MA4YWxkTrZu0gW";
+
+// A multipart/form-data body with one text field and `parts` files of `size` bytes
+static std::string multipartBody(int parts, size_t size)
+{
+  std::string body = "--" + BOUNDARY + "\r\n"
+                                        "Content-Disposition: form-data; name=\"folder_id\"\r\n\r\n"
+                                        "1\r\n";
+  for (int i = 0; i < parts; ++i)
+  {
+    body += "--" + BOUNDARY + "\r\n";
+    body += "Content-Disposition: form-data; name=\"file\"; filename=\"file-" + std::to_string(i) + ".bin\"\r\n";
+    body += "Content-Type: application/octet-stream\r\n\r\n";
+    body += std::string(size, static_cast<char>('a' + i % 26));
+    body += "\r\n";
+  }
+  body += "--" + BOUNDARY + "--\r\n";
+  return body;
+}
+
+static void BM_MultipartParse(benchmark::State &state)
+{
+  std::string body = multipartBody(static_cast<int>(state.range(0)), static_cast<size_t>(state.range(1)));
+  for (auto _ : state)
+  {
+    auto parsed = MultipartParser::parse(body, BOUNDARY);
+    benchmark::DoNotOptimize(parsed);
+  }
+  state.SetBytesProcessed(static_cast<int64_t>(state.iterations()) * static_cast<int64_t>(body.size()));
+}
+BENCHMARK(BM_MultipartParse)->Args({1, 1024})->Args({1, 1 << 20})->Args({16, 64 * 1024})->Args({1, 16 << 20});
+
+static void BM_MultipartParseView(benchmark::State &state)
+{
+  std::string body = multipartBody(static_cast<int>(state.range(0)), static_cast<size_t>(state.range(1)));
+  for (auto _ : state)
+  {
+    auto parsed = MultipartParser::parseView(body, BOUNDARY);
+    benchmark::DoNotOptimize(parsed);
+  }
+  state.SetBytesProcessed(static_cast<int64_t>(state.iterations()) * static_cast<int64_t>(body.size()));
+}
+BENCHMARK(BM_MultipartParseView)->Args({1, 1024})->Args({1, 1 << 20})->Args({16, 64 * 1024})->Args({1, 16 << 20});
+
+static void BM_ExtractBoundary(benchmark::State &state)
+{
+  const std::string content_type = "multipart/form-data; charset=utf-8; boundary=\"" + BOUNDARY + "\"";
+  for (auto _ : state)
+  {
+    auto boundary = MultipartParser::extractBoundary(content_type);
+    benchmark::DoNotOptimize(boundary);
+  }
+}
+BENCHMARK(BM_ExtractBoundary);
+
+static void BM_ParseSqliteToChrono(benchmark::State &state)
+{
+  const char *timestamp = "2024-06-15 13:45:30";
+  for (auto _ : state)
+  {
+    auto parsed = parseSqliteToChrono(timestamp);
+    benchmark::DoNotOptimize(parsed);
+  }
+}
+BENCHMARK(BM_ParseSqliteToChrono);
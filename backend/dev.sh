@@ -15,6 +15,7 @@ NC='\033[0m' # No Color
 # Project directories
 PROJECT_DIR="$(cd "$(dirname "${BASH_SOURCE[0]}")" && pwd)"
 BUILD_DIR="$PROJECT_DIR/build"
+BENCH_BUILD_DIR="$PROJECT_DIR/build-bench"
 
 # Helper functions
 print_header() {
@@ -125,6 +126,58 @@ test_ctest() {
     fi
 }
 
+# Run the benchmarks from an optimised build, saving JSON named after the commit
+bench() {
+    print_header "Running Benchmarks"
+
+    cd "$PROJECT_DIR"
+    cmake -S . -B "$BENCH_BUILD_DIR" -DCMAKE_BUILD_TYPE=Release
+    cmake --build "$BENCH_BUILD_DIR" --target bytebucket_bench
+
+    if [ ! -f "$BENCH_BUILD_DIR/bytebucket_bench" ]; then
+        print_error "Benchmark executable not found. Is Google Benchmark installed?"
+        exit 1
+    fi
+
+    local results_dir="$PROJECT_DIR/bench-results"
+    local commit=$(git rev-parse --short HEAD 2>/dev/null || echo unknown)
+    mkdir -p "$results_dir"
+
+    # synthetic databases are generated on first use and kept beside the binary
+    cd "$BENCH_BUILD_DIR"
+    "$BENCH_BUILD_DIR/bytebucket_bench" \
+        --benchmark_repetitions=5 \
+        --benchmark_report_aggregates_only=true \
+        --benchmark_out="$results_dir/$commit.json" \
+        --benchmark_out_format=json \
+        "$@"
+
+    print_success "Results written to bench-results/$commit.json"
+}
+
+# Run a load scenario against a freshly started server, saving JSON named after the commit
+load() {
+    local scenario="${1:-browse}"
+    print_header "Running Load Scenario: $scenario"
+
+    cd "$PROJECT_DIR"
+    cmake -S . -B "$BENCH_BUILD_DIR" -DCMAKE_BUILD_TYPE=Release
+    cmake --build "$BENCH_BUILD_DIR" --target bytebucket bytebucket_load
+
+    local results_dir="$PROJECT_DIR/load-results"
+    local commit=$(git rev-parse --short HEAD 2>/dev/null || echo unknown)
+    mkdir -p "$results_dir"
+
+    # the server runs in a scratch directory, so every run starts from an empty database
+    "$BENCH_BUILD_DIR/bytebucket_load" \
+        --scenario "$scenario" \
+        --server "$BENCH_BUILD_DIR/bytebucket" \
+        --out "$results_dir/$commit-$scenario.json" \
+        "${@:2}"
+
+    print_success "Results written to load-results/$commit-$scenario.json"
+}
+
 # Start the server
 server() {
     print_header "Starting ByteBucket Server"
@@ -467,6 +520,8 @@ status() {
     echo "  server    - Start the server"
     echo "  clean     - Clean build directory"
     echo "  check     - Build and test"
+    echo "  bench     - Run benchmarks"
+    echo "  load      - Run a load scenario"
     echo "  watch     - Watch for changes and auto-rebuild"
     echo "  status    - Show this status"
 }
@@ -486,6 +541,9 @@ help() {
     echo "  clean           Clean build directory"
     echo "  rebuild         Complete rebuild (clean + build from scratch)"
     echo "  check           Build and run tests"
+    echo "  bench [args]    Run benchmarks, saving JSON to bench-results/<commit>.json"
+    echo "  load [scenario] [args]"
+    echo "                  Run a load scenario, saving JSON to load-results/<commit>-<scenario>.json"
     echo "  watch           Watch for changes and auto-rebuild/test"
     echo "  watch-server    Watch for changes and auto-rebuild/restart server"
     echo "  install-deps    Install dependencies (macOS only)"
@@ -525,6 +583,12 @@ case "${1:-help}" in
     "check")
         check
         ;;
+    "bench")
+        bench "${@:2}"
+        ;;
+    "load")
+        load "${@:2}"
+        ;;
     "watch")
         watch
         ;;
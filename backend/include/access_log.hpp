@@ -0,0 +1,133 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+namespace bytebucket
+{
+  // One access or event log entry. Fixed size with no heap, so pushing it is a
+  // copy into a ring slot; longer strings are truncated.
+  struct LogRecord
+  {
+    enum class Kind : uint8_t
+    {
+      Access,
+      Event
+    };
+
+    Kind kind = Kind::Access;
+    std::chrono::system_clock::time_point time;
+    uint32_t durationMicros = 0;
+    uint16_t status = 0;
+    uint64_t bytesIn = 0;
+    uint64_t bytesOut = 0;
+    std::array<char, 8> method{};
+    std::array<char, 48> remote{};
+    std::array<char, 32> route{};   // route pattern, or the event name
+    std::array<char, 160> target{}; // request target, or the event message
+
+    // Copies as much of from as fits, always leaving a terminating NUL. A cut
+    // never falls inside a UTF-8 sequence, so the log stays valid UTF-8.
+    template <size_t N>
+    static void copy(std::array<char, N> &to, std::string_view from)
+    {
+      size_t length = from.size() < N - 1 ? from.size() : N - 1;
+      if (length < from.size())
+        while (length > 0 && (static_cast<unsigned char>(from[length]) & 0xC0) == 0x80)
+          --length;
+      from.copy(to.data(), length);
+      to[length] = '\0';
+    }
+  };
+
+  // Asynchronous JSON-lines access log. Each request thread pushes records
+  // into its own single-producer ring, so logging never takes a lock or
+  // touches a stream on the request path; a background thread drains all
+  // rings, formats the records and writes them in batches, rotating the file
+  // when it grows past maxBytes. A full ring drops the record and counts it,
+  // and the writer notes the drop count in the log, so a slow disk can't
+  // stall requests.
+  class AccessLog
+  {
+  public:
+    struct Options
+    {
+      std::string path = "access.log";
+      uint64_t maxBytes = 64 * 1024 * 1024;
+      unsigned keepFiles = 5; // rotated files kept as path.1 .. path.N
+      // records per thread, rounded up to a power of two; a connection thread
+      // logs one record per request, so this only needs to cover a flush interval
+      size_t ringCapacity = 64;
+      std::chrono::milliseconds flushInterval{50};
+    };
+
+    struct Stats
+    {
+      uint64_t written = 0;
+      uint64_t dropped = 0;
+      uint64_t rotations = 0;
+    };
+
+    // nullptr if the log file can't be opened
+    static std::shared_ptr<AccessLog> create(const Options &options);
+
+    AccessLog(const AccessLog &) = delete;
+    AccessLog &operator=(const AccessLog &) = delete;
+
+    // Writes out everything still queued, then stops the writer thread
+    ~AccessLog();
+
+    // false if this thread's ring was full and the record was dropped
+    bool push(const LogRecord &record);
+    bool event(std::string_view name, std::string_view message);
+
+    // Blocks until records pushed before the call are written
+    void flush();
+
+    Stats stats() const;
+
+  private:
+    struct Ring;
+
+    explicit AccessLog(const Options &options);
+
+    Ring &localRing();
+    void run();
+    size_t drain(std::string &batch);
+    bool writeBatch(const std::string &batch);
+    void rotate();
+
+    Options options;
+    const uint64_t id;
+
+    std::mutex ringsMutex;
+    std::vector<std::shared_ptr<Ring>> rings;
+
+    std::FILE *file = nullptr;
+    uint64_t fileBytes = 0;
+
+    std::mutex wakeMutex;
+    std::condition_variable wake;
+    std::condition_variable flushed;
+    uint64_t flushRequests = 0;
+    uint64_t flushesDone = 0;
+    bool stopping = false;
+
+    std::atomic<uint64_t> written{0};
+    std::atomic<uint64_t> dropped{0};
+    std::atomic<uint64_t> rotations{0};
+    uint64_t droppedReported = 0;
+
+    std::thread writer;
+  };
+}
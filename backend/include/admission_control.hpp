@@ -0,0 +1,125 @@
+#pragma once
+
+#include <boost/beast/core/string.hpp>
+#include <boost/beast/http/verb.hpp>
+#include <array>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <optional>
+
+namespace bytebucket
+{
+  // What a request costs the server, and so which limit it counts against
+  enum class RouteClass : uint8_t
+  {
+    Upload,   // bodies read into memory and written to disk
+    Download, // blobs read from disk or the cache, archives streamed
+    Metadata, // everything else that touches the database
+    Control,  // health, metrics, stats and debug; never limited, so overload stays observable
+    Count
+  };
+
+  // Caps on concurrent connections and on in-flight requests per route class
+  struct AdmissionLimits
+  {
+    uint64_t maxConnections = 1024;          // 0 for no limit
+    uint64_t maxUploads = 32;                // in flight at once, 0 for no limit
+    uint64_t maxDownloads = 128;
+    uint64_t maxMetadata = 128;
+    uint64_t maxQueued = 64;                 // requests per class allowed to wait for a slot
+    std::chrono::milliseconds queueWait{100}; // longest a queued request waits before it is shed
+    std::chrono::seconds retryAfter{1};      // sent with every 503
+
+    // BYTEBUCKET_MAX_CONNECTIONS, BYTEBUCKET_MAX_UPLOADS, BYTEBUCKET_MAX_DOWNLOADS,
+    // BYTEBUCKET_MAX_METADATA_REQUESTS, BYTEBUCKET_ADMISSION_QUEUE, BYTEBUCKET_ADMISSION_WAIT_MS
+    // and BYTEBUCKET_RETRY_AFTER_S
+    static AdmissionLimits fromEnvironment();
+  };
+
+  // Bounds how much work the thread-per-connection server takes on. A connection
+  // over the cap is answered 503 on the accept thread and closed without getting a
+  // thread of its own; a request over its class's limit waits briefly in a bounded
+  // queue and is otherwise answered 503 before its body is read. Past the limits
+  // the server turns work away quickly instead of slowing every request down.
+  class AdmissionControl
+  {
+    struct Gate;
+
+  public:
+    // Holds one slot until destroyed; must not outlive the AdmissionControl
+    class Ticket
+    {
+    public:
+      Ticket(Ticket &&other) noexcept : gate(other.gate) { other.gate = nullptr; }
+      Ticket &operator=(Ticket &&other) noexcept;
+      ~Ticket();
+
+      Ticket(const Ticket &) = delete;
+      Ticket &operator=(const Ticket &) = delete;
+
+    private:
+      friend class AdmissionControl;
+      explicit Ticket(Gate *gate) : gate(gate) {}
+      Gate *gate;
+    };
+
+    static std::shared_ptr<AdmissionControl> create(const AdmissionLimits &limits = AdmissionLimits{});
+
+    AdmissionControl(const AdmissionControl &) = delete;
+    AdmissionControl &operator=(const AdmissionControl &) = delete;
+
+    static RouteClass classify(boost::beast::http::verb method, boost::beast::string_view target);
+    static const char *routeClassName(RouteClass routeClass);
+
+    // Never waits; nullopt when the connection cap is reached
+    std::optional<Ticket> admitConnection();
+    // Waits up to queueWait when the class is full and its queue isn't; nullopt when shed.
+    // Control requests are always admitted.
+    std::optional<Ticket> admitRequest(RouteClass routeClass);
+
+    const AdmissionLimits &limits() const { return configured; }
+
+    struct GateStats
+    {
+      uint64_t limit = 0; // 0 when unlimited
+      uint64_t inFlight = 0;
+      uint64_t queued = 0;      // waiting for a slot right now
+      uint64_t admitted = 0;
+      uint64_t waited = 0;      // admitted after queueing
+      uint64_t rejected = 0;
+    };
+    struct Stats
+    {
+      GateStats connections;
+      std::array<GateStats, static_cast<size_t>(RouteClass::Control)> requests; // by RouteClass
+    };
+    Stats stats() const;
+
+  private:
+    struct Gate
+    {
+      uint64_t limit = 0;
+      uint64_t maxQueued = 0;
+      mutable std::mutex mutex;
+      std::condition_variable freed;
+      uint64_t inFlight = 0;
+      uint64_t queued = 0;
+      uint64_t admitted = 0;
+      uint64_t waited = 0;
+      uint64_t rejected = 0;
+
+      bool enter(std::chrono::milliseconds wait);
+      void leave();
+      GateStats stats() const;
+    };
+
+    explicit AdmissionControl(const AdmissionLimits &limits);
+
+    AdmissionLimits configured;
+    Gate connectionGate;
+    std::array<Gate, static_cast<size_t>(RouteClass::Control)> requestGates;
+  };
+}
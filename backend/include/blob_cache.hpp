@@ -0,0 +1,85 @@
+#pragma once
+
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace bytebucket
+{
+  // In-memory cache of small blobs, keyed by storage ID, held to a byte budget.
+  // Keys are spread over independently locked shards so concurrent downloads
+  // rarely contend. Each shard is a segmented LRU: new blobs enter a probation
+  // segment and only move to the protected segment when read again, so a scan
+  // of one-off downloads can't push out the blobs that are actually hot.
+  class BlobCache
+  {
+  public:
+    using Blob = std::shared_ptr<const std::vector<char>>;
+
+    struct Stats
+    {
+      uint64_t hits = 0;
+      uint64_t misses = 0;
+      uint64_t insertions = 0;
+      uint64_t evictions = 0;
+      uint64_t invalidations = 0;
+      size_t entries = 0;
+      size_t bytes = 0;
+      size_t capacityBytes = 0;
+    };
+
+    // maxEntryBytes bounds what's worth caching; larger blobs are always read from disk
+    static std::shared_ptr<BlobCache> create(size_t capacityBytes, size_t maxEntryBytes, size_t shardCount = 16);
+
+    BlobCache(const BlobCache &) = delete;
+    BlobCache &operator=(const BlobCache &) = delete;
+
+    // nullptr on a miss
+    Blob get(const std::string &key);
+    // false when the blob is too large to cache
+    bool put(const std::string &key, Blob blob);
+    void erase(const std::string &key);
+    void clear();
+
+    Stats stats() const;
+    size_t maxEntrySize() const { return maxEntryBytes; }
+
+  private:
+    struct Entry
+    {
+      std::string key;
+      Blob blob;
+      bool isProtected = false;
+    };
+
+    struct Shard
+    {
+      mutable std::mutex mutex;
+      std::list<Entry> probation; // most recently used first
+      std::list<Entry> protectedEntries;
+      std::unordered_map<std::string, std::list<Entry>::iterator> index;
+      size_t probationBytes = 0;
+      size_t protectedBytes = 0;
+      uint64_t hits = 0;
+      uint64_t misses = 0;
+      uint64_t insertions = 0;
+      uint64_t evictions = 0;
+      uint64_t invalidations = 0;
+    };
+
+    BlobCache(size_t capacityBytes, size_t maxEntryBytes, size_t shardCount);
+
+    Shard &shardFor(const std::string &key);
+    void unlink(Shard &shard, std::list<Entry>::iterator entry);
+    void evict(Shard &shard);
+
+    std::vector<std::unique_ptr<Shard>> shards;
+    size_t shardCapacity;
+    size_t protectedCapacity;
+    size_t maxEntryBytes;
+  };
+}
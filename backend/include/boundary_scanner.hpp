@@ -0,0 +1,34 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <string>
+#include <string_view>
+
+namespace bytebucket
+{
+  // Substring search specialised for one needle searched many times, such as a
+  // multipart boundary scanned across a whole request body. The needle's tables
+  // are built once. With SSE2, 16 candidate positions are tested at a time by
+  // matching the needle's first and last bytes, and only hits are compared in full.
+  // Without SSE2 it falls back to Boyer-Moore-Horspool.
+  class BoundaryScanner
+  {
+  public:
+    explicit BoundaryScanner(std::string_view needle);
+
+    // Position of the first match at or after from, or std::string_view::npos
+    size_t find(std::string_view haystack, size_t from = 0) const;
+
+    const std::string &needle() const { return pattern; }
+
+  private:
+    size_t findHorspool(std::string_view haystack, size_t from) const;
+#if defined(__SSE2__)
+    size_t findSse2(std::string_view haystack, size_t from) const;
+#endif
+
+    std::string pattern;
+    std::array<size_t, 256> skip; // Horspool shift for each byte value
+  };
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <cstddef>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <zlib.h>
+
+namespace bytebucket
+{
+  // How one route compresses its responses
+  struct CompressionPolicy
+  {
+    bool enabled = true;
+    int level = 6;          // zlib level, 1 (fastest) to 9 (smallest)
+    size_t minSize = 1024;  // smaller bodies aren't worth the gzip header and CPU
+  };
+
+  // Whether an Accept-Encoding header allows the given coding (q-values honoured,
+  // "*" matches anything not listed, q=0 refuses)
+  bool acceptsEncoding(std::string_view acceptEncoding, std::string_view coding);
+
+  // Text-like types that compress well; already-compressed media and archives are excluded
+  bool isCompressibleType(std::string_view contentType);
+
+  // Streaming gzip encoder. Each thread keeps one whose zlib state is reset and
+  // reused for every response instead of being allocated per response.
+  class GzipCompressor
+  {
+  public:
+    static GzipCompressor &forThread();
+
+    GzipCompressor(const GzipCompressor &) = delete;
+    GzipCompressor &operator=(const GzipCompressor &) = delete;
+    GzipCompressor(GzipCompressor &&) = delete;
+    GzipCompressor &operator=(GzipCompressor &&) = delete;
+
+    ~GzipCompressor();
+
+    // Starts a new gzip stream
+    bool begin(int level);
+    // Compresses input, appending whatever output is ready to out
+    bool write(std::string_view input, std::string &out);
+    // Flushes the rest of the stream and its trailer into out
+    bool finish(std::string &out);
+
+    // Whole-buffer convenience over the calling thread's compressor
+    static std::optional<std::string> compress(std::string_view input, int level);
+
+  private:
+    GzipCompressor();
+    bool deflateInto(std::string_view input, int flush, std::string &out);
+
+    z_stream stream{};
+    bool initialised = false;
+    int currentLevel = Z_DEFAULT_COMPRESSION;
+  };
+}
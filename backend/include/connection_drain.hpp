@@ -0,0 +1,77 @@
+#pragma once
+
+#include <boost/asio/ip/tcp.hpp>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <unordered_set>
+
+namespace bytebucket
+{
+  // Lets the server stop without cutting off requests in flight. Every session
+  // registers its socket; on shutdown, sessions waiting for their next request are
+  // closed at once and busy ones close after the response they're writing. Those
+  // still running when the deadline passes have their sockets shut down.
+  class ConnectionDrain
+  {
+    struct Entry
+    {
+      int fd;
+      std::atomic<bool> idle{false};
+    };
+
+  public:
+    using Clock = std::chrono::steady_clock;
+
+    // One session's registration, held for the session's lifetime
+    class Session
+    {
+    public:
+      Session(std::shared_ptr<ConnectionDrain> drain, boost::asio::ip::tcp::socket &socket);
+      ~Session();
+
+      Session(const Session &) = delete;
+      Session &operator=(const Session &) = delete;
+
+      // Called before waiting for the next request. Returns false once the server
+      // is draining, in which case the session shouldn't wait for one.
+      bool idle();
+      // Called once the next request has started arriving
+      void busy();
+
+    private:
+      std::shared_ptr<ConnectionDrain> drain;
+      Entry entry;
+    };
+
+    struct Result
+    {
+      size_t idleClosed = 0; // sessions closed while waiting for a request
+      size_t forced = 0;     // sessions still busy at the deadline
+      bool complete = false; // every session had ended by the time drain returned
+    };
+
+    static std::shared_ptr<ConnectionDrain> create();
+
+    ConnectionDrain(const ConnectionDrain &) = delete;
+    ConnectionDrain &operator=(const ConnectionDrain &) = delete;
+
+    bool draining() const { return isDraining.load(); }
+    size_t activeSessions() const;
+
+    // Closes idle sessions and waits up to timeout for the busy ones to finish,
+    // then shuts down what's left and gives those sessions `grace` to unwind
+    Result drain(Clock::duration timeout, Clock::duration grace = std::chrono::seconds(1));
+
+  private:
+    ConnectionDrain() = default;
+
+    mutable std::mutex mutex;
+    std::condition_variable ended;
+    std::unordered_set<Entry *> entries;
+    std::atomic<bool> isDraining{false};
+  };
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "database.hpp"
+
+namespace bytebucket
+{
+  // Fixed set of read-only connections shared by request threads.
+  // A leased connection is already inside a deferred read transaction, so every
+  // query made through it sees the same WAL snapshot. The transaction ends and the
+  // connection goes back to the pool when the last copy of the lease is dropped.
+  class ConnectionPool : public std::enable_shared_from_this<ConnectionPool>
+  {
+  public:
+    static std::shared_ptr<ConnectionPool> create(const std::string &dbPath = "bytebucket.db", size_t size = 8,
+                                                  const DatabaseTuning &tuning = DatabaseTuning{});
+
+    ConnectionPool(const ConnectionPool &) = delete;
+    ConnectionPool &operator=(const ConnectionPool &) = delete;
+    ConnectionPool(ConnectionPool &&) = delete;
+    ConnectionPool &operator=(ConnectionPool &&) = delete;
+
+    // Blocks while every connection is leased. Returns nullptr if the read
+    // transaction couldn't be started.
+    std::shared_ptr<Database> acquire();
+
+    struct Stats
+    {
+      size_t size = 0;
+      size_t idle = 0;
+      uint64_t acquisitions = 0;
+      uint64_t waits = 0;          // acquisitions that found the pool empty
+      uint64_t waitMicroseconds = 0; // total time spent waiting for a connection
+      CacheCounters cache;           // page cache hits/misses summed over finished leases
+    };
+    Stats stats() const;
+
+  private:
+    ConnectionPool() = default;
+
+    void release(std::shared_ptr<Database> connection);
+
+    size_t size = 0;
+    std::vector<std::shared_ptr<Database>> idle;
+    mutable std::mutex mutex;
+    std::condition_variable available;
+
+    std::atomic<uint64_t> acquisitionCount{0};
+    std::atomic<uint64_t> waitCount{0};
+    std::atomic<uint64_t> waitMicros{0};
+    std::atomic<int64_t> cacheHits{0};
+    std::atomic<int64_t> cacheMisses{0};
+  };
+}
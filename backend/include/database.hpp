@@ -1,11 +1,14 @@
 #pragma once
 
+#include <cstdint>
 #include <string>
+#include <utility>
 #include <vector>
 #include <chrono>
 #include <optional>
 #include <memory>
 #include <sqlite3.h>
+#include "query_profiler.hpp"
 
 namespace bytebucket
 {
@@ -18,9 +21,21 @@ namespace bytebucket
     int folderId;
     std::chrono::system_clock::time_point createdAt;
     std::chrono::system_clock::time_point updatedAt;
-    int size;
+    int64_t size; // bytes
     std::string contentType;
     std::string storageId; // id in local storage folder
+    std::string codec = "identity"; // blob encoding at rest; size is always the decoded size
+  };
+
+  // one row for Database::addFiles; the views must outlive the call
+  struct NewFile
+  {
+    std::string_view name;
+    int folderId;
+    int64_t size;
+    std::string_view contentType;
+    std::string_view storageId;
+    std::string_view codec = "identity";
   };
 
   struct FolderRecord
@@ -30,6 +45,64 @@ namespace bytebucket
     std::optional<int> parentId;
   };
 
+  // Everything under one folder, for walking a whole tree in two queries
+  struct FolderSubtree
+  {
+    std::vector<FolderRecord> folders; // the root first, every parent before its children
+    std::vector<FileRecord> files;     // files in any of those folders
+  };
+
+  // A resumable upload in progress, kept so it can be picked up again after a restart
+  struct UploadSessionRecord
+  {
+    std::string id; // storage ID; the partial file is "{id}.part"
+    std::string filename;
+    std::string contentType;
+    std::optional<int> folderId;
+    int64_t size = 0;
+    std::vector<std::pair<int64_t, int64_t>> ranges; // received [start, end) byte ranges
+    uint64_t revision = 0;                           // ranges are only replaced by a higher revision
+  };
+
+  enum class MetadataOp
+  {
+    Equals,
+    NotEquals,
+    LessThan,
+    LessOrEqual,
+    GreaterThan,
+    GreaterOrEqual,
+    Exists
+  };
+
+  // Range operators compare numerically when the operand parses as a number,
+  // otherwise they fall back to comparing the text value
+  struct MetadataPredicate
+  {
+    std::string key;
+    MetadataOp op = MetadataOp::Equals;
+    std::string value;
+  };
+
+  enum class FileSortField
+  {
+    Name,
+    Size,
+    CreatedAt,
+    UpdatedAt,
+    Metadata // sorts by the value stored under FileQuery::sortKey
+  };
+
+  struct FileQuery
+  {
+    std::vector<MetadataPredicate> predicates;
+    FileSortField sortBy = FileSortField::Name;
+    std::string sortKey;
+    bool descending = false;
+    int limit = 100;
+    int offset = 0;
+  };
+
   enum class DatabaseError
   {
     Success,
@@ -40,6 +113,42 @@ namespace bytebucket
     UnknownError
   };
 
+  enum class TempStore
+  {
+    Default = 0,
+    File = 1,
+    Memory = 2
+  };
+
+  // Per-connection SQLite memory and locking settings, applied as each connection opens
+  struct DatabaseTuning
+  {
+    int64_t mmapSize = 256LL * 1024 * 1024; // bytes of the file to memory-map, 0 disables
+    int64_t cacheSize = -65536;             // pages when positive, KiB when negative (64 MiB)
+    TempStore tempStore = TempStore::Memory;
+    int busyTimeoutMs = 5000; // wait on a held lock instead of failing with SQLITE_BUSY
+
+    // defaults above, overridden by BYTEBUCKET_SQLITE_MMAP_SIZE, BYTEBUCKET_SQLITE_CACHE_SIZE,
+    // BYTEBUCKET_SQLITE_TEMP_STORE (default|file|memory) and BYTEBUCKET_SQLITE_BUSY_TIMEOUT_MS
+    static DatabaseTuning fromEnvironment();
+  };
+
+  struct CacheCounters
+  {
+    int64_t hits = 0;
+    int64_t misses = 0;
+  };
+
+  // Live values read back from the connection rather than what was requested
+  struct DatabaseTuningStatus
+  {
+    DatabaseTuning applied;
+    int64_t pageSize = 0;
+    int64_t pageCount = 0;
+    int64_t cacheUsedBytes = 0;
+    CacheCounters cache;
+  };
+
   template <typename T>
   struct DatabaseResult
   {
@@ -54,7 +163,15 @@ namespace bytebucket
   class Database
   {
   public:
-    static std::shared_ptr<Database> create(const std::string &dbPath = "bytebucket.db");
+    // Schema version this build migrates databases to, kept in PRAGMA user_version
+    static constexpr int SCHEMA_VERSION = 7;
+
+    // read-write connection; brings the schema up to SCHEMA_VERSION first if it's behind
+    static std::shared_ptr<Database> create(const std::string &dbPath = "bytebucket.db",
+                                            const DatabaseTuning &tuning = DatabaseTuning{});
+    // read-only connection (query_only, no schema work); the database must already exist
+    static std::shared_ptr<Database> createReadOnly(const std::string &dbPath = "bytebucket.db",
+                                                    const DatabaseTuning &tuning = DatabaseTuning{});
 
     Database(const Database &) = delete;
     Database &operator=(const Database &) = delete;
@@ -63,13 +180,34 @@ namespace bytebucket
 
     ~Database();
 
+    // transactions
+    bool beginTransaction(bool immediate = false);
+    bool commitTransaction();
+    bool rollbackTransaction();
+    bool savepoint(std::string_view name);
+    bool releaseSavepoint(std::string_view name);
+    bool rollbackToSavepoint(std::string_view name);
+
+    // tuning
+    DatabaseResult<DatabaseTuningStatus> getTuningStatus() const;
+    // user_version of the open database; 0 for databases from before versioning
+    DatabaseResult<int> getSchemaVersion() const;
+    // page cache hits and misses since the connection opened or the last reset
+    CacheCounters getCacheCounters(bool reset = false) const;
+    // copies the whole WAL back into the database file and truncates it.
+    // Needs the write lock, so only call it outside a transaction.
+    DatabaseResult<bool> checkpoint();
+
     // files
     DatabaseResult<int> addFile(
         std::string_view name,
         int folderId,
-        int size,
+        int64_t size,
         std::string_view contentType,
-        std::string_view storageId);
+        std::string_view storageId,
+        std::string_view codec = "identity");
+    // Inserts every file or none, returning the stored rows in input order
+    DatabaseResult<std::vector<FileRecord>> addFiles(const std::vector<NewFile> &files);
     DatabaseResult<FileRecord> getFileById(int id) const;
     DatabaseResult<FileRecord> getFileByStorageId(std::string_view storageId) const;
     DatabaseResult<std::vector<FileRecord>> getFilesByFolder(int folderId) const;
@@ -77,11 +215,15 @@ namespace bytebucket
     DatabaseResult<bool> deleteFile(int id);
     DatabaseResult<bool> renameFile(int id, std::string_view name);
     DatabaseResult<bool> moveFile(int id, int parentId);
+    // Copies up to batchSize legacy TEXT timestamps into the epoch-ms columns.
+    // Returns how many rows were converted; 0 once nothing is left to migrate.
+    DatabaseResult<int> migrateLegacyTimestamps(int batchSize = 500);
 
     // folders
     DatabaseResult<int> insertFolder(std::string_view name, std::optional<int> parentId = std::nullopt);
     DatabaseResult<FolderRecord> getFolderById(int id) const;
     DatabaseResult<std::vector<FolderRecord>> getFoldersByParent(std::optional<int> parentId) const;
+    DatabaseResult<FolderSubtree> getFolderSubtree(int id) const;
     DatabaseResult<bool> deleteFolder(int id);
     DatabaseResult<bool> renameFolder(int id, std::string_view name);
     DatabaseResult<bool> moveFolder(int id, int parentId);
@@ -100,10 +242,30 @@ namespace bytebucket
     DatabaseResult<std::string> getFileMetadata(int fileId, std::string_view key) const;
     DatabaseResult<std::vector<std::pair<std::string, std::string>>> getAllFileMetadata(int fileId) const;
     DatabaseResult<bool> removeFileMetadata(int fileId, std::string_view key);
+    DatabaseResult<std::vector<FileRecord>> findFilesByMetadata(const FileQuery &query) const;
+
+    // upload sessions
+    DatabaseResult<bool> addUploadSession(const UploadSessionRecord &session);
+    // Only updates an existing row at a lower revision, so a late update can neither
+    // bring back a finished session nor replace newer ranges with older ones.
+    // value is false when nothing was updated for either reason.
+    DatabaseResult<bool> updateUploadSessionRanges(std::string_view id,
+                                                   const std::vector<std::pair<int64_t, int64_t>> &ranges,
+                                                   uint64_t revision);
+    DatabaseResult<bool> deleteUploadSession(std::string_view id);
+    DatabaseResult<std::vector<UploadSessionRecord>> getUploadSessions() const;
+
+    // Connections opened after this is set report their statements to it; nullptr stops that
+    static void setQueryProfiler(std::shared_ptr<QueryProfiler> profiler);
+    static std::shared_ptr<QueryProfiler> getQueryProfiler();
 
   private:
     explicit Database(sqlite3 *db);
 
+    inline static std::shared_ptr<QueryProfiler> queryProfiler;
+    // declared before db so it's destroyed after the connection closes
+    std::unique_ptr<QueryProfiler::Connection> trace;
+
     struct SQLiteDeleter
     {
       void operator()(sqlite3 *db)
@@ -116,7 +278,21 @@ namespace bytebucket
     std::unique_ptr<sqlite3, SQLiteDeleter> db;
     // when it's destroyed, it should call SQLiteDeleter::operator()(sqlite3*)
 
-    bool executeSchema() const;
-    bool executePragma() const;
+    bool executeStatement(const std::string &sql) const;
+    // runs the migrations newer than the database's user_version, all in one exclusive transaction
+    bool migrate() const;
+    bool createBaseSchema() const;
+    bool createMetadataIndexes() const;
+    bool executePragma(const DatabaseTuning &tuning) const;
+    bool applyTuning(const DatabaseTuning &tuning) const;
+    std::optional<int64_t> queryPragmaInt(const char *pragma) const;
+    bool migrateMetadataNumericValues() const;
+    bool migrateFileTimestampColumns() const;
+    bool migrateFileCodecColumn() const;
+    bool createUploadSessionsTable() const;
+    bool migrateUploadSessionRevision() const;
+    bool hasColumn(const char *table, std::string_view column) const;
+    // fills a FileRecord from the standard id..codec column list
+    FileRecord readFileRecord(sqlite3_stmt *stmt) const;
   };
 }
\ No newline at end of file
@@ -0,0 +1,143 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <condition_variable>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include "database.hpp"
+#include "mpsc_queue.hpp"
+#include "tracing.hpp"
+
+namespace bytebucket
+{
+  // Owns the only read-write SQLite connection and applies every mutation on one
+  // thread. Requests queue their writes and get a future back; the writer runs
+  // whatever is pending inside a single transaction (one savepoint per write so a
+  // failed write doesn't undo its neighbours) and fulfils the futures once the
+  // transaction has committed.
+  class DatabaseWriter
+  {
+  public:
+    // commitWindow bounds how long one transaction keeps absorbing newly queued writes
+    static std::shared_ptr<DatabaseWriter> create(
+        const std::string &dbPath = "bytebucket.db",
+        std::chrono::milliseconds commitWindow = std::chrono::milliseconds(2),
+        size_t maxBatchSize = 256,
+        const DatabaseTuning &tuning = DatabaseTuning{});
+
+    DatabaseWriter(const DatabaseWriter &) = delete;
+    DatabaseWriter &operator=(const DatabaseWriter &) = delete;
+    DatabaseWriter(DatabaseWriter &&) = delete;
+    DatabaseWriter &operator=(DatabaseWriter &&) = delete;
+
+    ~DatabaseWriter();
+
+    // mutation is called as mutation(Database &) on the writer thread and must return
+    // a DatabaseResult. The future resolves after the surrounding transaction commits.
+    template <typename F>
+    auto submit(F &&mutation) -> std::future<std::invoke_result_t<std::decay_t<F> &, Database &>>
+    {
+      using Result = std::invoke_result_t<std::decay_t<F> &, Database &>;
+      auto write = new Write<std::decay_t<F>, Result>(std::forward<F>(mutation));
+      auto future = write->promise.get_future();
+      enqueue(write);
+      return future;
+    }
+
+    // Finishes everything already queued, then stops the writer thread.
+    // Writes submitted afterwards fail immediately.
+    void stop();
+
+    // Checkpoints and truncates the WAL on the writer's connection. Only after stop(),
+    // since the connection belongs to the writer thread until then.
+    DatabaseResult<bool> checkpoint();
+
+    struct Stats
+    {
+      uint64_t transactions = 0;
+      uint64_t writes = 0;
+      uint64_t failedCommits = 0;
+    };
+    Stats stats() const;
+
+  private:
+    DatabaseWriter(std::shared_ptr<Database> db, std::chrono::milliseconds commitWindow, size_t maxBatchSize);
+
+    struct PendingWrite
+    {
+      virtual ~PendingWrite() = default;
+      // returns false when the write failed and its savepoint should be rolled back
+      virtual bool run(Database &db) = 0;
+      virtual void complete(bool committed, const std::string &errorMessage) = 0;
+      PendingWrite *next = nullptr;
+    };
+
+    template <typename F, typename Result>
+    struct Write : PendingWrite
+    {
+      explicit Write(F &&fn) : mutation(std::move(fn)), trace(Tracer::current()) {}
+      explicit Write(const F &fn) : mutation(fn), trace(Tracer::current()) {}
+
+      bool run(Database &db) override
+      {
+        // the write's spans belong to the request that queued it
+        TraceScope scope(trace);
+        try
+        {
+          result = mutation(db);
+        }
+        catch (const std::exception &e)
+        {
+          result = Result{};
+          result.error = DatabaseError::UnknownError;
+          result.errorMessage = std::string("Write failed: ") + e.what();
+        }
+        return result.success();
+      }
+
+      void complete(bool committed, const std::string &errorMessage) override
+      {
+        if (!committed && result.success())
+        {
+          result.value.reset();
+          result.error = DatabaseError::UnknownError;
+          result.errorMessage = errorMessage;
+        }
+        promise.set_value(std::move(result));
+      }
+
+      F mutation;
+      std::shared_ptr<Trace> trace;
+      Result result;
+      std::promise<Result> promise;
+    };
+
+    void enqueue(PendingWrite *write);
+    void run();
+    void commitBatch(PendingWrite *first);
+    static void failAll(PendingWrite *list, const std::string &errorMessage);
+
+    std::shared_ptr<Database> db;
+    std::chrono::milliseconds commitWindow;
+    size_t maxBatchSize;
+
+    MpscQueue<PendingWrite> queue;
+    PendingWrite *carry = nullptr; // only touched by the writer thread
+    std::mutex wakeMutex;
+    std::condition_variable wake;
+    std::atomic<bool> stopping{false};
+    std::atomic<bool> stopped{false};
+    std::thread thread;
+
+    std::atomic<uint64_t> transactionCount{0};
+    std::atomic<uint64_t> writeCount{0};
+    std::atomic<uint64_t> failedCommitCount{0};
+  };
+}
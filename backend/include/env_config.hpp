@@ -0,0 +1,19 @@
+#pragma once
+
+#include <cstdint>
+#include <optional>
+
+namespace bytebucket
+{
+  // Integer settings from BYTEBUCKET_* environment variables. Both return nullopt
+  // when the variable is unset or empty, and log and ignore a value that isn't a
+  // whole number, so a typo falls back to the default instead of stopping the server.
+  std::optional<int64_t> readEnvInteger(const char *name);
+
+  // As readEnvInteger, but a negative value is invalid too
+  std::optional<uint64_t> readEnvCount(const char *name);
+
+  // As readEnvCount, but returns fallback when the variable is unset or invalid,
+  // and a value under minimum is invalid too
+  uint64_t readEnvCount(const char *name, uint64_t fallback, uint64_t minimum);
+}
@@ -1,12 +1,22 @@
 #pragma once
 
+#include <cstdint>
 #include <string>
+#include <string_view>
+#include <unordered_set>
 #include <vector>
 #include <optional>
 #include <filesystem>
 
 namespace bytebucket
 {
+  // A saved blob and how its bytes are encoded on disk. Codec names are HTTP
+  // content-codings, so a stored blob can be sent as-is to a client accepting it.
+  struct StoredBlob
+  {
+    std::string fileId;
+    std::string codec; // "identity" or "gzip"
+  };
 
   class FileStorage
   {
@@ -21,6 +31,22 @@ namespace bytebucket
         const std::string &filename,
         const std::vector<char> &content,
         const std::string &content_type = "application/octet-stream");
+    static std::optional<std::string> saveFile(
+        const std::string &filename,
+        std::string_view content,
+        const std::string &content_type = "application/octet-stream");
+
+    // Save file, gzipping it at rest when that pays off: text-like content types
+    // are tried directly, anything else only if a sample of it compresses well.
+    // Kept plain when compression is disabled or saves under 10%.
+    static std::optional<StoredBlob> saveBlob(
+        const std::string &filename,
+        std::string_view content,
+        const std::string &content_type = "application/octet-stream");
+
+    // Compression at rest is on by default; set before serving requests
+    static void setBlobCompression(bool enabled);
+    static bool blobCompressionEnabled();
 
     // Get file path by ID
     static std::optional<std::filesystem::path> getFilePath(const std::string &file_id);
@@ -42,6 +68,41 @@ namespace bytebucket
 
     // Initialize storage directory (create if doesn't exist)
     static bool initializeStorage();
+
+    // Partial files back resumable uploads. They live beside finished blobs as
+    // "{file_id}.part" and only take the plain file ID once committed.
+
+    // Create and preallocate a partial file of the given size; returns its file ID
+    static std::optional<std::string> createPartialFile(int64_t size);
+
+    // Write bytes at an offset with pwrite and sync them to disk; safe to call
+    // concurrently for disjoint ranges
+    static bool writePartialFile(const std::string &file_id, int64_t offset, const char *data, size_t length);
+
+    // Flush the partial file, rename it into place and write its metadata
+    static bool commitPartialFile(
+        const std::string &file_id,
+        const std::string &filename,
+        const std::string &content_type,
+        int64_t size);
+
+    static bool deletePartialFile(const std::string &file_id);
+
+    // Size of a partial file on disk, or nullopt if there is none
+    static std::optional<int64_t> partialFileSize(const std::string &file_id);
+
+    // Deletes every partial file whose ID isn't in keep; returns how many went
+    static size_t deletePartialFilesExcept(const std::unordered_set<std::string> &keep);
+
+  private:
+    inline static bool compressBlobs = true;
+
+    static std::filesystem::path getPartialFilePath(const std::string &file_id);
+    static void writeMetadataFile(
+        const std::string &file_id,
+        const std::string &filename,
+        const std::string &content_type,
+        int64_t size);
   };
 
 }
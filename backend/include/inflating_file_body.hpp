@@ -0,0 +1,68 @@
+#pragma once
+
+#include <boost/asio/buffer.hpp>
+#include <boost/beast/core/error.hpp>
+#include <boost/beast/core/file.hpp>
+#include <boost/beast/http/message.hpp>
+#include <boost/optional.hpp>
+#include <cstdint>
+#include <memory>
+#include <utility>
+#include <zlib.h>
+
+namespace bytebucket
+{
+  // Beast body that serves a gzip-compressed file as its decoded bytes. The file
+  // is read and inflated a chunk at a time while the response is written, so a
+  // compressed blob never has to be expanded in memory or on disk. The decoded
+  // size is known up front, so responses keep a Content-Length.
+  struct InflatingFileBody
+  {
+    class writer;
+
+    class value_type
+    {
+    public:
+      void open(const char *path, std::uint64_t decodedSize, boost::beast::error_code &ec);
+      bool is_open() const { return file.is_open(); }
+      std::uint64_t size() const { return decodedSize; }
+
+    private:
+      friend class writer;
+      boost::beast::file file;
+      std::uint64_t decodedSize = 0;
+    };
+
+    static std::uint64_t size(const value_type &body) { return body.size(); }
+
+    class writer
+    {
+    public:
+      using const_buffers_type = boost::asio::const_buffer;
+
+      template <bool isRequest, class Fields>
+      writer(boost::beast::http::header<isRequest, Fields> &, value_type &body) : body(body)
+      {
+      }
+
+      writer(const writer &) = delete;
+      writer &operator=(const writer &) = delete;
+
+      ~writer();
+
+      void init(boost::beast::error_code &ec);
+      boost::optional<std::pair<const_buffers_type, bool>> get(boost::beast::error_code &ec);
+
+    private:
+      static constexpr std::size_t CHUNK = 64 * 1024;
+
+      value_type &body;
+      z_stream stream{};
+      bool initialised = false;
+      bool fileDone = false;
+      bool streamDone = false;
+      std::unique_ptr<char[]> input;
+      std::unique_ptr<char[]> output;
+    };
+  };
+}
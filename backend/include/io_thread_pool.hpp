@@ -0,0 +1,60 @@
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+#include "tracing.hpp"
+
+namespace bytebucket
+{
+  // Fixed set of threads for blocking file I/O, so one request can keep several
+  // disk writes in flight instead of issuing them one after another.
+  class IoThreadPool
+  {
+  public:
+    static std::shared_ptr<IoThreadPool> create(size_t threadCount = std::thread::hardware_concurrency());
+
+    IoThreadPool(const IoThreadPool &) = delete;
+    IoThreadPool &operator=(const IoThreadPool &) = delete;
+    IoThreadPool(IoThreadPool &&) = delete;
+    IoThreadPool &operator=(IoThreadPool &&) = delete;
+
+    // Finishes queued tasks, then joins the threads
+    ~IoThreadPool();
+
+    template <typename F>
+    auto submit(F &&task) -> std::future<std::invoke_result_t<std::decay_t<F> &>>
+    {
+      using Result = std::invoke_result_t<std::decay_t<F> &>;
+      auto packaged = std::make_shared<std::packaged_task<Result()>>(std::forward<F>(task));
+      auto future = packaged->get_future();
+      {
+        std::lock_guard<std::mutex> lock(mutex);
+        tasks.emplace_back([packaged, trace = Tracer::current()]()
+                           {
+                             TraceScope scope(trace);
+                             (*packaged)(); });
+      }
+      available.notify_one();
+      return future;
+    }
+
+    size_t size() const { return threads.size(); }
+
+  private:
+    IoThreadPool() = default;
+    void run();
+
+    std::vector<std::thread> threads;
+    std::deque<std::function<void()>> tasks;
+    std::mutex mutex;
+    std::condition_variable available;
+    bool stopping = false;
+  };
+}
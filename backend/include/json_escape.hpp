@@ -0,0 +1,40 @@
+#pragma once
+
+#include <cstdio>
+#include <string>
+#include <string_view>
+
+namespace bytebucket
+{
+  // Appends text as a quoted JSON string. Quotes and backslashes are escaped and
+  // control characters written as \u00XX; other bytes, UTF-8 included, pass through.
+  inline void appendJsonString(std::string &out, std::string_view text)
+  {
+    out += '"';
+    for (char c : text)
+    {
+      if (c == '"' || c == '\\')
+      {
+        out += '\\';
+        out += c;
+      }
+      else if (static_cast<unsigned char>(c) < 0x20)
+      {
+        char escaped[8];
+        std::snprintf(escaped, sizeof(escaped), "\\u%04x", static_cast<unsigned>(c));
+        out += escaped;
+      }
+      else
+        out += c;
+    }
+    out += '"';
+  }
+
+  inline std::string jsonString(std::string_view text)
+  {
+    std::string out;
+    out.reserve(text.size() + 2);
+    appendJsonString(out, text);
+    return out;
+  }
+}
@@ -0,0 +1,173 @@
+#pragma once
+
+#include <boost/asio/buffer.hpp>
+#include <boost/beast/core/error.hpp>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace bytebucket
+{
+  // Routes as matched by handle_request; metrics are labelled with these
+  enum class Route : uint8_t
+  {
+    Options,
+    Health,
+    Root,
+    GetFolderArchive,
+    GetFolder,
+    PostFolder,
+    DeleteFolder,
+    PostUpload,
+    DeleteFile,
+    PatchFileMove,
+    GetDownload,
+    GetTags,
+    PostTags,
+    PostFileTags,
+    DeleteFileTag,
+    PostFileMetadata,
+    DeleteFileMetadata,
+    SearchMetadata,
+    PostUploadSession,
+    PostUploadComplete,
+    PutUploadChunk,
+    GetUploadSession,
+    DeleteUploadSession,
+    GetDatabaseStats,
+    GetCacheStats,
+    GetMetrics,
+    GetQueryProfile,
+    GetTraces,
+    Rejected, // refused by check_request_header before routing
+    NotFound,
+    Count
+  };
+
+  enum class StorageOp : uint8_t
+  {
+    Read,
+    Write,
+    Delete,
+    Count
+  };
+
+  // What a connection was waiting on when its deadline passed
+  enum class TimeoutPhase : uint8_t
+  {
+    Idle,   // the next request on a kept-alive connection
+    Header, // the rest of a request's headers
+    Body,   // a request body arriving too slowly
+    Write,  // a client not reading its response
+    Count
+  };
+
+  // Process-wide request, connection and storage metrics. Each thread records
+  // into its own block of counters with plain relaxed stores, so recording
+  // costs a few nanoseconds and never takes a lock; a scrape sums the blocks.
+  // Latencies go into log-linear histograms with four buckets per power of two
+  // of microseconds, so a recorded value is within 25% of its bucket's bounds.
+  class Metrics
+  {
+  public:
+    using Clock = std::chrono::steady_clock;
+
+    static void recordRequest(Route route, unsigned status, uint64_t bytesIn, uint64_t bytesOut,
+                              Clock::duration elapsed);
+    static void recordStorage(StorageOp op, Clock::duration elapsed);
+
+    static void connectionOpened();
+    static void connectionClosed();
+    static void connectionTimedOut(TimeoutPhase phase);
+    static const char *timeoutPhaseName(TimeoutPhase phase);
+
+    // Everything above in Prometheus text exposition format
+    static std::string renderPrometheus();
+
+    // Histogram layout, exposed for tests
+    static constexpr size_t HISTOGRAM_BUCKETS = 116;
+    static size_t bucketFor(uint64_t micros);
+    static uint64_t bucketUpperBound(size_t bucket); // exclusive, in microseconds
+
+    static const char *routeMethod(Route route);
+    static const char *routePath(Route route);
+  };
+
+  // Times a storage operation for the lifetime of the scope
+  class StorageTimer
+  {
+  public:
+    explicit StorageTimer(StorageOp op) : op(op), started(Metrics::Clock::now()) {}
+    ~StorageTimer() { Metrics::recordStorage(op, Metrics::Clock::now() - started); }
+
+    StorageTimer(const StorageTimer &) = delete;
+    StorageTimer &operator=(const StorageTimer &) = delete;
+
+  private:
+    StorageOp op;
+    Metrics::Clock::time_point started;
+  };
+
+  // Write stream that forwards to another and notes the status code of the
+  // response passing through, along with the bytes written. Beast's
+  // message_generator hides the response, so this is where the status is seen.
+  template <class NextLayer>
+  class MeteredWriteStream
+  {
+  public:
+    explicit MeteredWriteStream(NextLayer &next) : next(next) {}
+
+    template <class ConstBufferSequence>
+    size_t write_some(const ConstBufferSequence &buffers)
+    {
+      boost::beast::error_code ec;
+      size_t written = write_some(buffers, ec);
+      if (ec)
+        throw boost::system::system_error(ec);
+      return written;
+    }
+
+    template <class ConstBufferSequence>
+    size_t write_some(const ConstBufferSequence &buffers, boost::beast::error_code &ec)
+    {
+      size_t written = next.write_some(buffers, ec);
+      // "HTTP/1.1 200": the status line's first 12 bytes
+      size_t taken = 0;
+      for (auto it = boost::asio::buffer_sequence_begin(buffers);
+           it != boost::asio::buffer_sequence_end(buffers) && headLength < head.size() && taken < written; ++it)
+      {
+        boost::asio::const_buffer buffer(*it);
+        const char *data = static_cast<const char *>(buffer.data());
+        for (size_t i = 0; i < buffer.size() && headLength < head.size() && taken < written; ++i, ++taken)
+          head[headLength++] = data[i];
+      }
+      bytes += written;
+      return written;
+    }
+
+    unsigned status() const
+    {
+      if (headLength < head.size())
+        return 0;
+      return static_cast<unsigned>((head[9] - '0') * 100 + (head[10] - '0') * 10 + (head[11] - '0'));
+    }
+
+    uint64_t bytesWritten() const { return bytes; }
+
+    // starts over for the next response on the connection
+    void reset()
+    {
+      headLength = 0;
+      bytes = 0;
+    }
+
+  private:
+    NextLayer &next;
+    std::array<char, 12> head{};
+    size_t headLength = 0;
+    uint64_t bytes = 0;
+  };
+}
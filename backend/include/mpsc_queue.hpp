@@ -0,0 +1,51 @@
+#pragma once
+
+#include <atomic>
+
+namespace bytebucket
+{
+  // Intrusive lock-free multi-producer single-consumer queue.
+  // Producers push with a single CAS on the head; the consumer detaches the whole
+  // list with one exchange and reverses it, so items come back in FIFO order.
+  // T must expose a `T *next` member that the queue is free to overwrite.
+  template <typename T>
+  class MpscQueue
+  {
+  public:
+    MpscQueue() = default;
+    MpscQueue(const MpscQueue &) = delete;
+    MpscQueue &operator=(const MpscQueue &) = delete;
+
+    // Returns true when the queue was empty before this push, so callers
+    // only need to wake the consumer on the empty -> non-empty transition
+    bool push(T *node)
+    {
+      T *current = head.load(std::memory_order_relaxed);
+      do
+      {
+        node->next = current;
+      } while (!head.compare_exchange_weak(current, node, std::memory_order_release, std::memory_order_relaxed));
+      return current == nullptr;
+    }
+
+    // Detaches every queued item, oldest first
+    T *popAll()
+    {
+      T *list = head.exchange(nullptr, std::memory_order_acquire);
+      T *ordered = nullptr;
+      while (list)
+      {
+        T *next = list->next;
+        list->next = ordered;
+        ordered = list;
+        list = next;
+      }
+      return ordered;
+    }
+
+    bool empty() const { return head.load(std::memory_order_acquire) == nullptr; }
+
+  private:
+    std::atomic<T *> head{nullptr};
+  };
+}
@@ -1,8 +1,8 @@
 #pragma once
 
 #include <string>
+#include <string_view>
 #include <vector>
-#include <unordered_map>
 #include <optional>
 
 namespace bytebucket
@@ -28,15 +28,47 @@ namespace bytebucket
     std::vector<MultipartField> fields;
   };
 
+  // Non-owning counterparts: every string_view points into the request body
+  // passed to parseView, so they're only valid while that body is alive
+
+  struct MultipartFileView
+  {
+    std::string_view name;
+    std::string_view filename;
+    std::string_view content_type;
+    std::string_view content;
+
+    MultipartFile toOwned() const;
+  };
+
+  struct MultipartFieldView
+  {
+    std::string_view name;
+    std::string_view value;
+
+    MultipartField toOwned() const;
+  };
+
+  struct MultipartView
+  {
+    std::vector<MultipartFileView> files;
+    std::vector<MultipartFieldView> fields;
+
+    MultipartData toOwned() const;
+  };
+
   class MultipartParser
   {
   public:
     static std::optional<MultipartData> parse(const std::string &body, const std::string &boundary);
+    // Parses without copying part data; allocations don't grow with part size
+    static std::optional<MultipartView> parseView(std::string_view body, std::string_view boundary);
     static std::string extractBoundary(const std::string &content_type);
     static std::string trim(const std::string &str);
 
   private:
-    static std::unordered_map<std::string, std::string> parseHeaders(const std::string &header_section);
+    static std::string_view trimView(std::string_view str);
+    static bool equalsIgnoreCase(std::string_view a, std::string_view b);
   };
 
 }
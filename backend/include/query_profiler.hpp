@@ -0,0 +1,81 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <sqlite3.h>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace bytebucket
+{
+  // Aggregates per-statement timings that SQLite reports through
+  // sqlite3_trace_v2: calls, rows and time for each normalised SQL text.
+  // Statements slower than the threshold are logged with their query plan,
+  // which is worked out on a separate read-only connection so the traced
+  // connection is never re-entered from its own callback.
+  class QueryProfiler
+  {
+  public:
+    struct QueryStats
+    {
+      std::string sql;
+      uint64_t calls = 0;
+      uint64_t rows = 0;
+      uint64_t totalNanoseconds = 0;
+      uint64_t maxNanoseconds = 0;
+      uint64_t slowCalls = 0;
+      std::string plan; // EXPLAIN QUERY PLAN, filled in the first time the statement is slow
+    };
+
+    // Per-connection trace state, handed to SQLite as the callback context.
+    // It must outlive the connection it was attached to.
+    class Connection
+    {
+    private:
+      friend class QueryProfiler;
+      explicit Connection(std::shared_ptr<QueryProfiler> profiler) : profiler(std::move(profiler)) {}
+
+      std::shared_ptr<QueryProfiler> profiler;
+      std::unordered_map<sqlite3_stmt *, uint64_t> rows; // rows stepped so far, per running statement
+    };
+
+    static std::shared_ptr<QueryProfiler> create(const std::string &dbPath, std::chrono::milliseconds slowThreshold);
+
+    QueryProfiler(const QueryProfiler &) = delete;
+    QueryProfiler &operator=(const QueryProfiler &) = delete;
+    ~QueryProfiler();
+
+    // Starts tracing db; keep the returned state alive until after the connection closes
+    static std::unique_ptr<Connection> attach(std::shared_ptr<QueryProfiler> profiler, sqlite3 *db);
+
+    // Most expensive statements first, by total time
+    std::vector<QueryStats> snapshot() const;
+    void reset();
+
+    std::chrono::milliseconds slowThreshold() const { return threshold; }
+
+    // Collapses whitespace and replaces literals, so statements differing only
+    // in inlined values or the length of an IN (?, ?, ...) list aggregate together
+    static std::string normalise(std::string_view sql);
+
+  private:
+    QueryProfiler(std::string dbPath, std::chrono::milliseconds slowThreshold);
+
+    static int traceCallback(unsigned type, void *context, void *p, void *x);
+    void record(sqlite3_stmt *stmt, uint64_t nanoseconds, uint64_t rows);
+    std::string explain(const std::string &sql);
+
+    std::string dbPath;
+    std::chrono::milliseconds threshold;
+
+    mutable std::mutex mutex;
+    std::unordered_map<std::string, QueryStats> queries;
+
+    std::mutex planMutex;
+    sqlite3 *planDb = nullptr;
+  };
+}
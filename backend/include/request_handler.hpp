@@ -2,10 +2,42 @@
 
 #include <boost/beast/core.hpp>
 #include <boost/beast/http.hpp>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <sstream>
 #include <string>
 
 namespace bytebucket
 {
+  class DatabaseWriter;
+  class ConnectionPool;
+  class IoThreadPool;
+  class BlobCache;
+  class AdmissionControl;
+  class Database;
+  struct FileRecord;
+  enum class Route : uint8_t;
+
+  // Largest request body a session will read
+  constexpr uint64_t MAX_REQUEST_BODY_SIZE = 100 * 1024 * 1024;
+
+  // Mutations are routed through this writer once set; call before serving requests
+  void setDatabaseWriter(std::shared_ptr<DatabaseWriter> writer);
+  // Reads lease connections from this pool once set
+  void setConnectionPool(std::shared_ptr<ConnectionPool> pool);
+  // Upload blob writes fan out across this pool once set
+  void setIoThreadPool(std::shared_ptr<IoThreadPool> pool);
+  // Small hot blobs are served from this cache once set
+  void setBlobCache(std::shared_ptr<BlobCache> cache);
+  // Admission limits and queue depths are reported by /metrics once set
+  void setAdmissionControl(std::shared_ptr<AdmissionControl> admission);
+  // Picks up the upload sessions recorded before a restart and deletes partial
+  // files that no session owns; call once the database is set up, before serving.
+  // Returns how many sessions were restored.
+  size_t restore_upload_sessions();
+
   template <typename T>
   void addCorsHeaders(boost::beast::http::response<T> &res);
 
@@ -16,6 +48,13 @@ namespace bytebucket
   boost::beast::http::response<boost::beast::http::string_body>
   create_success_response(boost::beast::http::status status, unsigned version, const std::string &content_type, const std::string &body);
 
+  // 503 telling the client when to come back
+  boost::beast::http::response<boost::beast::http::string_body>
+  create_overloaded_response(unsigned version, std::chrono::seconds retry_after);
+
+  // Appends one file's JSON object; a null db skips the tag and metadata lookups
+  void buildFileJson(std::ostringstream &json_stream, const FileRecord &file, std::shared_ptr<Database> db);
+
   // Endpoint handlers
   boost::beast::http::response<boost::beast::http::string_body>
   handle_options(unsigned version);
@@ -37,6 +76,9 @@ namespace bytebucket
   boost::beast::http::message_generator
   handle_get_download(const boost::beast::http::request<boost::beast::http::string_body> &req);
 
+  boost::beast::http::message_generator
+  handle_get_folder_archive(const boost::beast::http::request<boost::beast::http::string_body> &req);
+
   boost::beast::http::response<boost::beast::http::string_body>
   handle_delete_file(const boost::beast::http::request<boost::beast::http::string_body> &req);
 
@@ -67,6 +109,57 @@ namespace bytebucket
   boost::beast::http::response<boost::beast::http::string_body>
   handle_post_file_metadata(const boost::beast::http::request<boost::beast::http::string_body> &req);
 
+  boost::beast::http::response<boost::beast::http::string_body>
+  handle_get_metadata_search(const boost::beast::http::request<boost::beast::http::string_body> &req);
+
+  // Resumable uploads
+  boost::beast::http::response<boost::beast::http::string_body>
+  handle_post_upload_session(const boost::beast::http::request<boost::beast::http::string_body> &req);
+
+  boost::beast::http::response<boost::beast::http::string_body>
+  handle_get_upload_session(const boost::beast::http::request<boost::beast::http::string_body> &req);
+
+  boost::beast::http::response<boost::beast::http::string_body>
+  handle_put_upload_chunk(const boost::beast::http::request<boost::beast::http::string_body> &req);
+
+  boost::beast::http::response<boost::beast::http::string_body>
+  handle_post_upload_complete(const boost::beast::http::request<boost::beast::http::string_body> &req);
+
+  boost::beast::http::response<boost::beast::http::string_body>
+  handle_delete_upload_session(const boost::beast::http::request<boost::beast::http::string_body> &req);
+
+  boost::beast::http::response<boost::beast::http::string_body>
+  handle_get_database_stats(const boost::beast::http::request<boost::beast::http::string_body> &req);
+
+  boost::beast::http::response<boost::beast::http::string_body>
+  handle_get_cache_stats(const boost::beast::http::request<boost::beast::http::string_body> &req);
+
+  boost::beast::http::response<boost::beast::http::string_body>
+  handle_get_metrics(const boost::beast::http::request<boost::beast::http::string_body> &req);
+
+  boost::beast::http::response<boost::beast::http::string_body>
+  handle_get_query_profile(const boost::beast::http::request<boost::beast::http::string_body> &req);
+
+  boost::beast::http::response<boost::beast::http::string_body>
+  handle_get_traces(const boost::beast::http::request<boost::beast::http::string_body> &req);
+
+  // Runs on the headers alone, before the body is read. Returns the response to
+  // refuse the request with (oversized body, body for an unknown route, bad upload
+  // Content-Type, unknown folder or upload session, too little disk), or nullopt
+  // to go on and read it.
+  std::optional<boost::beast::http::response<boost::beast::http::string_body>>
+  check_request_header(const boost::beast::http::request<boost::beast::http::string_body> &req,
+                       std::optional<uint64_t> content_length);
+
+  // True when the client holds its body back until it sees 100 Continue. Only
+  // asked once check_request_header has let the request through.
+  bool expects_continue(const boost::beast::http::request<boost::beast::http::string_body> &req);
+
+  // Which route a request would be dispatched to, from its method and target alone
+  Route match_route(const boost::beast::http::request<boost::beast::http::string_body> &req);
+
   // Main request handler
   boost::beast::http::message_generator handle_request(boost::beast::http::request<boost::beast::http::string_body> &&req);
+  // Same, also reporting which route matched
+  boost::beast::http::message_generator handle_request(boost::beast::http::request<boost::beast::http::string_body> &&req, Route &route);
 }
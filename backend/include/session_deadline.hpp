@@ -0,0 +1,138 @@
+#pragma once
+
+#include "metrics.hpp"
+#include <boost/asio/ip/tcp.hpp>
+#include <boost/beast/core/error.hpp>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <unordered_set>
+
+namespace bytebucket
+{
+  // How long a connection may keep its session thread waiting on the client
+  struct SessionLimits
+  {
+    std::chrono::seconds idleTimeout{30};      // for the next request on a kept-alive connection
+    std::chrono::seconds headerTimeout{10};    // for a request's headers, and for the first one after accepting
+    std::chrono::seconds bodyGrace{10};        // a body may start slowly,
+    uint64_t minBodyBytesPerSecond = 16384;    // but must then average at least this
+    std::chrono::seconds writeTimeout{30};     // longest a response write may go without progress
+    uint64_t maxRequestsPerConnection = 1000;  // 0 for no limit
+
+    // BYTEBUCKET_IDLE_TIMEOUT_S, BYTEBUCKET_HEADER_TIMEOUT_S, BYTEBUCKET_BODY_GRACE_S,
+    // BYTEBUCKET_MIN_BODY_RATE, BYTEBUCKET_WRITE_TIMEOUT_S and BYTEBUCKET_MAX_REQUESTS_PER_CONNECTION
+    static SessionLimits fromEnvironment();
+
+    // When the first `bytes` bytes of a body that started arriving at bodyStarted must be in
+    std::chrono::steady_clock::time_point bodyDeadline(std::chrono::steady_clock::time_point bodyStarted,
+                                                       uint64_t bytes) const;
+  };
+
+  class SocketDeadline;
+
+  // Enforces deadlines on the blocking reads and writes of the thread-per-connection
+  // sessions. Beast's tcp_stream timeouts only cover asynchronous operations, so one
+  // thread checks every armed deadline a few times a second and shuts the socket down
+  // when one passes; the blocked call then fails and the session ends, freeing its thread.
+  class DeadlineWatchdog
+  {
+  public:
+    using Clock = std::chrono::steady_clock;
+
+    static std::shared_ptr<DeadlineWatchdog> create(Clock::duration resolution = std::chrono::milliseconds(100));
+    ~DeadlineWatchdog();
+
+    DeadlineWatchdog(const DeadlineWatchdog &) = delete;
+    DeadlineWatchdog &operator=(const DeadlineWatchdog &) = delete;
+
+    uint64_t expiredCount() const { return expired.load(std::memory_order_relaxed); }
+
+  private:
+    friend class SocketDeadline;
+
+    struct Entry
+    {
+      int fd;
+      std::atomic<int64_t> deadline{0}; // Clock ticks; 0 when disarmed
+      std::atomic<uint8_t> phase{0};
+      std::atomic<bool> fired{false};
+    };
+
+    explicit DeadlineWatchdog(Clock::duration resolution);
+    void add(Entry *entry);
+    void remove(Entry *entry);
+    void run();
+
+    Clock::duration resolution;
+    std::mutex mutex;
+    std::condition_variable wake;
+    bool stopping = false;
+    std::unordered_set<Entry *> entries;
+    std::atomic<uint64_t> expired{0};
+    std::thread thread;
+  };
+
+  // One socket's deadline, registered with the watchdog for the session's lifetime.
+  // Arming and disarming are single atomic stores, so it costs nothing per request.
+  // Without a watchdog every call is a no-op.
+  class SocketDeadline
+  {
+  public:
+    using Clock = DeadlineWatchdog::Clock;
+
+    SocketDeadline(std::shared_ptr<DeadlineWatchdog> watchdog, boost::asio::ip::tcp::socket &socket);
+    ~SocketDeadline();
+
+    SocketDeadline(const SocketDeadline &) = delete;
+    SocketDeadline &operator=(const SocketDeadline &) = delete;
+
+    void expiresAt(Clock::time_point deadline, TimeoutPhase phase);
+    void expiresAfter(Clock::duration timeout, TimeoutPhase phase) { expiresAt(Clock::now() + timeout, phase); }
+    void cancel();
+
+    // Set once the deadline has passed and the socket was shut down
+    std::optional<TimeoutPhase> expired() const;
+
+  private:
+    std::shared_ptr<DeadlineWatchdog> watchdog;
+    DeadlineWatchdog::Entry entry;
+  };
+
+  // Write stream that re-arms a deadline before each write, so a response of any
+  // size may take as long as it needs while the client keeps reading it
+  template <class NextLayer>
+  class DeadlineWriteStream
+  {
+  public:
+    DeadlineWriteStream(NextLayer &next, SocketDeadline &deadline, SocketDeadline::Clock::duration timeout)
+        : next(next), deadline(deadline), timeout(timeout) {}
+
+    template <class ConstBufferSequence>
+    size_t write_some(const ConstBufferSequence &buffers)
+    {
+      boost::beast::error_code ec;
+      size_t written = write_some(buffers, ec);
+      if (ec)
+        throw boost::system::system_error(ec);
+      return written;
+    }
+
+    template <class ConstBufferSequence>
+    size_t write_some(const ConstBufferSequence &buffers, boost::beast::error_code &ec)
+    {
+      deadline.expiresAfter(timeout, TimeoutPhase::Write);
+      return next.write_some(buffers, ec);
+    }
+
+  private:
+    NextLayer &next;
+    SocketDeadline &deadline;
+    SocketDeadline::Clock::duration timeout;
+  };
+}
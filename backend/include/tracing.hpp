@@ -0,0 +1,125 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace bytebucket
+{
+  // The spans of one traced request. Shared by every thread that works on the
+  // request, so spans from the writer or I/O pool land alongside the caller's.
+  class Trace : public std::enable_shared_from_this<Trace>
+  {
+  public:
+    using Clock = std::chrono::steady_clock;
+
+    struct Span
+    {
+      const char *name;
+      const char *category;
+      Clock::time_point start;
+      Clock::duration duration;
+      uint32_t thread;
+    };
+
+    // spans past this are counted but not kept, so a long streamed response stays bounded
+    static constexpr size_t MAX_SPANS = 4096;
+
+    Trace(uint64_t id, std::string label);
+
+    uint64_t id() const { return traceId; }
+    const std::string &label() const { return requestLabel; }
+    Clock::time_point started() const { return startedAt; }
+    Clock::time_point finished() const { return finishedAt; }
+
+    void record(const Span &span);
+    std::vector<Span> spans() const;
+    uint64_t droppedSpans() const;
+
+  private:
+    friend class Tracer;
+
+    uint64_t traceId;
+    std::string requestLabel;
+    Clock::time_point startedAt;
+    Clock::time_point finishedAt;
+
+    mutable std::mutex mutex;
+    std::vector<Span> recorded;
+    uint64_t dropped = 0;
+  };
+
+  // Per-request tracing. A connection thread starts a trace for a sampled or
+  // forced request, which becomes the thread's current trace; TraceSpans record
+  // into whatever trace is current on their thread and cost one thread-local
+  // read when there is none. Finished traces are kept in a small ring of recent
+  // traces and exported as Chrome trace-event JSON (chrome://tracing, Perfetto).
+  class Tracer
+  {
+  public:
+    // 1 in every sampleEvery requests is traced; 0 traces forced requests only
+    static void setSampling(uint32_t sampleEvery);
+    static uint32_t sampling();
+
+    // Starts tracing the request on this thread when forced or sampled. A
+    // forcedId of 0 forces a trace with a generated id. Returns the trace or nullptr.
+    // The "METHOD target" label is only built for a request that is traced.
+    static std::shared_ptr<Trace> begin(std::string_view method, std::string_view target,
+                                        std::optional<uint64_t> forcedId);
+
+    // Finishes this thread's trace and keeps it among the recent traces
+    static void end();
+
+    static std::shared_ptr<Trace> current();
+
+    // Recent traces, or only the one with traceId, as {"traceEvents":[...]}
+    static std::string renderChromeTrace(std::optional<uint64_t> traceId = std::nullopt);
+
+    static constexpr size_t KEPT_TRACES = 64;
+    static void clear();
+
+  private:
+    friend class TraceSpan;
+    friend class TraceScope;
+    static Trace *&threadTrace();
+  };
+
+  // Records its lifetime as a span of the current trace, if there is one.
+  // name and category must outlive the trace; string literals are expected.
+  class TraceSpan
+  {
+  public:
+    TraceSpan(const char *name, const char *category);
+    ~TraceSpan();
+
+    TraceSpan(const TraceSpan &) = delete;
+    TraceSpan &operator=(const TraceSpan &) = delete;
+
+  private:
+    Trace *trace;
+    const char *name;
+    const char *category;
+    Trace::Clock::time_point started;
+  };
+
+  // Makes a trace current on this thread for the scope, so work handed to
+  // another thread is recorded in the trace of the request that queued it
+  class TraceScope
+  {
+  public:
+    explicit TraceScope(std::shared_ptr<Trace> trace);
+    ~TraceScope();
+
+    TraceScope(const TraceScope &) = delete;
+    TraceScope &operator=(const TraceScope &) = delete;
+
+  private:
+    std::shared_ptr<Trace> trace;
+    Trace *previous;
+  };
+}
@@ -0,0 +1,109 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace bytebucket
+{
+  enum class UploadError
+  {
+    Success,
+    NotFound,
+    InvalidRange,
+    Incomplete,
+    Conflict, // session is being finalised or still has chunks in flight
+    StorageFailed
+  };
+
+  template <typename T>
+  struct UploadResult
+  {
+    std::optional<T> value;
+    UploadError error = UploadError::Success;
+    std::string errorMessage;
+
+    bool success() const { return error == UploadError::Success; }
+    explicit operator bool() const { return success(); }
+  };
+
+  struct UploadSessionInfo
+  {
+    std::string id; // also the storage ID the finished blob is saved under
+    std::string filename;
+    std::string contentType;
+    std::optional<int> folderId;
+    int64_t size = 0;
+    int64_t receivedBytes = 0;
+    std::vector<std::pair<int64_t, int64_t>> ranges; // received [start, end) byte ranges, sorted and merged
+    uint64_t revision = 0; // bumped whenever ranges grow, so a stale copy can be told from a newer one
+
+    bool complete() const { return receivedBytes == size; }
+  };
+
+  // Tracks resumable uploads. Each session owns a preallocated partial file that
+  // chunks are written into at their offsets, in any order and from any number of
+  // threads. Sessions live in memory; an abandoned one is dropped after idleTimeout,
+  // checked as sessions are accessed. Callers record sessions elsewhere (the
+  // database) and hand them back through restore after a restart.
+  class UploadSessions
+  {
+  public:
+    explicit UploadSessions(std::chrono::seconds idleTimeout = std::chrono::hours(24));
+
+    UploadResult<UploadSessionInfo> create(
+        const std::string &filename,
+        const std::string &contentType,
+        std::optional<int> folderId,
+        int64_t size);
+
+    // Chunks may overlap earlier ones; the bytes are expected to be identical
+    UploadResult<UploadSessionInfo> writeChunk(const std::string &id, int64_t offset, const char *data, size_t length);
+
+    UploadResult<UploadSessionInfo> status(const std::string &id);
+
+    // Locks the session against further chunks and commits the partial file under
+    // the session ID. The caller records the file row, then calls finish or abort.
+    UploadResult<UploadSessionInfo> commit(const std::string &id);
+
+    // Forgets a session after its file row has been recorded
+    void finish(const std::string &id);
+
+    // Drops a session and whatever has been stored for it
+    UploadResult<bool> abort(const std::string &id);
+
+    // Takes back a session recorded before a restart. Refused unless its partial
+    // file is still there at the declared size; its idle time starts over.
+    UploadResult<UploadSessionInfo> restore(const UploadSessionInfo &info);
+
+  private:
+    struct Session
+    {
+      UploadSessionInfo info;
+      std::map<int64_t, int64_t> received; // start -> end
+      int inFlight = 0;
+      bool committing = false;
+      bool committed = false;
+      bool expired = false;
+      std::chrono::steady_clock::time_point lastActivity;
+      mutable std::mutex mutex;
+    };
+
+    std::shared_ptr<Session> find(const std::string &id);
+    void expireIdleSessions();
+    static void addRange(Session &session, int64_t start, int64_t end);
+    static UploadSessionInfo snapshot(const Session &session);
+
+    std::chrono::seconds idleTimeout;
+    mutable std::mutex mutex;
+    std::unordered_map<std::string, std::shared_ptr<Session>> sessions;
+    std::chrono::steady_clock::time_point nextSweep; // guarded by mutex
+  };
+}
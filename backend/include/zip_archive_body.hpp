@@ -0,0 +1,74 @@
+#pragma once
+
+#include "zip_stream.hpp"
+#include <boost/asio/buffer.hpp>
+#include <boost/beast/core/error.hpp>
+#include <boost/beast/http/message.hpp>
+#include <boost/optional.hpp>
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace bytebucket
+{
+  // One file or directory to put in an archive
+  struct ZipArchiveEntry
+  {
+    std::string path;               // '/'-separated and relative; directories end with '/'
+    std::filesystem::path source;   // blob on disk; empty for directories
+    std::string codec = "identity"; // how the blob is encoded at rest
+    uint64_t size = 0;              // decoded size
+    bool deflate = false;           // compress a plain blob rather than store it
+    std::chrono::system_clock::time_point modified;
+  };
+
+  // Beast body that streams a ZIP of the given entries while the response is
+  // written; its length isn't known up front, so it goes out chunked. A reader
+  // thread fills a bounded queue of blob chunks ahead of the encoder, so memory
+  // stays fixed however large the archive gets. gzip blobs are copied into the
+  // archive as deflate entries without being decompressed.
+  struct ZipArchiveBody
+  {
+    struct value_type
+    {
+      std::vector<ZipArchiveEntry> entries;
+      int deflateLevel = 1;
+      size_t readAheadChunks = 8; // queue bound, in chunks of CHUNK_SIZE
+    };
+
+    static constexpr size_t CHUNK_SIZE = 256 * 1024;
+
+    class writer
+    {
+    public:
+      using const_buffers_type = boost::asio::const_buffer;
+
+      template <bool isRequest, class Fields>
+      writer(boost::beast::http::header<isRequest, Fields> &, value_type &body) : body(body)
+      {
+      }
+
+      writer(const writer &) = delete;
+      writer &operator=(const writer &) = delete;
+
+      // stops the reader thread if the response ended early
+      ~writer();
+
+      void init(boost::beast::error_code &ec);
+      boost::optional<std::pair<const_buffers_type, bool>> get(boost::beast::error_code &ec);
+
+    private:
+      struct ReadAhead;
+
+      value_type &body;
+      std::shared_ptr<ReadAhead> readAhead; // shared_ptr: the inline constructor needs no complete type
+      std::unique_ptr<ZipEncoder> encoder;
+      std::string output;
+      bool done = false;
+    };
+  };
+}
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <zlib.h>
+
+namespace bytebucket
+{
+  enum class ZipMethod
+  {
+    Stored,
+    Deflate,            // the encoder compresses the bytes it's given
+    DeflatePassthrough  // the bytes are already a raw deflate stream, e.g. a gzip blob's payload
+  };
+
+  // Writes a ZIP archive strictly front to back, so it can go straight onto a
+  // socket. Each entry's local header is followed by its data and then a data
+  // descriptor with the CRC and sizes, which are only known once the data has
+  // passed through. The central directory is written last. ZIP64 fields are
+  // added only for sizes, offsets or counts that don't fit the classic format.
+  class ZipEncoder
+  {
+  public:
+    explicit ZipEncoder(int deflateLevel = Z_DEFAULT_COMPRESSION);
+    ~ZipEncoder();
+
+    ZipEncoder(const ZipEncoder &) = delete;
+    ZipEncoder &operator=(const ZipEncoder &) = delete;
+
+    // size is the entry's decoded size, used to decide on ZIP64 up front.
+    // Passthrough entries must supply the decoded bytes' CRC-32.
+    // Paths ending in '/' are directories.
+    bool beginEntry(const std::string &path, ZipMethod method, uint64_t size,
+                    std::chrono::system_clock::time_point modified,
+                    std::optional<uint32_t> crc, std::string &out);
+    bool write(std::string_view data, std::string &out);
+    bool endEntry(std::string &out);
+
+    // Central directory and end records; nothing may be written after this
+    void finish(std::string &out);
+
+    uint64_t bytesWritten() const { return offset; }
+
+  private:
+    struct CentralRecord
+    {
+      std::string path;
+      ZipMethod method;
+      uint16_t dosTime;
+      uint16_t dosDate;
+      uint32_t crc;
+      uint64_t compressedSize;
+      uint64_t uncompressedSize;
+      uint64_t localHeaderOffset;
+      bool descriptor;
+      bool zip64Local;
+    };
+
+    void emit(std::string &out, std::string_view bytes);
+    bool deflateInto(std::string_view data, int flush, std::string &out);
+
+    std::vector<CentralRecord> entries;
+    std::optional<CentralRecord> current;
+    uint64_t offset = 0;
+
+    z_stream stream{};
+    bool deflateReady = false;
+    int level;
+  };
+}
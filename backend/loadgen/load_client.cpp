@@ -0,0 +1,410 @@
+#include "load_client.hpp"
+#include <boost/asio/connect.hpp>
+#include <boost/asio/steady_timer.hpp>
+#include <boost/beast/core/flat_buffer.hpp>
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <sstream>
+
+namespace bytebucket
+{
+  namespace load
+  {
+    namespace http = boost::beast::http;
+    using Clock = std::chrono::steady_clock;
+
+    static http::request<http::string_body> makeRequest(const std::string &host, http::verb method,
+                                                        const std::string &target, const std::string &body,
+                                                        const std::string &contentType)
+    {
+      http::request<http::string_body> req{method, target, 11};
+      req.set(http::field::host, host);
+      req.set(http::field::user_agent, "bytebucket-load");
+      if (!contentType.empty())
+        req.set(http::field::content_type, contentType);
+      req.body() = body;
+      req.prepare_payload();
+      return req;
+    }
+
+    SyncClient::SyncClient(std::string host, unsigned short port) : host(std::move(host)), port(port) {}
+
+    bool SyncClient::connect()
+    {
+      boost::system::error_code ec;
+      boost::asio::ip::tcp::resolver resolver(ioc);
+      auto endpoints = resolver.resolve(host, std::to_string(port), ec);
+      if (ec)
+        return false;
+      socket.emplace(ioc);
+      boost::asio::connect(*socket, endpoints, ec);
+      if (ec)
+      {
+        socket.reset();
+        return false;
+      }
+      return true;
+    }
+
+    Response SyncClient::request(http::verb method, const std::string &target, const std::string &body,
+                                 const std::string &contentType)
+    {
+      Response response;
+      // one retry covers the server having closed an idle keep-alive connection
+      for (int attempt = 0; attempt < 2; ++attempt)
+      {
+        if (!socket && !connect())
+          return response;
+
+        boost::system::error_code ec;
+        auto req = makeRequest(host, method, target, body, contentType);
+        http::write(*socket, req, ec);
+        boost::beast::flat_buffer buffer;
+        http::response_parser<http::string_body> parser;
+        parser.body_limit((std::numeric_limits<std::uint64_t>::max)());
+        if (!ec)
+          http::read(*socket, buffer, parser, ec);
+        if (ec)
+        {
+          socket.reset();
+          continue;
+        }
+
+        response.status = parser.get().result_int();
+        response.body = std::move(parser.get().body());
+        if (!parser.get().keep_alive())
+          socket.reset();
+        return response;
+      }
+      return response;
+    }
+
+    struct LoadRunner::Connection
+    {
+      explicit Connection(boost::asio::io_context &ioc) : socket(ioc), timer(ioc) {}
+
+      boost::asio::ip::tcp::socket socket;
+      boost::asio::steady_timer timer;
+      boost::beast::flat_buffer buffer;
+      http::request<http::string_body> request;
+      std::optional<http::response_parser<http::string_body>> parser;
+      RequestSpec spec;
+      Clock::time_point due;     // when the request in flight should have been sent
+      Clock::time_point nextDue; // paced runs only
+      Clock::duration interval{};
+    };
+
+    LoadRunner::LoadRunner(const LoadOptions &options, Scenario &scenario)
+        : options(options), scenario(scenario), rng(options.seed), deadline(ioc)
+    {
+      report.scenario = scenario.name();
+      report.options = options;
+    }
+
+    LoadReport LoadRunner::run()
+    {
+      boost::asio::ip::tcp::resolver resolver(ioc);
+      endpoints = resolver.resolve(options.host, std::to_string(options.port));
+
+      auto started = Clock::now();
+      measureFrom = started + options.warmup;
+      stopAt = measureFrom + options.duration;
+
+      std::vector<std::shared_ptr<Connection>> connections;
+      for (size_t i = 0; i < options.connections; ++i)
+      {
+        auto connection = std::make_shared<Connection>(ioc);
+        if (options.rate > 0)
+        {
+          // each connection carries an equal share of the rate, staggered so they don't send in bursts
+          connection->interval = std::chrono::duration_cast<Clock::duration>(
+              std::chrono::duration<double>(static_cast<double>(options.connections) / options.rate));
+          connection->nextDue = started + connection->interval * static_cast<int64_t>(i) /
+                                              static_cast<int64_t>(options.connections);
+        }
+        connections.push_back(connection);
+      }
+      active = connections.size();
+      for (auto &connection : connections)
+        connect(connection);
+
+      // requests the server never answers mustn't keep the run going forever
+      deadline.expires_at(stopAt + std::chrono::seconds(10));
+      deadline.async_wait([&connections](const boost::system::error_code &ec)
+                          {
+        if (ec)
+          return;
+        for (auto &connection : connections)
+        {
+          boost::system::error_code ignored;
+          connection->timer.cancel();
+          connection->socket.close(ignored);
+        } });
+
+      ioc.run();
+      report.elapsedSeconds = std::chrono::duration<double>(options.duration).count();
+      return report;
+    }
+
+    void LoadRunner::connect(const std::shared_ptr<Connection> &connection)
+    {
+      if (Clock::now() >= stopAt)
+      {
+        retire();
+        return;
+      }
+      boost::asio::async_connect(connection->socket, endpoints,
+                                 [this, connection](const boost::system::error_code &ec, const auto &)
+                                 {
+                                   if (!ec)
+                                   {
+                                     schedule(connection);
+                                     return;
+                                   }
+                                   if (Clock::now() >= measureFrom)
+                                   {
+                                     auto &stats = report.operations["connect"];
+                                     stats.requests++;
+                                     stats.transportErrors++;
+                                   }
+                                   // the server may be restarting; back off briefly and try again
+                                   connection->timer.expires_after(std::chrono::milliseconds(100));
+                                   connection->timer.async_wait([this, connection](const boost::system::error_code &waitError)
+                                                                {
+                                     if (waitError)
+                                     {
+                                       retire();
+                                       return;
+                                     }
+                                     boost::system::error_code ignored;
+                                     connection->socket.close(ignored);
+                                     connect(connection); });
+                                 });
+    }
+
+    void LoadRunner::schedule(const std::shared_ptr<Connection> &connection)
+    {
+      auto now = Clock::now();
+      if (options.rate <= 0)
+      {
+        if (now >= stopAt)
+        {
+          retire();
+          return;
+        }
+        connection->due = now;
+        send(connection);
+        return;
+      }
+
+      connection->due = connection->nextDue;
+      connection->nextDue += connection->interval;
+      if (connection->due >= stopAt)
+      {
+        retire();
+        return;
+      }
+      if (connection->due <= now)
+      {
+        // behind schedule: send at once, and the lateness counts against the latency
+        send(connection);
+        return;
+      }
+      connection->timer.expires_at(connection->due);
+      connection->timer.async_wait([this, connection](const boost::system::error_code &ec)
+                                   {
+        if (ec)
+          retire();
+        else
+          send(connection); });
+    }
+
+    void LoadRunner::retire()
+    {
+      if (--active == 0)
+        deadline.cancel();
+    }
+
+    void LoadRunner::send(const std::shared_ptr<Connection> &connection)
+    {
+      connection->spec = scenario.next(rng);
+      connection->request = makeRequest(options.host, connection->spec.method, connection->spec.target,
+                                        connection->spec.body, connection->spec.contentType);
+      http::async_write(connection->socket, connection->request,
+                        [this, connection](const boost::system::error_code &ec, size_t)
+                        {
+                          if (ec)
+                          {
+                            fail(connection);
+                            return;
+                          }
+                          connection->parser.emplace();
+                          connection->parser->body_limit((std::numeric_limits<std::uint64_t>::max)());
+                          http::async_read(connection->socket, connection->buffer, *connection->parser,
+                                           [this, connection](const boost::system::error_code &readError, size_t)
+                                           {
+                                             if (readError)
+                                             {
+                                               fail(connection);
+                                               return;
+                                             }
+                                             finish(connection, connection->parser->get().result_int(),
+                                                    connection->parser->get().body());
+                                           });
+                        });
+    }
+
+    void LoadRunner::finish(const std::shared_ptr<Connection> &connection, unsigned status, const std::string &body)
+    {
+      auto latency = Clock::now() - connection->due;
+      if (connection->due >= measureFrom)
+      {
+        auto &stats = report.operations[connection->spec.operation];
+        stats.requests++;
+        stats.statuses[status]++;
+        if (status >= 400)
+          stats.errors++;
+        stats.latencyMicros.push_back(static_cast<uint32_t>(
+            std::min<int64_t>(std::chrono::duration_cast<std::chrono::microseconds>(latency).count(), UINT32_MAX)));
+      }
+
+      if (connection->spec.onResponse)
+        connection->spec.onResponse(Response{status, body});
+
+      if (!connection->parser->get().keep_alive())
+      {
+        boost::system::error_code ignored;
+        connection->socket.close(ignored);
+        connection->buffer.clear();
+        connect(connection);
+        return;
+      }
+      schedule(connection);
+    }
+
+    void LoadRunner::fail(const std::shared_ptr<Connection> &connection)
+    {
+      if (connection->due >= measureFrom)
+      {
+        auto &stats = report.operations[connection->spec.operation];
+        stats.requests++;
+        stats.transportErrors++;
+      }
+      if (connection->spec.onResponse)
+        connection->spec.onResponse(Response{});
+
+      boost::system::error_code ignored;
+      connection->socket.close(ignored);
+      connection->buffer.clear();
+      connect(connection);
+    }
+
+    // Nearest-rank percentile of sorted latencies, in milliseconds
+    static double percentileMs(const std::vector<uint32_t> &sorted, double quantile)
+    {
+      if (sorted.empty())
+        return 0;
+      size_t rank = static_cast<size_t>(std::ceil(quantile * static_cast<double>(sorted.size())));
+      return sorted[std::min(sorted.size(), std::max<size_t>(rank, 1)) - 1] / 1000.0;
+    }
+
+    static void appendNumber(std::ostringstream &out, double value)
+    {
+      char formatted[32];
+      std::snprintf(formatted, sizeof(formatted), "%.3f", value);
+      out << formatted;
+    }
+
+    static void appendStats(std::ostringstream &out, const OperationStats &stats, double seconds)
+    {
+      std::vector<uint32_t> sorted = stats.latencyMicros;
+      std::sort(sorted.begin(), sorted.end());
+      double total = 0;
+      for (uint32_t micros : sorted)
+        total += micros;
+      uint64_t failed = stats.errors + stats.transportErrors;
+
+      out << R"("requests":)" << stats.requests << R"(,"throughput_rps":)";
+      appendNumber(out, seconds > 0 ? static_cast<double>(stats.requests) / seconds : 0);
+      out << R"(,"errors":)" << stats.errors << R"(,"transport_errors":)" << stats.transportErrors
+          << R"(,"error_rate":)";
+      appendNumber(out, stats.requests ? static_cast<double>(failed) / static_cast<double>(stats.requests) : 0);
+      out << R"(,"latency_ms":{"mean":)";
+      appendNumber(out, sorted.empty() ? 0 : total / static_cast<double>(sorted.size()) / 1000.0);
+      for (auto [label, quantile] : {std::pair{"p50", 0.5}, {"p90", 0.9}, {"p99", 0.99}, {"p999", 0.999}})
+      {
+        out << ",\"" << label << "\":";
+        appendNumber(out, percentileMs(sorted, quantile));
+      }
+      out << R"(,"max":)";
+      appendNumber(out, sorted.empty() ? 0 : sorted.back() / 1000.0);
+      out << R"(},"statuses":{)";
+      bool first = true;
+      for (const auto &[status, count] : stats.statuses)
+      {
+        out << (first ? "" : ",") << '"' << status << R"(":)" << count;
+        first = false;
+      }
+      out << "}";
+    }
+
+    static OperationStats combined(const std::map<std::string, OperationStats> &operations)
+    {
+      OperationStats all;
+      for (const auto &[name, stats] : operations)
+      {
+        all.requests += stats.requests;
+        all.errors += stats.errors;
+        all.transportErrors += stats.transportErrors;
+        for (const auto &[status, count] : stats.statuses)
+          all.statuses[status] += count;
+        all.latencyMicros.insert(all.latencyMicros.end(), stats.latencyMicros.begin(), stats.latencyMicros.end());
+      }
+      return all;
+    }
+
+    std::string LoadReport::toJson() const
+    {
+      std::ostringstream out;
+      out << R"({"scenario":")" << scenario << R"(","connections":)" << options.connections
+          << R"(,"target_rate":)";
+      appendNumber(out, options.rate);
+      out << R"(,"duration_s":)" << options.duration.count() << R"(,"warmup_s":)" << options.warmup.count()
+          << R"(,"seed":)" << options.seed << ",";
+      appendStats(out, combined(operations), elapsedSeconds);
+      out << R"(,"operations":{)";
+      bool first = true;
+      for (const auto &[name, stats] : operations)
+      {
+        out << (first ? "" : ",") << '"' << name << R"(":{)";
+        appendStats(out, stats, elapsedSeconds);
+        out << "}";
+        first = false;
+      }
+      out << "}}";
+      return out.str();
+    }
+
+    std::string LoadReport::summary() const
+    {
+      std::ostringstream out;
+      auto line = [&](const std::string &name, const OperationStats &stats)
+      {
+        std::vector<uint32_t> sorted = stats.latencyMicros;
+        std::sort(sorted.begin(), sorted.end());
+        char formatted[200];
+        std::snprintf(formatted, sizeof(formatted), "%-18s %9llu req %9.1f req/s %7llu err   p50 %8.2f  p99 %8.2f  p999 %8.2f ms\n",
+                      name.c_str(), static_cast<unsigned long long>(stats.requests),
+                      elapsedSeconds > 0 ? static_cast<double>(stats.requests) / elapsedSeconds : 0,
+                      static_cast<unsigned long long>(stats.errors + stats.transportErrors),
+                      percentileMs(sorted, 0.5), percentileMs(sorted, 0.99), percentileMs(sorted, 0.999));
+        out << formatted;
+      };
+      for (const auto &[name, stats] : operations)
+        line(name, stats);
+      line("total", combined(operations));
+      return out.str();
+    }
+  }
+}
@@ -0,0 +1,132 @@
+#pragma once
+
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/ip/tcp.hpp>
+#include <boost/asio/steady_timer.hpp>
+#include <boost/beast/http.hpp>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <optional>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace bytebucket
+{
+  namespace load
+  {
+    struct Response
+    {
+      unsigned status = 0; // 0 when the request never got an answer
+      std::string body;
+    };
+
+    // Blocking single-connection client, for setting scenarios up and health checks
+    class SyncClient
+    {
+    public:
+      SyncClient(std::string host, unsigned short port);
+
+      // Reconnects as needed; a transport failure comes back as status 0
+      Response request(boost::beast::http::verb method, const std::string &target,
+                       const std::string &body = "", const std::string &contentType = "");
+
+    private:
+      bool connect();
+
+      std::string host;
+      unsigned short port;
+      boost::asio::io_context ioc;
+      std::optional<boost::asio::ip::tcp::socket> socket;
+    };
+
+    // One request a scenario wants sent. onResponse runs on the load thread once
+    // the answer arrives, so scenarios can track what exists without locking.
+    struct RequestSpec
+    {
+      const char *operation; // reported per operation; must be a string literal
+      boost::beast::http::verb method;
+      std::string target;
+      std::string body;
+      std::string contentType;
+      std::function<void(const Response &)> onResponse;
+    };
+
+    class Scenario
+    {
+    public:
+      virtual ~Scenario() = default;
+      virtual const char *name() const = 0;
+      // Creates the folders, files and tags the scenario works on
+      virtual bool setup(SyncClient &client, std::mt19937_64 &rng) = 0;
+      virtual RequestSpec next(std::mt19937_64 &rng) = 0;
+    };
+
+    struct LoadOptions
+    {
+      std::string host = "127.0.0.1";
+      unsigned short port = 8080;
+      size_t connections = 16;
+      double rate = 0; // requests per second over all connections; 0 sends as fast as answers come back
+      std::chrono::seconds duration{30};
+      std::chrono::seconds warmup{5}; // run but not counted
+      uint64_t seed = 1;
+    };
+
+    struct OperationStats
+    {
+      uint64_t requests = 0;
+      uint64_t errors = 0;          // 4xx and 5xx answers
+      uint64_t transportErrors = 0; // connect, write or read failures
+      std::map<unsigned, uint64_t> statuses;
+      std::vector<uint32_t> latencyMicros;
+    };
+
+    struct LoadReport
+    {
+      std::string scenario;
+      LoadOptions options;
+      double elapsedSeconds = 0;
+      std::map<std::string, OperationStats> operations;
+
+      // {"scenario":..,"throughput_rps":..,"latency_ms":{"p50":..,"p99":..,"p999":..},..}
+      std::string toJson() const;
+      std::string summary() const;
+    };
+
+    // Drives the scenario over options.connections keep-alive connections from
+    // one thread. With a rate set, each connection sends on a fixed schedule and
+    // latency is measured from when a request was due rather than when it went
+    // out, so a stalled server can't hide its stall by delaying the next request.
+    class LoadRunner
+    {
+    public:
+      LoadRunner(const LoadOptions &options, Scenario &scenario);
+      LoadReport run();
+
+    private:
+      struct Connection;
+
+      void connect(const std::shared_ptr<Connection> &connection);
+      void schedule(const std::shared_ptr<Connection> &connection);
+      void send(const std::shared_ptr<Connection> &connection);
+      void finish(const std::shared_ptr<Connection> &connection, unsigned status, const std::string &body);
+      void fail(const std::shared_ptr<Connection> &connection);
+      void retire();
+
+      LoadOptions options;
+      Scenario &scenario;
+      std::mt19937_64 rng;
+      boost::asio::io_context ioc;
+      boost::asio::steady_timer deadline;
+      size_t active = 0; // connections that haven't finished their run
+      boost::asio::ip::tcp::resolver::results_type endpoints;
+      std::chrono::steady_clock::time_point measureFrom;
+      std::chrono::steady_clock::time_point stopAt;
+      LoadReport report;
+    };
+  }
+}
@@ -0,0 +1,206 @@
+#include "load_client.hpp"
+#include "scenarios.hpp"
+#include <csignal>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <thread>
+#include <sys/wait.h>
+#include <unistd.h>
+
+using namespace bytebucket::load;
+
+static void usage()
+{
+  std::cerr << "usage: bytebucket_load [options]\n"
+               "  --scenario NAME     browse, mixed, tags or deep-delete (default browse)\n"
+               "  --connections N     keep-alive connections (default 16)\n"
+               "  --rate R            requests per second over all connections; 0 is closed loop (default 0)\n"
+               "  --duration S        measured seconds (default 30)\n"
+               "  --warmup S          seconds run before measuring (default 5)\n"
+               "  --host H --port P   server to load (default 127.0.0.1:8080)\n"
+               "  --seed N            seeds the request mix (default 1)\n"
+               "  --out FILE          write the JSON report there instead of stdout\n"
+               "  --server PATH       start this bytebucket binary in a scratch directory for the run;\n"
+               "                      it always listens on 8080\n";
+}
+
+// Polls /health until the server answers or the timeout passes
+static bool waitForServer(const LoadOptions &options, std::chrono::seconds timeout)
+{
+  auto give_up = std::chrono::steady_clock::now() + timeout;
+  while (std::chrono::steady_clock::now() < give_up)
+  {
+    SyncClient client(options.host, options.port);
+    if (client.request(boost::beast::http::verb::get, "/health").status == 200)
+      return true;
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+  }
+  return false;
+}
+
+// A bytebucket started for the run, in a scratch directory removed afterwards
+class LocalServer
+{
+public:
+  bool start(const std::string &binary)
+  {
+    std::string scratch_template = (std::filesystem::temp_directory_path() / "bytebucket-load-XXXXXX").string();
+    if (!mkdtemp(scratch_template.data()))
+    {
+      std::cerr << "Failed to create a scratch directory\n";
+      return false;
+    }
+    scratch = scratch_template;
+
+    std::string program = std::filesystem::absolute(binary).string();
+    pid = fork();
+    if (pid < 0)
+      return false;
+    if (pid == 0)
+    {
+      if (chdir(scratch.c_str()) != 0)
+        _exit(127);
+      std::string log_path = (std::filesystem::path(scratch) / "server.log").string();
+      if (!std::freopen(log_path.c_str(), "w", stdout) || !std::freopen(log_path.c_str(), "a", stderr))
+        _exit(127);
+      execl(program.c_str(), program.c_str(), static_cast<char *>(nullptr));
+      _exit(127);
+    }
+    return true;
+  }
+
+  ~LocalServer()
+  {
+    if (pid > 0)
+    {
+      kill(pid, SIGTERM);
+      int status = 0;
+      waitpid(pid, &status, 0);
+    }
+    if (!scratch.empty())
+    {
+      std::error_code ignored;
+      std::filesystem::remove_all(scratch, ignored);
+    }
+  }
+
+private:
+  pid_t pid = -1;
+  std::string scratch;
+};
+
+int main(int argc, char *argv[])
+{
+  LoadOptions options;
+  std::string scenario_name = "browse";
+  std::string out_path;
+  std::string server_binary;
+
+  for (int i = 1; i < argc; ++i)
+  {
+    std::string arg = argv[i];
+    if (arg == "--help" || arg == "-h")
+    {
+      usage();
+      return 0;
+    }
+    if (i + 1 >= argc)
+    {
+      std::cerr << "Missing value for " << arg << "\n";
+      usage();
+      return 2;
+    }
+    std::string value = argv[++i];
+    try
+    {
+      if (arg == "--scenario")
+        scenario_name = value;
+      else if (arg == "--connections")
+        options.connections = std::stoul(value);
+      else if (arg == "--rate")
+        options.rate = std::stod(value);
+      else if (arg == "--duration")
+        options.duration = std::chrono::seconds(std::stol(value));
+      else if (arg == "--warmup")
+        options.warmup = std::chrono::seconds(std::stol(value));
+      else if (arg == "--host")
+        options.host = value;
+      else if (arg == "--port")
+        options.port = static_cast<unsigned short>(std::stoul(value));
+      else if (arg == "--seed")
+        options.seed = std::stoull(value);
+      else if (arg == "--out")
+        out_path = value;
+      else if (arg == "--server")
+        server_binary = value;
+      else
+      {
+        std::cerr << "Unknown option " << arg << "\n";
+        usage();
+        return 2;
+      }
+    }
+    catch (const std::exception &)
+    {
+      std::cerr << "Invalid value for " << arg << ": " << value << "\n";
+      return 2;
+    }
+  }
+
+  auto scenario = createScenario(scenario_name);
+  if (!scenario)
+  {
+    std::cerr << "Unknown scenario " << scenario_name << "; expected one of:";
+    for (const auto &name : scenarioNames())
+      std::cerr << " " << name;
+    std::cerr << "\n";
+    return 2;
+  }
+  if (options.connections == 0 || options.duration.count() <= 0)
+  {
+    std::cerr << "--connections and --duration must be positive\n";
+    return 2;
+  }
+
+  LocalServer server;
+  if (!server_binary.empty() && !server.start(server_binary))
+    return 1;
+  if (!waitForServer(options, std::chrono::seconds(server_binary.empty() ? 1 : 15)))
+  {
+    std::cerr << "No server answering on " << options.host << ":" << options.port << "\n";
+    return 1;
+  }
+
+  std::cerr << "Setting up " << scenario->name() << "...\n";
+  std::mt19937_64 setup_rng(options.seed);
+  SyncClient client(options.host, options.port);
+  if (!scenario->setup(client, setup_rng))
+  {
+    std::cerr << "Scenario setup failed\n";
+    return 1;
+  }
+
+  std::cerr << "Running " << scenario->name() << " on " << options.connections << " connections for "
+            << options.warmup.count() << "s warmup + " << options.duration.count() << "s\n";
+  LoadRunner runner(options, *scenario);
+  LoadReport report = runner.run();
+
+  std::cerr << report.summary();
+  if (out_path.empty())
+  {
+    std::cout << report.toJson() << "\n";
+  }
+  else
+  {
+    std::ofstream out(out_path);
+    out << report.toJson() << "\n";
+    if (!out)
+    {
+      std::cerr << "Failed to write " << out_path << "\n";
+      return 1;
+    }
+  }
+  return 0;
+}
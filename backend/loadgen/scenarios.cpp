@@ -0,0 +1,395 @@
+#include "scenarios.hpp"
+#include <optional>
+
+namespace bytebucket
+{
+  namespace load
+  {
+    namespace http = boost::beast::http;
+
+    static const std::string BOUNDARY = "----ByteBucketLoadBoundary3kZfQ8";
+    static const std::string MULTIPART_TYPE = "multipart/form-data; boundary=" + BOUNDARY;
+    static const std::string JSON_TYPE = "application/json";
+
+    static std::string multipartUpload(const std::string &filename, size_t size, std::mt19937_64 &rng)
+    {
+      std::string body = "--" + BOUNDARY + "\r\n";
+      body += "Content-Disposition: form-data; name=\"file\"; filename=\"" + filename + "\"\r\n";
+      body += "Content-Type: application/octet-stream\r\n\r\n";
+      char fill = static_cast<char>('a' + rng() % 26);
+      body += std::string(size, fill);
+      body += "\r\n--" + BOUNDARY + "--\r\n";
+      return body;
+    }
+
+    // First "id": in a response body, which is the created row's for every create endpoint
+    static std::optional<int64_t> responseId(const Response &response)
+    {
+      if (response.status < 200 || response.status >= 300)
+        return std::nullopt;
+      size_t at = response.body.find("\"id\":");
+      if (at == std::string::npos)
+        return std::nullopt;
+      try
+      {
+        return std::stoll(response.body.substr(at + 5));
+      }
+      catch (...)
+      {
+        return std::nullopt;
+      }
+    }
+
+    static std::optional<int64_t> createFolder(SyncClient &client, const std::string &name,
+                                               std::optional<int64_t> parent)
+    {
+      std::string body = R"({"name":")" + name + R"(")";
+      if (parent)
+        body += R"(,"parent_id":)" + std::to_string(*parent);
+      body += "}";
+      return responseId(client.request(http::verb::post, "/folder", body, JSON_TYPE));
+    }
+
+    static std::optional<int64_t> uploadFile(SyncClient &client, int64_t folder, const std::string &name,
+                                             size_t size, std::mt19937_64 &rng)
+    {
+      return responseId(client.request(http::verb::post, "/upload?folder_id=" + std::to_string(folder),
+                                       multipartUpload(name, size, rng), MULTIPART_TYPE));
+    }
+
+    template <class T>
+    static const T &pick(const std::vector<T> &items, std::mt19937_64 &rng)
+    {
+      return items[rng() % items.size()];
+    }
+
+    // Swap-remove, so tracked sets stay O(1) to pick from
+    template <class T>
+    static void removeAt(std::vector<T> &items, size_t index)
+    {
+      items[index] = items.back();
+      items.pop_back();
+    }
+
+    static double uniform(std::mt19937_64 &rng)
+    {
+      return std::uniform_real_distribution<double>(0, 1)(rng);
+    }
+
+    // Listing-heavy read traffic over a fixed tree
+    class BrowseScenario : public Scenario
+    {
+    public:
+      const char *name() const override { return "browse"; }
+
+      bool setup(SyncClient &client, std::mt19937_64 &rng) override
+      {
+        for (int f = 0; f < FOLDERS; ++f)
+        {
+          auto folder = createFolder(client, "browse-" + std::to_string(f), std::nullopt);
+          if (!folder)
+            return false;
+          folders.push_back(*folder);
+          for (int i = 0; i < FILES_PER_FOLDER; ++i)
+          {
+            auto file = uploadFile(client, *folder, "file-" + std::to_string(i) + ".txt", 512 + rng() % 8192, rng);
+            if (!file)
+              return false;
+            files.push_back(*file);
+          }
+        }
+        return true;
+      }
+
+      RequestSpec next(std::mt19937_64 &rng) override
+      {
+        double roll = uniform(rng);
+        if (roll < 0.7)
+          return {"get_folder", http::verb::get, "/folder/" + std::to_string(pick(folders, rng)), "", "", nullptr};
+        if (roll < 0.8)
+          return {"get_root", http::verb::get, "/folder", "", "", nullptr};
+        return {"download", http::verb::get, "/download/" + std::to_string(pick(files, rng)), "", "", nullptr};
+      }
+
+    private:
+      static constexpr int FOLDERS = 20;
+      static constexpr int FILES_PER_FOLDER = 50;
+      std::vector<int64_t> folders;
+      std::vector<int64_t> files;
+    };
+
+    // Uploads, downloads and deletes over a file set that changes as it runs
+    class MixedScenario : public Scenario
+    {
+    public:
+      const char *name() const override { return "mixed"; }
+
+      bool setup(SyncClient &client, std::mt19937_64 &rng) override
+      {
+        for (int f = 0; f < FOLDERS; ++f)
+        {
+          auto folder = createFolder(client, "mixed-" + std::to_string(f), std::nullopt);
+          if (!folder)
+            return false;
+          folders.push_back(*folder);
+        }
+        for (int i = 0; i < INITIAL_FILES; ++i)
+        {
+          auto file = uploadFile(client, pick(folders, rng), "seed-" + std::to_string(i) + ".bin", fileSize(rng), rng);
+          if (!file)
+            return false;
+          files.push_back(*file);
+        }
+        return true;
+      }
+
+      RequestSpec next(std::mt19937_64 &rng) override
+      {
+        double roll = uniform(rng);
+        if (roll < 0.3 || files.empty())
+        {
+          std::string name = "upload-" + std::to_string(uploads++) + ".bin";
+          return {"upload", http::verb::post, "/upload?folder_id=" + std::to_string(pick(folders, rng)),
+                  multipartUpload(name, fileSize(rng), rng), MULTIPART_TYPE,
+                  [this](const Response &response)
+                  {
+                    if (auto id = responseId(response))
+                      files.push_back(*id);
+                  }};
+        }
+        if (roll < 0.9)
+          return {"download", http::verb::get, "/download/" + std::to_string(pick(files, rng)), "", "", nullptr};
+
+        // forgotten as soon as the delete is sent, so nothing else picks it meanwhile
+        size_t index = rng() % files.size();
+        int64_t id = files[index];
+        removeAt(files, index);
+        return {"delete", http::verb::delete_, "/files/" + std::to_string(id), "", "", nullptr};
+      }
+
+    private:
+      // mostly small files with a tail of large ones
+      static size_t fileSize(std::mt19937_64 &rng)
+      {
+        return uniform(rng) < 0.9 ? 1024 + rng() % (64 * 1024) : 1024 * 1024 + rng() % (4 * 1024 * 1024);
+      }
+
+      static constexpr int FOLDERS = 10;
+      static constexpr int INITIAL_FILES = 200;
+      std::vector<int64_t> folders;
+      std::vector<int64_t> files;
+      uint64_t uploads = 0;
+    };
+
+    // Tags attached and removed at a high rate, with listings that read them back
+    class TagStormScenario : public Scenario
+    {
+    public:
+      const char *name() const override { return "tags"; }
+
+      bool setup(SyncClient &client, std::mt19937_64 &rng) override
+      {
+        auto created = createFolder(client, "tags", std::nullopt);
+        if (!created)
+          return false;
+        folder = *created;
+        for (int i = 0; i < FILES; ++i)
+        {
+          auto file = uploadFile(client, folder, "tagged-" + std::to_string(i) + ".txt", 256, rng);
+          if (!file)
+            return false;
+          files.push_back(*file);
+        }
+        // tag names are unique server-wide, so a rerun against the same server needs new ones
+        std::string run = std::to_string(rng() % 1000000);
+        for (int t = 0; t < TAGS; ++t)
+        {
+          std::string name = "storm-" + run + "-" + std::to_string(t);
+          auto tag = responseId(client.request(http::verb::post, "/tags", R"({"name":")" + name + R"("})", JSON_TYPE));
+          if (!tag)
+            return false;
+          tags.push_back({*tag, name});
+        }
+        state.assign(files.size() * tags.size(), Absent);
+        return true;
+      }
+
+      RequestSpec next(std::mt19937_64 &rng) override
+      {
+        double roll = uniform(rng);
+        if (roll < 0.2)
+          return {"get_folder", http::verb::get, "/folder/" + std::to_string(folder), "", "", nullptr};
+
+        size_t file = rng() % files.size();
+        size_t tag = rng() % tags.size();
+        size_t pair = file * tags.size() + tag;
+        if (roll < 0.3 || state[pair] == Pending)
+          return {"get_tags", http::verb::get, "/tags", "", "", nullptr};
+
+        std::string target = "/files/" + std::to_string(files[file]) + "/tags";
+        if (state[pair] == Attached)
+        {
+          state[pair] = Pending;
+          return {"remove_tag", http::verb::delete_, target + "/" + std::to_string(tags[tag].id), "", "",
+                  [this, pair](const Response &response)
+                  { state[pair] = response.status == 200 ? Absent : Attached; }};
+        }
+        state[pair] = Pending;
+        return {"add_tag", http::verb::post, target, R"({"tagName":")" + tags[tag].name + R"("})", JSON_TYPE,
+                [this, pair](const Response &response)
+                { state[pair] = response.status >= 200 && response.status < 300 ? Attached : Absent; }};
+      }
+
+    private:
+      enum PairState : uint8_t
+      {
+        Absent,
+        Pending,
+        Attached
+      };
+
+      struct Tag
+      {
+        int64_t id;
+        std::string name;
+      };
+
+      static constexpr int FILES = 200;
+      static constexpr int TAGS = 32;
+      int64_t folder = 0;
+      std::vector<int64_t> files;
+      std::vector<Tag> tags;
+      std::vector<PairState> state; // files x tags
+    };
+
+    // Deletes of deep folder trees while other connections browse and grow them
+    class DeepDeleteScenario : public Scenario
+    {
+    public:
+      const char *name() const override { return "deep-delete"; }
+
+      bool setup(SyncClient &client, std::mt19937_64 &rng) override
+      {
+        for (int t = 0; t < INITIAL_TREES; ++t)
+        {
+          Tree tree;
+          std::optional<int64_t> parent;
+          for (size_t depth = 0; depth < DEPTH; ++depth)
+          {
+            auto folder = createFolder(client, "deep-" + std::to_string(t) + "-" + std::to_string(depth), parent);
+            if (!folder || !uploadFile(client, *folder, "leaf.txt", 1024, rng))
+              return false;
+            tree.folders.push_back(*folder);
+            parent = folder;
+          }
+          trees.push_back(std::move(tree));
+        }
+        growing.resize(GROWING);
+        return true;
+      }
+
+      RequestSpec next(std::mt19937_64 &rng) override
+      {
+        double roll = uniform(rng);
+        // deletes outpace the rebuilds, so they wait once few trees are left to browse
+        if (roll < 0.1 && trees.size() > MIN_TREES)
+        {
+          size_t index = rng() % trees.size();
+          int64_t top = trees[index].folders.front();
+          removeAt(trees, index);
+          return {"delete_tree", http::verb::delete_, "/folder/" + std::to_string(top), "", "", nullptr};
+        }
+        if (roll < 0.4)
+        {
+          // trees are rebuilt a level at a time; one request per growing tree is in flight at most
+          size_t slot = rng() % growing.size();
+          if (!growing[slot].pending)
+            return grow(slot, rng);
+        }
+        if (trees.empty())
+          return {"get_root", http::verb::get, "/folder", "", "", nullptr};
+        const Tree &tree = pick(trees, rng);
+        return {"get_folder", http::verb::get, "/folder/" + std::to_string(pick(tree.folders, rng)), "", "", nullptr};
+      }
+
+    private:
+      struct Tree
+      {
+        std::vector<int64_t> folders; // top first
+      };
+
+      struct Growing
+      {
+        Tree tree;
+        bool pending = false;
+        bool needsFile = false; // the deepest folder still wants its file
+      };
+
+      RequestSpec grow(size_t slot, std::mt19937_64 &rng)
+      {
+        Growing &growth = growing[slot];
+        growth.pending = true;
+        if (growth.needsFile)
+        {
+          return {"grow_upload", http::verb::post, "/upload?folder_id=" + std::to_string(growth.tree.folders.back()),
+                  multipartUpload("leaf.txt", 1024, rng), MULTIPART_TYPE,
+                  [this, slot](const Response &response)
+                  {
+                    Growing &growth = growing[slot];
+                    growth.pending = false;
+                    if (response.status < 200 || response.status >= 300)
+                      return;
+                    growth.needsFile = false;
+                    if (growth.tree.folders.size() == DEPTH)
+                    {
+                      trees.push_back(std::move(growth.tree));
+                      growth.tree = Tree{};
+                    }
+                  }};
+        }
+
+        std::string body = R"({"name":"grown-)" + std::to_string(grown++) + R"(")";
+        if (!growth.tree.folders.empty())
+          body += R"(,"parent_id":)" + std::to_string(growth.tree.folders.back());
+        body += "}";
+        return {"grow_folder", http::verb::post, "/folder", body, JSON_TYPE,
+                [this, slot](const Response &response)
+                {
+                  Growing &growth = growing[slot];
+                  growth.pending = false;
+                  if (auto id = responseId(response))
+                  {
+                    growth.tree.folders.push_back(*id);
+                    growth.needsFile = true;
+                  }
+                }};
+      }
+
+      static constexpr size_t DEPTH = 16;
+      static constexpr int INITIAL_TREES = 50;
+      static constexpr size_t MIN_TREES = 10;
+      static constexpr size_t GROWING = 16;
+      std::vector<Tree> trees;
+      std::vector<Growing> growing;
+      uint64_t grown = 0;
+    };
+
+    std::unique_ptr<Scenario> createScenario(const std::string &name)
+    {
+      if (name == "browse")
+        return std::make_unique<BrowseScenario>();
+      if (name == "mixed")
+        return std::make_unique<MixedScenario>();
+      if (name == "tags")
+        return std::make_unique<TagStormScenario>();
+      if (name == "deep-delete")
+        return std::make_unique<DeepDeleteScenario>();
+      return nullptr;
+    }
+
+    std::vector<std::string> scenarioNames()
+    {
+      return {"browse", "mixed", "tags", "deep-delete"};
+    }
+  }
+}
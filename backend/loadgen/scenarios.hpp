@@ -0,0 +1,16 @@
+#pragma once
+
+#include "load_client.hpp"
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace bytebucket
+{
+  namespace load
+  {
+    // browse, mixed, tags or deep-delete; nullptr for any other name
+    std::unique_ptr<Scenario> createScenario(const std::string &name);
+    std::vector<std::string> scenarioNames();
+  }
+}
@@ -0,0 +1,300 @@
+#include "access_log.hpp"
+#include "json_escape.hpp"
+#include <algorithm>
+#include <ctime>
+#include <filesystem>
+#include <iostream>
+
+namespace bytebucket
+{
+  static std::atomic<uint64_t> nextLogId{1};
+
+  // Single-producer single-consumer ring: the request thread owns head, the
+  // writer thread owns tail, and each only reads the other's index
+  struct AccessLog::Ring
+  {
+    explicit Ring(size_t capacity) : slots(capacity), mask(capacity - 1) {}
+
+    bool tryPush(const LogRecord &record)
+    {
+      uint64_t h = head.load(std::memory_order_relaxed);
+      if (h - tail.load(std::memory_order_acquire) >= slots.size())
+        return false;
+      slots[h & mask] = record;
+      head.store(h + 1, std::memory_order_release);
+      return true;
+    }
+
+    bool tryPop(LogRecord &record)
+    {
+      uint64_t t = tail.load(std::memory_order_relaxed);
+      if (t == head.load(std::memory_order_acquire))
+        return false;
+      record = slots[t & mask];
+      tail.store(t + 1, std::memory_order_release);
+      return true;
+    }
+
+    std::vector<LogRecord> slots;
+    const uint64_t mask;
+    alignas(64) std::atomic<uint64_t> head{0};
+    alignas(64) std::atomic<uint64_t> tail{0};
+    std::atomic<bool> closed{false}; // the producing thread has exited
+  };
+
+  static size_t roundUpToPowerOfTwo(size_t value)
+  {
+    size_t power = 1;
+    while (power < value)
+      power <<= 1;
+    return power;
+  }
+
+  std::shared_ptr<AccessLog> AccessLog::create(const Options &options)
+  {
+    auto log = std::shared_ptr<AccessLog>(new AccessLog(options));
+    if (!log->file)
+      return nullptr;
+    log->writer = std::thread([raw = log.get()]()
+                              { raw->run(); });
+    return log;
+  }
+
+  AccessLog::AccessLog(const Options &options) : options(options), id(nextLogId++)
+  {
+    this->options.ringCapacity = roundUpToPowerOfTwo(options.ringCapacity == 0 ? 1 : options.ringCapacity);
+    file = std::fopen(options.path.c_str(), "a");
+    if (!file)
+    {
+      std::cerr << "Couldn't open access log " << options.path << std::endl;
+      return;
+    }
+    std::error_code ec;
+    fileBytes = std::filesystem::file_size(options.path, ec);
+    if (ec)
+      fileBytes = 0;
+  }
+
+  AccessLog::~AccessLog()
+  {
+    {
+      std::lock_guard<std::mutex> lock(wakeMutex);
+      stopping = true;
+    }
+    wake.notify_all();
+    if (writer.joinable())
+      writer.join();
+    if (file)
+      std::fclose(file);
+  }
+
+  AccessLog::Ring &AccessLog::localRing()
+  {
+    // closes the ring when its thread exits so the writer can drop it once drained
+    struct LocalRing
+    {
+      uint64_t owner = 0;
+      std::shared_ptr<Ring> ring;
+
+      ~LocalRing()
+      {
+        if (ring)
+          ring->closed.store(true, std::memory_order_release);
+      }
+    };
+    thread_local LocalRing local;
+
+    if (local.owner != id)
+    {
+      if (local.ring)
+        local.ring->closed.store(true, std::memory_order_release);
+      local.ring = std::make_shared<Ring>(options.ringCapacity);
+      local.owner = id;
+      std::lock_guard<std::mutex> lock(ringsMutex);
+      rings.push_back(local.ring);
+    }
+    return *local.ring;
+  }
+
+  bool AccessLog::push(const LogRecord &record)
+  {
+    if (localRing().tryPush(record))
+      return true;
+    dropped.fetch_add(1, std::memory_order_relaxed);
+    return false;
+  }
+
+  bool AccessLog::event(std::string_view name, std::string_view message)
+  {
+    LogRecord record;
+    record.kind = LogRecord::Kind::Event;
+    record.time = std::chrono::system_clock::now();
+    LogRecord::copy(record.route, name);
+    LogRecord::copy(record.target, message);
+    return push(record);
+  }
+
+  void AccessLog::flush()
+  {
+    std::unique_lock<std::mutex> lock(wakeMutex);
+    uint64_t request = ++flushRequests;
+    wake.notify_all();
+    flushed.wait(lock, [&]()
+                 { return flushesDone >= request || stopping; });
+  }
+
+  AccessLog::Stats AccessLog::stats() const
+  {
+    Stats result;
+    result.written = written.load(std::memory_order_relaxed);
+    result.dropped = dropped.load(std::memory_order_relaxed);
+    result.rotations = rotations.load(std::memory_order_relaxed);
+    return result;
+  }
+
+  void AccessLog::run()
+  {
+    std::string batch;
+    for (;;)
+    {
+      uint64_t flushTarget;
+      bool stop;
+      {
+        std::unique_lock<std::mutex> lock(wakeMutex);
+        wake.wait_for(lock, options.flushInterval, [this]()
+                      { return stopping || flushRequests > flushesDone; });
+        flushTarget = flushRequests;
+        stop = stopping;
+      }
+
+      batch.clear();
+      size_t lines = drain(batch);
+      if (lines > 0 && writeBatch(batch))
+        written.fetch_add(lines, std::memory_order_relaxed);
+
+      {
+        std::lock_guard<std::mutex> lock(wakeMutex);
+        flushesDone = flushTarget;
+      }
+      flushed.notify_all();
+      if (stop)
+        return;
+    }
+  }
+
+  static void appendTime(std::string &out, std::chrono::system_clock::time_point time)
+  {
+    auto millis = std::chrono::duration_cast<std::chrono::milliseconds>(time.time_since_epoch()).count();
+    std::time_t seconds = static_cast<std::time_t>(millis / 1000);
+    std::tm utc{};
+    gmtime_r(&seconds, &utc);
+    char formatted[64];
+    std::snprintf(formatted, sizeof(formatted), "\"%04d-%02d-%02dT%02d:%02d:%02d.%03dZ\"",
+                  utc.tm_year + 1900, utc.tm_mon + 1, utc.tm_mday, utc.tm_hour, utc.tm_min, utc.tm_sec,
+                  static_cast<int>(millis % 1000));
+    out += formatted;
+  }
+
+  static void appendRecord(std::string &out, const LogRecord &record)
+  {
+    out += "{\"time\":";
+    appendTime(out, record.time);
+    if (record.kind == LogRecord::Kind::Event)
+    {
+      out += ",\"event\":";
+      appendJsonString(out, record.route.data());
+      out += ",\"message\":";
+      appendJsonString(out, record.target.data());
+      out += "}\n";
+      return;
+    }
+
+    out += ",\"remote\":";
+    appendJsonString(out, record.remote.data());
+    out += ",\"method\":";
+    appendJsonString(out, record.method.data());
+    out += ",\"target\":";
+    appendJsonString(out, record.target.data());
+    out += ",\"route\":";
+    appendJsonString(out, record.route.data());
+    out += ",\"status\":" + std::to_string(record.status);
+    out += ",\"bytes_in\":" + std::to_string(record.bytesIn);
+    out += ",\"bytes_out\":" + std::to_string(record.bytesOut);
+    out += ",\"duration_us\":" + std::to_string(record.durationMicros);
+    out += "}\n";
+  }
+
+  size_t AccessLog::drain(std::string &batch)
+  {
+    std::vector<std::shared_ptr<Ring>> current;
+    {
+      std::lock_guard<std::mutex> lock(ringsMutex);
+      current = rings;
+    }
+
+    size_t lines = 0;
+    LogRecord record;
+    for (const auto &ring : current)
+    {
+      // read closed first: once it's set, nothing more can be pushed behind what's drained here
+      bool closed = ring->closed.load(std::memory_order_acquire);
+      while (ring->tryPop(record))
+      {
+        appendRecord(batch, record);
+        ++lines;
+      }
+      if (closed)
+      {
+        std::lock_guard<std::mutex> lock(ringsMutex);
+        rings.erase(std::find(rings.begin(), rings.end(), ring));
+      }
+    }
+
+    uint64_t droppedNow = dropped.load(std::memory_order_relaxed);
+    if (droppedNow > droppedReported)
+    {
+      LogRecord note;
+      note.kind = LogRecord::Kind::Event;
+      note.time = std::chrono::system_clock::now();
+      LogRecord::copy(note.route, "log_dropped");
+      LogRecord::copy(note.target, std::to_string(droppedNow - droppedReported) + " records dropped: log rings full");
+      appendRecord(batch, note);
+      droppedReported = droppedNow;
+      ++lines;
+    }
+    return lines;
+  }
+
+  bool AccessLog::writeBatch(const std::string &batch)
+  {
+    if (fileBytes > 0 && fileBytes + batch.size() > options.maxBytes)
+      rotate();
+    if (!file)
+      return false;
+
+    size_t wrote = std::fwrite(batch.data(), 1, batch.size(), file);
+    std::fflush(file);
+    fileBytes += wrote;
+    return wrote == batch.size();
+  }
+
+  void AccessLog::rotate()
+  {
+    std::fclose(file);
+    std::error_code ec;
+    if (options.keepFiles == 0)
+      std::filesystem::remove(options.path, ec);
+    else
+    {
+      for (unsigned i = options.keepFiles - 1; i >= 1; --i)
+        std::filesystem::rename(options.path + "." + std::to_string(i), options.path + "." + std::to_string(i + 1), ec);
+      std::filesystem::rename(options.path, options.path + ".1", ec);
+    }
+
+    file = std::fopen(options.path.c_str(), "w");
+    if (!file)
+      std::cerr << "Couldn't reopen access log " << options.path << " after rotating" << std::endl;
+    fileBytes = 0;
+    rotations.fetch_add(1, std::memory_order_relaxed);
+  }
+}
@@ -0,0 +1,169 @@
+#include "admission_control.hpp"
+#include "env_config.hpp"
+#include <iterator>
+
+namespace bytebucket
+{
+  AdmissionLimits AdmissionLimits::fromEnvironment()
+  {
+    AdmissionLimits limits;
+    if (auto connections = readEnvCount("BYTEBUCKET_MAX_CONNECTIONS"))
+      limits.maxConnections = *connections;
+    if (auto uploads = readEnvCount("BYTEBUCKET_MAX_UPLOADS"))
+      limits.maxUploads = *uploads;
+    if (auto downloads = readEnvCount("BYTEBUCKET_MAX_DOWNLOADS"))
+      limits.maxDownloads = *downloads;
+    if (auto metadata = readEnvCount("BYTEBUCKET_MAX_METADATA_REQUESTS"))
+      limits.maxMetadata = *metadata;
+    if (auto queued = readEnvCount("BYTEBUCKET_ADMISSION_QUEUE"))
+      limits.maxQueued = *queued;
+    if (auto ms = readEnvCount("BYTEBUCKET_ADMISSION_WAIT_MS"))
+      limits.queueWait = std::chrono::milliseconds(*ms);
+    if (auto seconds = readEnvCount("BYTEBUCKET_RETRY_AFTER_S"); seconds && *seconds > 0)
+      limits.retryAfter = std::chrono::seconds(*seconds);
+    return limits;
+  }
+
+  AdmissionControl::Ticket &AdmissionControl::Ticket::operator=(Ticket &&other) noexcept
+  {
+    if (this != &other)
+    {
+      if (gate)
+        gate->leave();
+      gate = other.gate;
+      other.gate = nullptr;
+    }
+    return *this;
+  }
+
+  AdmissionControl::Ticket::~Ticket()
+  {
+    if (gate)
+      gate->leave();
+  }
+
+  bool AdmissionControl::Gate::enter(std::chrono::milliseconds wait)
+  {
+    std::unique_lock<std::mutex> lock(mutex);
+    if (limit == 0 || inFlight < limit)
+    {
+      ++inFlight;
+      ++admitted;
+      return true;
+    }
+    if (queued >= maxQueued || wait.count() == 0)
+    {
+      ++rejected;
+      return false;
+    }
+
+    ++queued;
+    bool admit = freed.wait_for(lock, wait, [this]()
+                                { return inFlight < limit; });
+    --queued;
+    if (!admit)
+    {
+      ++rejected;
+      return false;
+    }
+    ++inFlight;
+    ++admitted;
+    ++waited;
+    return true;
+  }
+
+  void AdmissionControl::Gate::leave()
+  {
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      --inFlight;
+    }
+    freed.notify_one();
+  }
+
+  AdmissionControl::GateStats AdmissionControl::Gate::stats() const
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    GateStats stats;
+    stats.limit = limit;
+    stats.inFlight = inFlight;
+    stats.queued = queued;
+    stats.admitted = admitted;
+    stats.waited = waited;
+    stats.rejected = rejected;
+    return stats;
+  }
+
+  std::shared_ptr<AdmissionControl> AdmissionControl::create(const AdmissionLimits &limits)
+  {
+    return std::shared_ptr<AdmissionControl>(new AdmissionControl(limits));
+  }
+
+  AdmissionControl::AdmissionControl(const AdmissionLimits &limits) : configured(limits)
+  {
+    connectionGate.limit = limits.maxConnections;
+    const uint64_t requestLimits[] = {limits.maxUploads, limits.maxDownloads, limits.maxMetadata};
+    static_assert(std::size(requestLimits) == static_cast<size_t>(RouteClass::Control));
+    for (size_t routeClass = 0; routeClass < requestGates.size(); ++routeClass)
+    {
+      requestGates[routeClass].limit = requestLimits[routeClass];
+      requestGates[routeClass].maxQueued = limits.maxQueued;
+    }
+  }
+
+  RouteClass AdmissionControl::classify(boost::beast::http::verb method, boost::beast::string_view target)
+  {
+    using boost::beast::http::verb;
+    auto startsWith = [target](boost::beast::string_view prefix)
+    { return target.substr(0, prefix.size()) == prefix; };
+
+    if (method == verb::options || target == "/" || target == "/health" || target == "/metrics" ||
+        startsWith("/stats/") || startsWith("/debug/"))
+      return RouteClass::Control;
+
+    // chunk uploads and completion move bodies; status checks and aborts don't
+    if ((method == verb::post && (target == "/upload" || startsWith("/upload?") || target == "/uploads")) ||
+        (startsWith("/uploads/") && (method == verb::put || (method == verb::post && target.find("/complete") != boost::beast::string_view::npos))))
+      return RouteClass::Upload;
+
+    if (method == verb::get &&
+        (startsWith("/download/") ||
+         (startsWith("/folder/") && target.size() > 16 && target.substr(target.size() - 8) == "/archive")))
+      return RouteClass::Download;
+
+    return RouteClass::Metadata;
+  }
+
+  const char *AdmissionControl::routeClassName(RouteClass routeClass)
+  {
+    static constexpr const char *NAMES[] = {"upload", "download", "metadata", "control"};
+    static_assert(std::size(NAMES) == static_cast<size_t>(RouteClass::Count));
+    return NAMES[static_cast<size_t>(routeClass)];
+  }
+
+  std::optional<AdmissionControl::Ticket> AdmissionControl::admitConnection()
+  {
+    if (!connectionGate.enter(std::chrono::milliseconds(0)))
+      return std::nullopt;
+    return Ticket(&connectionGate);
+  }
+
+  std::optional<AdmissionControl::Ticket> AdmissionControl::admitRequest(RouteClass routeClass)
+  {
+    if (routeClass == RouteClass::Control)
+      return Ticket(nullptr);
+    Gate &gate = requestGates[static_cast<size_t>(routeClass)];
+    if (!gate.enter(configured.queueWait))
+      return std::nullopt;
+    return Ticket(&gate);
+  }
+
+  AdmissionControl::Stats AdmissionControl::stats() const
+  {
+    Stats stats;
+    stats.connections = connectionGate.stats();
+    for (size_t routeClass = 0; routeClass < requestGates.size(); ++routeClass)
+      stats.requests[routeClass] = requestGates[routeClass].stats();
+    return stats;
+  }
+}
@@ -0,0 +1,160 @@
+#include "blob_cache.hpp"
+#include <algorithm>
+#include <functional>
+
+namespace bytebucket
+{
+  // share of each shard kept for blobs that have been read more than once
+  static constexpr size_t PROTECTED_PERCENT = 80;
+
+  std::shared_ptr<BlobCache> BlobCache::create(size_t capacityBytes, size_t maxEntryBytes, size_t shardCount)
+  {
+    return std::shared_ptr<BlobCache>(new BlobCache(capacityBytes, maxEntryBytes, shardCount));
+  }
+
+  BlobCache::BlobCache(size_t capacityBytes, size_t maxEntryBytes, size_t shardCount)
+  {
+    shardCount = std::max<size_t>(shardCount, 1);
+    shardCapacity = capacityBytes / shardCount;
+    protectedCapacity = shardCapacity / 100 * PROTECTED_PERCENT;
+    // a blob can't be bigger than the shard it would live in
+    this->maxEntryBytes = std::min(maxEntryBytes, shardCapacity);
+    for (size_t i = 0; i < shardCount; ++i)
+      shards.push_back(std::make_unique<Shard>());
+  }
+
+  BlobCache::Shard &BlobCache::shardFor(const std::string &key)
+  {
+    return *shards[std::hash<std::string>{}(key) % shards.size()];
+  }
+
+  BlobCache::Blob BlobCache::get(const std::string &key)
+  {
+    Shard &shard = shardFor(key);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+
+    auto found = shard.index.find(key);
+    if (found == shard.index.end())
+    {
+      ++shard.misses;
+      return nullptr;
+    }
+    ++shard.hits;
+
+    auto entry = found->second;
+    size_t size = entry->blob->size();
+    if (entry->isProtected)
+    {
+      shard.protectedEntries.splice(shard.protectedEntries.begin(), shard.protectedEntries, entry);
+      return entry->blob;
+    }
+
+    // a second read promotes the blob; the protected segment's coldest entries
+    // drop back to probation to make room
+    shard.protectedEntries.splice(shard.protectedEntries.begin(), shard.probation, entry);
+    entry->isProtected = true;
+    shard.probationBytes -= size;
+    shard.protectedBytes += size;
+    while (shard.protectedBytes > protectedCapacity && shard.protectedEntries.size() > 1)
+    {
+      auto demoted = std::prev(shard.protectedEntries.end());
+      size_t demotedSize = demoted->blob->size();
+      demoted->isProtected = false;
+      shard.probation.splice(shard.probation.begin(), shard.protectedEntries, demoted);
+      shard.protectedBytes -= demotedSize;
+      shard.probationBytes += demotedSize;
+    }
+    return entry->blob;
+  }
+
+  bool BlobCache::put(const std::string &key, Blob blob)
+  {
+    if (!blob || blob->size() > maxEntryBytes)
+      return false;
+
+    Shard &shard = shardFor(key);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+
+    auto found = shard.index.find(key);
+    if (found != shard.index.end())
+      unlink(shard, found->second);
+
+    shard.probation.push_front(Entry{key, std::move(blob), false});
+    shard.index[key] = shard.probation.begin();
+    shard.probationBytes += shard.probation.front().blob->size();
+    ++shard.insertions;
+
+    while (shard.probationBytes + shard.protectedBytes > shardCapacity)
+      evict(shard);
+    return true;
+  }
+
+  void BlobCache::erase(const std::string &key)
+  {
+    Shard &shard = shardFor(key);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+
+    auto found = shard.index.find(key);
+    if (found == shard.index.end())
+      return;
+    unlink(shard, found->second);
+    ++shard.invalidations;
+  }
+
+  void BlobCache::clear()
+  {
+    for (auto &shard : shards)
+    {
+      std::lock_guard<std::mutex> lock(shard->mutex);
+      shard->invalidations += shard->index.size();
+      shard->index.clear();
+      shard->probation.clear();
+      shard->protectedEntries.clear();
+      shard->probationBytes = 0;
+      shard->protectedBytes = 0;
+    }
+  }
+
+  void BlobCache::unlink(Shard &shard, std::list<Entry>::iterator entry)
+  {
+    size_t size = entry->blob->size();
+    shard.index.erase(entry->key);
+    if (entry->isProtected)
+    {
+      shard.protectedBytes -= size;
+      shard.protectedEntries.erase(entry);
+    }
+    else
+    {
+      shard.probationBytes -= size;
+      shard.probation.erase(entry);
+    }
+  }
+
+  // Drops the least recently used probation entry, or a protected one if
+  // probation is empty
+  void BlobCache::evict(Shard &shard)
+  {
+    auto &segment = shard.probation.empty() ? shard.protectedEntries : shard.probation;
+    unlink(shard, std::prev(segment.end()));
+    ++shard.evictions;
+  }
+
+  BlobCache::Stats BlobCache::stats() const
+  {
+    Stats total;
+    total.capacityBytes = shardCapacity * shards.size();
+    for (const auto &shard : shards)
+    {
+      std::lock_guard<std::mutex> lock(shard->mutex);
+      total.hits += shard->hits;
+      total.misses += shard->misses;
+      total.insertions += shard->insertions;
+      total.evictions += shard->evictions;
+      total.invalidations += shard->invalidations;
+      total.entries += shard->index.size();
+      total.bytes += shard->probationBytes + shard->protectedBytes;
+    }
+    return total;
+  }
+}
@@ -0,0 +1,91 @@
+#include "boundary_scanner.hpp"
+#include <cstring>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace bytebucket
+{
+  BoundaryScanner::BoundaryScanner(std::string_view needle) : pattern(needle)
+  {
+    skip.fill(pattern.size());
+    for (size_t i = 0; i + 1 < pattern.size(); ++i)
+      skip[static_cast<unsigned char>(pattern[i])] = pattern.size() - 1 - i;
+  }
+
+  size_t BoundaryScanner::find(std::string_view haystack, size_t from) const
+  {
+    const size_t n = pattern.size();
+    if (from > haystack.size())
+      return std::string_view::npos;
+    if (n == 0)
+      return from;
+    if (n > haystack.size() - from)
+      return std::string_view::npos;
+
+    if (n == 1)
+    {
+      const void *hit = std::memchr(haystack.data() + from, pattern[0], haystack.size() - from);
+      return hit ? static_cast<size_t>(static_cast<const char *>(hit) - haystack.data()) : std::string_view::npos;
+    }
+
+#if defined(__SSE2__)
+    return findSse2(haystack, from);
+#else
+    return findHorspool(haystack, from);
+#endif
+  }
+
+  size_t BoundaryScanner::findHorspool(std::string_view haystack, size_t from) const
+  {
+    const size_t n = pattern.size();
+    const char *h = haystack.data();
+    const char *p = pattern.data();
+    const unsigned char last = static_cast<unsigned char>(p[n - 1]);
+
+    size_t i = from;
+    while (i + n <= haystack.size())
+    {
+      unsigned char c = static_cast<unsigned char>(h[i + n - 1]);
+      if (c == last && std::memcmp(h + i, p, n - 1) == 0)
+        return i;
+      i += skip[c];
+    }
+    return std::string_view::npos;
+  }
+
+#if defined(__SSE2__)
+  size_t BoundaryScanner::findSse2(std::string_view haystack, size_t from) const
+  {
+    const size_t n = pattern.size();
+    const char *h = haystack.data();
+    const char *p = pattern.data();
+
+    const __m128i first = _mm_set1_epi8(p[0]);
+    const __m128i last = _mm_set1_epi8(p[n - 1]);
+
+    // each block checks start positions i..i+15; the last-byte load reaches i+n-1+15
+    size_t i = from;
+    while (i + n - 1 + 16 <= haystack.size())
+    {
+      __m128i blockFirst = _mm_loadu_si128(reinterpret_cast<const __m128i *>(h + i));
+      __m128i blockLast = _mm_loadu_si128(reinterpret_cast<const __m128i *>(h + i + n - 1));
+      __m128i candidates = _mm_and_si128(_mm_cmpeq_epi8(first, blockFirst), _mm_cmpeq_epi8(last, blockLast));
+
+      unsigned mask = static_cast<unsigned>(_mm_movemask_epi8(candidates));
+      while (mask != 0)
+      {
+        unsigned bit = static_cast<unsigned>(__builtin_ctz(mask));
+        if (std::memcmp(h + i + bit + 1, p + 1, n - 2) == 0)
+          return i + bit;
+        mask &= mask - 1;
+      }
+      i += 16;
+    }
+
+    // fewer than 16 start positions left
+    return findHorspool(haystack, i);
+  }
+#endif
+}
@@ -0,0 +1,173 @@
+#include "compression.hpp"
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+
+namespace bytebucket
+{
+  static constexpr size_t OUTPUT_CHUNK = 64 * 1024;
+  // zlib counts input in uInt, so very large buffers are fed in slices
+  static constexpr size_t INPUT_SLICE = 1u << 30;
+
+  static std::string_view trim(std::string_view value)
+  {
+    while (!value.empty() && std::isspace(static_cast<unsigned char>(value.front())))
+      value.remove_prefix(1);
+    while (!value.empty() && std::isspace(static_cast<unsigned char>(value.back())))
+      value.remove_suffix(1);
+    return value;
+  }
+
+  static bool equalsIgnoreCase(std::string_view a, std::string_view b)
+  {
+    return a.size() == b.size() &&
+           std::equal(a.begin(), a.end(), b.begin(), [](char x, char y)
+                      { return std::tolower(static_cast<unsigned char>(x)) == std::tolower(static_cast<unsigned char>(y)); });
+  }
+
+  bool acceptsEncoding(std::string_view acceptEncoding, std::string_view coding)
+  {
+    std::optional<double> codingQuality;
+    std::optional<double> wildcardQuality;
+
+    while (!acceptEncoding.empty())
+    {
+      size_t comma = acceptEncoding.find(',');
+      std::string_view entry = trim(acceptEncoding.substr(0, comma));
+      acceptEncoding = comma == std::string_view::npos ? std::string_view{} : acceptEncoding.substr(comma + 1);
+
+      size_t semicolon = entry.find(';');
+      std::string_view name = trim(entry.substr(0, semicolon));
+      double quality = 1.0;
+      if (semicolon != std::string_view::npos)
+      {
+        std::string_view params = trim(entry.substr(semicolon + 1));
+        if (params.size() > 2 && (params[0] == 'q' || params[0] == 'Q') && params[1] == '=')
+          quality = std::strtod(std::string(params.substr(2)).c_str(), nullptr);
+      }
+
+      if (equalsIgnoreCase(name, coding))
+        codingQuality = quality;
+      else if (name == "*")
+        wildcardQuality = quality;
+    }
+
+    if (codingQuality.has_value())
+      return codingQuality.value() > 0.0;
+    return wildcardQuality.has_value() && wildcardQuality.value() > 0.0;
+  }
+
+  bool isCompressibleType(std::string_view contentType)
+  {
+    std::string type(trim(contentType.substr(0, contentType.find(';'))));
+    std::transform(type.begin(), type.end(), type.begin(), [](unsigned char c)
+                   { return static_cast<char>(std::tolower(c)); });
+
+    if (type.rfind("text/", 0) == 0)
+      return true;
+    if (type.size() > 5 && (type.compare(type.size() - 5, 5, "+json") == 0 || type.compare(type.size() - 4, 4, "+xml") == 0))
+      return true;
+
+    static const char *const compressible[] = {
+        "application/json",
+        "application/x-ndjson",
+        "application/javascript",
+        "application/xml",
+        "application/csv",
+        "application/x-yaml",
+        "application/yaml",
+        "application/sql",
+        "application/x-sh",
+    };
+    return std::any_of(std::begin(compressible), std::end(compressible), [&](const char *candidate)
+                       { return type == candidate; });
+  }
+
+  GzipCompressor &GzipCompressor::forThread()
+  {
+    thread_local GzipCompressor compressor;
+    return compressor;
+  }
+
+  GzipCompressor::GzipCompressor() = default;
+
+  GzipCompressor::~GzipCompressor()
+  {
+    if (initialised)
+      deflateEnd(&stream);
+  }
+
+  bool GzipCompressor::begin(int level)
+  {
+    if (!initialised)
+    {
+      // windowBits 15 + 16 selects the gzip wrapper
+      if (deflateInit2(&stream, level, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+        return false;
+      initialised = true;
+      currentLevel = level;
+      return true;
+    }
+
+    if (deflateReset(&stream) != Z_OK)
+      return false;
+    if (level != currentLevel)
+    {
+      if (deflateParams(&stream, level, Z_DEFAULT_STRATEGY) != Z_OK)
+        return false;
+      currentLevel = level;
+    }
+    return true;
+  }
+
+  bool GzipCompressor::write(std::string_view input, std::string &out)
+  {
+    while (!input.empty())
+    {
+      std::string_view slice = input.substr(0, INPUT_SLICE);
+      if (!deflateInto(slice, Z_NO_FLUSH, out))
+        return false;
+      input.remove_prefix(slice.size());
+    }
+    return true;
+  }
+
+  bool GzipCompressor::finish(std::string &out)
+  {
+    return deflateInto({}, Z_FINISH, out);
+  }
+
+  bool GzipCompressor::deflateInto(std::string_view input, int flush, std::string &out)
+  {
+    if (!initialised)
+      return false;
+
+    stream.next_in = reinterpret_cast<Bytef *>(const_cast<char *>(input.data()));
+    stream.avail_in = static_cast<uInt>(input.size());
+    do
+    {
+      size_t used = out.size();
+      out.resize(used + OUTPUT_CHUNK);
+      stream.next_out = reinterpret_cast<Bytef *>(&out[used]);
+      stream.avail_out = static_cast<uInt>(OUTPUT_CHUNK);
+
+      int returnCode = deflate(&stream, flush);
+      out.resize(used + OUTPUT_CHUNK - stream.avail_out);
+      if (returnCode == Z_STREAM_ERROR)
+        return false;
+      if (returnCode == Z_STREAM_END)
+        return true;
+    } while (stream.avail_out == 0 || stream.avail_in > 0);
+    return true;
+  }
+
+  std::optional<std::string> GzipCompressor::compress(std::string_view input, int level)
+  {
+    auto &compressor = forThread();
+    std::string out;
+    out.reserve(input.size() / 4 + 64);
+    if (!compressor.begin(level) || !compressor.write(input, out) || !compressor.finish(out))
+      return std::nullopt;
+    return out;
+  }
+}
@@ -0,0 +1,78 @@
+#include "connection_drain.hpp"
+#include <sys/socket.h>
+
+namespace bytebucket
+{
+  std::shared_ptr<ConnectionDrain> ConnectionDrain::create()
+  {
+    return std::shared_ptr<ConnectionDrain>(new ConnectionDrain());
+  }
+
+  ConnectionDrain::Session::Session(std::shared_ptr<ConnectionDrain> drain, boost::asio::ip::tcp::socket &socket)
+      : drain(std::move(drain))
+  {
+    entry.fd = socket.native_handle();
+    std::lock_guard<std::mutex> lock(this->drain->mutex);
+    this->drain->entries.insert(&entry);
+  }
+
+  ConnectionDrain::Session::~Session()
+  {
+    {
+      // under the lock, so drain never shuts down an fd the session has already closed
+      std::lock_guard<std::mutex> lock(drain->mutex);
+      drain->entries.erase(&entry);
+    }
+    drain->ended.notify_all();
+  }
+
+  bool ConnectionDrain::Session::idle()
+  {
+    // both sides are sequentially consistent: either drain sees this session idle
+    // and closes it, or the session sees the drain and doesn't wait
+    entry.idle.store(true);
+    if (!drain->isDraining.load())
+      return true;
+    entry.idle.store(false);
+    return false;
+  }
+
+  void ConnectionDrain::Session::busy()
+  {
+    entry.idle.store(false);
+  }
+
+  size_t ConnectionDrain::activeSessions() const
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    return entries.size();
+  }
+
+  ConnectionDrain::Result ConnectionDrain::drain(Clock::duration timeout, Clock::duration grace)
+  {
+    Result result;
+    isDraining.store(true);
+
+    std::unique_lock<std::mutex> lock(mutex);
+    for (Entry *entry : entries)
+    {
+      if (!entry->idle.load())
+        continue;
+      // wakes the session's wait for the next request, which then sees end of stream
+      ::shutdown(entry->fd, SHUT_RDWR);
+      ++result.idleClosed;
+    }
+
+    if (!ended.wait_for(lock, timeout, [this]()
+                        { return entries.empty(); }))
+    {
+      for (Entry *entry : entries)
+        ::shutdown(entry->fd, SHUT_RDWR);
+      result.forced = entries.size();
+      ended.wait_for(lock, grace, [this]()
+                     { return entries.empty(); });
+    }
+    result.complete = entries.empty();
+    return result;
+  }
+}
@@ -0,0 +1,89 @@
+#include "connection_pool.hpp"
+#include <chrono>
+#include <iostream>
+
+namespace bytebucket
+{
+  std::shared_ptr<ConnectionPool> ConnectionPool::create(const std::string &dbPath, size_t size, const DatabaseTuning &tuning)
+  {
+    auto pool = std::shared_ptr<ConnectionPool>(new ConnectionPool());
+    pool->size = size == 0 ? 1 : size;
+
+    for (size_t i = 0; i < pool->size; ++i)
+    {
+      auto connection = Database::createReadOnly(dbPath, tuning);
+      if (!connection)
+      {
+        std::cerr << "Failed to open pooled read connection" << std::endl;
+        return nullptr;
+      }
+      pool->idle.push_back(std::move(connection));
+    }
+
+    return pool;
+  }
+
+  std::shared_ptr<Database> ConnectionPool::acquire()
+  {
+    std::shared_ptr<Database> connection;
+    {
+      std::unique_lock<std::mutex> lock(mutex);
+      if (idle.empty())
+      {
+        auto waitStart = std::chrono::steady_clock::now();
+        available.wait(lock, [this]()
+                       { return !idle.empty(); });
+        auto waited = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - waitStart);
+        waitCount.fetch_add(1, std::memory_order_relaxed);
+        waitMicros.fetch_add(static_cast<uint64_t>(waited.count()), std::memory_order_relaxed);
+      }
+      connection = std::move(idle.back());
+      idle.pop_back();
+    }
+    acquisitionCount.fetch_add(1, std::memory_order_relaxed);
+
+    if (!connection->beginTransaction())
+    {
+      release(std::move(connection));
+      return nullptr;
+    }
+
+    // the lease aliases the pooled connection; dropping it ends the snapshot and hands it back
+    auto self = shared_from_this();
+    Database *raw = connection.get();
+    return std::shared_ptr<Database>(raw, [self, connection](Database *) mutable
+                                     {
+      connection->commitTransaction();
+      self->release(std::move(connection)); });
+  }
+
+  void ConnectionPool::release(std::shared_ptr<Database> connection)
+  {
+    // fold this lease's cache counters into the pool totals and start the connection from zero
+    auto counters = connection->getCacheCounters(true);
+    cacheHits.fetch_add(counters.hits, std::memory_order_relaxed);
+    cacheMisses.fetch_add(counters.misses, std::memory_order_relaxed);
+
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      idle.push_back(std::move(connection));
+    }
+    available.notify_one();
+  }
+
+  ConnectionPool::Stats ConnectionPool::stats() const
+  {
+    Stats stats;
+    stats.size = size;
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      stats.idle = idle.size();
+    }
+    stats.acquisitions = acquisitionCount.load(std::memory_order_relaxed);
+    stats.waits = waitCount.load(std::memory_order_relaxed);
+    stats.waitMicroseconds = waitMicros.load(std::memory_order_relaxed);
+    stats.cache.hits = cacheHits.load(std::memory_order_relaxed);
+    stats.cache.misses = cacheMisses.load(std::memory_order_relaxed);
+    return stats;
+  }
+}
@@ -1,11 +1,47 @@
 #include "database.hpp"
+#include "env_config.hpp"
+#include "tracing.hpp"
 #include <iostream>
 #include <iomanip>
 #include <sstream>
+#include <cstdlib>
+#include <cerrno>
+#include <cmath>
 
 namespace bytebucket
 {
-  inline std::optional<std::chrono::system_clock::time_point> parseSqliteToChrono(const char *sqlite3Time)
+  // metadata values are stored as text; values that are entirely a finite number
+  // are mirrored into value_num so range filters can use the (key, value_num) index
+  static std::optional<double> parseMetadataNumber(std::string_view value)
+  {
+    if (value.empty() || std::isspace(static_cast<unsigned char>(value.front())) ||
+        std::isspace(static_cast<unsigned char>(value.back())))
+      return std::nullopt;
+
+    std::string text(value);
+    char *end = nullptr;
+    errno = 0;
+    double number = std::strtod(text.c_str(), &end);
+    if (errno != 0 || end != text.c_str() + text.size() || !std::isfinite(number))
+      return std::nullopt;
+
+    return number;
+  }
+
+  static int64_t currentEpochMillis()
+  {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
+               std::chrono::system_clock::now().time_since_epoch())
+        .count();
+  }
+
+  static std::chrono::system_clock::time_point fromEpochMillis(int64_t millis)
+  {
+    return std::chrono::system_clock::time_point(
+        std::chrono::duration_cast<std::chrono::system_clock::duration>(std::chrono::milliseconds(millis)));
+  }
+
+  std::optional<std::chrono::system_clock::time_point> parseSqliteToChrono(const char *sqlite3Time)
   {
     if (!sqlite3Time)
       return std::nullopt;
@@ -79,8 +115,68 @@ namespace bytebucket
     return std::chrono::system_clock::from_time_t(utcTime);
   }
 
-  std::shared_ptr<Database> Database::create(const std::string &dbPath)
+  // maps a failed files INSERT to the matching DatabaseError
+  template <typename T>
+  static void setFileInsertError(sqlite3 *db, DatabaseResult<T> &result)
+  {
+    int extendedErrorCode = sqlite3_extended_errcode(db);
+    std::string errorMsg = sqlite3_errmsg(db);
+
+    switch (extendedErrorCode)
+    {
+    case SQLITE_CONSTRAINT_FOREIGNKEY:
+      result.error = DatabaseError::ForeignKeyConstraint;
+      result.errorMessage = "Folder doesn't exist";
+      break;
+    case SQLITE_CONSTRAINT_NOTNULL:
+      result.error = DatabaseError::NotNullConstraint;
+      result.errorMessage = "File name cannot be empty";
+      break;
+    case SQLITE_CONSTRAINT_UNIQUE:
+      result.error = DatabaseError::UniqueConstraint;
+      result.errorMessage = "A file with this storage ID already exists";
+      break;
+    case SQLITE_CONSTRAINT:
+      result.error = DatabaseError::UnknownError;
+      result.errorMessage = "Constraint violation: " + errorMsg;
+      break;
+    default:
+      result.error = DatabaseError::UnknownError;
+      result.errorMessage = "Database error: " + errorMsg;
+      break;
+    }
+  }
+
+  DatabaseTuning DatabaseTuning::fromEnvironment()
+  {
+    DatabaseTuning tuning;
+
+    if (auto mmapSize = readEnvInteger("BYTEBUCKET_SQLITE_MMAP_SIZE"); mmapSize && *mmapSize >= 0)
+      tuning.mmapSize = *mmapSize;
+    if (auto cacheSize = readEnvInteger("BYTEBUCKET_SQLITE_CACHE_SIZE"))
+      tuning.cacheSize = *cacheSize;
+    if (auto busyTimeout = readEnvInteger("BYTEBUCKET_SQLITE_BUSY_TIMEOUT_MS"); busyTimeout && *busyTimeout >= 0)
+      tuning.busyTimeoutMs = static_cast<int>(*busyTimeout);
+
+    if (const char *tempStore = std::getenv("BYTEBUCKET_SQLITE_TEMP_STORE"))
+    {
+      std::string_view value(tempStore);
+      if (value == "default")
+        tuning.tempStore = TempStore::Default;
+      else if (value == "file")
+        tuning.tempStore = TempStore::File;
+      else if (value == "memory")
+        tuning.tempStore = TempStore::Memory;
+      else if (!value.empty())
+        std::cerr << "Ignoring invalid BYTEBUCKET_SQLITE_TEMP_STORE: " << value << std::endl;
+    }
+
+    return tuning;
+  }
+
+  std::shared_ptr<Database> Database::create(const std::string &dbPath, const DatabaseTuning &tuning)
   {
+    TraceSpan span("Database::create", "db");
     sqlite3 *db = nullptr;
     int returnCode = sqlite3_open(dbPath.c_str(), &db);
     if (returnCode != SQLITE_OK)
@@ -92,7 +188,31 @@ namespace bytebucket
     }
 
     auto database = std::shared_ptr<Database>(new Database(db));
-    if (!database->executePragma() || !database->executeSchema())
+    if (queryProfiler)
+      database->trace = QueryProfiler::attach(queryProfiler, db);
+    if (!database->executePragma(tuning) || !database->migrate())
+      return nullptr;
+
+    return database;
+  }
+
+  std::shared_ptr<Database> Database::createReadOnly(const std::string &dbPath, const DatabaseTuning &tuning)
+  {
+    TraceSpan span("Database::createReadOnly", "db");
+    sqlite3 *db = nullptr;
+    int returnCode = sqlite3_open_v2(dbPath.c_str(), &db, SQLITE_OPEN_READONLY | SQLITE_OPEN_NOMUTEX, nullptr);
+    if (returnCode != SQLITE_OK)
+    {
+      std::cerr << "Couldn't open database read-only: " << sqlite3_errmsg(db) << std::endl;
+      if (db)
+        sqlite3_close(db);
+      return nullptr;
+    }
+
+    auto database = std::shared_ptr<Database>(new Database(db));
+    if (queryProfiler)
+      database->trace = QueryProfiler::attach(queryProfiler, db);
+    if (!database->executeStatement("PRAGMA query_only = ON;") || !database->applyTuning(tuning))
       return nullptr;
 
     return database;
@@ -101,7 +221,30 @@ namespace bytebucket
   Database::Database(sqlite3 *db) : db(db) {}
   Database::~Database() = default;
 
-  bool Database::executePragma() const
+  void Database::setQueryProfiler(std::shared_ptr<QueryProfiler> profiler)
+  {
+    queryProfiler = std::move(profiler);
+  }
+
+  std::shared_ptr<QueryProfiler> Database::getQueryProfiler()
+  {
+    return queryProfiler;
+  }
+
+  bool Database::executeStatement(const std::string &sql) const
+  {
+    char *errMsg = nullptr;
+    int returnCode = sqlite3_exec(db.get(), sql.c_str(), nullptr, nullptr, &errMsg);
+    if (returnCode != SQLITE_OK)
+    {
+      std::cerr << "Statement error (" << sql << "): " << (errMsg ? errMsg : sqlite3_errmsg(db.get())) << std::endl;
+      sqlite3_free(errMsg);
+      return false;
+    }
+    return true;
+  }
+
+  bool Database::executePragma(const DatabaseTuning &tuning) const
   {
     const char *pragmas[] = {
         "PRAGMA foreign_keys = ON;",
@@ -120,10 +263,112 @@ namespace bytebucket
         return false;
       }
     }
+    return applyTuning(tuning);
+  }
+
+  bool Database::applyTuning(const DatabaseTuning &tuning) const
+  {
+    return executeStatement("PRAGMA mmap_size = " + std::to_string(tuning.mmapSize) + ";") &&
+           executeStatement("PRAGMA cache_size = " + std::to_string(tuning.cacheSize) + ";") &&
+           executeStatement("PRAGMA temp_store = " + std::to_string(static_cast<int>(tuning.tempStore)) + ";") &&
+           executeStatement("PRAGMA busy_timeout = " + std::to_string(tuning.busyTimeoutMs) + ";");
+  }
+
+  std::optional<int64_t> Database::queryPragmaInt(const char *pragma) const
+  {
+    sqlite3_stmt *stmt = nullptr;
+    std::string sql = std::string("PRAGMA ") + pragma + ";";
+    if (sqlite3_prepare_v2(db.get(), sql.c_str(), -1, &stmt, nullptr) != SQLITE_OK)
+      return std::nullopt;
+
+    std::optional<int64_t> value;
+    if (sqlite3_step(stmt) == SQLITE_ROW)
+      value = sqlite3_column_int64(stmt, 0);
+    sqlite3_finalize(stmt);
+    return value;
+  }
+
+  bool Database::migrate() const
+  {
+    struct Migration
+    {
+      int version;
+      const char *description;
+      bool (Database::*apply)() const;
+    };
+
+    // Append only: a migration runs once per database, in order, and never changes once released.
+    // Steps 2-4 also bring databases from before versioning (user_version 0) up to date, so
+    // they check for what they add rather than assume it's missing.
+    static const Migration migrations[] = {
+        {1, "base tables, indexes and root folder", &Database::createBaseSchema},
+        {2, "file_metadata.value_num", &Database::migrateMetadataNumericValues},
+        {3, "files epoch-ms timestamps", &Database::migrateFileTimestampColumns}, // rows: migrateLegacyTimestamps
+        {4, "files.codec", &Database::migrateFileCodecColumn},
+        {5, "metadata and timestamp indexes", &Database::createMetadataIndexes},
+        {6, "upload_sessions", &Database::createUploadSessionsTable},
+        {7, "upload_sessions.revision", &Database::migrateUploadSessionRevision},
+    };
+    static_assert(sizeof(migrations) / sizeof(migrations[0]) == SCHEMA_VERSION,
+                  "SCHEMA_VERSION must name the last migration");
+
+    // an up to date database costs one pragma read and no DDL
+    auto version = queryPragmaInt("user_version");
+    if (!version)
+      return false;
+    if (*version == SCHEMA_VERSION)
+      return true;
+    if (*version > SCHEMA_VERSION)
+    {
+      std::cerr << "Database schema version " << *version << " is newer than this build supports ("
+                << SCHEMA_VERSION << ")" << std::endl;
+      return false;
+    }
+
+    auto started = std::chrono::steady_clock::now();
+    // another process may be migrating the same file; the version is read again once the lock is ours
+    if (!executeStatement("BEGIN EXCLUSIVE;"))
+      return false;
+    version = queryPragmaInt("user_version");
+    if (!version)
+    {
+      executeStatement("ROLLBACK;");
+      return false;
+    }
+
+    int64_t from = *version;
+    bool existing = hasColumn("folders", "id");
+    for (const Migration &migration : migrations)
+    {
+      if (migration.version <= from)
+        continue;
+      if (!(this->*migration.apply)() ||
+          !executeStatement("PRAGMA user_version = " + std::to_string(migration.version) + ";"))
+      {
+        std::cerr << "Schema migration " << migration.version << " (" << migration.description << ") failed"
+                  << std::endl;
+        executeStatement("ROLLBACK;");
+        return false;
+      }
+    }
+
+    if (!executeStatement("COMMIT;"))
+    {
+      executeStatement("ROLLBACK;");
+      return false;
+    }
+
+    // creating a fresh database isn't worth a log line; upgrading an existing one is
+    if (existing && from < SCHEMA_VERSION)
+    {
+      auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - started);
+      std::cerr << "Migrated database schema from version " << from << " to " << SCHEMA_VERSION << " in "
+                << elapsed.count() << " ms" << std::endl;
+    }
     return true;
   }
 
-  bool Database::executeSchema() const
+  bool Database::createBaseSchema() const
   {
     const char *schema = R"(
       CREATE TABLE IF NOT EXISTS folders (
@@ -138,11 +383,12 @@ namespace bytebucket
         id INTEGER PRIMARY KEY AUTOINCREMENT,
         name TEXT NOT NULL,
         folder_id INTEGER NOT NULL,
-        created_at TEXT DEFAULT CURRENT_TIMESTAMP,
-        updated_at TEXT DEFAULT CURRENT_TIMESTAMP,
+        created_at_ms INTEGER NOT NULL, -- unix epoch milliseconds
+        updated_at_ms INTEGER NOT NULL,
         size INTEGER,
         content_type TEXT,
         storage_id TEXT UNIQUE NOT NULL,
+        codec TEXT NOT NULL DEFAULT 'identity', -- blob encoding at rest: identity or gzip
         FOREIGN KEY (folder_id) REFERENCES folders(id) ON DELETE CASCADE
       );
 
@@ -172,14 +418,14 @@ namespace bytebucket
         file_id INTEGER NOT NULL,
         key TEXT NOT NULL,
         value TEXT,
+        value_num REAL,
         PRIMARY KEY (file_id, key),
         FOREIGN KEY (file_id) REFERENCES files(id) ON DELETE CASCADE
       );
     )";
 
     char *errMsg = nullptr;
-    int returnCode = sqlite3_exec(db.get(), schema, nullptr, nullptr, &errMsg);
-    if (returnCode != SQLITE_OK)
+    if (sqlite3_exec(db.get(), schema, nullptr, nullptr, &errMsg) != SQLITE_OK)
     {
       std::cerr << "Schema error: " << errMsg << std::endl;
       sqlite3_free(errMsg);
@@ -191,8 +437,7 @@ namespace bytebucket
       VALUES (1, 'root', NULL);
     )";
 
-    returnCode = sqlite3_exec(db.get(), rootFolderSql, nullptr, nullptr, &errMsg);
-    if (returnCode != SQLITE_OK)
+    if (sqlite3_exec(db.get(), rootFolderSql, nullptr, nullptr, &errMsg) != SQLITE_OK)
     {
       std::cerr << "Root folder creation error: " << errMsg << std::endl;
       sqlite3_free(errMsg);
@@ -202,18 +447,338 @@ namespace bytebucket
     return true;
   }
 
+  bool Database::createMetadataIndexes() const
+  {
+    const char *metadataIndexes = R"(
+      CREATE INDEX IF NOT EXISTS idx_file_metadata_key_value ON file_metadata(key, value);
+      CREATE INDEX IF NOT EXISTS idx_file_metadata_key_value_num ON file_metadata(key, value_num);
+      CREATE INDEX IF NOT EXISTS idx_files_created_at_ms ON files(created_at_ms);
+      CREATE INDEX IF NOT EXISTS idx_files_updated_at_ms ON files(updated_at_ms);
+    )";
+
+    char *errMsg = nullptr;
+    if (sqlite3_exec(db.get(), metadataIndexes, nullptr, nullptr, &errMsg) != SQLITE_OK)
+    {
+      std::cerr << "Metadata index error: " << errMsg << std::endl;
+      sqlite3_free(errMsg);
+      return false;
+    }
+    return true;
+  }
+
+  bool Database::hasColumn(const char *table, std::string_view column) const
+  {
+    bool found = false;
+    sqlite3_stmt *stmt = nullptr;
+    std::string sql = std::string("PRAGMA table_info(") + table + ");";
+    if (sqlite3_prepare_v2(db.get(), sql.c_str(), -1, &stmt, nullptr) != SQLITE_OK)
+      return false;
+
+    while (sqlite3_step(stmt) == SQLITE_ROW)
+    {
+      const char *columnName = reinterpret_cast<const char *>(sqlite3_column_text(stmt, 1));
+      if (columnName && std::string_view(columnName) == column)
+        found = true;
+    }
+    sqlite3_finalize(stmt);
+    return found;
+  }
+
+  bool Database::migrateMetadataNumericValues() const
+  {
+    if (hasColumn("file_metadata", "value_num"))
+      return true;
+
+    char *errMsg = nullptr;
+    if (sqlite3_exec(db.get(), "ALTER TABLE file_metadata ADD COLUMN value_num REAL;", nullptr, nullptr, &errMsg) != SQLITE_OK)
+    {
+      std::cerr << "Metadata migration error: " << errMsg << std::endl;
+      sqlite3_free(errMsg);
+      return false;
+    }
+
+    sqlite3_stmt *selectStmt = nullptr;
+    sqlite3_stmt *updateStmt = nullptr;
+    if (sqlite3_prepare_v2(db.get(), "SELECT rowid, value FROM file_metadata;", -1, &selectStmt, nullptr) != SQLITE_OK ||
+        sqlite3_prepare_v2(db.get(), "UPDATE file_metadata SET value_num = ? WHERE rowid = ?;", -1, &updateStmt, nullptr) != SQLITE_OK)
+    {
+      sqlite3_finalize(selectStmt);
+      sqlite3_finalize(updateStmt);
+      return false;
+    }
+
+    bool ok = true;
+    int rc;
+    while ((rc = sqlite3_step(selectStmt)) == SQLITE_ROW)
+    {
+      const char *valueText = reinterpret_cast<const char *>(sqlite3_column_text(selectStmt, 1));
+      auto number = parseMetadataNumber(valueText ? valueText : "");
+      if (!number.has_value())
+        continue;
+
+      sqlite3_bind_double(updateStmt, 1, number.value());
+      sqlite3_bind_int64(updateStmt, 2, sqlite3_column_int64(selectStmt, 0));
+      if (sqlite3_step(updateStmt) != SQLITE_DONE)
+      {
+        std::cerr << "Metadata migration error: " << sqlite3_errmsg(db.get()) << std::endl;
+        ok = false;
+        break;
+      }
+      sqlite3_reset(updateStmt);
+    }
+    if (ok && rc != SQLITE_DONE)
+    {
+      std::cerr << "Metadata migration error: " << sqlite3_errmsg(db.get()) << std::endl;
+      ok = false;
+    }
+    sqlite3_finalize(selectStmt);
+    sqlite3_finalize(updateStmt);
+    return ok;
+  }
+
+  bool Database::migrateFileTimestampColumns() const
+  {
+    if (hasColumn("files", "created_at_ms"))
+      return true;
+
+    // ALTER can't add NOT NULL without a default; legacy rows stay NULL until migrated
+    const char *sql = R"(
+      ALTER TABLE files ADD COLUMN created_at_ms INTEGER;
+      ALTER TABLE files ADD COLUMN updated_at_ms INTEGER;
+    )";
+
+    char *errMsg = nullptr;
+    if (sqlite3_exec(db.get(), sql, nullptr, nullptr, &errMsg) != SQLITE_OK)
+    {
+      std::cerr << "Timestamp migration error: " << errMsg << std::endl;
+      sqlite3_free(errMsg);
+      return false;
+    }
+    return true;
+  }
+
+  bool Database::migrateFileCodecColumn() const
+  {
+    if (hasColumn("files", "codec"))
+      return true;
+
+    char *errMsg = nullptr;
+    if (sqlite3_exec(db.get(), "ALTER TABLE files ADD COLUMN codec TEXT NOT NULL DEFAULT 'identity';",
+                     nullptr, nullptr, &errMsg) != SQLITE_OK)
+    {
+      std::cerr << "Codec migration error: " << errMsg << std::endl;
+      sqlite3_free(errMsg);
+      return false;
+    }
+    return true;
+  }
+
+  bool Database::createUploadSessionsTable() const
+  {
+    const char *uploadSessions = R"(
+      CREATE TABLE IF NOT EXISTS upload_sessions (
+        id TEXT PRIMARY KEY,
+        filename TEXT NOT NULL,
+        content_type TEXT NOT NULL,
+        folder_id INTEGER,
+        size INTEGER NOT NULL,
+        ranges TEXT NOT NULL DEFAULT ''
+      );
+    )";
+
+    char *errMsg = nullptr;
+    if (sqlite3_exec(db.get(), uploadSessions, nullptr, nullptr, &errMsg) != SQLITE_OK)
+    {
+      std::cerr << "Upload sessions table error: " << errMsg << std::endl;
+      sqlite3_free(errMsg);
+      return false;
+    }
+    return true;
+  }
+
+  bool Database::migrateUploadSessionRevision() const
+  {
+    if (hasColumn("upload_sessions", "revision"))
+      return true;
+
+    char *errMsg = nullptr;
+    if (sqlite3_exec(db.get(), "ALTER TABLE upload_sessions ADD COLUMN revision INTEGER NOT NULL DEFAULT 0;",
+                     nullptr, nullptr, &errMsg) != SQLITE_OK)
+    {
+      std::cerr << "Upload session revision migration error: " << errMsg << std::endl;
+      sqlite3_free(errMsg);
+      return false;
+    }
+    return true;
+  }
+
+  FileRecord Database::readFileRecord(sqlite3_stmt *stmt) const
+  {
+    FileRecord file;
+    file.id = sqlite3_column_int(stmt, 0);
+    file.name = reinterpret_cast<const char *>(sqlite3_column_text(stmt, 1));
+    file.folderId = sqlite3_column_int(stmt, 2);
+    file.createdAt = fromEpochMillis(sqlite3_column_int64(stmt, 3));
+    file.updatedAt = fromEpochMillis(sqlite3_column_int64(stmt, 4));
+    file.size = sqlite3_column_int64(stmt, 5);
+    file.contentType = reinterpret_cast<const char *>(sqlite3_column_text(stmt, 6));
+    file.storageId = reinterpret_cast<const char *>(sqlite3_column_text(stmt, 7));
+    if (const unsigned char *codec = sqlite3_column_text(stmt, 8))
+      file.codec = reinterpret_cast<const char *>(codec);
+
+    // rows from before the epoch-ms columns that haven't been migrated yet
+    bool createdMissing = sqlite3_column_type(stmt, 3) == SQLITE_NULL;
+    bool updatedMissing = sqlite3_column_type(stmt, 4) == SQLITE_NULL;
+    if (createdMissing || updatedMissing)
+    {
+      sqlite3_stmt *legacyStmt = nullptr;
+      if (sqlite3_prepare_v2(db.get(), "SELECT created_at, updated_at FROM files WHERE id = ?;", -1, &legacyStmt, nullptr) == SQLITE_OK)
+      {
+        sqlite3_bind_int(legacyStmt, 1, file.id);
+        if (sqlite3_step(legacyStmt) == SQLITE_ROW)
+        {
+          auto created = parseSqliteToChrono(reinterpret_cast<const char *>(sqlite3_column_text(legacyStmt, 0)));
+          auto updated = parseSqliteToChrono(reinterpret_cast<const char *>(sqlite3_column_text(legacyStmt, 1)));
+          if (createdMissing && created.has_value())
+            file.createdAt = created.value();
+          if (updatedMissing && updated.has_value())
+            file.updatedAt = updated.value();
+        }
+      }
+      sqlite3_finalize(legacyStmt);
+    }
+
+    return file;
+  }
+
+#pragma region tuning
+  DatabaseResult<int> Database::getSchemaVersion() const
+  {
+    TraceSpan span("Database::getSchemaVersion", "db");
+    DatabaseResult<int> result;
+    auto version = queryPragmaInt("user_version");
+    if (!version)
+    {
+      result.error = DatabaseError::UnknownError;
+      result.errorMessage = std::string("Failed to read user_version: ") + sqlite3_errmsg(db.get());
+      return result;
+    }
+    result.value = static_cast<int>(*version);
+    return result;
+  }
+
+  DatabaseResult<DatabaseTuningStatus> Database::getTuningStatus() const
+  {
+    TraceSpan span("Database::getTuningStatus", "db");
+    DatabaseResult<DatabaseTuningStatus> result;
+
+    // builds with memory mapping compiled out return no row for mmap_size
+    std::optional<int64_t> mmapSize = queryPragmaInt("mmap_size").value_or(0);
+    auto cacheSize = queryPragmaInt("cache_size");
+    auto tempStore = queryPragmaInt("temp_store");
+    auto busyTimeout = queryPragmaInt("busy_timeout");
+    auto pageSize = queryPragmaInt("page_size");
+    auto pageCount = queryPragmaInt("page_count");
+    if (!mmapSize || !cacheSize || !tempStore || !busyTimeout || !pageSize || !pageCount)
+    {
+      result.error = DatabaseError::UnknownError;
+      result.errorMessage = std::string("Failed to read pragma: ") + sqlite3_errmsg(db.get());
+      return result;
+    }
+
+    DatabaseTuningStatus status;
+    status.applied.mmapSize = *mmapSize;
+    status.applied.cacheSize = *cacheSize;
+    status.applied.tempStore = static_cast<TempStore>(*tempStore);
+    status.applied.busyTimeoutMs = static_cast<int>(*busyTimeout);
+    status.pageSize = *pageSize;
+    status.pageCount = *pageCount;
+
+    int current = 0;
+    int highwater = 0;
+    if (sqlite3_db_status(db.get(), SQLITE_DBSTATUS_CACHE_USED, &current, &highwater, 0) == SQLITE_OK)
+      status.cacheUsedBytes = current;
+    status.cache = getCacheCounters();
+
+    result.value = status;
+    return result;
+  }
+
+  DatabaseResult<bool> Database::checkpoint()
+  {
+    TraceSpan span("Database::checkpoint", "db");
+    DatabaseResult<bool> result;
+    // TRUNCATE waits out readers through the busy handler, then empties the WAL
+    int rc = sqlite3_wal_checkpoint_v2(db.get(), nullptr, SQLITE_CHECKPOINT_TRUNCATE, nullptr, nullptr);
+    if (rc != SQLITE_OK)
+    {
+      result.error = DatabaseError::UnknownError;
+      result.errorMessage = std::string("WAL checkpoint failed: ") + sqlite3_errmsg(db.get());
+      return result;
+    }
+    result.value = true;
+    return result;
+  }
+
+  CacheCounters Database::getCacheCounters(bool reset) const
+  {
+    CacheCounters counters;
+    int current = 0;
+    int highwater = 0;
+    if (sqlite3_db_status(db.get(), SQLITE_DBSTATUS_CACHE_HIT, &current, &highwater, reset ? 1 : 0) == SQLITE_OK)
+      counters.hits = current;
+    if (sqlite3_db_status(db.get(), SQLITE_DBSTATUS_CACHE_MISS, &current, &highwater, reset ? 1 : 0) == SQLITE_OK)
+      counters.misses = current;
+    return counters;
+  }
+#pragma endregion tuning
+
+#pragma region transactions
+  bool Database::beginTransaction(bool immediate)
+  {
+    return executeStatement(immediate ? "BEGIN IMMEDIATE;" : "BEGIN DEFERRED;");
+  }
+
+  bool Database::commitTransaction()
+  {
+    return executeStatement("COMMIT;");
+  }
+
+  bool Database::rollbackTransaction()
+  {
+    return executeStatement("ROLLBACK;");
+  }
+
+  bool Database::savepoint(std::string_view name)
+  {
+    return executeStatement("SAVEPOINT " + std::string(name) + ";");
+  }
+
+  bool Database::releaseSavepoint(std::string_view name)
+  {
+    return executeStatement("RELEASE SAVEPOINT " + std::string(name) + ";");
+  }
+
+  bool Database::rollbackToSavepoint(std::string_view name)
+  {
+    return executeStatement("ROLLBACK TO SAVEPOINT " + std::string(name) + ";");
+  }
+#pragma endregion transactions
+
 #pragma region files
   DatabaseResult<int> Database::addFile(
       std::string_view name,
       int folderId,
-      int size,
+      int64_t size,
       std::string_view contentType,
-      std::string_view storageId)
+      std::string_view storageId,
+      std::string_view codec)
   {
+    TraceSpan span("Database::addFile", "db");
     DatabaseResult<int> result;
     const char *sql = R"(
-      INSERT INTO files (name, folder_id, created_at, updated_at, size, content_type, storage_id) 
-      VALUES (?, ?, CURRENT_TIMESTAMP, CURRENT_TIMESTAMP, ?, ?, ?)
+      INSERT INTO files (name, folder_id, created_at_ms, updated_at_ms, size, content_type, storage_id, codec) 
+      VALUES (?, ?, ?, ?, ?, ?, ?, ?)
     )";
     sqlite3_stmt *stmt = nullptr;
 
@@ -224,55 +789,108 @@ namespace bytebucket
       return result;
     }
 
+    int64_t now = currentEpochMillis();
     sqlite3_bind_text(stmt, 1, name.data(), static_cast<int>(name.size()), SQLITE_STATIC);
     sqlite3_bind_int(stmt, 2, folderId);
-    sqlite3_bind_int(stmt, 3, size);
-    sqlite3_bind_text(stmt, 4, contentType.data(), static_cast<int>(contentType.size()), SQLITE_STATIC);
-    sqlite3_bind_text(stmt, 5, storageId.data(), static_cast<int>(storageId.size()), SQLITE_STATIC);
+    sqlite3_bind_int64(stmt, 3, now);
+    sqlite3_bind_int64(stmt, 4, now);
+    sqlite3_bind_int64(stmt, 5, size);
+    sqlite3_bind_text(stmt, 6, contentType.data(), static_cast<int>(contentType.size()), SQLITE_STATIC);
+    sqlite3_bind_text(stmt, 7, storageId.data(), static_cast<int>(storageId.size()), SQLITE_STATIC);
+    sqlite3_bind_text(stmt, 8, codec.data(), static_cast<int>(codec.size()), SQLITE_STATIC);
 
     int returnCode = sqlite3_step(stmt);
     sqlite3_finalize(stmt);
     if (returnCode != SQLITE_DONE)
     {
-      int extendedErrorCode = sqlite3_extended_errcode(db.get());
-      std::string errorMsg = sqlite3_errmsg(db.get());
+      setFileInsertError(db.get(), result);
+      return result;
+    }
 
-      switch (extendedErrorCode)
+    result.value = static_cast<int>(sqlite3_last_insert_rowid(db.get()));
+    result.error = DatabaseError::Success;
+    return result;
+  }
+
+  DatabaseResult<std::vector<FileRecord>> Database::addFiles(const std::vector<NewFile> &files)
+  {
+    TraceSpan span("Database::addFiles", "db");
+    DatabaseResult<std::vector<FileRecord>> result;
+    const char *sql = R"(
+      INSERT INTO files (name, folder_id, created_at_ms, updated_at_ms, size, content_type, storage_id, codec) 
+      VALUES (?, ?, ?, ?, ?, ?, ?, ?)
+      RETURNING id, name, folder_id, created_at_ms, updated_at_ms, size, content_type, storage_id, codec
+    )";
+    sqlite3_stmt *stmt = nullptr;
+
+    if (sqlite3_prepare_v3(db.get(), sql, -1, SQLITE_PREPARE_PERSISTENT, &stmt, nullptr) != SQLITE_OK)
+    {
+      result.error = DatabaseError::PrepareStatementFailed;
+      result.errorMessage = "Failed to prepare file insert statement";
+      return result;
+    }
+
+    if (!savepoint("add_files"))
+    {
+      sqlite3_finalize(stmt);
+      result.error = DatabaseError::UnknownError;
+      result.errorMessage = "Failed to start file insert savepoint";
+      return result;
+    }
+
+    std::vector<FileRecord> records;
+    records.reserve(files.size());
+    int64_t now = currentEpochMillis();
+    bool failed = false;
+
+    for (const auto &file : files)
+    {
+      sqlite3_bind_text(stmt, 1, file.name.data(), static_cast<int>(file.name.size()), SQLITE_STATIC);
+      sqlite3_bind_int(stmt, 2, file.folderId);
+      sqlite3_bind_int64(stmt, 3, now);
+      sqlite3_bind_int64(stmt, 4, now);
+      sqlite3_bind_int64(stmt, 5, file.size);
+      sqlite3_bind_text(stmt, 6, file.contentType.data(), static_cast<int>(file.contentType.size()), SQLITE_STATIC);
+      sqlite3_bind_text(stmt, 7, file.storageId.data(), static_cast<int>(file.storageId.size()), SQLITE_STATIC);
+      sqlite3_bind_text(stmt, 8, file.codec.data(), static_cast<int>(file.codec.size()), SQLITE_STATIC);
+
+      // the row comes back from RETURNING; the next step finishes the insert
+      if (sqlite3_step(stmt) != SQLITE_ROW)
       {
-      case SQLITE_CONSTRAINT_FOREIGNKEY:
-        result.error = DatabaseError::ForeignKeyConstraint;
-        result.errorMessage = "Folder doesn't exist";
-        break;
-      case SQLITE_CONSTRAINT_NOTNULL:
-        result.error = DatabaseError::NotNullConstraint;
-        result.errorMessage = "File name cannot be empty";
-        break;
-      case SQLITE_CONSTRAINT_UNIQUE:
-        result.error = DatabaseError::UniqueConstraint;
-        result.errorMessage = "A file with this storage ID already exists";
+        failed = true;
         break;
-      case SQLITE_CONSTRAINT:
-        result.error = DatabaseError::UnknownError;
-        result.errorMessage = "Constraint violation: " + errorMsg;
-        break;
-      default:
-        result.error = DatabaseError::UnknownError;
-        result.errorMessage = "Database error: " + errorMsg;
+      }
+      records.push_back(readFileRecord(stmt));
+      if (sqlite3_step(stmt) != SQLITE_DONE)
+      {
+        failed = true;
         break;
       }
+      sqlite3_reset(stmt);
+    }
+
+    if (failed)
+    {
+      setFileInsertError(db.get(), result);
+      sqlite3_finalize(stmt);
+      rollbackToSavepoint("add_files");
+      releaseSavepoint("add_files");
       return result;
     }
 
-    result.value = static_cast<int>(sqlite3_last_insert_rowid(db.get()));
+    sqlite3_finalize(stmt);
+    releaseSavepoint("add_files");
+    result.value = std::move(records);
     result.error = DatabaseError::Success;
     return result;
   }
 
   DatabaseResult<FileRecord> Database::getFileById(int id) const
   {
+    TraceSpan span("Database::getFileById", "db");
     DatabaseResult<FileRecord> result;
     const char *sql = R"(
-      SELECT id, name, folder_id, created_at, updated_at, size, content_type, storage_id 
+      SELECT id, name, folder_id, created_at_ms, updated_at_ms, size, content_type, storage_id, codec 
       FROM files 
       WHERE id = ?
     )";
@@ -296,16 +914,8 @@ namespace bytebucket
       return result;
     }
 
-    FileRecord file;
-    file.id = sqlite3_column_int(stmt, 0);
-    file.name = reinterpret_cast<const char *>(sqlite3_column_text(stmt, 1));
-    file.folderId = sqlite3_column_int(stmt, 2);
-    file.createdAt = parseSqliteToChrono(reinterpret_cast<const char *>(sqlite3_column_text(stmt, 3))).value();
-    file.updatedAt = parseSqliteToChrono(reinterpret_cast<const char *>(sqlite3_column_text(stmt, 4))).value();
-    file.size = sqlite3_column_int(stmt, 5);
-    file.contentType = reinterpret_cast<const char *>(sqlite3_column_text(stmt, 6));
-    file.storageId = reinterpret_cast<const char *>(sqlite3_column_text(stmt, 7));
-
+    FileRecord file = readFileRecord(stmt);
+
     sqlite3_finalize(stmt);
     result.value = file;
     result.error = DatabaseError::Success;
@@ -314,9 +924,10 @@ namespace bytebucket
 
   DatabaseResult<FileRecord> Database::getFileByStorageId(std::string_view storageId) const
   {
+    TraceSpan span("Database::getFileByStorageId", "db");
     DatabaseResult<FileRecord> result;
     const char *sql = R"(
-      SELECT id, name, folder_id, created_at, updated_at, size, content_type, storage_id 
+      SELECT id, name, folder_id, created_at_ms, updated_at_ms, size, content_type, storage_id, codec 
       FROM files 
       WHERE storage_id = ?
     )";
@@ -340,15 +951,7 @@ namespace bytebucket
       return result;
     }
 
-    FileRecord file;
-    file.id = sqlite3_column_int(stmt, 0);
-    file.name = reinterpret_cast<const char *>(sqlite3_column_text(stmt, 1));
-    file.folderId = sqlite3_column_int(stmt, 2);
-    file.createdAt = parseSqliteToChrono(reinterpret_cast<const char *>(sqlite3_column_text(stmt, 3))).value();
-    file.updatedAt = parseSqliteToChrono(reinterpret_cast<const char *>(sqlite3_column_text(stmt, 4))).value();
-    file.size = sqlite3_column_int(stmt, 5);
-    file.contentType = reinterpret_cast<const char *>(sqlite3_column_text(stmt, 6));
-    file.storageId = reinterpret_cast<const char *>(sqlite3_column_text(stmt, 7));
+    FileRecord file = readFileRecord(stmt);
 
     sqlite3_finalize(stmt);
     result.value = file;
@@ -358,9 +961,10 @@ namespace bytebucket
 
   DatabaseResult<std::vector<FileRecord>> Database::getFilesByFolder(int folderId) const
   {
+    TraceSpan span("Database::getFilesByFolder", "db");
     DatabaseResult<std::vector<FileRecord>> result;
     const char *sql = R"(
-      SELECT id, name, folder_id, created_at, updated_at, size, content_type, storage_id 
+      SELECT id, name, folder_id, created_at_ms, updated_at_ms, size, content_type, storage_id, codec 
       FROM files 
       WHERE folder_id = ?
       ORDER BY name
@@ -379,15 +983,7 @@ namespace bytebucket
     std::vector<FileRecord> files;
     while (sqlite3_step(stmt) == SQLITE_ROW)
     {
-      FileRecord file;
-      file.id = sqlite3_column_int(stmt, 0);
-      file.name = reinterpret_cast<const char *>(sqlite3_column_text(stmt, 1));
-      file.folderId = sqlite3_column_int(stmt, 2);
-      file.createdAt = parseSqliteToChrono(reinterpret_cast<const char *>(sqlite3_column_text(stmt, 3))).value();
-      file.updatedAt = parseSqliteToChrono(reinterpret_cast<const char *>(sqlite3_column_text(stmt, 4))).value();
-      file.size = sqlite3_column_int(stmt, 5);
-      file.contentType = reinterpret_cast<const char *>(sqlite3_column_text(stmt, 6));
-      file.storageId = reinterpret_cast<const char *>(sqlite3_column_text(stmt, 7));
+      FileRecord file = readFileRecord(stmt);
 
       files.push_back(std::move(file));
     }
@@ -400,10 +996,11 @@ namespace bytebucket
 
   DatabaseResult<bool> Database::updateFileTimestamp(int id)
   {
+    TraceSpan span("Database::updateFileTimestamp", "db");
     DatabaseResult<bool> result;
     const char *sql = R"(
       UPDATE files 
-      SET updated_at = CURRENT_TIMESTAMP 
+      SET updated_at_ms = ? 
       WHERE id = ?
     )";
     sqlite3_stmt *stmt = nullptr;
@@ -415,7 +1012,8 @@ namespace bytebucket
       return result;
     }
 
-    sqlite3_bind_int(stmt, 1, id);
+    sqlite3_bind_int64(stmt, 1, currentEpochMillis());
+    sqlite3_bind_int(stmt, 2, id);
 
     int returnCode = sqlite3_step(stmt);
     if (returnCode != SQLITE_DONE)
@@ -442,6 +1040,7 @@ namespace bytebucket
 
   DatabaseResult<bool> Database::deleteFile(int id)
   {
+    TraceSpan span("Database::deleteFile", "db");
     DatabaseResult<bool> result;
     const char *sql = R"(
       DELETE FROM files 
@@ -483,10 +1082,11 @@ namespace bytebucket
 
   DatabaseResult<bool> Database::renameFile(int id, std::string_view name)
   {
+    TraceSpan span("Database::renameFile", "db");
     DatabaseResult<bool> result;
     const char *sql = R"(
       UPDATE files 
-      SET name = ?, updated_at = CURRENT_TIMESTAMP 
+      SET name = ?, updated_at_ms = ? 
       WHERE id = ?
     )";
     sqlite3_stmt *stmt = nullptr;
@@ -499,7 +1099,8 @@ namespace bytebucket
     }
 
     sqlite3_bind_text(stmt, 1, name.data(), static_cast<int>(name.size()), SQLITE_STATIC);
-    sqlite3_bind_int(stmt, 2, id);
+    sqlite3_bind_int64(stmt, 2, currentEpochMillis());
+    sqlite3_bind_int(stmt, 3, id);
 
     int returnCode = sqlite3_step(stmt);
     if (returnCode != SQLITE_DONE)
@@ -536,10 +1137,11 @@ namespace bytebucket
 
   DatabaseResult<bool> Database::moveFile(int id, int parentId)
   {
+    TraceSpan span("Database::moveFile", "db");
     DatabaseResult<bool> result;
     const char *sql = R"(
       UPDATE files 
-      SET folder_id = ?, updated_at = CURRENT_TIMESTAMP 
+      SET folder_id = ?, updated_at_ms = ? 
       WHERE id = ?
     )";
     sqlite3_stmt *stmt = nullptr;
@@ -552,7 +1154,8 @@ namespace bytebucket
     }
 
     sqlite3_bind_int(stmt, 1, parentId);
-    sqlite3_bind_int(stmt, 2, id);
+    sqlite3_bind_int64(stmt, 2, currentEpochMillis());
+    sqlite3_bind_int(stmt, 3, id);
 
     int returnCode = sqlite3_step(stmt);
     if (returnCode != SQLITE_DONE)
@@ -591,11 +1194,61 @@ namespace bytebucket
     result.error = DatabaseError::Success;
     return result;
   }
+
+  DatabaseResult<int> Database::migrateLegacyTimestamps(int batchSize)
+  {
+    TraceSpan span("Database::migrateLegacyTimestamps", "db");
+    DatabaseResult<int> result;
+
+    // only databases created before the epoch-ms columns still have the TEXT ones
+    if (!hasColumn("files", "created_at"))
+    {
+      result.value = 0;
+      return result;
+    }
+
+    // julianday reads the same "YYYY-MM-DD HH:MM:SS" UTC text CURRENT_TIMESTAMP wrote;
+    // unparseable values become 0 so every selected row makes progress
+    const char *sql = R"(
+      UPDATE files SET
+        created_at_ms = COALESCE(created_at_ms,
+          CAST(ROUND((julianday(created_at) - 2440587.5) * 86400000.0) AS INTEGER), 0),
+        updated_at_ms = COALESCE(updated_at_ms,
+          CAST(ROUND((julianday(updated_at) - 2440587.5) * 86400000.0) AS INTEGER), 0)
+      WHERE id IN (
+        SELECT id FROM files
+        WHERE created_at_ms IS NULL OR updated_at_ms IS NULL
+        LIMIT ?)
+    )";
+    sqlite3_stmt *stmt = nullptr;
+
+    if (sqlite3_prepare_v2(db.get(), sql, -1, &stmt, nullptr) != SQLITE_OK)
+    {
+      result.error = DatabaseError::PrepareStatementFailed;
+      result.errorMessage = "Failed to prepare timestamp migration statement";
+      return result;
+    }
+
+    sqlite3_bind_int(stmt, 1, batchSize);
+
+    int returnCode = sqlite3_step(stmt);
+    sqlite3_finalize(stmt);
+    if (returnCode != SQLITE_DONE)
+    {
+      result.error = DatabaseError::UnknownError;
+      result.errorMessage = std::string("Failed to migrate timestamps: ") + sqlite3_errmsg(db.get());
+      return result;
+    }
+
+    result.value = sqlite3_changes(db.get());
+    return result;
+  }
 #pragma endregion files
 
 #pragma region folders
   DatabaseResult<int> Database::insertFolder(std::string_view name, std::optional<int> parentId)
   {
+    TraceSpan span("Database::insertFolder", "db");
     DatabaseResult<int> result;
     const char *sql = R"(
       INSERT INTO folders (name, parent_id) 
@@ -656,6 +1309,7 @@ namespace bytebucket
 
   DatabaseResult<FolderRecord> Database::getFolderById(int id) const
   {
+    TraceSpan span("Database::getFolderById", "db");
     DatabaseResult<FolderRecord> result;
     const char *sql = R"(
       SELECT id, name, parent_id 
@@ -699,6 +1353,7 @@ namespace bytebucket
 
   DatabaseResult<std::vector<FolderRecord>> Database::getFoldersByParent(std::optional<int> parentId) const
   {
+    TraceSpan span("Database::getFoldersByParent", "db");
     DatabaseResult<std::vector<FolderRecord>> result;
     std::vector<FolderRecord> folders;
     const char *sql = R"(
@@ -747,8 +1402,82 @@ namespace bytebucket
     return result;
   }
 
+  DatabaseResult<FolderSubtree> Database::getFolderSubtree(int id) const
+  {
+    TraceSpan span("Database::getFolderSubtree", "db");
+    DatabaseResult<FolderSubtree> result;
+    FolderSubtree subtree;
+
+    // UNION ALL walks the tree as a queue, so parents come out before their children
+    const char *foldersSql = R"(
+      WITH RECURSIVE subtree(id, name, parent_id, depth) AS (
+        SELECT id, name, parent_id, 0 FROM folders WHERE id = ?
+        UNION ALL
+        SELECT f.id, f.name, f.parent_id, subtree.depth + 1
+        FROM folders f JOIN subtree ON f.parent_id = subtree.id
+      )
+      SELECT id, name, parent_id FROM subtree ORDER BY depth, name
+    )";
+    sqlite3_stmt *stmt = nullptr;
+
+    if (sqlite3_prepare_v3(db.get(), foldersSql, -1, SQLITE_PREPARE_PERSISTENT, &stmt, nullptr) != SQLITE_OK)
+    {
+      result.error = DatabaseError::PrepareStatementFailed;
+      result.errorMessage = "Failed to prepare folder subtree statement";
+      return result;
+    }
+
+    sqlite3_bind_int(stmt, 1, id);
+    while (sqlite3_step(stmt) == SQLITE_ROW)
+    {
+      FolderRecord folder;
+      folder.id = sqlite3_column_int(stmt, 0);
+      folder.name = reinterpret_cast<const char *>(sqlite3_column_text(stmt, 1));
+      if (sqlite3_column_type(stmt, 2) != SQLITE_NULL)
+        folder.parentId = sqlite3_column_int(stmt, 2);
+      subtree.folders.push_back(std::move(folder));
+    }
+    sqlite3_finalize(stmt);
+
+    if (subtree.folders.empty())
+    {
+      result.error = DatabaseError::UnknownError;
+      result.errorMessage = "Folder not found";
+      return result;
+    }
+
+    const char *filesSql = R"(
+      WITH RECURSIVE subtree(id) AS (
+        SELECT id FROM folders WHERE id = ?
+        UNION ALL
+        SELECT f.id FROM folders f JOIN subtree ON f.parent_id = subtree.id
+      )
+      SELECT id, name, folder_id, created_at_ms, updated_at_ms, size, content_type, storage_id, codec 
+      FROM files 
+      WHERE folder_id IN (SELECT id FROM subtree)
+      ORDER BY folder_id, name, id
+    )";
+
+    if (sqlite3_prepare_v3(db.get(), filesSql, -1, SQLITE_PREPARE_PERSISTENT, &stmt, nullptr) != SQLITE_OK)
+    {
+      result.error = DatabaseError::PrepareStatementFailed;
+      result.errorMessage = "Failed to prepare subtree files statement";
+      return result;
+    }
+
+    sqlite3_bind_int(stmt, 1, id);
+    while (sqlite3_step(stmt) == SQLITE_ROW)
+      subtree.files.push_back(readFileRecord(stmt));
+    sqlite3_finalize(stmt);
+
+    result.value = std::move(subtree);
+    result.error = DatabaseError::Success;
+    return result;
+  }
+
   DatabaseResult<bool> Database::deleteFolder(int id)
   {
+    TraceSpan span("Database::deleteFolder", "db");
     DatabaseResult<bool> result;
     const char *deleteSql = R"(
       DELETE FROM folders 
@@ -790,6 +1519,7 @@ namespace bytebucket
 
   DatabaseResult<bool> Database::renameFolder(int id, std::string_view name)
   {
+    TraceSpan span("Database::renameFolder", "db");
     DatabaseResult<bool> result;
     const char *sql = R"(
       UPDATE folders 
@@ -843,6 +1573,7 @@ namespace bytebucket
 
   DatabaseResult<bool> Database::moveFolder(int id, int parentId)
   {
+    TraceSpan span("Database::moveFolder", "db");
     DatabaseResult<bool> result;
 
     // First check if we're trying to move a folder into itself or one of its descendants
@@ -958,6 +1689,7 @@ namespace bytebucket
 #pragma region tags
   DatabaseResult<int> Database::insertTag(std::string_view name)
   {
+    TraceSpan span("Database::insertTag", "db");
     DatabaseResult<int> result;
 
     if (name.empty())
@@ -1018,6 +1750,7 @@ namespace bytebucket
 
   DatabaseResult<int> Database::getTagByName(std::string_view name) const
   {
+    TraceSpan span("Database::getTagByName", "db");
     DatabaseResult<int> result;
 
     if (name.empty())
@@ -1060,6 +1793,7 @@ namespace bytebucket
 
   DatabaseResult<std::string> Database::getTagById(int id) const
   {
+    TraceSpan span("Database::getTagById", "db");
     DatabaseResult<std::string> result;
 
     const char *sql = R"(
@@ -1104,6 +1838,7 @@ namespace bytebucket
 
   DatabaseResult<bool> Database::addFileTag(int fileId, int tagId)
   {
+    TraceSpan span("Database::addFileTag", "db");
     DatabaseResult<bool> result;
     const char *sql = R"(
       INSERT INTO file_tags (file_id, tag_id) 
@@ -1158,6 +1893,7 @@ namespace bytebucket
 
   DatabaseResult<bool> Database::removeFileTag(int fileId, int tagId)
   {
+    TraceSpan span("Database::removeFileTag", "db");
     DatabaseResult<bool> result;
     const char *sql = R"(
       DELETE FROM file_tags 
@@ -1199,6 +1935,7 @@ namespace bytebucket
 
   DatabaseResult<std::vector<std::string>> Database::getFileTags(int fileId) const
   {
+    TraceSpan span("Database::getFileTags", "db");
     DatabaseResult<std::vector<std::string>> result;
     const char *sql = R"(
       SELECT t.name 
@@ -1236,6 +1973,7 @@ namespace bytebucket
 
   DatabaseResult<std::vector<std::string>> Database::getAllTags() const
   {
+    TraceSpan span("Database::getAllTags", "db");
     DatabaseResult<std::vector<std::string>> result;
     const char *sql = R"(
       SELECT name 
@@ -1271,6 +2009,7 @@ namespace bytebucket
 #pragma region metadata
   DatabaseResult<bool> Database::setFileMetadata(int fileId, std::string_view key, std::string_view value)
   {
+    TraceSpan span("Database::setFileMetadata", "db");
     DatabaseResult<bool> result;
 
     if (key.empty())
@@ -1281,8 +2020,8 @@ namespace bytebucket
     }
 
     const char *sql = R"(
-      INSERT OR REPLACE INTO file_metadata (file_id, key, value) 
-      VALUES (?, ?, ?)
+      INSERT OR REPLACE INTO file_metadata (file_id, key, value, value_num) 
+      VALUES (?, ?, ?, ?)
     )";
     sqlite3_stmt *stmt = nullptr;
 
@@ -1296,6 +2035,11 @@ namespace bytebucket
     sqlite3_bind_int(stmt, 1, fileId);
     sqlite3_bind_text(stmt, 2, key.data(), static_cast<int>(key.size()), SQLITE_STATIC);
     sqlite3_bind_text(stmt, 3, value.data(), static_cast<int>(value.size()), SQLITE_STATIC);
+    auto number = parseMetadataNumber(value);
+    if (number.has_value())
+      sqlite3_bind_double(stmt, 4, number.value());
+    else
+      sqlite3_bind_null(stmt, 4);
 
     int returnCode = sqlite3_step(stmt);
     sqlite3_finalize(stmt);
@@ -1333,6 +2077,7 @@ namespace bytebucket
 
   DatabaseResult<std::string> Database::getFileMetadata(int fileId, std::string_view key) const
   {
+    TraceSpan span("Database::getFileMetadata", "db");
     DatabaseResult<std::string> result;
 
     if (key.empty())
@@ -1381,6 +2126,7 @@ namespace bytebucket
 
   DatabaseResult<std::vector<std::pair<std::string, std::string>>> Database::getAllFileMetadata(int fileId) const
   {
+    TraceSpan span("Database::getAllFileMetadata", "db");
     DatabaseResult<std::vector<std::pair<std::string, std::string>>> result;
     const char *sql = R"(
       SELECT key, value 
@@ -1419,6 +2165,7 @@ namespace bytebucket
 
   DatabaseResult<bool> Database::removeFileMetadata(int fileId, std::string_view key)
   {
+    TraceSpan span("Database::removeFileMetadata", "db");
     DatabaseResult<bool> result;
 
     if (key.empty())
@@ -1467,6 +2214,348 @@ namespace bytebucket
     return result;
   }
 
+  DatabaseResult<std::vector<FileRecord>> Database::findFilesByMetadata(const FileQuery &query) const
+  {
+    TraceSpan span("Database::findFilesByMetadata", "db");
+    DatabaseResult<std::vector<FileRecord>> result;
+
+    // without a predicate there is nothing to drive the index, so refuse rather than scan every file
+    if (query.predicates.empty())
+    {
+      result.error = DatabaseError::UnknownError;
+      result.errorMessage = "At least one metadata predicate is required";
+      return result;
+    }
+
+    if (query.sortBy == FileSortField::Metadata && query.sortKey.empty())
+    {
+      result.error = DatabaseError::UnknownError;
+      result.errorMessage = "Metadata sort key cannot be empty";
+      return result;
+    }
+
+    // each predicate becomes a lookup on (key, value) or (key, value_num) and the
+    // matching file ids are intersected, so cost scales with the matches per predicate
+    std::ostringstream sql;
+    sql << "SELECT f.id, f.name, f.folder_id, f.created_at_ms, f.updated_at_ms, f.size, f.content_type, f.storage_id, f.codec "
+        << "FROM files f ";
+
+    if (query.sortBy == FileSortField::Metadata)
+      sql << "LEFT JOIN file_metadata s ON s.file_id = f.id AND s.key = ? ";
+
+    sql << "WHERE f.id IN (";
+    std::vector<std::optional<double>> numericOperands;
+    for (size_t i = 0; i < query.predicates.size(); ++i)
+    {
+      const auto &predicate = query.predicates[i];
+      if (predicate.key.empty())
+      {
+        result.error = DatabaseError::UnknownError;
+        result.errorMessage = "Metadata key cannot be empty";
+        return result;
+      }
+
+      if (i > 0)
+        sql << " INTERSECT ";
+      sql << "SELECT file_id FROM file_metadata WHERE key = ?";
+
+      std::optional<double> number;
+      if (predicate.op != MetadataOp::Equals && predicate.op != MetadataOp::NotEquals && predicate.op != MetadataOp::Exists)
+        number = parseMetadataNumber(predicate.value);
+      numericOperands.push_back(number);
+
+      const char *column = number.has_value() ? "value_num" : "value";
+      switch (predicate.op)
+      {
+      case MetadataOp::Equals:
+        sql << " AND value = ?";
+        break;
+      case MetadataOp::NotEquals:
+        sql << " AND value <> ?";
+        break;
+      case MetadataOp::LessThan:
+        sql << " AND " << column << " < ?";
+        break;
+      case MetadataOp::LessOrEqual:
+        sql << " AND " << column << " <= ?";
+        break;
+      case MetadataOp::GreaterThan:
+        sql << " AND " << column << " > ?";
+        break;
+      case MetadataOp::GreaterOrEqual:
+        sql << " AND " << column << " >= ?";
+        break;
+      case MetadataOp::Exists:
+        break;
+      }
+    }
+    sql << ") ";
+
+    const char *direction = query.descending ? "DESC" : "ASC";
+    switch (query.sortBy)
+    {
+    case FileSortField::Name:
+      sql << "ORDER BY f.name " << direction;
+      break;
+    case FileSortField::Size:
+      sql << "ORDER BY f.size " << direction;
+      break;
+    case FileSortField::CreatedAt:
+      sql << "ORDER BY f.created_at_ms " << direction;
+      break;
+    case FileSortField::UpdatedAt:
+      sql << "ORDER BY f.updated_at_ms " << direction;
+      break;
+    case FileSortField::Metadata:
+      sql << "ORDER BY s.value_num " << direction << ", s.value " << direction;
+      break;
+    }
+    sql << ", f.id " << direction << " LIMIT ? OFFSET ?";
+
+    std::string sqlText = sql.str();
+    sqlite3_stmt *stmt = nullptr;
+
+    if (sqlite3_prepare_v2(db.get(), sqlText.c_str(), -1, &stmt, nullptr) != SQLITE_OK)
+    {
+      result.error = DatabaseError::PrepareStatementFailed;
+      result.errorMessage = "Failed to prepare find files by metadata statement";
+      return result;
+    }
+
+    int index = 1;
+    if (query.sortBy == FileSortField::Metadata)
+      sqlite3_bind_text(stmt, index++, query.sortKey.data(), static_cast<int>(query.sortKey.size()), SQLITE_STATIC);
+
+    for (size_t i = 0; i < query.predicates.size(); ++i)
+    {
+      const auto &predicate = query.predicates[i];
+      sqlite3_bind_text(stmt, index++, predicate.key.data(), static_cast<int>(predicate.key.size()), SQLITE_STATIC);
+      if (predicate.op == MetadataOp::Exists)
+        continue;
+
+      if (numericOperands[i].has_value())
+        sqlite3_bind_double(stmt, index++, numericOperands[i].value());
+      else
+        sqlite3_bind_text(stmt, index++, predicate.value.data(), static_cast<int>(predicate.value.size()), SQLITE_STATIC);
+    }
+
+    sqlite3_bind_int(stmt, index++, query.limit);
+    sqlite3_bind_int(stmt, index++, query.offset);
+
+    std::vector<FileRecord> files;
+    while (sqlite3_step(stmt) == SQLITE_ROW)
+    {
+      FileRecord file = readFileRecord(stmt);
+
+      files.push_back(std::move(file));
+    }
+
+    sqlite3_finalize(stmt);
+    result.value = std::move(files);
+    result.error = DatabaseError::Success;
+    return result;
+  }
+
 #pragma endregion metadata
 
+#pragma region upload sessions
+  // Received ranges are stored as "start-end,start-end"
+  static std::string encodeRanges(const std::vector<std::pair<int64_t, int64_t>> &ranges)
+  {
+    std::string text;
+    for (const auto &[start, end] : ranges)
+    {
+      if (!text.empty())
+        text += ',';
+      text += std::to_string(start) + '-' + std::to_string(end);
+    }
+    return text;
+  }
+
+  static std::optional<std::vector<std::pair<int64_t, int64_t>>> decodeRanges(std::string_view text)
+  {
+    std::vector<std::pair<int64_t, int64_t>> ranges;
+    while (!text.empty())
+    {
+      size_t comma = text.find(',');
+      std::string_view range = text.substr(0, comma);
+      text = comma == std::string_view::npos ? std::string_view() : text.substr(comma + 1);
+
+      size_t dash = range.find('-');
+      if (dash == std::string_view::npos)
+        return std::nullopt;
+      char *end = nullptr;
+      std::string startText(range.substr(0, dash));
+      std::string endText(range.substr(dash + 1));
+      long long start = std::strtoll(startText.c_str(), &end, 10);
+      if (startText.empty() || *end != '\0')
+        return std::nullopt;
+      long long stop = std::strtoll(endText.c_str(), &end, 10);
+      if (endText.empty() || *end != '\0' || start < 0 || stop < start)
+        return std::nullopt;
+      ranges.emplace_back(start, stop);
+    }
+    return ranges;
+  }
+
+  DatabaseResult<bool> Database::addUploadSession(const UploadSessionRecord &session)
+  {
+    TraceSpan span("Database::addUploadSession", "db");
+    DatabaseResult<bool> result;
+    const char *sql = R"(
+      INSERT INTO upload_sessions (id, filename, content_type, folder_id, size, ranges, revision)
+      VALUES (?, ?, ?, ?, ?, ?, ?)
+    )";
+    sqlite3_stmt *stmt = nullptr;
+
+    if (sqlite3_prepare_v3(db.get(), sql, -1, SQLITE_PREPARE_PERSISTENT, &stmt, nullptr) != SQLITE_OK)
+    {
+      result.error = DatabaseError::PrepareStatementFailed;
+      result.errorMessage = "Failed to prepare add upload session statement";
+      return result;
+    }
+
+    std::string ranges = encodeRanges(session.ranges);
+    sqlite3_bind_text(stmt, 1, session.id.data(), static_cast<int>(session.id.size()), SQLITE_STATIC);
+    sqlite3_bind_text(stmt, 2, session.filename.data(), static_cast<int>(session.filename.size()), SQLITE_STATIC);
+    sqlite3_bind_text(stmt, 3, session.contentType.data(), static_cast<int>(session.contentType.size()), SQLITE_STATIC);
+    if (session.folderId.has_value())
+      sqlite3_bind_int(stmt, 4, session.folderId.value());
+    else
+      sqlite3_bind_null(stmt, 4);
+    sqlite3_bind_int64(stmt, 5, session.size);
+    sqlite3_bind_text(stmt, 6, ranges.data(), static_cast<int>(ranges.size()), SQLITE_STATIC);
+    sqlite3_bind_int64(stmt, 7, static_cast<sqlite3_int64>(session.revision));
+
+    int returnCode = sqlite3_step(stmt);
+    sqlite3_finalize(stmt);
+
+    if (returnCode != SQLITE_DONE)
+    {
+      result.error = returnCode == SQLITE_CONSTRAINT ? DatabaseError::UniqueConstraint : DatabaseError::UnknownError;
+      result.errorMessage = "Failed to execute add upload session query";
+      return result;
+    }
+
+    result.value = true;
+    return result;
+  }
+
+  DatabaseResult<bool> Database::updateUploadSessionRanges(std::string_view id,
+                                                           const std::vector<std::pair<int64_t, int64_t>> &ranges,
+                                                           uint64_t revision)
+  {
+    TraceSpan span("Database::updateUploadSessionRanges", "db");
+    DatabaseResult<bool> result;
+    // concurrent chunks can reach the writer in any order; only the newest ranges stick
+    const char *sql = "UPDATE upload_sessions SET ranges = ?, revision = ? WHERE id = ? AND revision < ?";
+    sqlite3_stmt *stmt = nullptr;
+
+    if (sqlite3_prepare_v3(db.get(), sql, -1, SQLITE_PREPARE_PERSISTENT, &stmt, nullptr) != SQLITE_OK)
+    {
+      result.error = DatabaseError::PrepareStatementFailed;
+      result.errorMessage = "Failed to prepare update upload session statement";
+      return result;
+    }
+
+    std::string text = encodeRanges(ranges);
+    sqlite3_bind_text(stmt, 1, text.data(), static_cast<int>(text.size()), SQLITE_STATIC);
+    sqlite3_bind_int64(stmt, 2, static_cast<sqlite3_int64>(revision));
+    sqlite3_bind_text(stmt, 3, id.data(), static_cast<int>(id.size()), SQLITE_STATIC);
+    sqlite3_bind_int64(stmt, 4, static_cast<sqlite3_int64>(revision));
+
+    int returnCode = sqlite3_step(stmt);
+    sqlite3_finalize(stmt);
+
+    if (returnCode != SQLITE_DONE)
+    {
+      result.error = DatabaseError::UnknownError;
+      result.errorMessage = "Failed to execute update upload session query";
+      return result;
+    }
+
+    result.value = sqlite3_changes(db.get()) > 0;
+    return result;
+  }
+
+  DatabaseResult<bool> Database::deleteUploadSession(std::string_view id)
+  {
+    TraceSpan span("Database::deleteUploadSession", "db");
+    DatabaseResult<bool> result;
+    const char *sql = "DELETE FROM upload_sessions WHERE id = ?";
+    sqlite3_stmt *stmt = nullptr;
+
+    if (sqlite3_prepare_v3(db.get(), sql, -1, SQLITE_PREPARE_PERSISTENT, &stmt, nullptr) != SQLITE_OK)
+    {
+      result.error = DatabaseError::PrepareStatementFailed;
+      result.errorMessage = "Failed to prepare delete upload session statement";
+      return result;
+    }
+
+    sqlite3_bind_text(stmt, 1, id.data(), static_cast<int>(id.size()), SQLITE_STATIC);
+
+    int returnCode = sqlite3_step(stmt);
+    sqlite3_finalize(stmt);
+
+    if (returnCode != SQLITE_DONE)
+    {
+      result.error = DatabaseError::UnknownError;
+      result.errorMessage = "Failed to execute delete upload session query";
+      return result;
+    }
+
+    result.value = sqlite3_changes(db.get()) > 0;
+    return result;
+  }
+
+  DatabaseResult<std::vector<UploadSessionRecord>> Database::getUploadSessions() const
+  {
+    TraceSpan span("Database::getUploadSessions", "db");
+    DatabaseResult<std::vector<UploadSessionRecord>> result;
+    const char *sql = R"(
+      SELECT id, filename, content_type, folder_id, size, ranges, revision
+      FROM upload_sessions
+      ORDER BY id
+    )";
+    sqlite3_stmt *stmt = nullptr;
+
+    if (sqlite3_prepare_v3(db.get(), sql, -1, SQLITE_PREPARE_PERSISTENT, &stmt, nullptr) != SQLITE_OK)
+    {
+      result.error = DatabaseError::PrepareStatementFailed;
+      result.errorMessage = "Failed to prepare get upload sessions statement";
+      return result;
+    }
+
+    std::vector<UploadSessionRecord> sessions;
+    int returnCode;
+    while ((returnCode = sqlite3_step(stmt)) == SQLITE_ROW)
+    {
+      UploadSessionRecord session;
+      session.id = reinterpret_cast<const char *>(sqlite3_column_text(stmt, 0));
+      session.filename = reinterpret_cast<const char *>(sqlite3_column_text(stmt, 1));
+      session.contentType = reinterpret_cast<const char *>(sqlite3_column_text(stmt, 2));
+      if (sqlite3_column_type(stmt, 3) != SQLITE_NULL)
+        session.folderId = sqlite3_column_int(stmt, 3);
+      session.size = sqlite3_column_int64(stmt, 4);
+      const char *ranges = reinterpret_cast<const char *>(sqlite3_column_text(stmt, 5));
+      // a row whose ranges can't be read is restored as if nothing had arrived
+      if (auto decoded = decodeRanges(ranges ? ranges : ""))
+        session.ranges = std::move(decoded.value());
+      session.revision = static_cast<uint64_t>(sqlite3_column_int64(stmt, 6));
+      sessions.push_back(std::move(session));
+    }
+    sqlite3_finalize(stmt);
+
+    if (returnCode != SQLITE_DONE)
+    {
+      result.error = DatabaseError::UnknownError;
+      result.errorMessage = "Failed to execute get upload sessions query";
+      return result;
+    }
+
+    result.value = std::move(sessions);
+    return result;
+  }
+#pragma endregion upload sessions
+
 }
\ No newline at end of file
@@ -0,0 +1,197 @@
+#include "database_writer.hpp"
+#include <vector>
+
+namespace bytebucket
+{
+  std::shared_ptr<DatabaseWriter> DatabaseWriter::create(
+      const std::string &dbPath,
+      std::chrono::milliseconds commitWindow,
+      size_t maxBatchSize,
+      const DatabaseTuning &tuning)
+  {
+    auto db = Database::create(dbPath, tuning);
+    if (!db)
+      return nullptr;
+
+    return std::shared_ptr<DatabaseWriter>(new DatabaseWriter(std::move(db), commitWindow, maxBatchSize));
+  }
+
+  DatabaseWriter::DatabaseWriter(std::shared_ptr<Database> db, std::chrono::milliseconds commitWindow, size_t maxBatchSize)
+      : db(std::move(db)), commitWindow(commitWindow), maxBatchSize(maxBatchSize == 0 ? 1 : maxBatchSize)
+  {
+    thread = std::thread([this]()
+                         { run(); });
+  }
+
+  DatabaseWriter::~DatabaseWriter()
+  {
+    stop();
+  }
+
+  void DatabaseWriter::stop()
+  {
+    if (stopping.exchange(true))
+      return;
+
+    {
+      std::lock_guard<std::mutex> lock(wakeMutex);
+    }
+    wake.notify_one();
+
+    if (thread.joinable())
+      thread.join();
+
+    stopped = true;
+    failAll(queue.popAll(), "Database writer is stopped");
+  }
+
+  DatabaseResult<bool> DatabaseWriter::checkpoint()
+  {
+    if (!stopped)
+    {
+      DatabaseResult<bool> result;
+      result.error = DatabaseError::UnknownError;
+      result.errorMessage = "Database writer is still running";
+      return result;
+    }
+    return db->checkpoint();
+  }
+
+  DatabaseWriter::Stats DatabaseWriter::stats() const
+  {
+    Stats stats;
+    stats.transactions = transactionCount.load(std::memory_order_relaxed);
+    stats.writes = writeCount.load(std::memory_order_relaxed);
+    stats.failedCommits = failedCommitCount.load(std::memory_order_relaxed);
+    return stats;
+  }
+
+  void DatabaseWriter::enqueue(PendingWrite *write)
+  {
+    if (stopped)
+    {
+      failAll(write, "Database writer is stopped");
+      return;
+    }
+
+    if (queue.push(write))
+    {
+      // taking the lock orders this notify after the writer's emptiness check,
+      // so the wakeup can't slip in between the check and the wait
+      {
+        std::lock_guard<std::mutex> lock(wakeMutex);
+      }
+      wake.notify_one();
+    }
+
+    // stop() may have drained the queue between our check and the push
+    if (stopped)
+      failAll(queue.popAll(), "Database writer is stopped");
+  }
+
+  void DatabaseWriter::run()
+  {
+    for (;;)
+    {
+      PendingWrite *pending = carry ? carry : queue.popAll();
+      carry = nullptr;
+      if (pending)
+      {
+        commitBatch(pending);
+        continue;
+      }
+
+      if (stopping)
+        break;
+
+      std::unique_lock<std::mutex> lock(wakeMutex);
+      wake.wait(lock, [this]()
+                { return stopping.load() || !queue.empty(); });
+    }
+  }
+
+  void DatabaseWriter::commitBatch(PendingWrite *first)
+  {
+    std::vector<PendingWrite *> batch;
+
+    if (!db->beginTransaction(true))
+    {
+      failedCommitCount.fetch_add(1, std::memory_order_relaxed);
+      failAll(first, "Failed to begin write transaction");
+      return;
+    }
+
+    // keep absorbing writes that arrive while this transaction is open, until the
+    // commit window closes or the batch is full; leftovers go into the next batch
+    auto deadline = std::chrono::steady_clock::now() + commitWindow;
+    PendingWrite *pending = first;
+    bool isolated = true;
+    while (pending)
+    {
+      PendingWrite *next = pending->next;
+
+      if (!db->savepoint("pending_write"))
+      {
+        // the write never ran, so it fails alone and the batch carries on
+        pending->complete(false, "Failed to open a savepoint for the write");
+        delete pending;
+      }
+      else
+      {
+        if (pending->run(*db))
+          isolated = db->releaseSavepoint("pending_write");
+        else
+          isolated = db->rollbackToSavepoint("pending_write") && db->releaseSavepoint("pending_write");
+        batch.push_back(pending);
+
+        if (!isolated)
+        {
+          // this write's changes can't be told apart from the rest any more; the
+          // whole batch fails, and whatever hasn't run yet goes into the next one
+          carry = next;
+          break;
+        }
+      }
+
+      if (batch.size() >= maxBatchSize)
+      {
+        // the remainder is older than anything still queued, so it goes first next time
+        carry = next;
+        break;
+      }
+
+      if (!next && std::chrono::steady_clock::now() < deadline)
+        next = queue.popAll();
+      pending = next;
+    }
+
+    bool committed = isolated && db->commitTransaction();
+    std::string errorMessage;
+    if (!committed)
+    {
+      db->rollbackTransaction();
+      failedCommitCount.fetch_add(1, std::memory_order_relaxed);
+      errorMessage = isolated ? "Failed to commit write transaction" : "Failed to isolate a write from its batch";
+    }
+
+    transactionCount.fetch_add(1, std::memory_order_relaxed);
+    writeCount.fetch_add(batch.size(), std::memory_order_relaxed);
+
+    for (PendingWrite *write : batch)
+    {
+      write->complete(committed, errorMessage);
+      delete write;
+    }
+  }
+
+  void DatabaseWriter::failAll(PendingWrite *list, const std::string &errorMessage)
+  {
+    while (list)
+    {
+      PendingWrite *next = list->next;
+      list->complete(false, errorMessage);
+      delete list;
+      list = next;
+    }
+  }
+}
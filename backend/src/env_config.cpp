@@ -0,0 +1,50 @@
+#include "env_config.hpp"
+#include <cerrno>
+#include <cstdlib>
+#include <iostream>
+
+namespace bytebucket
+{
+  static std::optional<int64_t> parseEnvInteger(const char *name, bool allowNegative)
+  {
+    const char *text = std::getenv(name);
+    if (!text || !*text)
+      return std::nullopt;
+
+    char *end = nullptr;
+    errno = 0;
+    long long number = std::strtoll(text, &end, 10);
+    if (errno != 0 || *end != '\0' || (!allowNegative && number < 0))
+    {
+      std::cerr << "Ignoring invalid " << name << ": " << text << std::endl;
+      return std::nullopt;
+    }
+    return static_cast<int64_t>(number);
+  }
+
+  std::optional<int64_t> readEnvInteger(const char *name)
+  {
+    return parseEnvInteger(name, true);
+  }
+
+  std::optional<uint64_t> readEnvCount(const char *name)
+  {
+    auto number = parseEnvInteger(name, false);
+    if (!number)
+      return std::nullopt;
+    return static_cast<uint64_t>(*number);
+  }
+
+  uint64_t readEnvCount(const char *name, uint64_t fallback, uint64_t minimum)
+  {
+    auto count = readEnvCount(name);
+    if (!count)
+      return fallback;
+    if (*count < minimum)
+    {
+      std::cerr << "Ignoring " << name << " below " << minimum << ": " << *count << std::endl;
+      return fallback;
+    }
+    return *count;
+  }
+}
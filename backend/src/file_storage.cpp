@@ -1,4 +1,7 @@
 #include "file_storage.hpp"
+#include "compression.hpp"
+#include "tracing.hpp"
+#include <algorithm>
 #include <filesystem>
 #include <fstream>
 #include <random>
@@ -6,6 +9,10 @@
 #include <iomanip>
 #include <chrono>
 #include <iostream>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
 
 namespace bytebucket
 {
@@ -15,6 +22,15 @@ namespace bytebucket
       const std::vector<char> &content,
       const std::string &content_type)
   {
+    return saveFile(filename, std::string_view(content.data(), content.size()), content_type);
+  }
+
+  std::optional<std::string> FileStorage::saveFile(
+      const std::string &filename,
+      std::string_view content,
+      const std::string &content_type)
+  {
+    TraceSpan span("FileStorage::saveFile", "storage");
     if (!initializeStorage())
     {
       return std::nullopt;
@@ -29,8 +45,10 @@ namespace bytebucket
 
     try
     {
-      // Write file content
-      std::ofstream file(file_path, std::ios::binary);
+      // written under a .part name and renamed, so a process stopped mid-write
+      // never leaves a truncated blob under a real ID
+      std::filesystem::path part_path = getPartialFilePath(file_id);
+      std::ofstream file(part_path, std::ios::binary);
       if (!file.is_open())
       {
         return std::nullopt;
@@ -38,22 +56,14 @@ namespace bytebucket
 
       file.write(content.data(), content.size());
       file.close();
-
-      // Create metadata file
-      std::filesystem::path metadata_path = storage_path / (file_id + ".meta");
-      std::ofstream metadata(metadata_path);
-      if (metadata.is_open())
+      if (!file)
       {
-        metadata << "original_filename=" << filename << "\n";
-        metadata << "content_type=" << content_type << "\n";
-        metadata << "size=" << content.size() << "\n";
-
-        // Add timestamp
-        auto now = std::chrono::system_clock::now();
-        auto time_t = std::chrono::system_clock::to_time_t(now);
-        metadata << "uploaded_at=" << time_t << "\n";
-        metadata.close();
+        std::filesystem::remove(part_path);
+        return std::nullopt;
       }
+      std::filesystem::rename(part_path, file_path);
+
+      writeMetadataFile(file_id, filename, content_type, static_cast<int64_t>(content.size()));
 
       return file_id;
     }
@@ -64,6 +74,60 @@ namespace bytebucket
     }
   }
 
+  std::optional<StoredBlob> FileStorage::saveBlob(
+      const std::string &filename,
+      std::string_view content,
+      const std::string &content_type)
+  {
+    TraceSpan span("FileStorage::saveBlob", "storage");
+    constexpr size_t MIN_COMPRESS_SIZE = 1024;
+    constexpr size_t SAMPLE_SIZE = 64 * 1024;
+
+    std::optional<std::string> compressed;
+    if (compressBlobs && content.size() >= MIN_COMPRESS_SIZE)
+    {
+      // unknown types are judged on a fast-level sample before paying for the whole blob
+      bool candidate = isCompressibleType(content_type);
+      if (!candidate)
+      {
+        auto sample = GzipCompressor::compress(content.substr(0, SAMPLE_SIZE), 1);
+        candidate = sample.has_value() && sample->size() < std::min(content.size(), SAMPLE_SIZE) * 8 / 10;
+      }
+
+      if (candidate)
+      {
+        compressed = GzipCompressor::compress(content, 6);
+        if (compressed.has_value() && compressed->size() > content.size() * 9 / 10)
+          compressed.reset();
+      }
+    }
+
+    // the metadata file keeps the decoded size either way
+    if (!compressed.has_value())
+    {
+      auto file_id = saveFile(filename, content, content_type);
+      if (!file_id.has_value())
+        return std::nullopt;
+      return StoredBlob{file_id.value(), "identity"};
+    }
+
+    auto file_id = saveFile(filename, compressed.value(), content_type);
+    if (!file_id.has_value())
+      return std::nullopt;
+    writeMetadataFile(file_id.value(), filename, content_type, static_cast<int64_t>(content.size()));
+    return StoredBlob{file_id.value(), "gzip"};
+  }
+
+  void FileStorage::setBlobCompression(bool enabled)
+  {
+    compressBlobs = enabled;
+  }
+
+  bool FileStorage::blobCompressionEnabled()
+  {
+    return compressBlobs;
+  }
+
   std::optional<std::filesystem::path> FileStorage::getFilePath(const std::string &file_id)
   {
     std::filesystem::path storage_path = getStorageDir();
@@ -87,6 +151,7 @@ namespace bytebucket
 
   std::optional<std::vector<char>> FileStorage::readFile(const std::string &file_id)
   {
+    TraceSpan span("FileStorage::readFile", "storage");
     if (!fileExists(file_id))
       return std::nullopt;
 
@@ -118,6 +183,7 @@ namespace bytebucket
 
   bool FileStorage::deleteFile(const std::string &file_id)
   {
+    TraceSpan span("FileStorage::deleteFile", "storage");
     if (!fileExists(file_id))
       return false;
 
@@ -173,6 +239,168 @@ namespace bytebucket
     return STORAGE_DIR;
   }
 
+  void FileStorage::writeMetadataFile(
+      const std::string &file_id,
+      const std::string &filename,
+      const std::string &content_type,
+      int64_t size)
+  {
+    std::filesystem::path metadata_path = getStorageDir() / (file_id + ".meta");
+    std::ofstream metadata(metadata_path);
+    if (metadata.is_open())
+    {
+      metadata << "original_filename=" << filename << "\n";
+      metadata << "content_type=" << content_type << "\n";
+      metadata << "size=" << size << "\n";
+
+      // Add timestamp
+      auto now = std::chrono::system_clock::now();
+      auto time_t = std::chrono::system_clock::to_time_t(now);
+      metadata << "uploaded_at=" << time_t << "\n";
+      metadata.close();
+    }
+  }
+
+  std::filesystem::path FileStorage::getPartialFilePath(const std::string &file_id)
+  {
+    return getStorageDir() / (file_id + ".part");
+  }
+
+  std::optional<std::string> FileStorage::createPartialFile(int64_t size)
+  {
+    TraceSpan span("FileStorage::createPartialFile", "storage");
+    if (size < 0 || !initializeStorage())
+      return std::nullopt;
+
+    std::string file_id = generateFileId();
+    std::filesystem::path part_path = getPartialFilePath(file_id);
+
+    int fd = ::open(part_path.c_str(), O_WRONLY | O_CREAT | O_EXCL, 0644);
+    if (fd < 0)
+    {
+      std::cerr << "Error creating partial file: " << std::strerror(errno) << std::endl;
+      return std::nullopt;
+    }
+
+    // reserve the blocks up front so a full disk fails here rather than mid-upload
+    int rc = size > 0 ? ::posix_fallocate(fd, 0, static_cast<off_t>(size)) : 0;
+    if (rc == EOPNOTSUPP || rc == EINVAL)
+      rc = ::ftruncate(fd, static_cast<off_t>(size)) == 0 ? 0 : errno;
+    ::close(fd);
+
+    if (rc != 0)
+    {
+      std::cerr << "Error preallocating partial file: " << std::strerror(rc) << std::endl;
+      std::filesystem::remove(part_path);
+      return std::nullopt;
+    }
+
+    return file_id;
+  }
+
+  bool FileStorage::writePartialFile(const std::string &file_id, int64_t offset, const char *data, size_t length)
+  {
+    TraceSpan span("FileStorage::writePartialFile", "storage");
+    int fd = ::open(getPartialFilePath(file_id).c_str(), O_WRONLY);
+    if (fd < 0)
+      return false;
+
+    bool ok = true;
+    size_t written = 0;
+    while (written < length)
+    {
+      ssize_t n = ::pwrite(fd, data + written, length - written, static_cast<off_t>(offset + written));
+      if (n < 0)
+      {
+        if (errno == EINTR)
+          continue;
+        std::cerr << "Error writing partial file: " << std::strerror(errno) << std::endl;
+        ok = false;
+        break;
+      }
+      written += static_cast<size_t>(n);
+    }
+
+    // a chunk is only reported (and recorded) as received once it's on disk, so a
+    // session restored after a power loss can't claim bytes that never landed
+    if (ok && length > 0 && ::fdatasync(fd) != 0)
+    {
+      std::cerr << "Error syncing partial file: " << std::strerror(errno) << std::endl;
+      ok = false;
+    }
+
+    ::close(fd);
+    return ok;
+  }
+
+  bool FileStorage::commitPartialFile(
+      const std::string &file_id,
+      const std::string &filename,
+      const std::string &content_type,
+      int64_t size)
+  {
+    TraceSpan span("FileStorage::commitPartialFile", "storage");
+    std::filesystem::path part_path = getPartialFilePath(file_id);
+    int fd = ::open(part_path.c_str(), O_WRONLY);
+    if (fd < 0)
+      return false;
+    bool synced = ::fsync(fd) == 0;
+    ::close(fd);
+    if (!synced)
+      return false;
+
+    try
+    {
+      // rename is atomic, so readers never see a half-written blob under the final ID
+      std::filesystem::rename(part_path, getStorageDir() / file_id);
+      writeMetadataFile(file_id, filename, content_type, size);
+      return true;
+    }
+    catch (const std::exception &e)
+    {
+      std::cerr << "Error committing partial file: " << e.what() << std::endl;
+      return false;
+    }
+  }
+
+  bool FileStorage::deletePartialFile(const std::string &file_id)
+  {
+    TraceSpan span("FileStorage::deletePartialFile", "storage");
+    std::error_code ec;
+    return std::filesystem::remove(getPartialFilePath(file_id), ec);
+  }
+
+  std::optional<int64_t> FileStorage::partialFileSize(const std::string &file_id)
+  {
+    std::error_code ec;
+    auto size = std::filesystem::file_size(getPartialFilePath(file_id), ec);
+    if (ec)
+      return std::nullopt;
+    return static_cast<int64_t>(size);
+  }
+
+  size_t FileStorage::deletePartialFilesExcept(const std::unordered_set<std::string> &keep)
+  {
+    TraceSpan span("FileStorage::deletePartialFilesExcept", "storage");
+    std::vector<std::filesystem::path> orphans;
+    std::error_code ec;
+    for (const auto &entry : std::filesystem::directory_iterator(getStorageDir(), ec))
+    {
+      const auto &path = entry.path();
+      if (path.extension() == ".part" && keep.count(path.stem().string()) == 0)
+        orphans.push_back(path);
+    }
+
+    size_t deleted = 0;
+    for (const auto &path : orphans)
+    {
+      std::error_code remove_error;
+      if (std::filesystem::remove(path, remove_error))
+        ++deleted;
+    }
+    return deleted;
+  }
+
   bool FileStorage::initializeStorage()
   {
     try
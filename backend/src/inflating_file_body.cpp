@@ -0,0 +1,76 @@
+#include "inflating_file_body.hpp"
+#include <boost/beast/http/error.hpp>
+
+namespace bytebucket
+{
+  void InflatingFileBody::value_type::open(const char *path, std::uint64_t size, boost::beast::error_code &ec)
+  {
+    file.open(path, boost::beast::file_mode::scan, ec);
+    if (!ec)
+      decodedSize = size;
+  }
+
+  InflatingFileBody::writer::~writer()
+  {
+    if (initialised)
+      inflateEnd(&stream);
+  }
+
+  void InflatingFileBody::writer::init(boost::beast::error_code &ec)
+  {
+    // windowBits 15 + 16 accepts only the gzip wrapper
+    if (inflateInit2(&stream, 15 + 16) != Z_OK)
+    {
+      ec = boost::beast::errc::make_error_code(boost::beast::errc::not_enough_memory);
+      return;
+    }
+    initialised = true;
+    input = std::make_unique<char[]>(CHUNK);
+    output = std::make_unique<char[]>(CHUNK);
+    ec = {};
+  }
+
+  boost::optional<std::pair<InflatingFileBody::writer::const_buffers_type, bool>>
+  InflatingFileBody::writer::get(boost::beast::error_code &ec)
+  {
+    ec = {};
+    for (;;)
+    {
+      if (streamDone)
+        return boost::none;
+
+      if (stream.avail_in == 0 && !fileDone)
+      {
+        std::size_t read = body.file.read(input.get(), CHUNK, ec);
+        if (ec)
+          return boost::none;
+        fileDone = read == 0;
+        stream.next_in = reinterpret_cast<Bytef *>(input.get());
+        stream.avail_in = static_cast<uInt>(read);
+      }
+
+      stream.next_out = reinterpret_cast<Bytef *>(output.get());
+      stream.avail_out = static_cast<uInt>(CHUNK);
+      int returnCode = inflate(&stream, Z_NO_FLUSH);
+      std::size_t produced = CHUNK - stream.avail_out;
+
+      if (returnCode == Z_STREAM_END)
+        streamDone = true;
+      else if (returnCode != Z_OK && returnCode != Z_BUF_ERROR)
+      {
+        ec = boost::beast::errc::make_error_code(boost::beast::errc::illegal_byte_sequence);
+        return boost::none;
+      }
+
+      if (produced > 0)
+        return {{const_buffers_type(output.get(), produced), !streamDone}};
+
+      // the file ended before the gzip trailer
+      if (fileDone && stream.avail_in == 0 && !streamDone)
+      {
+        ec = boost::beast::http::error::partial_message;
+        return boost::none;
+      }
+    }
+  }
+}
@@ -0,0 +1,46 @@
+#include "io_thread_pool.hpp"
+
+namespace bytebucket
+{
+  std::shared_ptr<IoThreadPool> IoThreadPool::create(size_t threadCount)
+  {
+    auto pool = std::shared_ptr<IoThreadPool>(new IoThreadPool());
+    if (threadCount == 0)
+      threadCount = 1;
+
+    pool->threads.reserve(threadCount);
+    for (size_t i = 0; i < threadCount; ++i)
+      pool->threads.emplace_back([raw = pool.get()]()
+                                 { raw->run(); });
+    return pool;
+  }
+
+  IoThreadPool::~IoThreadPool()
+  {
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      stopping = true;
+    }
+    available.notify_all();
+    for (auto &thread : threads)
+      thread.join();
+  }
+
+  void IoThreadPool::run()
+  {
+    for (;;)
+    {
+      std::function<void()> task;
+      {
+        std::unique_lock<std::mutex> lock(mutex);
+        available.wait(lock, [this]()
+                       { return stopping || !tasks.empty(); });
+        if (tasks.empty())
+          return;
+        task = std::move(tasks.front());
+        tasks.pop_front();
+      }
+      task();
+    }
+  }
+}
@@ -2,63 +2,408 @@
 #include <boost/beast/http.hpp>      // HTTP protocol support
 #include <boost/beast/version.hpp>   // Version information
 #include <boost/asio/ip/tcp.hpp>     // TCP networking
+#include <boost/asio/post.hpp>       // Work handed to the io_context
 #include <boost/asio/signal_set.hpp> // Signal handling
 #include <boost/asio/strand.hpp>     // Thread synchronization
+#include <algorithm>                 // std::min
+#include <atomic>                    // Stop flags
+#include <csignal>                   // SIGINT and SIGTERM
+#include <cstdint>                   // Fixed-width integers
 #include <cstdlib>                   // Standard library utilities
+#include <functional>                // Accept loop continuation
 #include <iostream>                  // Input/output streams
+#include <limits>                    // Numeric limits
 #include <memory>                    // Smart pointers
+#include <optional>                  // Optional values
 #include <string>                    // String handling
+#include <string_view>               // Non-owning string views
 #include <thread>                    // Multi-threading support
 #include "request_handler.hpp"
 #include "database.hpp"
+#include "database_writer.hpp"
+#include "connection_pool.hpp"
+#include "io_thread_pool.hpp"
+#include "blob_cache.hpp"
+#include "metrics.hpp"
+#include "access_log.hpp"
+#include "tracing.hpp"
+#include "file_storage.hpp"
+#include "session_deadline.hpp"
+#include "admission_control.hpp"
+#include "env_config.hpp"
+#include "connection_drain.hpp"
+
+// written by a background thread; null when BYTEBUCKET_ACCESS_LOG=off
+static std::shared_ptr<bytebucket::AccessLog> access_log;
+
+// shuts down the sockets of clients that stall past session_limits
+static std::shared_ptr<bytebucket::DeadlineWatchdog> session_watchdog;
+static bytebucket::SessionLimits session_limits;
+
+// caps connections and in-flight requests per route class; past them clients get a 503
+static std::shared_ptr<bytebucket::AdmissionControl> admission;
+
+// tracks sessions so SIGTERM can let in-flight requests finish before exiting
+static std::shared_ptr<bytebucket::ConnectionDrain> session_drain = bytebucket::ConnectionDrain::create();
+
+// Copies the request line into an access log record while the request is still
+// around, or returns nothing when access logging is off
+static std::optional<bytebucket::LogRecord> access_record(boost::beast::string_view method, boost::beast::string_view target)
+{
+  if (!access_log)
+    return std::nullopt;
+  bytebucket::LogRecord record;
+  bytebucket::LogRecord::copy(record.method, std::string_view(method.data(), method.size()));
+  bytebucket::LogRecord::copy(record.target, std::string_view(target.data(), target.size()));
+  return record;
+}
+
+static void log_access(std::optional<bytebucket::LogRecord> record, const std::string &remote,
+                       bytebucket::Route route, unsigned status, uint64_t bytes_in, uint64_t bytes_out,
+                       bytebucket::Metrics::Clock::duration elapsed)
+{
+  if (!record)
+    return;
+  record->time = std::chrono::system_clock::now();
+  record->durationMicros = static_cast<uint32_t>(std::chrono::duration_cast<std::chrono::microseconds>(elapsed).count());
+  record->status = static_cast<uint16_t>(status);
+  record->bytesIn = bytes_in;
+  record->bytesOut = bytes_out;
+  bytebucket::LogRecord::copy(record->remote, remote);
+  bytebucket::LogRecord::copy(record->route, bytebucket::Metrics::routePath(route));
+  access_log->push(*record);
+}
+
+// "X-Trace: <id>" traces the request whatever the sampling rate; a numeric
+// value becomes the trace id so the caller can fetch it from /debug/traces
+static std::optional<uint64_t> forced_trace_id(const boost::beast::http::request<boost::beast::http::string_body> &req)
+{
+  auto header = req.find("X-Trace");
+  if (header == req.end())
+    return std::nullopt;
+  std::string value = std::string(header->value());
+  char *end = nullptr;
+  uint64_t id = std::strtoull(value.c_str(), &end, 10);
+  return (!value.empty() && *end == '\0') ? id : 0;
+}
+
+// Answers a connection over the cap without giving it a thread. Whatever part of the
+// request has already arrived is drained first, so closing doesn't reset the
+// connection before the client reads the 503.
+static void shed_connection(boost::asio::ip::tcp::socket &socket)
+{
+  boost::system::error_code ec;
+  socket.non_blocking(true, ec);
+  char scratch[4096];
+  for (int reads = 0; reads < 16 && !ec; ++reads)
+    socket.read_some(boost::asio::buffer(scratch), ec);
+
+  // a fresh socket's send buffer always has room for this, so the write can't block the accept loop
+  auto response = bytebucket::create_overloaded_response(11, admission->limits().retryAfter);
+  response.keep_alive(false);
+  socket.non_blocking(false, ec);
+  boost::beast::http::write(socket, response, ec);
+  socket.shutdown(boost::asio::ip::tcp::socket::shutdown_send, ec);
+  socket.close(ec);
+}
+
+// Converts pre-epoch-ms timestamps in small writer batches so requests interleave
+// with the migration. Stopped and joined before the writer shuts down, so nothing
+// touches the database once the final checkpoint has run.
+class TimestampMigration
+{
+public:
+  explicit TimestampMigration(std::shared_ptr<bytebucket::DatabaseWriter> writer)
+      : thread([this, writer]()
+               { run(*writer); }) {}
+
+  ~TimestampMigration() { stop(); }
+
+  TimestampMigration(const TimestampMigration &) = delete;
+  TimestampMigration &operator=(const TimestampMigration &) = delete;
+
+  // finishes the batch in progress, if any
+  void stop()
+  {
+    stopping = true;
+    if (thread.joinable())
+      thread.join();
+  }
+
+private:
+  void run(bytebucket::DatabaseWriter &writer)
+  {
+    while (!stopping)
+    {
+      auto batch = writer.submit([](bytebucket::Database &db)
+                                 { return db.migrateLegacyTimestamps(500); })
+                       .get();
+      if (!batch.success())
+      {
+        std::cerr << "Timestamp migration stopped: " << batch.errorMessage << std::endl;
+        return;
+      }
+      if (batch.value.value() == 0)
+        return;
+      std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+  }
+
+  std::atomic<bool> stopping{false};
+  std::thread thread;
+};
 
 // Handle a single client session - reads requests and sends responses
 // Each session runs in its own thread to handle multiple concurrent clients
 void do_session(boost::asio::ip::tcp::socket socket)
 {
   boost::beast::flat_buffer buffer; // Buffer for reading HTTP data
+  bytebucket::SocketDeadline deadline{session_watchdog, socket};
+  bytebucket::DeadlineWriteStream<boost::asio::ip::tcp::socket> guarded{socket, deadline, session_limits.writeTimeout};
+  bytebucket::MeteredWriteStream<bytebucket::DeadlineWriteStream<boost::asio::ip::tcp::socket>> metered{guarded};
+  bytebucket::ConnectionDrain::Session drain{session_drain, socket};
+  bytebucket::Metrics::connectionOpened();
+  boost::system::error_code endpoint_error;
+  auto endpoint = socket.remote_endpoint(endpoint_error);
+  std::string remote = endpoint_error ? std::string() : endpoint.address().to_string();
+  uint64_t requests = 0;
   try
   {
     // Keep the connection alive for multiple requests (HTTP keep-alive)
     for (;;)
     {
       boost::beast::http::request<boost::beast::http::string_body> req;
+      metered.reset();
 
-      // Create a parser with increased body limit for file uploads
       boost::beast::http::request_parser<boost::beast::http::string_body> parser;
-      parser.body_limit(100 * 1024 * 1024); // body limit 100MB
+      // oversized Content-Length is answered by check_request_header, not failed by the parser
+      parser.body_limit((std::numeric_limits<std::uint64_t>::max)());
+
+      // a kept-alive connection may sit idle a while; a new one has to get on with its first request
+      if (buffer.size() == 0)
+      {
+        if (requests == 0)
+          deadline.expiresAfter(session_limits.headerTimeout, bytebucket::TimeoutPhase::Header);
+        else
+          deadline.expiresAfter(session_limits.idleTimeout, bytebucket::TimeoutPhase::Idle);
+        // once the server is draining, a connection with nothing more to send is closed instead
+        if (!drain.idle() && socket.available() == 0)
+          break;
+        socket.wait(boost::asio::ip::tcp::socket::wait_read);
+        drain.busy();
+      }
+
+      // Read headers first so a request that will be refused is answered before its body is sent
+      deadline.expiresAfter(session_limits.headerTimeout, bytebucket::TimeoutPhase::Header);
+      uint64_t bytes_in = boost::beast::http::read_header(socket, buffer, parser);
+      auto started = bytebucket::Metrics::Clock::now();
+      auto method = parser.get().method_string();
+      auto target = parser.get().target();
+      bytebucket::Tracer::begin(std::string_view(method.data(), method.size()),
+                                std::string_view(target.data(), target.size()), forced_trace_id(parser.get()));
+
+      std::optional<uint64_t> content_length;
+      if (parser.content_length())
+        content_length = *parser.content_length();
+      std::optional<boost::beast::http::response<boost::beast::http::string_body>> rejection;
+      {
+        bytebucket::TraceSpan span("check_request_header", "http");
+        rejection = bytebucket::check_request_header(parser.get(), content_length);
+      }
+      // over its class's limit the request waits briefly for a slot, then is shed before its body is read
+      std::optional<bytebucket::AdmissionControl::Ticket> admitted;
+      if (!rejection && admission)
+      {
+        bytebucket::TraceSpan span("admission", "http");
+        admitted = admission->admitRequest(bytebucket::AdmissionControl::classify(parser.get().method(), parser.get().target()));
+        if (!admitted)
+          rejection = bytebucket::create_overloaded_response(parser.get().version(), admission->limits().retryAfter);
+      }
+      if (rejection)
+      {
+        // the unread body is still on the wire, so the connection can't be reused
+        rejection->keep_alive(false);
+        {
+          bytebucket::TraceSpan span("write_response", "http");
+          boost::beast::http::write(metered, *rejection);
+        }
+        bytebucket::Tracer::end();
+        auto elapsed = bytebucket::Metrics::Clock::now() - started;
+        bytebucket::Metrics::recordRequest(bytebucket::Route::Rejected, metered.status(), bytes_in,
+                                           metered.bytesWritten(), elapsed);
+        log_access(access_record(parser.get().method_string(), parser.get().target()), remote,
+                   bytebucket::Route::Rejected, metered.status(), bytes_in, metered.bytesWritten(), elapsed);
+        break;
+      }
 
-      boost::beast::http::read(socket, buffer, parser);
+      // limits chunked bodies, which carry no Content-Length to check up front
+      parser.body_limit(bytebucket::MAX_REQUEST_BODY_SIZE);
+
+      // the client is waiting for the go-ahead before sending the body
+      if (bytebucket::expects_continue(parser.get()))
+      {
+        boost::beast::http::response<boost::beast::http::empty_body> proceed{boost::beast::http::status::continue_, parser.get().version()};
+        boost::beast::http::write(guarded, proceed);
+      }
+
+      {
+        // after a grace period the body has to keep up an average of minBodyBytesPerSecond
+        bytebucket::TraceSpan span("read_body", "http");
+        auto body_started = bytebucket::SocketDeadline::Clock::now();
+        uint64_t body_bytes = 0;
+        while (!parser.is_done())
+        {
+          // a second's worth at the minimum rate is the slack for the read in progress
+          deadline.expiresAt(session_limits.bodyDeadline(body_started, body_bytes + session_limits.minBodyBytesPerSecond),
+                             bytebucket::TimeoutPhase::Body);
+          body_bytes += boost::beast::http::read_some(socket, buffer, parser);
+        }
+        bytes_in += body_bytes;
+      }
+      // handlers take as long as they take; writes arm their own deadline
+      deadline.cancel();
       req = parser.release();
 
-      // Store keep_alive status before moving the request
+      // Store keep_alive status and what the log needs before moving the request
       bool keep_alive = req.keep_alive();
+      auto logged = access_record(req.method_string(), req.target());
 
-      boost::beast::http::message_generator response = bytebucket::handle_request(std::move(req));
-      boost::beast::write(socket, response);
+      bytebucket::Route route = bytebucket::Route::NotFound;
+      std::optional<boost::beast::http::message_generator> response;
+      {
+        bytebucket::TraceSpan span("handle_request", "http");
+        response.emplace(bytebucket::handle_request(std::move(req), route));
+      }
+      {
+        // streamed bodies are read and encoded here, as the socket takes them
+        bytebucket::TraceSpan span("write_response", "http");
+        boost::beast::write(metered, *response);
+      }
+      bytebucket::Tracer::end();
+      auto elapsed = bytebucket::Metrics::Clock::now() - started;
+      bytebucket::Metrics::recordRequest(route, metered.status(), bytes_in, metered.bytesWritten(), elapsed);
+      log_access(std::move(logged), remote, route, metered.status(), bytes_in, metered.bytesWritten(), elapsed);
 
-      if (!keep_alive)
+      // a connection is closed after its last allowed request, so long-lived clients rebalance
+      ++requests;
+      if (!keep_alive || session_drain->draining() ||
+          (session_limits.maxRequestsPerConnection > 0 && requests >= session_limits.maxRequestsPerConnection))
         break;
     }
   }
+  catch (const boost::system::system_error &e)
+  {
+    // the watchdog shut the socket down; under a slow-client flood these would swamp stderr
+    if (auto phase = deadline.expired())
+    {
+      if (access_log)
+        access_log->event("session_timeout", std::string(bytebucket::Metrics::timeoutPhaseName(*phase)) + " " + remote);
+    }
+    else if (session_drain->draining())
+    {
+      // closed by the drain while idle, or cut off when its deadline passed
+      if (access_log && e.code() != boost::beast::http::error::end_of_stream)
+        access_log->event("session_drained", std::string(e.what()) + " " + remote);
+    }
+    else
+    {
+      std::cerr << "Session error: " << e.what() << std::endl;
+      // a client closing its keep-alive connection isn't worth an event line
+      if (access_log && e.code() != boost::beast::http::error::end_of_stream)
+        access_log->event("session_error", e.what());
+    }
+  }
   catch (const std::exception &e)
   {
     std::cerr << "Session error: " << e.what() << std::endl;
+    if (access_log)
+      access_log->event("session_error", e.what());
   }
+  // keeps the trace of a request that failed part way
+  bytebucket::Tracer::end();
+  bytebucket::Metrics::connectionClosed();
 }
 
 int main(int argc, char *argv[])
 {
+  auto startup_began = std::chrono::steady_clock::now();
+  auto startup_ms = [&startup_began]()
+  {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - startup_began).count();
+  };
+
   try
   {
     std::cout << "Initialising db..." << std::endl;
-    auto db = bytebucket::Database::create();
-    if (!db)
+    // per-statement profiling, with slow statements logged along with their plan
+    if (const char *profile = std::getenv("BYTEBUCKET_QUERY_PROFILE"); profile && std::string(profile) == "on")
+    {
+      uint64_t slow_ms = bytebucket::readEnvCount("BYTEBUCKET_SLOW_QUERY_MS", 100, 0);
+      bytebucket::Database::setQueryProfiler(
+          bytebucket::QueryProfiler::create("bytebucket.db", std::chrono::milliseconds(slow_ms)));
+    }
+
+    // single writer thread owns the read-write connection; all mutations go through it
+    auto tuning = bytebucket::DatabaseTuning::fromEnvironment();
+    auto writer = bytebucket::DatabaseWriter::create("bytebucket.db", std::chrono::milliseconds(2), 256, tuning);
+    if (!writer)
     {
       std::cerr << "Failed to initialise db" << std::endl;
       return EXIT_FAILURE;
     }
-    std::cout << "Initialised db!" << std::endl;
+    bytebucket::setDatabaseWriter(writer);
+
+    // reads lease read-only connections so they never queue behind the writer
+    auto pool = bytebucket::ConnectionPool::create("bytebucket.db", 8, tuning);
+    if (!pool)
+    {
+      std::cerr << "Failed to open read connections" << std::endl;
+      return EXIT_FAILURE;
+    }
+    bytebucket::setConnectionPool(pool);
+
+    // uploads are gzipped at rest when it pays off unless turned off
+    if (const char *blob_compression = std::getenv("BYTEBUCKET_BLOB_COMPRESSION"))
+      bytebucket::FileStorage::setBlobCompression(std::string(blob_compression) != "off");
+
+    // multi-file uploads write their blobs concurrently on these threads
+    bytebucket::setIoThreadPool(bytebucket::IoThreadPool::create(4));
+
+    // small downloads are kept in memory; BYTEBUCKET_BLOB_CACHE_MB=0 turns this off
+    uint64_t blob_cache_mb = bytebucket::readEnvCount("BYTEBUCKET_BLOB_CACHE_MB", 64, 0);
+    if (blob_cache_mb > 0)
+      bytebucket::setBlobCache(bytebucket::BlobCache::create(blob_cache_mb * 1024 * 1024, 1024 * 1024));
+    // resumable uploads in progress when the server last stopped carry on where they were
+    bytebucket::restore_upload_sessions();
+
+    std::cout << "Initialised db in " << startup_ms() << " ms (schema version "
+              << bytebucket::Database::SCHEMA_VERSION << ")" << std::endl;
+
+    // one JSON line per request, rotated past BYTEBUCKET_ACCESS_LOG_MAX_MB; BYTEBUCKET_ACCESS_LOG=off turns it off
+    bytebucket::AccessLog::Options log_options;
+    if (const char *log_path = std::getenv("BYTEBUCKET_ACCESS_LOG"))
+      log_options.path = log_path;
+    log_options.maxBytes = bytebucket::readEnvCount("BYTEBUCKET_ACCESS_LOG_MAX_MB", 64, 1) * 1024 * 1024;
+    if (log_options.path != "off")
+      access_log = bytebucket::AccessLog::create(log_options);
+
+    // trace 1 in BYTEBUCKET_TRACE_SAMPLE requests (default 1000, 0 for X-Trace requests only)
+    uint64_t trace_sample = bytebucket::readEnvCount("BYTEBUCKET_TRACE_SAMPLE", 1000, 0);
+    bytebucket::Tracer::setSampling(static_cast<uint32_t>(std::min<uint64_t>(trace_sample, std::numeric_limits<uint32_t>::max())));
+
+    // how long SIGTERM waits for in-flight requests before cutting them off
+    std::chrono::seconds shutdown_timeout{bytebucket::readEnvCount("BYTEBUCKET_SHUTDOWN_TIMEOUT_S", 30, 1)};
+
+    // idle, header, body and write deadlines for client connections
+    session_limits = bytebucket::SessionLimits::fromEnvironment();
+    session_watchdog = bytebucket::DeadlineWatchdog::create();
+
+    // past these limits connections and requests are shed with 503 and Retry-After
+    admission = bytebucket::AdmissionControl::create(bytebucket::AdmissionLimits::fromEnvironment());
+    bytebucket::setAdmissionControl(admission);
+
+    // converts pre-epoch-ms timestamps alongside the requests; joined on shutdown
+    TimestampMigration timestamp_migration{writer};
 
     auto const address = boost::asio::ip::make_address("0.0.0.0"); // Listen on all interfaces
     unsigned short port = 8080;
@@ -66,17 +411,91 @@ int main(int argc, char *argv[])
     boost::asio::io_context ioc{1};
     boost::asio::ip::tcp::acceptor acceptor{ioc, {address, port}};
 
-    std::cout << "Server started on http://0.0.0.0:8080\n";
+    // SIGINT or SIGTERM closes the acceptor, which ends the accept loop and starts the drain
+    boost::asio::signal_set signals{ioc, SIGINT, SIGTERM};
+    signals.async_wait([&acceptor](const boost::system::error_code &ec, int signal_number)
+                       {
+      if (ec)
+        return;
+      std::cout << "Received " << (signal_number == SIGINT ? "SIGINT" : "SIGTERM") << ", no longer accepting connections" << std::endl;
+      acceptor.close(); });
+
+    std::cout << "Server started on http://0.0.0.0:8080 in " << startup_ms() << " ms\n";
     std::cout << "Health check available at: http://0.0.0.0:8080/health\n";
 
-    for (;;) // server loop
+    std::function<void()> accept_next = [&]()
+    {
+      acceptor.async_accept([&](const boost::system::error_code &ec, boost::asio::ip::tcp::socket socket)
+                            {
+        if (ec == boost::asio::error::operation_aborted)
+          return;
+        if (ec)
+          throw boost::system::system_error(ec);
+
+        if (auto slot = admission->admitConnection())
+        {
+          // the slot is held until the session's thread is done
+          std::thread([socket = std::move(socket), slot = std::move(*slot)]() mutable
+                      { do_session(std::move(socket)); })
+              .detach(); // Detach thread so it runs independently
+        }
+        else
+          shed_connection(socket);
+        accept_next(); });
+    };
+    accept_next();
+    ioc.run();
+
+    auto stopping_began = std::chrono::steady_clock::now();
+    auto stopping_ms = [&stopping_began]()
     {
-      boost::asio::ip::tcp::socket socket{ioc};
-      acceptor.accept(socket);
+      return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - stopping_began).count();
+    };
+
+    // a second signal gives up on the drain
+    signals.async_wait([](const boost::system::error_code &ec, int)
+                       {
+      if (ec)
+        return;
+      std::cerr << "Received a second signal, exiting without draining" << std::endl;
+      std::_Exit(EXIT_FAILURE); });
+    ioc.restart();
+    std::thread signal_thread([&ioc]()
+                              { ioc.run(); });
+
+    // idle connections close now; busy ones after their response, or at the deadline
+    std::cout << "Draining " << session_drain->activeSessions() << " connections (up to "
+              << shutdown_timeout.count() << " s)" << std::endl;
+    auto drained = session_drain->drain(shutdown_timeout);
+    if (drained.forced > 0)
+      std::cerr << drained.forced << " connections were still busy after " << shutdown_timeout.count()
+                << " s and were cut off" << std::endl;
+
+    // writes already queued are committed, then the WAL is folded back into the database
+    timestamp_migration.stop();
+    writer->stop();
+    auto checkpoint = writer->checkpoint();
+    if (!checkpoint.success())
+      std::cerr << checkpoint.errorMessage << std::endl;
+
+    boost::asio::post(ioc, [&signals]()
+                      { signals.cancel(); });
+    signal_thread.join();
 
-      std::thread([socket = std::move(socket)]() mutable
-                  { do_session(std::move(socket)); })
-          .detach(); // Detach thread so it runs independently
+    std::cout << "Stopped in " << stopping_ms() << " ms (" << drained.idleClosed << " idle connections closed, "
+              << drained.forced << " cut off" << (checkpoint.success() ? ", WAL checkpointed" : "") << ")" << std::endl;
+    if (access_log)
+    {
+      access_log->event("shutdown", drained.forced == 0 ? std::string("drained")
+                                                        : std::to_string(drained.forced) + " connections cut off");
+      access_log->flush();
+    }
+
+    // a session that hasn't unwound may still touch the globals static destructors would free
+    if (!drained.complete)
+    {
+      std::cout.flush();
+      std::_Exit(EXIT_FAILURE);
     }
   }
   catch (const std::exception &e)
@@ -0,0 +1,315 @@
+#include "metrics.hpp"
+#include <algorithm>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <vector>
+
+namespace bytebucket
+{
+  static constexpr size_t ROUTE_COUNT = static_cast<size_t>(Route::Count);
+  static constexpr size_t STORAGE_OP_COUNT = static_cast<size_t>(StorageOp::Count);
+
+  // status codes counted individually; anything else is counted as "other"
+  static constexpr std::array<uint16_t, 23> TRACKED_STATUSES = {
+      200, 201, 204, 206, 304, 400, 401, 403, 404, 405, 408, 409,
+      411, 413, 415, 416, 429, 500, 501, 503, 504, 505, 507};
+  static constexpr size_t STATUS_SLOTS = TRACKED_STATUSES.size() + 1;
+
+  static constexpr const char *ROUTE_METHODS[ROUTE_COUNT] = {
+      "OPTIONS", "GET", "GET", "GET", "GET", "POST", "DELETE", "POST", "DELETE", "PATCH",
+      "GET", "GET", "POST", "POST", "DELETE", "POST", "DELETE", "GET", "POST", "POST",
+      "PUT", "GET", "DELETE", "GET", "GET", "GET", "GET", "GET", "", ""};
+
+  static constexpr const char *ROUTE_PATHS[ROUTE_COUNT] = {
+      "*", "/health", "/", "/folder/{id}/archive", "/folder/{id}", "/folder", "/folder/{id}",
+      "/upload", "/files/{id}", "/files/{id}/move", "/download/{id}", "/tags", "/tags",
+      "/files/{id}/tags", "/files/{id}/tags/{tagId}", "/files/{id}/metadata",
+      "/files/{id}/metadata/{key}", "/search/metadata", "/uploads", "/uploads/{id}/complete",
+      "/uploads/{id}", "/uploads/{id}", "/uploads/{id}", "/stats/database", "/stats/cache",
+      "/metrics", "/debug/queries", "/debug/traces", "rejected", "unmatched"};
+
+  static constexpr const char *STORAGE_OP_NAMES[STORAGE_OP_COUNT] = {"read", "write", "delete"};
+
+  // Written only by its owning thread and read by scrapes, so a relaxed load
+  // and store is enough; no locked read-modify-write on the hot path
+  struct Counter
+  {
+    std::atomic<uint64_t> value{0};
+
+    void add(uint64_t amount) { value.store(value.load(std::memory_order_relaxed) + amount, std::memory_order_relaxed); }
+    uint64_t get() const { return value.load(std::memory_order_relaxed); }
+  };
+
+  struct Histogram
+  {
+    std::array<Counter, Metrics::HISTOGRAM_BUCKETS> buckets;
+    Counter sumMicros;
+
+    void record(uint64_t micros)
+    {
+      buckets[Metrics::bucketFor(micros)].add(1);
+      sumMicros.add(micros);
+    }
+  };
+
+  struct ThreadCounters
+  {
+    std::array<std::array<Counter, STATUS_SLOTS>, ROUTE_COUNT> requests;
+    std::array<Histogram, ROUTE_COUNT> latency;
+    std::array<Counter, ROUTE_COUNT> bytesIn;
+    std::array<Counter, ROUTE_COUNT> bytesOut;
+    std::array<Histogram, STORAGE_OP_COUNT> storage;
+
+    void addTo(ThreadCounters &total) const
+    {
+      for (size_t route = 0; route < ROUTE_COUNT; ++route)
+      {
+        for (size_t slot = 0; slot < STATUS_SLOTS; ++slot)
+          total.requests[route][slot].add(requests[route][slot].get());
+        addHistogram(latency[route], total.latency[route]);
+        total.bytesIn[route].add(bytesIn[route].get());
+        total.bytesOut[route].add(bytesOut[route].get());
+      }
+      for (size_t op = 0; op < STORAGE_OP_COUNT; ++op)
+        addHistogram(storage[op], total.storage[op]);
+    }
+
+    static void addHistogram(const Histogram &from, Histogram &to)
+    {
+      for (size_t bucket = 0; bucket < Metrics::HISTOGRAM_BUCKETS; ++bucket)
+        to.buckets[bucket].add(from.buckets[bucket].get());
+      to.sumMicros.add(from.sumMicros.get());
+    }
+  };
+
+  // Live per-thread blocks plus the totals of threads that have exited.
+  // Connections get their own threads, so blocks come and go all the time.
+  struct Registry
+  {
+    std::mutex mutex;
+    std::vector<ThreadCounters *> live;
+    ThreadCounters retired;
+    std::atomic<int64_t> activeConnections{0};
+    std::atomic<uint64_t> connections{0};
+    std::array<std::atomic<uint64_t>, static_cast<size_t>(TimeoutPhase::Count)> timeouts{};
+  };
+
+  // never destroyed, so threads exiting during shutdown can still retire their counters
+  static Registry &registry()
+  {
+    static Registry *instance = new Registry();
+    return *instance;
+  }
+
+  struct ThreadCountersHandle
+  {
+    std::unique_ptr<ThreadCounters> counters = std::make_unique<ThreadCounters>();
+
+    ThreadCountersHandle()
+    {
+      std::lock_guard<std::mutex> lock(registry().mutex);
+      registry().live.push_back(counters.get());
+    }
+
+    ~ThreadCountersHandle()
+    {
+      Registry &shared = registry();
+      std::lock_guard<std::mutex> lock(shared.mutex);
+      counters->addTo(shared.retired);
+      shared.live.erase(std::find(shared.live.begin(), shared.live.end(), counters.get()));
+    }
+  };
+
+  static ThreadCounters &localCounters()
+  {
+    thread_local ThreadCountersHandle handle;
+    return *handle.counters;
+  }
+
+  static size_t statusSlot(unsigned status)
+  {
+    auto found = std::find(TRACKED_STATUSES.begin(), TRACKED_STATUSES.end(), status);
+    return static_cast<size_t>(found - TRACKED_STATUSES.begin());
+  }
+
+  static uint64_t toMicros(Metrics::Clock::duration elapsed)
+  {
+    auto micros = std::chrono::duration_cast<std::chrono::microseconds>(elapsed).count();
+    return micros < 0 ? 0 : static_cast<uint64_t>(micros);
+  }
+
+  size_t Metrics::bucketFor(uint64_t micros)
+  {
+    if (micros < 4)
+      return static_cast<size_t>(micros);
+    // two bits below the leading one pick one of four sub-buckets
+    size_t magnitude = 63 - static_cast<size_t>(__builtin_clzll(micros));
+    size_t sub = static_cast<size_t>(micros >> (magnitude - 2)) & 3;
+    return std::min((magnitude - 1) * 4 + sub, HISTOGRAM_BUCKETS - 1);
+  }
+
+  uint64_t Metrics::bucketUpperBound(size_t bucket)
+  {
+    if (bucket < 4)
+      return bucket + 1;
+    size_t magnitude = bucket / 4 + 1;
+    uint64_t sub = bucket % 4;
+    return (5 + sub) << (magnitude - 2);
+  }
+
+  const char *Metrics::routeMethod(Route route)
+  {
+    return ROUTE_METHODS[static_cast<size_t>(route)];
+  }
+
+  const char *Metrics::routePath(Route route)
+  {
+    return ROUTE_PATHS[static_cast<size_t>(route)];
+  }
+
+  void Metrics::recordRequest(Route route, unsigned status, uint64_t bytesIn, uint64_t bytesOut,
+                              Clock::duration elapsed)
+  {
+    ThreadCounters &counters = localCounters();
+    size_t index = static_cast<size_t>(route);
+    counters.requests[index][statusSlot(status)].add(1);
+    counters.latency[index].record(toMicros(elapsed));
+    counters.bytesIn[index].add(bytesIn);
+    counters.bytesOut[index].add(bytesOut);
+  }
+
+  void Metrics::recordStorage(StorageOp op, Clock::duration elapsed)
+  {
+    localCounters().storage[static_cast<size_t>(op)].record(toMicros(elapsed));
+  }
+
+  void Metrics::connectionOpened()
+  {
+    registry().activeConnections.fetch_add(1, std::memory_order_relaxed);
+    registry().connections.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  void Metrics::connectionClosed()
+  {
+    registry().activeConnections.fetch_sub(1, std::memory_order_relaxed);
+  }
+
+  void Metrics::connectionTimedOut(TimeoutPhase phase)
+  {
+    registry().timeouts[static_cast<size_t>(phase)].fetch_add(1, std::memory_order_relaxed);
+  }
+
+  const char *Metrics::timeoutPhaseName(TimeoutPhase phase)
+  {
+    static constexpr const char *NAMES[] = {"idle", "header", "body", "write"};
+    static_assert(std::size(NAMES) == static_cast<size_t>(TimeoutPhase::Count));
+    return NAMES[static_cast<size_t>(phase)];
+  }
+
+  static void writeHistogram(std::ostringstream &out, const char *name, const std::string &labels, const Histogram &histogram)
+  {
+    // Prometheus buckets at each power of two microseconds, which are all
+    // internal bucket boundaries, so the cumulative counts are exact
+    uint64_t cumulative = 0;
+    size_t bucket = 0;
+    for (uint64_t bound = 1; bound <= (uint64_t{1} << 30); bound <<= 1)
+    {
+      for (; bucket < Metrics::HISTOGRAM_BUCKETS && Metrics::bucketUpperBound(bucket) <= bound; ++bucket)
+        cumulative += histogram.buckets[bucket].get();
+      out << name << "_bucket{" << labels << (labels.empty() ? "" : ",") << "le=\"" << bound / 1e6 << "\"} " << cumulative << "\n";
+    }
+    for (; bucket < Metrics::HISTOGRAM_BUCKETS; ++bucket)
+      cumulative += histogram.buckets[bucket].get();
+    out << name << "_bucket{" << labels << (labels.empty() ? "" : ",") << "le=\"+Inf\"} " << cumulative << "\n";
+    out << name << "_sum{" << labels << "} " << histogram.sumMicros.get() / 1e6 << "\n";
+    out << name << "_count{" << labels << "} " << cumulative << "\n";
+  }
+
+  std::string Metrics::renderPrometheus()
+  {
+    ThreadCounters total;
+    int64_t activeConnections;
+    uint64_t connections;
+    std::array<uint64_t, static_cast<size_t>(TimeoutPhase::Count)> timeouts{};
+    {
+      Registry &shared = registry();
+      std::lock_guard<std::mutex> lock(shared.mutex);
+      shared.retired.addTo(total);
+      for (const ThreadCounters *counters : shared.live)
+        counters->addTo(total);
+      activeConnections = shared.activeConnections.load(std::memory_order_relaxed);
+      connections = shared.connections.load(std::memory_order_relaxed);
+      for (size_t phase = 0; phase < timeouts.size(); ++phase)
+        timeouts[phase] = shared.timeouts[phase].load(std::memory_order_relaxed);
+    }
+
+    std::ostringstream out;
+    out.precision(10);
+    auto routeLabels = [](size_t route)
+    {
+      return std::string("method=\"") + ROUTE_METHODS[route] + "\",route=\"" + ROUTE_PATHS[route] + "\"";
+    };
+
+    out << "# HELP bytebucket_http_requests_total Requests answered, by route and status code.\n"
+        << "# TYPE bytebucket_http_requests_total counter\n";
+    for (size_t route = 0; route < ROUTE_COUNT; ++route)
+    {
+      for (size_t slot = 0; slot < STATUS_SLOTS; ++slot)
+      {
+        uint64_t count = total.requests[route][slot].get();
+        if (count == 0)
+          continue;
+        std::string code = slot < TRACKED_STATUSES.size() ? std::to_string(TRACKED_STATUSES[slot]) : "other";
+        out << "bytebucket_http_requests_total{" << routeLabels(route) << ",code=\"" << code << "\"} " << count << "\n";
+      }
+    }
+
+    out << "# HELP bytebucket_http_request_duration_seconds Time from a request's headers arriving to its response being written.\n"
+        << "# TYPE bytebucket_http_request_duration_seconds histogram\n";
+    for (size_t route = 0; route < ROUTE_COUNT; ++route)
+    {
+      if (total.bytesIn[route].get() == 0)
+        continue;
+      writeHistogram(out, "bytebucket_http_request_duration_seconds", routeLabels(route), total.latency[route]);
+    }
+
+    out << "# HELP bytebucket_http_request_bytes_total Bytes read from clients, headers included.\n"
+        << "# TYPE bytebucket_http_request_bytes_total counter\n";
+    for (size_t route = 0; route < ROUTE_COUNT; ++route)
+    {
+      if (total.bytesIn[route].get() > 0)
+        out << "bytebucket_http_request_bytes_total{" << routeLabels(route) << "} " << total.bytesIn[route].get() << "\n";
+    }
+
+    out << "# HELP bytebucket_http_response_bytes_total Bytes written to clients, headers included.\n"
+        << "# TYPE bytebucket_http_response_bytes_total counter\n";
+    for (size_t route = 0; route < ROUTE_COUNT; ++route)
+    {
+      if (total.bytesOut[route].get() > 0)
+        out << "bytebucket_http_response_bytes_total{" << routeLabels(route) << "} " << total.bytesOut[route].get() << "\n";
+    }
+
+    out << "# HELP bytebucket_http_active_connections Client connections currently open.\n"
+        << "# TYPE bytebucket_http_active_connections gauge\n"
+        << "bytebucket_http_active_connections " << activeConnections << "\n"
+        << "# HELP bytebucket_http_connections_total Client connections accepted.\n"
+        << "# TYPE bytebucket_http_connections_total counter\n"
+        << "bytebucket_http_connections_total " << connections << "\n";
+
+    out << "# HELP bytebucket_http_connection_timeouts_total Connections closed because a deadline passed, by what they were waiting on.\n"
+        << "# TYPE bytebucket_http_connection_timeouts_total counter\n";
+    for (size_t phase = 0; phase < timeouts.size(); ++phase)
+      out << "bytebucket_http_connection_timeouts_total{phase=\"" << timeoutPhaseName(static_cast<TimeoutPhase>(phase))
+          << "\"} " << timeouts[phase] << "\n";
+
+    out << "# HELP bytebucket_storage_operation_duration_seconds Blob reads, writes and deletes on disk.\n"
+        << "# TYPE bytebucket_storage_operation_duration_seconds histogram\n";
+    for (size_t op = 0; op < STORAGE_OP_COUNT; ++op)
+      writeHistogram(out, "bytebucket_storage_operation_duration_seconds",
+                     std::string("op=\"") + STORAGE_OP_NAMES[op] + "\"", total.storage[op]);
+
+    return out.str();
+  }
+}
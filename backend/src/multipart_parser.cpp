@@ -1,7 +1,7 @@
 #include "multipart_parser.hpp"
-#include <sstream>
+#include "boundary_scanner.hpp"
 #include <algorithm>
-#include <iostream>
+#include <cctype>
 
 // example multipart input
 /*
@@ -38,78 +38,135 @@ photo,profile,avatar
 namespace bytebucket
 {
 
+    MultipartFile MultipartFileView::toOwned() const
+    {
+        MultipartFile file;
+        file.name = std::string(name);
+        file.filename = std::string(filename);
+        file.content_type = std::string(content_type);
+        file.content.assign(content.begin(), content.end());
+        return file;
+    }
+
+    MultipartField MultipartFieldView::toOwned() const
+    {
+        return MultipartField{std::string(name), std::string(value)};
+    }
+
+    MultipartData MultipartView::toOwned() const
+    {
+        MultipartData data;
+        data.files.reserve(files.size());
+        data.fields.reserve(fields.size());
+        for (const auto &file : files)
+            data.files.push_back(file.toOwned());
+        for (const auto &field : fields)
+            data.fields.push_back(field.toOwned());
+        return data;
+    }
+
     std::optional<MultipartData> MultipartParser::parse(const std::string &body, const std::string &boundary)
+    {
+        auto view = parseView(body, boundary);
+        if (!view.has_value())
+            return std::nullopt;
+        return view->toOwned();
+    }
+
+    std::optional<MultipartView> MultipartParser::parseView(std::string_view body, std::string_view boundary)
     {
         if (boundary.empty())
         {
             return std::nullopt;
         }
 
-        MultipartData result;
-
-        // Create boundary markers
-        std::string start_boundary = "--" + boundary;
-        std::string end_boundary = "--" + boundary + "--";
+        // Boundary marker; the closing "--boundary--" starts with it too, so one scan finds both
+        std::string marker;
+        marker.reserve(boundary.size() + 2);
+        marker.append("--").append(boundary);
+        const BoundaryScanner start_boundary(marker);
 
-        if (body.find(start_boundary) == std::string::npos)
+        size_t first_boundary = start_boundary.find(body);
+        if (first_boundary == std::string_view::npos)
         {
             return std::nullopt;
         }
 
-        // Split by boundary
-        size_t pos = 0;
+        // typical forms fit without the vectors regrowing; larger ones grow as the
+        // split runs rather than paying for a second scan of the body to count parts
+        MultipartView result;
+        result.files.reserve(16);
+        result.fields.reserve(16);
+
+        // Split by boundary, starting at the marker already found
+        size_t pos = first_boundary;
         bool found_valid_part = false;
 
         while (pos < body.length())
         {
             // Find next boundary
-            size_t boundary_pos = body.find(start_boundary, pos);
-            if (boundary_pos == std::string::npos)
+            size_t boundary_pos = start_boundary.find(body, pos);
+            if (boundary_pos == std::string_view::npos)
                 break;
 
             // Skip the boundary line
             size_t content_start = body.find("\r\n", boundary_pos);
-            if (content_start == std::string::npos)
+            if (content_start == std::string_view::npos)
                 break;
             content_start += 2; // Skip \r\n
 
             // Find next boundary to determine content end
-            size_t next_boundary = body.find(start_boundary, content_start);
-            if (next_boundary == std::string::npos)
-            {
-                // Check for end boundary
-                next_boundary = body.find(end_boundary, content_start);
-                if (next_boundary == std::string::npos)
-                    break;
-            }
+            size_t next_boundary = start_boundary.find(body, content_start);
+            if (next_boundary == std::string_view::npos || next_boundary < content_start + 2)
+                break;
 
-            // Extract the part content (without the final \r\n before boundary)
-            std::string part_content = body.substr(content_start, next_boundary - content_start - 2);
+            // The part content (without the final \r\n before boundary)
+            std::string_view part_content = body.substr(content_start, next_boundary - content_start - 2);
 
             // Split headers and content
             size_t header_end = part_content.find("\r\n\r\n");
-            if (header_end == std::string::npos)
+            if (header_end == std::string_view::npos)
             {
                 pos = next_boundary;
                 continue;
             }
 
-            std::string headers_section = part_content.substr(0, header_end);
-            std::string content_section = part_content.substr(header_end + 4);
+            std::string_view headers_section = part_content.substr(0, header_end);
+            std::string_view content_section = part_content.substr(header_end + 4);
+
+            // Only two headers matter, so pick them out of the lines in place
+            std::string_view disposition;
+            std::string_view part_content_type;
+            bool has_disposition = false;
+            while (!headers_section.empty())
+            {
+                size_t line_end = headers_section.find('\n');
+                std::string_view line = headers_section.substr(0, line_end);
+                headers_section = line_end == std::string_view::npos ? std::string_view{} : headers_section.substr(line_end + 1);
+
+                size_t colon_pos = line.find(':');
+                if (colon_pos == std::string_view::npos)
+                    continue;
 
-            // Parse headers
-            auto headers = parseHeaders(headers_section);
+                std::string_view key = trimView(line.substr(0, colon_pos));
+                std::string_view value = trimView(line.substr(colon_pos + 1));
+                if (equalsIgnoreCase(key, "content-disposition"))
+                {
+                    disposition = value;
+                    has_disposition = true;
+                }
+                else if (equalsIgnoreCase(key, "content-type"))
+                {
+                    part_content_type = value;
+                }
+            }
 
             // Check if this is a file or regular field
-            auto content_disposition = headers.find("content-disposition");
-            if (content_disposition != headers.end())
+            if (has_disposition)
             {
-                // Parse Content-Disposition header
-                std::string disposition = content_disposition->second;
-
                 // Extract name
                 size_t name_pos = disposition.find("name=\"");
-                if (name_pos == std::string::npos)
+                if (name_pos == std::string_view::npos)
                 {
                     pos = next_boundary;
                     continue;
@@ -117,40 +174,29 @@ namespace bytebucket
 
                 name_pos += 6; // Skip name="
                 size_t name_end = disposition.find("\"", name_pos);
-                std::string field_name = disposition.substr(name_pos, name_end - name_pos);
+                std::string_view field_name = disposition.substr(name_pos, name_end - name_pos);
 
                 // Check if it has filename (indicates file upload)
                 size_t filename_pos = disposition.find("filename=\"");
-                if (filename_pos != std::string::npos)
+                if (filename_pos != std::string_view::npos)
                 {
                     // This is a file
                     filename_pos += 10; // Skip filename="
                     size_t filename_end = disposition.find("\"", filename_pos);
-                    std::string filename = disposition.substr(filename_pos, filename_end - filename_pos);
-
-                    std::string content_type = "application/octet-stream"; // Default
-                    auto ct_iter = headers.find("content-type");
-                    if (ct_iter != headers.end())
-                        content_type = ct_iter->second;
 
-                    // Create file object
-                    MultipartFile file;
+                    MultipartFileView file;
                     file.name = field_name;
-                    file.filename = filename;
-                    file.content_type = content_type;
-                    file.content = std::vector<char>(content_section.begin(), content_section.end());
+                    file.filename = disposition.substr(filename_pos, filename_end - filename_pos);
+                    file.content_type = part_content_type.empty() ? std::string_view("application/octet-stream") : part_content_type;
+                    file.content = content_section;
 
-                    result.files.push_back(std::move(file));
+                    result.files.push_back(file);
                     found_valid_part = true;
                 }
                 else
                 {
                     // This is a regular field
-                    MultipartField field;
-                    field.name = field_name;
-                    field.value = content_section;
-
-                    result.fields.push_back(std::move(field));
+                    result.fields.push_back(MultipartFieldView{field_name, content_section});
                     found_valid_part = true;
                 }
             }
@@ -186,32 +232,21 @@ namespace bytebucket
         return boundary;
     }
 
-    std::unordered_map<std::string, std::string> MultipartParser::parseHeaders(const std::string &header_section)
+    std::string_view MultipartParser::trimView(std::string_view str)
     {
-        std::unordered_map<std::string, std::string> headers;
-        std::istringstream stream(header_section);
-        std::string line;
-
-        while (std::getline(stream, line))
-        {
-            // Remove \r if present
-            if (!line.empty() && line.back() == '\r')
-                line.pop_back();
-
-            size_t colon_pos = line.find(':');
-            if (colon_pos != std::string::npos)
-            {
-                std::string key = trim(line.substr(0, colon_pos));
-                std::string value = trim(line.substr(colon_pos + 1));
-
-                // Convert key to lowercase for case-insensitive lookup
-                std::transform(key.begin(), key.end(), key.begin(), ::tolower);
+        size_t start = str.find_first_not_of(" \t\r\n");
+        if (start == std::string_view::npos)
+            return {};
 
-                headers[key] = value;
-            }
-        }
+        size_t end = str.find_last_not_of(" \t\r\n");
+        return str.substr(start, end - start + 1);
+    }
 
-        return headers;
+    bool MultipartParser::equalsIgnoreCase(std::string_view a, std::string_view b)
+    {
+        return a.size() == b.size() &&
+               std::equal(a.begin(), a.end(), b.begin(), [](char x, char y)
+                          { return std::tolower(static_cast<unsigned char>(x)) == std::tolower(static_cast<unsigned char>(y)); });
     }
 
     std::string MultipartParser::trim(const std::string &str)
@@ -0,0 +1,213 @@
+#include "query_profiler.hpp"
+#include <algorithm>
+#include <cctype>
+#include <iostream>
+
+namespace bytebucket
+{
+  std::shared_ptr<QueryProfiler> QueryProfiler::create(const std::string &dbPath, std::chrono::milliseconds slowThreshold)
+  {
+    return std::shared_ptr<QueryProfiler>(new QueryProfiler(dbPath, slowThreshold));
+  }
+
+  QueryProfiler::QueryProfiler(std::string dbPath, std::chrono::milliseconds slowThreshold)
+      : dbPath(std::move(dbPath)), threshold(slowThreshold)
+  {
+  }
+
+  QueryProfiler::~QueryProfiler()
+  {
+    if (planDb)
+      sqlite3_close(planDb);
+  }
+
+  std::unique_ptr<QueryProfiler::Connection> QueryProfiler::attach(std::shared_ptr<QueryProfiler> profiler, sqlite3 *db)
+  {
+    std::unique_ptr<Connection> connection(new Connection(std::move(profiler)));
+    if (sqlite3_trace_v2(db, SQLITE_TRACE_PROFILE | SQLITE_TRACE_ROW, traceCallback, connection.get()) != SQLITE_OK)
+      return nullptr;
+    return connection;
+  }
+
+  int QueryProfiler::traceCallback(unsigned type, void *context, void *p, void *x)
+  {
+    auto *connection = static_cast<Connection *>(context);
+    auto *stmt = static_cast<sqlite3_stmt *>(p);
+
+    if (type == SQLITE_TRACE_ROW)
+    {
+      connection->rows[stmt]++;
+      return 0;
+    }
+
+    if (type == SQLITE_TRACE_PROFILE)
+    {
+      uint64_t rows = 0;
+      auto found = connection->rows.find(stmt);
+      if (found != connection->rows.end())
+      {
+        rows = found->second;
+        connection->rows.erase(found);
+      }
+      connection->profiler->record(stmt, static_cast<uint64_t>(*static_cast<sqlite3_int64 *>(x)), rows);
+    }
+    return 0;
+  }
+
+  void QueryProfiler::record(sqlite3_stmt *stmt, uint64_t nanoseconds, uint64_t rows)
+  {
+    const char *text = sqlite3_sql(stmt);
+    if (!text)
+      return;
+    std::string sql = normalise(text);
+    bool slow = nanoseconds >= static_cast<uint64_t>(std::chrono::nanoseconds(threshold).count());
+
+    bool needsPlan = false;
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      QueryStats &stats = queries[sql];
+      if (stats.sql.empty())
+        stats.sql = sql;
+      stats.calls++;
+      stats.rows += rows;
+      stats.totalNanoseconds += nanoseconds;
+      stats.maxNanoseconds = std::max(stats.maxNanoseconds, nanoseconds);
+      if (slow)
+      {
+        stats.slowCalls++;
+        needsPlan = stats.plan.empty();
+      }
+    }
+    if (!slow)
+      return;
+
+    std::string plan;
+    if (needsPlan)
+    {
+      plan = explain(text);
+      std::lock_guard<std::mutex> lock(mutex);
+      queries[sql].plan = plan;
+    }
+    else
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      plan = queries[sql].plan;
+    }
+
+    std::cerr << "Slow query (" << nanoseconds / 1000000.0 << " ms, " << rows << " rows): " << sql << "\n"
+              << plan << std::flush;
+  }
+
+  std::string QueryProfiler::explain(const std::string &sql)
+  {
+    std::lock_guard<std::mutex> lock(planMutex);
+    if (!planDb && sqlite3_open_v2(dbPath.c_str(), &planDb, SQLITE_OPEN_READONLY | SQLITE_OPEN_NOMUTEX, nullptr) != SQLITE_OK)
+    {
+      sqlite3_close(planDb);
+      planDb = nullptr;
+      return "  (no query plan: can't open " + dbPath + ")\n";
+    }
+
+    sqlite3_stmt *stmt = nullptr;
+    std::string explainSql = "EXPLAIN QUERY PLAN " + sql;
+    if (sqlite3_prepare_v2(planDb, explainSql.c_str(), -1, &stmt, nullptr) != SQLITE_OK)
+    {
+      std::string reason = sqlite3_errmsg(planDb);
+      sqlite3_finalize(stmt);
+      return "  (no query plan: " + reason + ")\n";
+    }
+
+    // rows are (id, parent, notused, detail); indent each step under its parent
+    std::unordered_map<int, int> depth;
+    std::string plan;
+    while (sqlite3_step(stmt) == SQLITE_ROW)
+    {
+      int id = sqlite3_column_int(stmt, 0);
+      int parent = sqlite3_column_int(stmt, 1);
+      auto parentDepth = depth.find(parent);
+      int level = parentDepth == depth.end() ? 1 : parentDepth->second + 1;
+      depth[id] = level;
+      const unsigned char *detail = sqlite3_column_text(stmt, 3);
+      plan += std::string(static_cast<size_t>(level) * 2, ' ') + (detail ? reinterpret_cast<const char *>(detail) : "") + "\n";
+    }
+    sqlite3_finalize(stmt);
+    return plan;
+  }
+
+  std::vector<QueryProfiler::QueryStats> QueryProfiler::snapshot() const
+  {
+    std::vector<QueryStats> result;
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      result.reserve(queries.size());
+      for (const auto &[sql, stats] : queries)
+        result.push_back(stats);
+    }
+    std::sort(result.begin(), result.end(), [](const QueryStats &a, const QueryStats &b)
+              { return a.totalNanoseconds > b.totalNanoseconds; });
+    return result;
+  }
+
+  void QueryProfiler::reset()
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    queries.clear();
+  }
+
+  std::string QueryProfiler::normalise(std::string_view sql)
+  {
+    std::string out;
+    out.reserve(sql.size());
+    bool pendingSpace = false;
+
+    for (size_t i = 0; i < sql.size(); ++i)
+    {
+      char c = sql[i];
+      if (std::isspace(static_cast<unsigned char>(c)))
+      {
+        pendingSpace = true;
+        continue;
+      }
+      if (pendingSpace && !out.empty())
+        out += ' ';
+      pendingSpace = false;
+
+      bool afterIdentifier = !out.empty() && (std::isalnum(static_cast<unsigned char>(out.back())) || out.back() == '_');
+      if (c == '\'')
+      {
+        // string literal, with '' as an escaped quote
+        for (++i; i < sql.size(); ++i)
+        {
+          if (sql[i] == '\'' && (i + 1 >= sql.size() || sql[i + 1] != '\''))
+            break;
+          if (sql[i] == '\'')
+            ++i;
+        }
+        out += '?';
+      }
+      else if (std::isdigit(static_cast<unsigned char>(c)) && !afterIdentifier)
+      {
+        while (i + 1 < sql.size() && (std::isalnum(static_cast<unsigned char>(sql[i + 1])) || sql[i + 1] == '.'))
+          ++i;
+        out += '?';
+      }
+      else
+        out += c;
+    }
+
+    // IN (?, ?, ?) lists of any length become IN (?...)
+    for (size_t at = out.find("IN ("); at != std::string::npos; at = out.find("IN (", at + 4))
+    {
+      size_t close = out.find(')', at);
+      if (close == std::string::npos)
+        break;
+      std::string_view list(out.data() + at + 4, close - at - 4);
+      if (!list.empty() && list.find_first_not_of("?, ") == std::string_view::npos)
+        out.replace(at + 4, close - at - 4, "?...");
+    }
+
+    if (!out.empty() && out.back() == ';')
+      out.pop_back();
+    return out;
+  }
+}
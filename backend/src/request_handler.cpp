@@ -2,23 +2,159 @@
 #include "multipart_parser.hpp"
 #include "file_storage.hpp"
 #include "database.hpp"
+#include "database_writer.hpp"
+#include "connection_pool.hpp"
+#include "upload_session.hpp"
+#include "io_thread_pool.hpp"
+#include "blob_cache.hpp"
+#include "admission_control.hpp"
+#include "metrics.hpp"
+#include "tracing.hpp"
+#include "json_escape.hpp"
+#include "compression.hpp"
+#include "inflating_file_body.hpp"
+#include "zip_archive_body.hpp"
+#include <boost/beast/core/string.hpp>
 #include <boost/beast/http.hpp>
+#include <filesystem>
 #include <string>
+#include <unordered_set>
+#include <unordered_map>
+#include <utility>
+#include <vector>
 #include <iostream>
 #include <sstream>
 #include <iomanip>
 #include <ctime>
+#include <cstdio>
+#include <limits>
 
 namespace bytebucket
 {
   const std::string SERVER_NAME{"ByteBucket-Server"};
 
+  std::shared_ptr<DatabaseWriter> database_writer;
+  std::shared_ptr<ConnectionPool> connection_pool;
+  std::shared_ptr<IoThreadPool> io_thread_pool;
+  std::shared_ptr<BlobCache> blob_cache;
+  std::shared_ptr<AdmissionControl> admission_control;
+  UploadSessions upload_sessions;
+
+  void setDatabaseWriter(std::shared_ptr<DatabaseWriter> writer)
+  {
+    database_writer = std::move(writer);
+  }
+
+  void setConnectionPool(std::shared_ptr<ConnectionPool> pool)
+  {
+    connection_pool = std::move(pool);
+  }
+
+  void setIoThreadPool(std::shared_ptr<IoThreadPool> pool)
+  {
+    io_thread_pool = std::move(pool);
+  }
+
+  void setBlobCache(std::shared_ptr<BlobCache> cache)
+  {
+    blob_cache = std::move(cache);
+  }
+
+  void setAdmissionControl(std::shared_ptr<AdmissionControl> admission)
+  {
+    admission_control = std::move(admission);
+  }
+
+  // Stored bytes of a blob, from the cache when it's there; blobs small enough
+  // to cache are added after being read from disk
+  std::optional<BlobCache::Blob> read_blob(const FileRecord &file_record)
+  {
+    if (blob_cache)
+    {
+      if (auto cached = blob_cache->get(file_record.storageId))
+        return cached;
+    }
+
+    std::optional<std::vector<char>> file_content;
+    {
+      StorageTimer timer(StorageOp::Read);
+      file_content = FileStorage::readFile(file_record.storageId);
+    }
+    if (!file_content.has_value())
+      return std::nullopt;
+
+    auto blob = std::make_shared<const std::vector<char>>(std::move(file_content.value()));
+    if (blob_cache)
+      blob_cache->put(file_record.storageId, blob);
+    return blob;
+  }
+
+  // Deletes a blob from storage and drops any cached copy. The file goes first:
+  // dropping the cache entry first would let a download that misses it read the
+  // file back in and re-cache a blob that's about to be deleted.
+  bool delete_blob(const std::string &storage_id)
+  {
+    bool deleted;
+    {
+      StorageTimer timer(StorageOp::Delete);
+      deleted = FileStorage::deleteFile(storage_id);
+    }
+    if (blob_cache)
+      blob_cache->erase(storage_id);
+    return deleted;
+  }
+
+  // Leases a pooled read connection when a pool is configured. Every query made
+  // through the lease sees one snapshot, so a listing can't mix before and after
+  // states of a concurrent write. Falls back to a fresh connection otherwise.
+  std::shared_ptr<Database> read_database()
+  {
+    TraceSpan span("read_database", "db");
+    if (connection_pool)
+      return connection_pool->acquire();
+    return Database::create();
+  }
+
+  // Runs a mutation on the shared writer thread when one is configured so that
+  // writes are serialised and group-committed; otherwise on a fresh read-write
+  // connection. Pooled connections are read-only, so a write never borrows one.
+  template <typename F>
+  auto write_database(F &&mutation) -> std::invoke_result_t<F &, Database &>
+  {
+    TraceSpan span("write_database", "db");
+    if (database_writer)
+      return database_writer->submit(std::forward<F>(mutation)).get();
+
+    auto db = Database::create();
+    if (!db)
+    {
+      std::invoke_result_t<F &, Database &> result;
+      result.error = DatabaseError::UnknownError;
+      result.errorMessage = "Database connection failed";
+      return result;
+    }
+    return mutation(*db);
+  }
+
+  // Runs blocking file I/O on the I/O pool when one is configured; otherwise
+  // runs it inline and hands back an already-ready future
+  template <typename F>
+  auto run_io(F &&task) -> std::future<std::invoke_result_t<std::decay_t<F> &>>
+  {
+    if (io_thread_pool)
+      return io_thread_pool->submit(std::forward<F>(task));
+
+    std::promise<std::invoke_result_t<std::decay_t<F> &>> done;
+    done.set_value(task());
+    return done.get_future();
+  }
+
   template <typename T>
   void addCorsHeaders(boost::beast::http::response<T> &res)
   {
     // TODO: specific frontend access control urls
     res.set(boost::beast::http::field::access_control_allow_origin, "*");
-    res.set(boost::beast::http::field::access_control_allow_methods, "GET, POST, DELETE, OPTIONS");
+    res.set(boost::beast::http::field::access_control_allow_methods, "GET, POST, PUT, DELETE, OPTIONS");
     res.set(boost::beast::http::field::access_control_allow_headers, "Content-Type");
   }
 
@@ -46,6 +182,59 @@ namespace bytebucket
     return res;
   }
 
+  boost::beast::http::response<boost::beast::http::string_body>
+  create_overloaded_response(unsigned version, std::chrono::seconds retry_after)
+  {
+    auto res = create_error_response(boost::beast::http::status::service_unavailable, version,
+                                     "Server is overloaded, retry later");
+    res.set(boost::beast::http::field::retry_after, std::to_string(retry_after.count()));
+    return res;
+  }
+
+  // Per-route gzip settings. Listings are repetitive JSON and worth a higher level;
+  // downloads can be large, so they take the fast end.
+  const CompressionPolicy LISTING_COMPRESSION{true, 6, 1024};
+  const CompressionPolicy DEFAULT_COMPRESSION{true, 4, 1024};
+  const CompressionPolicy DOWNLOAD_COMPRESSION{true, 1, 4096};
+  // deflate for text-like entries in folder archives; smaller entries are stored
+  const CompressionPolicy ARCHIVE_COMPRESSION{true, 1, 4096};
+
+  // Gzips the body in place when the policy, content type and client's
+  // Accept-Encoding all allow it and the result is actually smaller
+  template <typename Body>
+  void compress_response(const boost::beast::http::request<boost::beast::http::string_body> &req,
+                         boost::beast::http::response<Body> &res, const CompressionPolicy &policy)
+  {
+    if (!policy.enabled || res.find(boost::beast::http::field::content_encoding) != res.end())
+      return;
+    TraceSpan span("compress_response", "serialize");
+    if (!isCompressibleType(std::string(res[boost::beast::http::field::content_type])))
+      return;
+
+    // caches must key on the encoding even when this response goes out uncompressed
+    res.set(boost::beast::http::field::vary, "Accept-Encoding");
+    if (res.body().size() < policy.minSize ||
+        !acceptsEncoding(std::string(req[boost::beast::http::field::accept_encoding]), "gzip"))
+      return;
+
+    auto compressed = GzipCompressor::compress(std::string_view(res.body().data(), res.body().size()), policy.level);
+    if (!compressed.has_value() || compressed->size() >= res.body().size())
+      return;
+
+    res.body().assign(compressed->begin(), compressed->end());
+    res.set(boost::beast::http::field::content_encoding, "gzip");
+    res.prepare_payload();
+  }
+
+  boost::beast::http::message_generator
+  compressed(const boost::beast::http::request<boost::beast::http::string_body> &req,
+             boost::beast::http::response<boost::beast::http::string_body> &&res,
+             const CompressionPolicy &policy = DEFAULT_COMPRESSION)
+  {
+    compress_response(req, res, policy);
+    return std::move(res);
+  }
+
   boost::beast::http::response<boost::beast::http::string_body>
   handle_options(unsigned version)
   {
@@ -68,8 +257,10 @@ namespace bytebucket
     return create_success_response(boost::beast::http::status::ok, version, "text/plain", "ByteBucket");
   }
 
+  // A null db skips the tag and metadata lookups, for files known to have neither
   void buildFileJson(std::ostringstream &json_stream, const FileRecord &file, std::shared_ptr<Database> db)
   {
+    TraceSpan span("buildFileJson", "serialize");
     auto created_time_t = std::chrono::system_clock::to_time_t(file.createdAt);
     auto updated_time_t = std::chrono::system_clock::to_time_t(file.updatedAt);
 
@@ -86,6 +277,12 @@ namespace bytebucket
                 << R"(,"updated_at":")" << updated_ss.str() << R"(")"
                 << R"(,"storage_id":")" << file.storageId << R"(")";
 
+    if (!db)
+    {
+      json_stream << R"(,"tags":[],"metadata":{}})";
+      return;
+    }
+
     auto tags_result = db->getFileTags(file.id);
     json_stream << R"(,"tags":[)";
     if (tags_result.success() && tags_result.value.has_value())
@@ -119,7 +316,7 @@ namespace bytebucket
 
   boost::beast::http::response<boost::beast::http::string_body> handle_get_folder(const boost::beast::http::request<boost::beast::http::string_body> &req)
   {
-    auto db = Database::create();
+    auto db = read_database();
     if (!db)
       return create_error_response(boost::beast::http::status::internal_server_error, req.version(),
                                    "Failed to initialize database");
@@ -189,6 +386,7 @@ namespace bytebucket
                                    "Failed to retrieve files");
     }
 
+    TraceSpan span("folder_json", "serialize");
     std::ostringstream json_response;
     json_response << "{";
 
@@ -249,7 +447,7 @@ namespace bytebucket
   boost::beast::http::response<boost::beast::http::string_body>
   handle_get_tags(const boost::beast::http::request<boost::beast::http::string_body> &req)
   {
-    auto db = Database::create();
+    auto db = read_database();
     if (!db)
       return create_error_response(boost::beast::http::status::internal_server_error, req.version(),
                                    "Failed to initialize database");
@@ -312,12 +510,8 @@ namespace bytebucket
       return create_error_response(boost::beast::http::status::bad_request, req.version(),
                                    "Tag name cannot be empty");
 
-    auto db = Database::create();
-    if (!db)
-      return create_error_response(boost::beast::http::status::internal_server_error, req.version(),
-                                   "Database connection failed");
-
-    DatabaseResult<int> dbResult = db->insertTag(tag_name);
+    DatabaseResult<int> dbResult = write_database([&](Database &write_db)
+                                                  { return write_db.insertTag(tag_name); });
     if (!dbResult.success())
     {
       if (dbResult.errorMessage.find("already exists") != std::string::npos)
@@ -379,62 +573,70 @@ namespace bytebucket
 
     // Parse JSON to extract tag name
     // Expected format: {"tagName": "tag_name"}
-    std::optional<int> tag_id;
-
     size_t tag_name_pos = body.find("\"tagName\"");
+    if (tag_name_pos == std::string::npos)
+      return create_error_response(boost::beast::http::status::bad_request, req.version(),
+                                   "Either 'tagName' field is required");
 
-    auto db = Database::create();
+    size_t colon_pos = body.find(":", tag_name_pos);
+    size_t quote_start = body.find("\"", colon_pos + 1);
+    size_t quote_end = body.find("\"", quote_start + 1);
+
+    if (quote_start == std::string::npos || quote_end == std::string::npos)
+      return create_error_response(boost::beast::http::status::bad_request, req.version(),
+                                   "Invalid JSON format for 'tagName' field");
+
+    std::string tag_name = body.substr(quote_start + 1, quote_end - quote_start - 1);
+    if (tag_name.empty())
+      return create_error_response(boost::beast::http::status::bad_request, req.version(),
+                                   "Tag name cannot be empty");
+
+    auto db = read_database();
     if (!db)
       return create_error_response(boost::beast::http::status::internal_server_error, req.version(),
                                    "Database connection failed");
 
-    if (tag_name_pos != std::string::npos)
-    {
-      // Extract tag name and get/create tag ID
-      size_t colon_pos = body.find(":", tag_name_pos);
-      size_t quote_start = body.find("\"", colon_pos + 1);
-      size_t quote_end = body.find("\"", quote_start + 1);
-
-      if (quote_start == std::string::npos || quote_end == std::string::npos)
-        return create_error_response(boost::beast::http::status::bad_request, req.version(),
-                                     "Invalid JSON format for 'tagName' field");
-
-      std::string tag_name = body.substr(quote_start + 1, quote_end - quote_start - 1);
-      if (tag_name.empty())
-        return create_error_response(boost::beast::http::status::bad_request, req.version(),
-                                     "Tag name cannot be empty");
+    auto file_result = db->getFileById(file_id);
+    if (!file_result.success() || !file_result.value.has_value())
+      return create_error_response(boost::beast::http::status::not_found, req.version(),
+                                   "File not found");
 
-      // Try to get existing tag by name
-      auto existing_tag = db->getTagByName(tag_name);
+    // look up or create the tag and attach it in the same write
+    auto add_result = write_database([&](Database &write_db) -> DatabaseResult<bool>
+                                     {
+      auto existing_tag = write_db.getTagByName(tag_name);
+      int tag_id;
       if (existing_tag.success() && existing_tag.value.has_value())
       {
         tag_id = existing_tag.value.value();
       }
       else
       {
-        // Create new tag if it doesn't exist
-        auto new_tag = db->insertTag(tag_name);
+        auto new_tag = write_db.insertTag(tag_name);
         if (!new_tag.success())
-          return create_error_response(boost::beast::http::status::internal_server_error, req.version(),
-                                       "Failed to create tag: " + new_tag.errorMessage);
+        {
+          DatabaseResult<bool> failed;
+          failed.error = new_tag.error;
+          failed.errorMessage = "Failed to create tag: " + new_tag.errorMessage;
+          return failed;
+        }
         tag_id = new_tag.value.value();
       }
-    }
-    else
-    {
-      return create_error_response(boost::beast::http::status::bad_request, req.version(),
-                                   "Either 'tagName' field is required");
-    }
 
-    auto file_result = db->getFileById(file_id);
-    if (!file_result.success() || !file_result.value.has_value())
-      return create_error_response(boost::beast::http::status::not_found, req.version(),
-                                   "File not found");
-
-    auto add_result = db->addFileTag(file_id, tag_id.value());
+      auto added = write_db.addFileTag(file_id, tag_id);
+      if (!added.success())
+        added.errorMessage = "Failed to add tag to file: " + added.errorMessage;
+      return added; });
     if (!add_result.success())
       return create_error_response(boost::beast::http::status::internal_server_error, req.version(),
-                                   "Failed to add tag to file: " + add_result.errorMessage);
+                                   add_result.errorMessage);
+
+    // the lease above predates the write; take a new snapshot that includes it
+    db.reset();
+    db = read_database();
+    if (!db)
+      return create_error_response(boost::beast::http::status::internal_server_error, req.version(),
+                                   "Database connection failed");
 
     std::ostringstream json_response;
     buildFileJson(json_response, file_result.value.value(), db);
@@ -484,7 +686,7 @@ namespace bytebucket
       return create_error_response(boost::beast::http::status::bad_request, req.version(),
                                    "Request body is required");
 
-    auto db = Database::create();
+    auto db = read_database();
     if (!db)
       return create_error_response(boost::beast::http::status::internal_server_error, req.version(),
                                    "Database connection failed");
@@ -495,8 +697,8 @@ namespace bytebucket
                                    "File not found");
 
     // Expected format: {"key1": "value1", "key2": "value2", ...}
+    std::vector<std::pair<std::string, std::string>> entries;
     size_t pos = 0;
-    bool any_metadata_added = false;
 
     while (pos < body.length())
     {
@@ -523,26 +725,43 @@ namespace bytebucket
         break;
 
       std::string value = body.substr(value_start + 1, value_end - value_start - 1);
+      pos = value_end + 1;
 
       if (key.empty())
-      {
-        pos = value_end + 1;
         continue;
-      }
 
-      auto set_result = db->setFileMetadata(file_id, key, value);
+      entries.emplace_back(std::move(key), std::move(value));
+    }
+
+    bool any_metadata_added = !entries.empty();
+    if (any_metadata_added)
+    {
+      // all keys from one request land in the same write, so they apply together or not at all
+      auto set_result = write_database([&](Database &write_db)
+                                       {
+        DatabaseResult<bool> set;
+        for (const auto &[key, value] : entries)
+        {
+          set = write_db.setFileMetadata(file_id, key, value);
+          if (!set.success())
+            break;
+        }
+        return set; });
       if (!set_result.success())
         return create_error_response(boost::beast::http::status::internal_server_error, req.version(),
                                      "Failed to set metadata: " + set_result.errorMessage);
-
-      any_metadata_added = true;
-      pos = value_end + 1;
     }
 
     if (!any_metadata_added)
       return create_error_response(boost::beast::http::status::bad_request, req.version(),
                                    "No valid metadata key-value pairs found in request");
 
+    db.reset();
+    db = read_database();
+    if (!db)
+      return create_error_response(boost::beast::http::status::internal_server_error, req.version(),
+                                   "Database connection failed");
+
     std::ostringstream json_response;
     buildFileJson(json_response, file_result.value.value(), db);
 
@@ -550,6 +769,369 @@ namespace bytebucket
                                    "application/json", json_response.str());
   }
 
+  std::string url_decode(std::string_view value)
+  {
+    std::string decoded;
+    decoded.reserve(value.size());
+    for (size_t i = 0; i < value.size(); ++i)
+    {
+      if (value[i] == '+')
+      {
+        decoded += ' ';
+      }
+      else if (value[i] == '%' && i + 2 < value.size() && std::isxdigit(static_cast<unsigned char>(value[i + 1])) &&
+               std::isxdigit(static_cast<unsigned char>(value[i + 2])))
+      {
+        decoded += static_cast<char>(std::stoi(std::string(value.substr(i + 1, 2)), nullptr, 16));
+        i += 2;
+      }
+      else
+      {
+        decoded += value[i];
+      }
+    }
+    return decoded;
+  }
+
+  std::vector<std::pair<std::string, std::string>> parse_query_string(std::string_view target)
+  {
+    std::vector<std::pair<std::string, std::string>> params;
+    size_t query_start = target.find('?');
+    if (query_start == std::string_view::npos)
+      return params;
+
+    std::string_view query = target.substr(query_start + 1);
+    while (!query.empty())
+    {
+      size_t amp_pos = query.find('&');
+      std::string_view pair = query.substr(0, amp_pos);
+      query = amp_pos == std::string_view::npos ? std::string_view{} : query.substr(amp_pos + 1);
+      if (pair.empty())
+        continue;
+
+      size_t eq_pos = pair.find('=');
+      if (eq_pos == std::string_view::npos)
+        params.emplace_back(url_decode(pair), "");
+      else
+        params.emplace_back(url_decode(pair.substr(0, eq_pos)), url_decode(pair.substr(eq_pos + 1)));
+    }
+    return params;
+  }
+
+  boost::beast::http::response<boost::beast::http::string_body>
+  handle_get_metadata_search(const boost::beast::http::request<boost::beast::http::string_body> &req)
+  {
+    // Expected format: /search/metadata?camera=Canon&iso.gt=800&sort=size&order=desc&limit=50
+    // Every parameter that isn't sort/order/limit/offset is a metadata predicate "key[.op]=value"
+    static const std::vector<std::pair<std::string, MetadataOp>> operators = {
+        {".eq", MetadataOp::Equals},
+        {".ne", MetadataOp::NotEquals},
+        {".lt", MetadataOp::LessThan},
+        {".lte", MetadataOp::LessOrEqual},
+        {".gt", MetadataOp::GreaterThan},
+        {".gte", MetadataOp::GreaterOrEqual},
+        {".exists", MetadataOp::Exists}};
+
+    FileQuery query;
+    for (const auto &[name, value] : parse_query_string(std::string(req.target())))
+    {
+      try
+      {
+        if (name == "limit")
+        {
+          query.limit = std::stoi(value);
+          if (query.limit <= 0 || query.limit > 1000)
+            return create_error_response(boost::beast::http::status::bad_request, req.version(),
+                                         "limit must be between 1 and 1000");
+          continue;
+        }
+        if (name == "offset")
+        {
+          query.offset = std::stoi(value);
+          if (query.offset < 0)
+            return create_error_response(boost::beast::http::status::bad_request, req.version(),
+                                         "offset cannot be negative");
+          continue;
+        }
+      }
+      catch (...)
+      {
+        return create_error_response(boost::beast::http::status::bad_request, req.version(),
+                                     "Invalid " + name + " value");
+      }
+
+      if (name == "order")
+      {
+        if (value != "asc" && value != "desc")
+          return create_error_response(boost::beast::http::status::bad_request, req.version(),
+                                       "order must be asc or desc");
+        query.descending = value == "desc";
+        continue;
+      }
+
+      if (name == "sort")
+      {
+        if (value == "name")
+          query.sortBy = FileSortField::Name;
+        else if (value == "size")
+          query.sortBy = FileSortField::Size;
+        else if (value == "created_at")
+          query.sortBy = FileSortField::CreatedAt;
+        else if (value == "updated_at")
+          query.sortBy = FileSortField::UpdatedAt;
+        else if (value.length() > 5 && value.substr(0, 5) == "meta.")
+        {
+          query.sortBy = FileSortField::Metadata;
+          query.sortKey = value.substr(5);
+        }
+        else
+          return create_error_response(boost::beast::http::status::bad_request, req.version(),
+                                       "sort must be name, size, created_at, updated_at or meta.{key}");
+        continue;
+      }
+
+      MetadataPredicate predicate{name, MetadataOp::Equals, value};
+      for (const auto &[suffix, op] : operators)
+      {
+        if (name.length() > suffix.length() && name.compare(name.length() - suffix.length(), suffix.length(), suffix) == 0)
+        {
+          predicate.key = name.substr(0, name.length() - suffix.length());
+          predicate.op = op;
+          break;
+        }
+      }
+      query.predicates.push_back(std::move(predicate));
+    }
+
+    if (query.predicates.empty())
+      return create_error_response(boost::beast::http::status::bad_request, req.version(),
+                                   "At least one metadata filter is required");
+
+    auto db = read_database();
+    if (!db)
+      return create_error_response(boost::beast::http::status::internal_server_error, req.version(),
+                                   "Database connection failed");
+
+    auto files_result = db->findFilesByMetadata(query);
+    if (!files_result.success())
+      return create_error_response(boost::beast::http::status::bad_request, req.version(),
+                                   files_result.errorMessage);
+
+    std::ostringstream json_response;
+    json_response << R"({"files":[)";
+    for (size_t i = 0; i < files_result.value->size(); ++i)
+    {
+      if (i > 0)
+        json_response << ",";
+      buildFileJson(json_response, (*files_result.value)[i], db);
+    }
+    json_response << "]}";
+
+    return create_success_response(boost::beast::http::status::ok, req.version(),
+                                   "application/json", json_response.str());
+  }
+
+  boost::beast::http::response<boost::beast::http::string_body>
+  handle_get_database_stats(const boost::beast::http::request<boost::beast::http::string_body> &req)
+  {
+    auto db = read_database();
+    if (!db)
+      return create_error_response(boost::beast::http::status::internal_server_error, req.version(),
+                                   "Database connection failed");
+
+    auto status_result = db->getTuningStatus();
+    if (!status_result.success())
+      return create_error_response(boost::beast::http::status::internal_server_error, req.version(),
+                                   "Failed to read database status: " + status_result.errorMessage);
+
+    const auto &status = status_result.value.value();
+    std::ostringstream json_response;
+    json_response << R"({"sqlite":{)"
+                  << R"("mmap_size":)" << status.applied.mmapSize << ","
+                  << R"("cache_size":)" << status.applied.cacheSize << ","
+                  << R"("temp_store":)" << static_cast<int>(status.applied.tempStore) << ","
+                  << R"("busy_timeout_ms":)" << status.applied.busyTimeoutMs << ","
+                  << R"("page_size":)" << status.pageSize << ","
+                  << R"("page_count":)" << status.pageCount << ","
+                  << R"("cache_used_bytes":)" << status.cacheUsedBytes << "}";
+
+    // with a pool, the counters cover every finished lease rather than this one connection
+    CacheCounters cache = status.cache;
+    if (connection_pool)
+    {
+      auto pool_stats = connection_pool->stats();
+      cache.hits += pool_stats.cache.hits;
+      cache.misses += pool_stats.cache.misses;
+      json_response << R"(,"pool":{)"
+                    << R"("size":)" << pool_stats.size << ","
+                    << R"("idle":)" << pool_stats.idle << ","
+                    << R"("acquisitions":)" << pool_stats.acquisitions << ","
+                    << R"("waits":)" << pool_stats.waits << ","
+                    << R"("wait_us":)" << pool_stats.waitMicroseconds << "}";
+    }
+    json_response << R"(,"cache":{"hits":)" << cache.hits << R"(,"misses":)" << cache.misses << "}}";
+
+    return create_success_response(boost::beast::http::status::ok, req.version(),
+                                   "application/json", json_response.str());
+  }
+
+  boost::beast::http::response<boost::beast::http::string_body>
+  handle_get_cache_stats(const boost::beast::http::request<boost::beast::http::string_body> &req)
+  {
+    if (!blob_cache)
+      return create_success_response(boost::beast::http::status::ok, req.version(),
+                                     "application/json", R"({"blob_cache":{"enabled":false}})");
+
+    auto stats = blob_cache->stats();
+    uint64_t lookups = stats.hits + stats.misses;
+    std::ostringstream json_response;
+    json_response << R"({"blob_cache":{"enabled":true,)"
+                  << R"("capacity_bytes":)" << stats.capacityBytes << ","
+                  << R"("max_entry_bytes":)" << blob_cache->maxEntrySize() << ","
+                  << R"("bytes":)" << stats.bytes << ","
+                  << R"("entries":)" << stats.entries << ","
+                  << R"("hits":)" << stats.hits << ","
+                  << R"("misses":)" << stats.misses << ","
+                  << R"("hit_ratio":)" << (lookups ? static_cast<double>(stats.hits) / lookups : 0.0) << ","
+                  << R"("insertions":)" << stats.insertions << ","
+                  << R"("evictions":)" << stats.evictions << ","
+                  << R"("invalidations":)" << stats.invalidations << "}}";
+
+    return create_success_response(boost::beast::http::status::ok, req.version(),
+                                   "application/json", json_response.str());
+  }
+
+  boost::beast::http::response<boost::beast::http::string_body>
+  handle_get_metrics(const boost::beast::http::request<boost::beast::http::string_body> &req)
+  {
+    std::ostringstream metrics;
+    metrics << Metrics::renderPrometheus();
+
+    if (connection_pool)
+    {
+      auto pool_stats = connection_pool->stats();
+      metrics << "# HELP bytebucket_db_pool_connections Read connections in the pool.\n"
+              << "# TYPE bytebucket_db_pool_connections gauge\n"
+              << "bytebucket_db_pool_connections " << pool_stats.size << "\n"
+              << "# HELP bytebucket_db_pool_idle_connections Read connections not currently leased.\n"
+              << "# TYPE bytebucket_db_pool_idle_connections gauge\n"
+              << "bytebucket_db_pool_idle_connections " << pool_stats.idle << "\n"
+              << "# HELP bytebucket_db_pool_acquisitions_total Read connection leases.\n"
+              << "# TYPE bytebucket_db_pool_acquisitions_total counter\n"
+              << "bytebucket_db_pool_acquisitions_total " << pool_stats.acquisitions << "\n"
+              << "# HELP bytebucket_db_pool_waits_total Leases that had to wait for a connection.\n"
+              << "# TYPE bytebucket_db_pool_waits_total counter\n"
+              << "bytebucket_db_pool_waits_total " << pool_stats.waits << "\n"
+              << "# HELP bytebucket_db_pool_wait_seconds_total Time spent waiting for a read connection.\n"
+              << "# TYPE bytebucket_db_pool_wait_seconds_total counter\n"
+              << "bytebucket_db_pool_wait_seconds_total " << pool_stats.waitMicroseconds / 1e6 << "\n";
+    }
+
+    if (blob_cache)
+    {
+      auto cache_stats = blob_cache->stats();
+      metrics << "# HELP bytebucket_blob_cache_hits_total Downloads served from the blob cache.\n"
+              << "# TYPE bytebucket_blob_cache_hits_total counter\n"
+              << "bytebucket_blob_cache_hits_total " << cache_stats.hits << "\n"
+              << "# HELP bytebucket_blob_cache_misses_total Downloads read from disk.\n"
+              << "# TYPE bytebucket_blob_cache_misses_total counter\n"
+              << "bytebucket_blob_cache_misses_total " << cache_stats.misses << "\n"
+              << "# HELP bytebucket_blob_cache_evictions_total Blobs evicted to stay within budget.\n"
+              << "# TYPE bytebucket_blob_cache_evictions_total counter\n"
+              << "bytebucket_blob_cache_evictions_total " << cache_stats.evictions << "\n"
+              << "# HELP bytebucket_blob_cache_bytes Bytes held by the blob cache.\n"
+              << "# TYPE bytebucket_blob_cache_bytes gauge\n"
+              << "bytebucket_blob_cache_bytes " << cache_stats.bytes << "\n";
+    }
+
+    if (admission_control)
+    {
+      auto admission = admission_control->stats();
+      std::vector<std::pair<const char *, AdmissionControl::GateStats>> gates{{"connections", admission.connections}};
+      for (size_t route_class = 0; route_class < admission.requests.size(); ++route_class)
+        gates.emplace_back(AdmissionControl::routeClassName(static_cast<RouteClass>(route_class)), admission.requests[route_class]);
+
+      auto family = [&metrics, &gates](const char *name, const char *type, const char *help,
+                                       uint64_t AdmissionControl::GateStats::*field)
+      {
+        metrics << "# HELP " << name << " " << help << "\n"
+                << "# TYPE " << name << " " << type << "\n";
+        for (const auto &[gate, stats] : gates)
+          metrics << name << "{class=\"" << gate << "\"} " << stats.*field << "\n";
+      };
+      family("bytebucket_admission_limit", "gauge", "Concurrent connections or in-flight requests allowed, 0 for no limit.",
+             &AdmissionControl::GateStats::limit);
+      family("bytebucket_admission_in_flight", "gauge", "Connections open or requests being served.",
+             &AdmissionControl::GateStats::inFlight);
+      family("bytebucket_admission_queue_depth", "gauge", "Requests waiting for a slot.",
+             &AdmissionControl::GateStats::queued);
+      family("bytebucket_admission_queued_total", "counter", "Requests admitted after waiting for a slot.",
+             &AdmissionControl::GateStats::waited);
+      family("bytebucket_admission_rejected_total", "counter", "Connections or requests shed with a 503.",
+             &AdmissionControl::GateStats::rejected);
+    }
+
+    return create_success_response(boost::beast::http::status::ok, req.version(),
+                                   "text/plain; version=0.0.4", metrics.str());
+  }
+
+  boost::beast::http::response<boost::beast::http::string_body>
+  handle_get_query_profile(const boost::beast::http::request<boost::beast::http::string_body> &req)
+  {
+    auto profiler = Database::getQueryProfiler();
+    if (!profiler)
+      return create_success_response(boost::beast::http::status::ok, req.version(),
+                                     "application/json", R"({"enabled":false,"queries":[]})");
+
+    std::ostringstream json_response;
+    json_response << R"({"enabled":true,"slow_threshold_ms":)" << profiler->slowThreshold().count()
+                  << R"(,"queries":[)";
+    bool first = true;
+    for (const auto &query : profiler->snapshot())
+    {
+      if (!first)
+        json_response << ",";
+      first = false;
+      json_response << R"({"sql":)" << jsonString(query.sql)
+                    << R"(,"calls":)" << query.calls
+                    << R"(,"rows":)" << query.rows
+                    << R"(,"total_ms":)" << query.totalNanoseconds / 1e6
+                    << R"(,"mean_ms":)" << query.totalNanoseconds / 1e6 / static_cast<double>(query.calls)
+                    << R"(,"max_ms":)" << query.maxNanoseconds / 1e6
+                    << R"(,"slow_calls":)" << query.slowCalls;
+      if (!query.plan.empty())
+        json_response << R"(,"plan":)" << jsonString(query.plan);
+      json_response << "}";
+    }
+    json_response << "]}";
+
+    return create_success_response(boost::beast::http::status::ok, req.version(),
+                                   "application/json", json_response.str());
+  }
+
+  // Recent traced requests as Chrome trace-event JSON; ?id= picks one trace
+  boost::beast::http::response<boost::beast::http::string_body>
+  handle_get_traces(const boost::beast::http::request<boost::beast::http::string_body> &req)
+  {
+    std::optional<uint64_t> trace_id;
+    for (const auto &[name, value] : parse_query_string(std::string(req.target())))
+    {
+      if (name != "id")
+        continue;
+      try
+      {
+        trace_id = std::stoull(value);
+      }
+      catch (const std::exception &)
+      {
+        return create_error_response(boost::beast::http::status::bad_request, req.version(), "Invalid trace id");
+      }
+    }
+
+    return create_success_response(boost::beast::http::status::ok, req.version(),
+                                   "application/json", Tracer::renderChromeTrace(trace_id));
+  }
+
   boost::beast::http::response<boost::beast::http::string_body>
   handle_post_folder(const boost::beast::http::request<boost::beast::http::string_body> &req)
   {
@@ -597,11 +1179,8 @@ namespace bytebucket
       }
     }
 
-    auto db = Database::create();
-    if (!db)
-      return create_error_response(boost::beast::http::status::internal_server_error, req.version(),
-                                   "Database connection failed");
-    DatabaseResult<int> dbResult = db->insertFolder(folder_name, parent_id);
+    DatabaseResult<int> dbResult = write_database([&](Database &write_db)
+                                                  { return write_db.insertFolder(folder_name, parent_id); });
     if (!dbResult.success() || !dbResult.value.has_value())
       return create_error_response(boost::beast::http::status::bad_request, req.version(),
                                    dbResult.errorMessage);
@@ -621,25 +1200,45 @@ namespace bytebucket
                                    "application/json", response_json.str());
   }
 
-  boost::beast::http::response<boost::beast::http::string_body>
-  handle_post_upload(const boost::beast::http::request<boost::beast::http::string_body> &req)
+  // Why an upload's Content-Type will be refused, if it will be. Only needs the
+  // headers, so it also runs before the body is read.
+  std::optional<std::string> upload_content_type_error(const boost::beast::http::request<boost::beast::http::string_body> &req)
   {
     auto content_type_it = req.find(boost::beast::http::field::content_type);
     if (content_type_it == req.end())
-      return create_error_response(boost::beast::http::status::bad_request, req.version(),
-                                   "Content-Type header is required");
+      return "Content-Type header is required";
 
     std::string content_type = std::string(content_type_it->value());
     if (content_type.find("multipart/form-data") == std::string::npos)
-      return create_error_response(boost::beast::http::status::bad_request, req.version(),
-                                   "Content-Type should be multipart/form-data");
+      return "Content-Type should be multipart/form-data";
 
-    std::string boundary = MultipartParser::extractBoundary(content_type);
-    if (boundary.empty())
-      return create_error_response(boost::beast::http::status::bad_request, req.version(),
-                                   "Invalid boundary in Content-Type");
+    if (MultipartParser::extractBoundary(content_type).empty())
+      return "Invalid boundary in Content-Type";
+    return std::nullopt;
+  }
 
-    auto multipart_data = MultipartParser::parse(req.body(), boundary);
+  // POST /upload?folder_id=N names the folder in the target, where it can be checked
+  // before the body arrives; the multipart folder_id field is used when it's absent
+  std::optional<std::string> upload_folder_param(std::string_view target)
+  {
+    for (const auto &[name, value] : parse_query_string(target))
+    {
+      if (name == "folder_id")
+        return value;
+    }
+    return std::nullopt;
+  }
+
+  boost::beast::http::response<boost::beast::http::string_body>
+  handle_post_upload(const boost::beast::http::request<boost::beast::http::string_body> &req)
+  {
+    if (auto content_type_error = upload_content_type_error(req))
+      return create_error_response(boost::beast::http::status::bad_request, req.version(), *content_type_error);
+
+    std::string boundary = MultipartParser::extractBoundary(std::string(req[boost::beast::http::field::content_type]));
+
+    // parts are views into req.body(); file bytes are only copied when written to storage
+    auto multipart_data = MultipartParser::parseView(req.body(), boundary);
     if (!multipart_data.has_value())
       return create_error_response(boost::beast::http::status::bad_request, req.version(),
                                    "Failed to parse multipart data");
@@ -648,19 +1247,34 @@ namespace bytebucket
       return create_error_response(boost::beast::http::status::bad_request, req.version(),
                                    "No files found in request");
 
-    auto db = Database::create();
+    auto db = read_database();
     if (!db)
       return create_error_response(boost::beast::http::status::internal_server_error, req.version(),
                                    "Database connection failed");
 
     std::optional<int> folder_id;
+    if (auto folder_param = upload_folder_param(std::string(req.target())))
+    {
+      try
+      {
+        folder_id = std::stoi(folder_param.value());
+      }
+      catch (...)
+      {
+        return create_error_response(boost::beast::http::status::bad_request, req.version(),
+                                     "Invalid folder_id");
+      }
+    }
+
     for (const auto &field : multipart_data->fields)
     {
+      if (folder_id.has_value())
+        break;
       if (field.name == "folder_id")
       {
         try
         {
-          folder_id = std::stoi(field.value);
+          folder_id = std::stoi(std::string(field.value));
         }
         catch (...)
         {
@@ -680,7 +1294,8 @@ namespace bytebucket
       }
       else
       {
-        auto root_folder_result = db->insertFolder("root", std::nullopt);
+        auto root_folder_result = write_database([](Database &write_db)
+                                                 { return write_db.insertFolder("root", std::nullopt); });
         if (root_folder_result.success() && root_folder_result.value.has_value())
         {
           folder_id = root_folder_result.value.value();
@@ -693,51 +1308,411 @@ namespace bytebucket
       }
     }
 
+    // the lease isn't needed again; don't hold its snapshot open across the disk writes
+    db.reset();
+
+    // blob writes run in parallel; every one is awaited before the views they read go away
+    std::vector<std::future<std::optional<StoredBlob>>> pending_saves;
+    pending_saves.reserve(multipart_data->files.size());
+    for (const auto &file : multipart_data->files)
+    {
+      pending_saves.push_back(run_io([&file]()
+                                     {
+                                       StorageTimer timer(StorageOp::Write);
+                                       return FileStorage::saveBlob(std::string(file.filename), file.content, std::string(file.content_type)); }));
+    }
+
+    std::vector<StoredBlob> blobs;
+    blobs.reserve(pending_saves.size());
+    bool save_failed = false;
+    for (auto &pending : pending_saves)
+    {
+      auto blob = pending.get();
+      if (blob.has_value())
+        blobs.push_back(std::move(blob.value()));
+      else
+        save_failed = true;
+    }
+
+    if (save_failed)
+    {
+      for (const auto &blob : blobs)
+        FileStorage::deleteFile(blob.fileId);
+      return create_error_response(boost::beast::http::status::internal_server_error, req.version(),
+                                   "Failed to save file to storage");
+    }
+
+    std::vector<NewFile> new_files;
+    new_files.reserve(multipart_data->files.size());
+    for (size_t i = 0; i < multipart_data->files.size(); ++i)
+    {
+      const auto &file = multipart_data->files[i];
+      new_files.push_back(NewFile{file.filename, folder_id.value(), static_cast<int64_t>(file.content.size()),
+                                  file.content_type, blobs[i].fileId, blobs[i].codec});
+    }
+
+    // every row of the upload goes in as one write, so a failure leaves none behind;
+    // RETURNING hands back the stored rows so nothing needs re-reading
+    auto db_result = write_database([&](Database &write_db)
+                                    { return write_db.addFiles(new_files); });
+
+    if (!db_result.success() || !db_result.value.has_value())
+    {
+      for (const auto &blob : blobs)
+        FileStorage::deleteFile(blob.fileId);
+      return create_error_response(boost::beast::http::status::internal_server_error, req.version(),
+                                   "Failed to save file to database: " + db_result.errorMessage);
+    }
+
     std::ostringstream response_json;
     response_json << R"({"files":[)";
-    bool first_file = true;
+    const auto &records = db_result.value.value();
+    for (size_t i = 0; i < records.size(); ++i)
+    {
+      if (i > 0)
+        response_json << ",";
+      // freshly inserted, so no tags or metadata to look up
+      buildFileJson(response_json, records[i], nullptr);
+    }
 
-    for (const auto &file : multipart_data->files)
+    response_json << "]}";
+
+    return create_success_response(boost::beast::http::status::ok, req.version(),
+                                   "application/json", response_json.str());
+  }
+
+  // Expected target: /uploads/{id}[/complete][?offset=N]; returns the {id} segment
+  std::string upload_id_from_target(std::string_view target)
+  {
+    std::string_view rest = target.substr(9); // Remove "/uploads/" prefix
+    size_t end = rest.find_first_of("/?");
+    return std::string(rest.substr(0, end));
+  }
+
+  boost::beast::http::status upload_error_status(UploadError error)
+  {
+    switch (error)
+    {
+    case UploadError::NotFound:
+      return boost::beast::http::status::not_found;
+    case UploadError::InvalidRange:
+      return boost::beast::http::status::bad_request;
+    case UploadError::Incomplete:
+    case UploadError::Conflict:
+      return boost::beast::http::status::conflict;
+    default:
+      return boost::beast::http::status::internal_server_error;
+    }
+  }
+
+  void buildUploadSessionJson(std::ostringstream &json_stream, const UploadSessionInfo &info)
+  {
+    json_stream << R"({"upload_id":")" << info.id << R"(")"
+                << R"(,"filename":")" << info.filename << R"(")"
+                << R"(,"size":)" << info.size
+                << R"(,"received_bytes":)" << info.receivedBytes
+                << R"(,"ranges":[)";
+    for (size_t i = 0; i < info.ranges.size(); ++i)
+    {
+      if (i > 0)
+        json_stream << ",";
+      json_stream << "[" << info.ranges[i].first << "," << info.ranges[i].second << "]";
+    }
+    json_stream << R"(],"complete":)" << (info.complete() ? "true" : "false") << "}";
+  }
+
+  // Upload sessions are recorded in the database so they survive a restart. The
+  // in-memory session is what requests see; the row is what a restart picks the
+  // upload up from, so it only ever lists ranges that are already on disk.
+  UploadSessionRecord upload_session_record(const UploadSessionInfo &info)
+  {
+    UploadSessionRecord record;
+    record.id = info.id;
+    record.filename = info.filename;
+    record.contentType = info.contentType;
+    record.folderId = info.folderId;
+    record.size = info.size;
+    record.ranges = info.ranges;
+    record.revision = info.revision;
+    return record;
+  }
+
+  void forget_upload_session(const std::string &upload_id)
+  {
+    auto forgotten = write_database([&](Database &write_db)
+                                    { return write_db.deleteUploadSession(upload_id); });
+    // a row left behind is dropped at the next start, once its partial file is gone
+    if (!forgotten.success())
+      std::cerr << "Couldn't remove upload session " << upload_id << ": " << forgotten.errorMessage << std::endl;
+  }
+
+  size_t restore_upload_sessions()
+  {
+    auto db = read_database();
+    if (!db)
+      return 0;
+    auto recorded = db->getUploadSessions();
+    if (!recorded.success())
+    {
+      std::cerr << "Couldn't read upload sessions: " << recorded.errorMessage << std::endl;
+      return 0;
+    }
+
+    std::unordered_set<std::string> restored;
+    for (const auto &record : recorded.value.value())
+    {
+      UploadSessionInfo info;
+      info.id = record.id;
+      info.filename = record.filename;
+      info.contentType = record.contentType;
+      info.folderId = record.folderId;
+      info.size = record.size;
+      info.ranges = record.ranges;
+      info.revision = record.revision;
+      if (upload_sessions.restore(info).success())
+        restored.insert(record.id);
+      else
+        forget_upload_session(record.id);
+    }
+
+    // partial files no session owns are left from uploads that never got recorded
+    size_t orphans = FileStorage::deletePartialFilesExcept(restored);
+    if (!restored.empty() || orphans > 0)
+      std::cout << "Restored " << restored.size() << " upload sessions, removed "
+                << orphans << " orphaned partial files" << std::endl;
+    return restored.size();
+  }
+
+  boost::beast::http::response<boost::beast::http::string_body>
+  handle_post_upload_session(const boost::beast::http::request<boost::beast::http::string_body> &req)
+  {
+    // Expected format: {"filename": "disk.img", "size": 53687091200, "content_type": "...", "folder_id": 2}
+    const std::string &body = req.body();
+
+    auto string_field = [&body](const std::string &name) -> std::optional<std::string>
+    {
+      size_t name_pos = body.find("\"" + name + "\"");
+      if (name_pos == std::string::npos)
+        return std::nullopt;
+      size_t colon_pos = body.find(":", name_pos);
+      size_t quote_start = colon_pos == std::string::npos ? std::string::npos : body.find("\"", colon_pos);
+      size_t quote_end = quote_start == std::string::npos ? std::string::npos : body.find("\"", quote_start + 1);
+      if (quote_end == std::string::npos)
+        return std::nullopt;
+      return body.substr(quote_start + 1, quote_end - quote_start - 1);
+    };
+    auto integer_field = [&body](const std::string &name) -> std::optional<int64_t>
+    {
+      size_t name_pos = body.find("\"" + name + "\"");
+      if (name_pos == std::string::npos)
+        return std::nullopt;
+      size_t colon_pos = body.find(":", name_pos);
+      size_t number_start = colon_pos == std::string::npos ? std::string::npos : body.find_first_not_of(" \t\r\n", colon_pos + 1);
+      if (number_start == std::string::npos)
+        return std::nullopt;
+      // the sign is kept so a negative value is rejected rather than read as positive;
+      // stoll throws on a missing number and on one that doesn't fit
+      size_t digits_start = body[number_start] == '-' ? number_start + 1 : number_start;
+      size_t number_end = body.find_first_not_of("0123456789", digits_start);
+      return std::stoll(body.substr(number_start, number_end - number_start));
+    };
+
+    std::optional<std::string> filename;
+    std::optional<int64_t> size;
+    std::optional<int64_t> folder_id;
+    try
+    {
+      filename = string_field("filename");
+      size = integer_field("size");
+      folder_id = integer_field("folder_id");
+    }
+    catch (...)
     {
-      auto storage_id = FileStorage::saveFile(file.filename, file.content, file.content_type);
-      if (!storage_id.has_value())
+      return create_error_response(boost::beast::http::status::bad_request, req.version(),
+                                   "Invalid number in request body");
+    }
+
+    if (!filename.has_value() || filename->empty())
+      return create_error_response(boost::beast::http::status::bad_request, req.version(),
+                                   "'filename' is required");
+    if (!size.has_value())
+      return create_error_response(boost::beast::http::status::bad_request, req.version(),
+                                   "'size' is required");
+
+    if (size.value() < 0)
+      return create_error_response(boost::beast::http::status::bad_request, req.version(),
+                                   "'size' cannot be negative");
+
+    std::string content_type = string_field("content_type").value_or("application/octet-stream");
+    std::optional<int> folder;
+    if (folder_id.has_value())
+    {
+      if (folder_id.value() < 0 || folder_id.value() > std::numeric_limits<int>::max())
+        return create_error_response(boost::beast::http::status::bad_request, req.version(),
+                                     "Invalid folder_id");
+      folder = static_cast<int>(folder_id.value());
+
+      // refused now rather than after the whole file has been uploaded
+      auto db = read_database();
+      if (!db)
         return create_error_response(boost::beast::http::status::internal_server_error, req.version(),
-                                     "Failed to save file to storage");
+                                     "Database connection failed");
+      if (!db->getFolderById(folder.value()).success())
+        return create_error_response(boost::beast::http::status::not_found, req.version(),
+                                     "Folder not found");
+    }
+
+    auto session = upload_sessions.create(filename.value(), content_type, folder, size.value());
+    if (!session.success())
+      return create_error_response(upload_error_status(session.error), req.version(), session.errorMessage);
+
+    auto recorded = write_database([&](Database &write_db)
+                                   { return write_db.addUploadSession(upload_session_record(session.value.value())); });
+    if (!recorded.success())
+    {
+      upload_sessions.abort(session.value->id);
+      return create_error_response(boost::beast::http::status::internal_server_error, req.version(),
+                                   "Failed to record upload session: " + recorded.errorMessage);
+    }
 
-      auto db_result = db->addFile(
-          file.filename,
-          folder_id.value(),
-          static_cast<int>(file.content.size()),
-          file.content_type,
-          storage_id.value());
+    std::ostringstream json_response;
+    buildUploadSessionJson(json_response, session.value.value());
+    return create_success_response(boost::beast::http::status::created, req.version(),
+                                   "application/json", json_response.str());
+  }
+
+  boost::beast::http::response<boost::beast::http::string_body>
+  handle_get_upload_session(const boost::beast::http::request<boost::beast::http::string_body> &req)
+  {
+    auto session = upload_sessions.status(upload_id_from_target(std::string(req.target())));
+    if (!session.success())
+      return create_error_response(upload_error_status(session.error), req.version(), session.errorMessage);
+
+    std::ostringstream json_response;
+    buildUploadSessionJson(json_response, session.value.value());
+    return create_success_response(boost::beast::http::status::ok, req.version(),
+                                   "application/json", json_response.str());
+  }
 
-      if (!db_result.success() || !db_result.value.has_value())
+  boost::beast::http::response<boost::beast::http::string_body>
+  handle_put_upload_chunk(const boost::beast::http::request<boost::beast::http::string_body> &req)
+  {
+    // Expected format: PUT /uploads/{id}?offset=N with the chunk bytes as the body
+    std::string target = std::string(req.target());
+    std::optional<int64_t> offset;
+    for (const auto &[name, value] : parse_query_string(target))
+    {
+      if (name != "offset")
+        continue;
+      try
       {
-        // TODO: Add FileStorage::deleteFile method
-        return create_error_response(boost::beast::http::status::internal_server_error, req.version(),
-                                     "Failed to save file to database: " + db_result.errorMessage);
+        offset = std::stoll(value);
+      }
+      catch (...)
+      {
+        return create_error_response(boost::beast::http::status::bad_request, req.version(),
+                                     "Invalid offset");
       }
+    }
+    if (!offset.has_value())
+      return create_error_response(boost::beast::http::status::bad_request, req.version(),
+                                   "offset query parameter is required");
+
+    const std::string &body = req.body();
+    auto session = upload_sessions.writeChunk(upload_id_from_target(target), offset.value(), body.data(), body.size());
+    if (!session.success())
+      return create_error_response(upload_error_status(session.error), req.version(), session.errorMessage);
+
+    // the chunk is already synced; an update that loses to a newer revision isn't a failure
+    auto recorded = write_database([&](Database &write_db)
+                                   { return write_db.updateUploadSessionRanges(session.value->id, session.value->ranges,
+                                                                               session.value->revision); });
+    if (!recorded.success())
+      return create_error_response(boost::beast::http::status::internal_server_error, req.version(),
+                                   "Failed to record upload progress: " + recorded.errorMessage);
 
-      if (!first_file)
-        response_json << ",";
-      first_file = false;
+    std::ostringstream json_response;
+    buildUploadSessionJson(json_response, session.value.value());
+    return create_success_response(boost::beast::http::status::ok, req.version(),
+                                   "application/json", json_response.str());
+  }
 
-      auto file_record_result = db->getFileById(db_result.value.value());
-      if (file_record_result.success() && file_record_result.value.has_value())
+  boost::beast::http::response<boost::beast::http::string_body>
+  handle_post_upload_complete(const boost::beast::http::request<boost::beast::http::string_body> &req)
+  {
+    std::string upload_id = upload_id_from_target(std::string(req.target()));
+
+    auto committed = upload_sessions.commit(upload_id);
+    if (!committed.success())
+      return create_error_response(upload_error_status(committed.error), req.version(), committed.errorMessage);
+    const auto &info = committed.value.value();
+
+    // the blob is already in place under its storage ID; the row either lands or the blob goes
+    auto db_result = write_database([&](Database &write_db)
+                                    {
+      int folder_id = 1;
+      if (info.folderId.has_value())
       {
-        buildFileJson(response_json, file_record_result.value.value(), db);
+        folder_id = info.folderId.value();
       }
       else
       {
-        return create_error_response(boost::beast::http::status::internal_server_error, req.version(),
-                                     "Error with fetching file after saving to db" + file_record_result.errorMessage);
+        auto root_folders = write_db.getFoldersByParent(std::nullopt);
+        if (root_folders.success() && !root_folders.value->empty())
+          folder_id = root_folders.value->front().id;
       }
+      // the session's row goes in the same transaction as the file's
+      auto added = write_db.addFile(info.filename, folder_id, info.size, info.contentType, info.id);
+      if (added.success())
+        write_db.deleteUploadSession(info.id);
+      return added; });
+
+    if (!db_result.success() || !db_result.value.has_value())
+    {
+      upload_sessions.abort(upload_id);
+      forget_upload_session(upload_id);
+      return create_error_response(boost::beast::http::status::internal_server_error, req.version(),
+                                   "Failed to save file to database: " + db_result.errorMessage);
     }
+    upload_sessions.finish(upload_id);
 
-    response_json << "]}";
+    auto db = read_database();
+    if (!db)
+      return create_error_response(boost::beast::http::status::internal_server_error, req.version(),
+                                   "Database connection failed");
+
+    auto file_result = db->getFileById(db_result.value.value());
+    if (!file_result.success() || !file_result.value.has_value())
+      return create_error_response(boost::beast::http::status::internal_server_error, req.version(),
+                                   "Error with fetching file after saving to db" + file_result.errorMessage);
 
+    std::ostringstream json_response;
+    buildFileJson(json_response, file_result.value.value(), db);
     return create_success_response(boost::beast::http::status::ok, req.version(),
-                                   "application/json", response_json.str());
+                                   "application/json", json_response.str());
+  }
+
+  boost::beast::http::response<boost::beast::http::string_body>
+  handle_delete_upload_session(const boost::beast::http::request<boost::beast::http::string_body> &req)
+  {
+    std::string upload_id = upload_id_from_target(std::string(req.target()));
+    auto aborted = upload_sessions.abort(upload_id);
+    if (!aborted.success())
+      return create_error_response(upload_error_status(aborted.error), req.version(), aborted.errorMessage);
+    forget_upload_session(upload_id);
+
+    return create_success_response(boost::beast::http::status::ok, req.version(),
+                                   "application/json", R"({"message":"Upload cancelled"})");
+  }
+
+  template <typename Body>
+  void set_download_headers(boost::beast::http::response<Body> &res,
+                            const std::string &content_type, const std::string &filename)
+  {
+    res.set(boost::beast::http::field::server, SERVER_NAME);
+    res.set(boost::beast::http::field::content_type, content_type);
+    res.set(boost::beast::http::field::content_disposition, "attachment; filename=\"" + filename + "\"");
+    addCorsHeaders(res);
   }
 
   boost::beast::http::response<boost::beast::http::vector_body<char>>
@@ -746,10 +1721,7 @@ namespace bytebucket
                          const std::vector<char> &content)
   {
     boost::beast::http::response<boost::beast::http::vector_body<char>> res{status, version};
-    res.set(boost::beast::http::field::server, SERVER_NAME);
-    res.set(boost::beast::http::field::content_type, content_type);
-    res.set(boost::beast::http::field::content_disposition, "attachment; filename=\"" + filename + "\"");
-    addCorsHeaders(res);
+    set_download_headers(res, content_type, filename);
     res.body() = content;
     res.prepare_payload();
     return res;
@@ -776,7 +1748,7 @@ namespace bytebucket
                                    "Invalid file ID format");
     }
 
-    auto db = Database::create();
+    auto db = read_database();
     if (!db)
       return create_error_response(boost::beast::http::status::internal_server_error, req.version(),
                                    "Database connection failed");
@@ -787,13 +1759,151 @@ namespace bytebucket
                                    "File not found");
 
     const FileRecord &file_record = db_result.value.value();
-    auto file_content = FileStorage::readFile(file_record.storageId);
+
+    // a compressed blob goes out as stored when the client can decode it, otherwise
+    // it's inflated while being written
+    if (file_record.codec == "gzip" &&
+        !acceptsEncoding(std::string(req[boost::beast::http::field::accept_encoding]), file_record.codec))
+    {
+      auto file_path = FileStorage::getFilePath(file_record.storageId);
+      if (!file_path.has_value())
+        return create_error_response(boost::beast::http::status::internal_server_error, req.version(),
+                                     "Failed to read file from storage");
+
+      boost::beast::http::response<InflatingFileBody> res{boost::beast::http::status::ok, req.version()};
+      boost::beast::error_code ec;
+      res.body().open(file_path->c_str(), static_cast<uint64_t>(file_record.size), ec);
+      if (ec)
+        return create_error_response(boost::beast::http::status::internal_server_error, req.version(),
+                                     "Failed to read file from storage");
+      set_download_headers(res, file_record.contentType, file_record.name);
+      res.set(boost::beast::http::field::vary, "Accept-Encoding");
+      res.prepare_payload();
+      return res;
+    }
+
+    auto file_content = read_blob(file_record);
     if (!file_content.has_value())
       return create_error_response(boost::beast::http::status::internal_server_error, req.version(),
                                    "Failed to read file from storage");
 
-    return create_binary_response(boost::beast::http::status::ok, req.version(),
-                                  file_record.contentType, file_record.name, file_content.value());
+    auto res = create_binary_response(boost::beast::http::status::ok, req.version(),
+                                      file_record.contentType, file_record.name, **file_content);
+    if (file_record.codec != "identity")
+    {
+      res.set(boost::beast::http::field::content_encoding, file_record.codec);
+      res.set(boost::beast::http::field::vary, "Accept-Encoding");
+    }
+    compress_response(req, res, DOWNLOAD_COMPRESSION);
+    return res;
+  }
+
+  // Makes a folder or file name safe to use as one segment of a ZIP path
+  std::string archive_path_segment(const std::string &name)
+  {
+    std::string segment = name;
+    for (auto &c : segment)
+    {
+      if (c == '/' || c == '\\')
+        c = '_';
+    }
+    if (segment.empty() || segment == "." || segment == "..")
+      segment = "_" + segment;
+    return segment;
+  }
+
+  // dir + name, with " (2)", " (3)", ... before the extension if that path is taken
+  std::string unique_archive_path(std::unordered_set<std::string> &used, const std::string &dir, const std::string &name)
+  {
+    std::string segment = archive_path_segment(name);
+    std::string path = dir + segment;
+    size_t dot = segment.rfind('.');
+    if (dot == 0 || dot == std::string::npos)
+      dot = segment.size();
+    for (int copy = 2; !used.insert(path).second; ++copy)
+      path = dir + segment.substr(0, dot) + " (" + std::to_string(copy) + ")" + segment.substr(dot);
+    return path;
+  }
+
+  boost::beast::http::message_generator
+  handle_get_folder_archive(const boost::beast::http::request<boost::beast::http::string_body> &req)
+  {
+    // Expected format: /folder/{id}/archive
+    std::string target = std::string(req.target());
+    std::string folder_id_str = target.substr(8, target.length() - 8 - 8); // between "/folder/" and "/archive"
+
+    int folder_id;
+    try
+    {
+      folder_id = std::stoi(folder_id_str);
+    }
+    catch (...)
+    {
+      return create_error_response(boost::beast::http::status::bad_request, req.version(),
+                                   "Invalid folder ID");
+    }
+
+    // the archive's length isn't known until it's written, so it needs chunked encoding
+    if (req.version() < 11)
+      return create_error_response(boost::beast::http::status::http_version_not_supported, req.version(),
+                                   "Folder archives need HTTP/1.1");
+
+    auto db = read_database();
+    if (!db)
+      return create_error_response(boost::beast::http::status::internal_server_error, req.version(),
+                                   "Database connection failed");
+
+    auto subtree_result = db->getFolderSubtree(folder_id);
+    if (!subtree_result.success() || !subtree_result.value.has_value())
+      return create_error_response(boost::beast::http::status::not_found, req.version(),
+                                   "Folder not found");
+    db.reset();
+    const FolderSubtree &subtree = subtree_result.value.value();
+
+    ZipArchiveBody::value_type archive;
+    archive.deflateLevel = ARCHIVE_COMPRESSION.level;
+    auto now = std::chrono::system_clock::now();
+
+    // paths are relative to the requested folder; parents are listed before children
+    std::unordered_map<int, std::string> folder_paths;
+    std::unordered_set<std::string> used_paths;
+    folder_paths[subtree.folders.front().id] = "";
+    for (size_t i = 1; i < subtree.folders.size(); ++i)
+    {
+      const FolderRecord &folder = subtree.folders[i];
+      auto parent = folder_paths.find(folder.parentId.value_or(-1));
+      if (parent == folder_paths.end())
+        continue;
+
+      ZipArchiveEntry entry;
+      entry.path = unique_archive_path(used_paths, parent->second, folder.name) + "/";
+      entry.modified = now;
+      folder_paths[folder.id] = entry.path;
+      archive.entries.push_back(std::move(entry));
+    }
+
+    for (const FileRecord &file : subtree.files)
+    {
+      auto folder = folder_paths.find(file.folderId);
+      if (folder == folder_paths.end())
+        continue;
+
+      ZipArchiveEntry entry;
+      entry.path = unique_archive_path(used_paths, folder->second, file.name);
+      entry.source = FileStorage::getStorageDir() / file.storageId;
+      entry.codec = file.codec;
+      entry.size = static_cast<uint64_t>(file.size);
+      entry.deflate = ARCHIVE_COMPRESSION.enabled && entry.size >= ARCHIVE_COMPRESSION.minSize &&
+                      isCompressibleType(file.contentType);
+      entry.modified = file.updatedAt;
+      archive.entries.push_back(std::move(entry));
+    }
+
+    boost::beast::http::response<ZipArchiveBody> res{boost::beast::http::status::ok, req.version()};
+    set_download_headers(res, "application/zip", archive_path_segment(subtree.folders.front().name) + ".zip");
+    res.body() = std::move(archive);
+    res.chunked(true);
+    return res;
   }
 
   boost::beast::http::response<boost::beast::http::string_body>
@@ -826,7 +1936,7 @@ namespace bytebucket
                                    "Invalid file ID format");
     }
 
-    auto db = Database::create();
+    auto db = read_database();
     if (!db)
     {
       return create_error_response(boost::beast::http::status::internal_server_error, req.version(),
@@ -841,14 +1951,15 @@ namespace bytebucket
     }
 
     const FileRecord &file_record = db_result.value.value();
-    bool storage_deleted = FileStorage::deleteFile(file_record.storageId);
+    bool storage_deleted = delete_blob(file_record.storageId);
     if (!storage_deleted)
     {
       return create_error_response(boost::beast::http::status::internal_server_error, req.version(),
                                    "Failed to delete file from storage");
     }
 
-    auto delete_result = db->deleteFile(file_id);
+    auto delete_result = write_database([&](Database &write_db)
+                                        { return write_db.deleteFile(file_id); });
     if (!delete_result.success() || !delete_result.value.has_value() || !delete_result.value.value())
     {
       // TODO: make this case not reachable (existing in db but not in storage)
@@ -890,7 +2001,7 @@ namespace bytebucket
                                    "Invalid folder ID format");
     }
 
-    auto db = Database::create();
+    auto db = read_database();
     if (!db)
     {
       return create_error_response(boost::beast::http::status::internal_server_error, req.version(),
@@ -913,7 +2024,7 @@ namespace bytebucket
       {
         for (const auto &file_record : files_result.value.value())
         {
-          if (!FileStorage::deleteFile(file_record.storageId))
+          if (!delete_blob(file_record.storageId))
           {
             std::cerr << "Warning: Failed to delete file " << file_record.storageId << " from storage" << std::endl;
             // Continue with other files
@@ -945,7 +2056,8 @@ namespace bytebucket
     }
 
     // Then delete the folder from database (this will cascade to all subfolders and files)
-    auto delete_result = db->deleteFolder(folder_id);
+    auto delete_result = write_database([&](Database &write_db)
+                                        { return write_db.deleteFolder(folder_id); });
     if (!delete_result.success() || !delete_result.value.has_value() || !delete_result.value.value())
     {
       return create_error_response(boost::beast::http::status::internal_server_error, req.version(),
@@ -1024,7 +2136,7 @@ namespace bytebucket
                                    "Failed to parse folder_id. Expected integer value");
     }
 
-    auto db = Database::create();
+    auto db = read_database();
     if (!db)
     {
       return create_error_response(boost::beast::http::status::internal_server_error, req.version(),
@@ -1045,7 +2157,8 @@ namespace bytebucket
                                    "Target folder not found");
     }
 
-    auto move_result = db->moveFile(file_id, folder_id);
+    auto move_result = write_database([&](Database &write_db)
+                                      { return write_db.moveFile(file_id, folder_id); });
     if (!move_result.success() || !move_result.value.has_value() || !move_result.value.value())
     {
       return create_error_response(boost::beast::http::status::internal_server_error, req.version(),
@@ -1100,7 +2213,7 @@ namespace bytebucket
                                    "Invalid file ID or tag ID format");
     }
 
-    auto db = Database::create();
+    auto db = read_database();
     if (!db)
     {
       return create_error_response(boost::beast::http::status::internal_server_error, req.version(),
@@ -1121,7 +2234,8 @@ namespace bytebucket
                                    "Tag not found");
     }
 
-    auto remove_result = db->removeFileTag(file_id, tag_id);
+    auto remove_result = write_database([&](Database &write_db)
+                                        { return write_db.removeFileTag(file_id, tag_id); });
     if (!remove_result.success() || !remove_result.value.has_value() || !remove_result.value.value())
     {
       return create_error_response(boost::beast::http::status::bad_request, req.version(),
@@ -1173,7 +2287,7 @@ namespace bytebucket
                                    "Invalid file ID format");
     }
 
-    auto db = Database::create();
+    auto db = read_database();
     if (!db)
     {
       return create_error_response(boost::beast::http::status::internal_server_error, req.version(),
@@ -1187,7 +2301,8 @@ namespace bytebucket
                                    "File not found");
     }
 
-    auto remove_result = db->removeFileMetadata(file_id, metadata_key);
+    auto remove_result = write_database([&](Database &write_db)
+                                        { return write_db.removeFileMetadata(file_id, metadata_key); });
     if (!remove_result.success() || !remove_result.value.has_value() || !remove_result.value.value())
     {
       return create_error_response(boost::beast::http::status::bad_request, req.version(),
@@ -1198,92 +2313,362 @@ namespace bytebucket
                                    "application/json", R"({"message":"Metadata removed from file successfully"})");
   }
 
+  std::optional<boost::beast::http::response<boost::beast::http::string_body>>
+  check_request_header(const boost::beast::http::request<boost::beast::http::string_body> &req,
+                       std::optional<uint64_t> content_length)
+  {
+    if (content_length.has_value() && content_length.value() > MAX_REQUEST_BODY_SIZE)
+      return create_error_response(boost::beast::http::status::payload_too_large, req.version(),
+                                   "Request body exceeds the " + std::to_string(MAX_REQUEST_BODY_SIZE / (1024 * 1024)) + " MB limit");
+
+    // a body sent to a route that doesn't exist would only be read to be thrown away
+    if ((content_length.value_or(0) > 0 || req.chunked()) && match_route(req) == Route::NotFound)
+      return create_success_response(boost::beast::http::status::not_found, req.version(),
+                                     "text/plain", "Not found");
+
+    std::string target = std::string(req.target());
+
+    if (req.method() == boost::beast::http::verb::post &&
+        (target == "/upload" || (target.length() > 8 && target.substr(0, 8) == "/upload?")))
+    {
+      if (auto content_type_error = upload_content_type_error(req))
+        return create_error_response(boost::beast::http::status::bad_request, req.version(), *content_type_error);
+
+      if (auto folder_param = upload_folder_param(target))
+      {
+        int folder_id = 0;
+        try
+        {
+          folder_id = std::stoi(folder_param.value());
+        }
+        catch (...)
+        {
+          return create_error_response(boost::beast::http::status::bad_request, req.version(),
+                                       "Invalid folder_id");
+        }
+
+        auto db = read_database();
+        if (!db)
+          return create_error_response(boost::beast::http::status::internal_server_error, req.version(),
+                                       "Database connection failed");
+        if (!db->getFolderById(folder_id).success())
+          return create_error_response(boost::beast::http::status::not_found, req.version(),
+                                       "Folder not found");
+      }
+
+      // the body lands in memory and then on disk; refuse what the disk can't hold
+      std::error_code space_error;
+      auto space = std::filesystem::space(FileStorage::getStorageDir(), space_error);
+      if (!space_error && content_length.has_value() && content_length.value() > space.available)
+        return create_error_response(boost::beast::http::status::insufficient_storage, req.version(),
+                                     "Not enough storage space for upload");
+      return std::nullopt;
+    }
+
+    if (req.method() == boost::beast::http::verb::put &&
+        target.length() > 9 && target.substr(0, 9) == "/uploads/" &&
+        target.find("/complete") == std::string::npos)
+    {
+      auto session = upload_sessions.status(upload_id_from_target(target));
+      if (!session.success())
+        return create_error_response(upload_error_status(session.error), req.version(), session.errorMessage);
+
+      // a malformed offset is reported by the handler; only a chunk that can't fit is refused here
+      for (const auto &[name, value] : parse_query_string(target))
+      {
+        if (name != "offset" || !content_length.has_value())
+          continue;
+        try
+        {
+          int64_t offset = std::stoll(value);
+          if (offset < 0 || offset > session.value->size ||
+              content_length.value() > static_cast<uint64_t>(session.value->size - offset))
+            return create_error_response(upload_error_status(UploadError::InvalidRange), req.version(),
+                                         "Chunk extends past the end of the upload");
+        }
+        catch (...)
+        {
+        }
+      }
+    }
+
+    return std::nullopt;
+  }
+
+  bool expects_continue(const boost::beast::http::request<boost::beast::http::string_body> &req)
+  {
+    return req.version() >= 11 &&
+           boost::beast::iequals(req[boost::beast::http::field::expect], "100-continue");
+  }
+
   boost::beast::http::message_generator handle_request(boost::beast::http::request<boost::beast::http::string_body> &&req)
+  {
+    Route route;
+    return handle_request(std::move(req), route);
+  }
+
+  Route match_route(const boost::beast::http::request<boost::beast::http::string_body> &req)
   {
     // Handle OPTIONS requests for CORS preflight
     if (req.method() == boost::beast::http::verb::options)
-      return handle_options(req.version());
+    {
+      return Route::Options;
+    }
 
     // GET /health
     if (req.method() == boost::beast::http::verb::get && req.target() == "/health")
-      return handle_health(req.version());
+    {
+      return Route::Health;
+    }
 
     // GET /
     if (req.method() == boost::beast::http::verb::get && req.target() == "/")
-      return handle_root(req.version());
+    {
+      return Route::Root;
+    }
+
+    // GET /folder/{id}/archive - the folder and everything under it as a streamed ZIP
+    if (req.method() == boost::beast::http::verb::get &&
+        req.target().length() > 16 && std::string(req.target()).substr(0, 8) == "/folder/" &&
+        std::string(req.target()).substr(req.target().length() - 8) == "/archive")
+    {
+      return Route::GetFolderArchive;
+    }
 
     // GET /folder, /folder/, or /folder/{id}
     if (req.method() == boost::beast::http::verb::get &&
         (req.target() == "/folder" || req.target() == "/folder/" ||
          (req.target().length() > 8 && std::string(req.target()).substr(0, 8) == "/folder/")))
-      return handle_get_folder(req);
+    {
+      return Route::GetFolder;
+    }
 
     // POST /folder
     if (req.method() == boost::beast::http::verb::post && req.target() == "/folder")
-      return handle_post_folder(req);
+    {
+      return Route::PostFolder;
+    }
 
     // DELETE /folder/{folderId}
     if (req.method() == boost::beast::http::verb::delete_ &&
         req.target().length() > 8 && std::string(req.target()).substr(0, 8) == "/folder/")
-      return handle_delete_folder(req);
+    {
+      return Route::DeleteFolder;
+    }
 
     // PATCH /folder/{folderId}/move
 
     // TODO: maybe rename this to /files?
     // POST /upload
-    if (req.method() == boost::beast::http::verb::post && req.target() == "/upload")
-      return handle_post_upload(req);
+    if (req.method() == boost::beast::http::verb::post &&
+        (req.target() == "/upload" ||
+         (req.target().length() > 8 && std::string(req.target()).substr(0, 8) == "/upload?")))
+    {
+      return Route::PostUpload;
+    }
 
-    // DELETE /files/{fileId}
+    // DELETE /files/{fileId}; /files/{fileId}/tags/.. and /metadata/.. are routed below
     if (req.method() == boost::beast::http::verb::delete_ &&
-        req.target().length() > 7 && std::string(req.target()).substr(0, 7) == "/files/")
-      return handle_delete_file(req);
+        req.target().length() > 7 && std::string(req.target()).substr(0, 7) == "/files/" &&
+        req.target().find('/', 7) == boost::beast::string_view::npos)
+    {
+      return Route::DeleteFile;
+    }
 
     // PATCH /files/{fileId}/move
     if (req.method() == boost::beast::http::verb::patch &&
         req.target().length() > 12 && std::string(req.target()).substr(0, 7) == "/files/" &&
         std::string(req.target()).substr(req.target().length() - 5) == "/move")
-      return handle_patch_file_move(req);
+    {
+      return Route::PatchFileMove;
+    }
 
     // GET /download/{id}
     if (req.method() == boost::beast::http::verb::get &&
         req.target().length() > 10 && std::string(req.target()).substr(0, 10) == "/download/")
-      return handle_get_download(req);
+    {
+      return Route::GetDownload;
+    }
 
     // GET /tags - gets all tags
     if (req.method() == boost::beast::http::verb::get && req.target() == "/tags")
-      return handle_get_tags(req);
+    {
+      return Route::GetTags;
+    }
 
     // POST /tags - create a new tag
     if (req.method() == boost::beast::http::verb::post && req.target() == "/tags")
-      return handle_post_tags(req);
+    {
+      return Route::PostTags;
+    }
 
     // POST /files/{fileId}/tags - add tag to file
     if (req.method() == boost::beast::http::verb::post &&
         req.target().length() > 7 && std::string(req.target()).substr(0, 7) == "/files/" &&
         std::string(req.target()).find("/tags") != std::string::npos)
-      return handle_post_file_tags(req);
+    {
+      return Route::PostFileTags;
+    }
 
     // DELETE /files/{fileId}/tags/{tagId} - remove tag from file
     if (req.method() == boost::beast::http::verb::delete_ &&
         req.target().length() > 13 && std::string(req.target()).substr(0, 7) == "/files/" &&
         std::string(req.target()).find("/tags/") != std::string::npos)
-      return handle_delete_file_tag(req);
+    {
+      return Route::DeleteFileTag;
+    }
 
     // POST /files/{fileId}/metadata - add metadata to file
     if (req.method() == boost::beast::http::verb::post &&
         req.target().length() > 7 && std::string(req.target()).substr(0, 7) == "/files/" &&
         std::string(req.target()).find("/metadata") != std::string::npos)
-      return handle_post_file_metadata(req);
+    {
+      return Route::PostFileMetadata;
+    }
+
+    // GET /search/metadata?key=value&key.gt=value - filter files by metadata
+    if (req.method() == boost::beast::http::verb::get &&
+        (req.target() == "/search/metadata" || std::string(req.target()).substr(0, 17) == "/search/metadata?"))
+    {
+      return Route::SearchMetadata;
+    }
+
+    // POST /uploads - start a resumable upload
+    if (req.method() == boost::beast::http::verb::post && req.target() == "/uploads")
+    {
+      return Route::PostUploadSession;
+    }
+
+    // /uploads/{uploadId}... - chunks, progress, finalize and cancel for a resumable upload
+    if (req.target().length() > 9 && std::string(req.target()).substr(0, 9) == "/uploads/")
+    {
+      std::string target = std::string(req.target());
+      bool is_complete = target.find("/complete") != std::string::npos;
+
+      if (req.method() == boost::beast::http::verb::post && is_complete)
+      {
+        return Route::PostUploadComplete;
+      }
+      if (req.method() == boost::beast::http::verb::put && !is_complete)
+      {
+        return Route::PutUploadChunk;
+      }
+      if (req.method() == boost::beast::http::verb::get && !is_complete)
+      {
+        return Route::GetUploadSession;
+      }
+      if (req.method() == boost::beast::http::verb::delete_ && !is_complete)
+      {
+        return Route::DeleteUploadSession;
+      }
+    }
+
+    // GET /stats/database - live SQLite tuning values and page cache counters
+    if (req.method() == boost::beast::http::verb::get && req.target() == "/stats/database")
+    {
+      return Route::GetDatabaseStats;
+    }
+
+    // GET /stats/cache - blob cache occupancy and hit ratio
+    if (req.method() == boost::beast::http::verb::get && req.target() == "/stats/cache")
+    {
+      return Route::GetCacheStats;
+    }
+
+    // GET /metrics - request, connection and storage metrics for Prometheus
+    if (req.method() == boost::beast::http::verb::get && req.target() == "/metrics")
+    {
+      return Route::GetMetrics;
+    }
+
+    // GET /debug/queries - per-statement SQLite timings when query profiling is on
+    if (req.method() == boost::beast::http::verb::get && req.target() == "/debug/queries")
+    {
+      return Route::GetQueryProfile;
+    }
+
+    // GET /debug/traces - sampled and forced request traces for chrome://tracing or Perfetto
+    if (req.method() == boost::beast::http::verb::get &&
+        (req.target() == "/debug/traces" || std::string(req.target()).rfind("/debug/traces?", 0) == 0))
+    {
+      return Route::GetTraces;
+    }
 
     // DELETE /files/{fileId}/metadata/{key} - remove metadata from file
     if (req.method() == boost::beast::http::verb::delete_ &&
         req.target().length() > 17 && std::string(req.target()).substr(0, 7) == "/files/" &&
         std::string(req.target()).find("/metadata/") != std::string::npos)
-      return handle_delete_file_metadata(req);
+    {
+      return Route::DeleteFileMetadata;
+    }
+
+    return Route::NotFound;
+  }
 
-    // 404 Not Found
-    return create_success_response(boost::beast::http::status::not_found, req.version(),
-                                   "text/plain", "Not found");
+  boost::beast::http::message_generator handle_request(boost::beast::http::request<boost::beast::http::string_body> &&req, Route &route)
+  {
+    route = match_route(req);
+    switch (route)
+    {
+    case Route::Options:
+      return handle_options(req.version());
+    case Route::Health:
+      return handle_health(req.version());
+    case Route::Root:
+      return handle_root(req.version());
+    case Route::GetFolderArchive:
+      return handle_get_folder_archive(req);
+    case Route::GetFolder:
+      return compressed(req, handle_get_folder(req), LISTING_COMPRESSION);
+    case Route::PostFolder:
+      return handle_post_folder(req);
+    case Route::DeleteFolder:
+      return handle_delete_folder(req);
+    case Route::PostUpload:
+      return compressed(req, handle_post_upload(req));
+    case Route::DeleteFile:
+      return handle_delete_file(req);
+    case Route::PatchFileMove:
+      return handle_patch_file_move(req);
+    case Route::GetDownload:
+      return handle_get_download(req);
+    case Route::GetTags:
+      return compressed(req, handle_get_tags(req));
+    case Route::PostTags:
+      return handle_post_tags(req);
+    case Route::PostFileTags:
+      return handle_post_file_tags(req);
+    case Route::DeleteFileTag:
+      return handle_delete_file_tag(req);
+    case Route::PostFileMetadata:
+      return handle_post_file_metadata(req);
+    case Route::SearchMetadata:
+      return compressed(req, handle_get_metadata_search(req), LISTING_COMPRESSION);
+    case Route::PostUploadSession:
+      return handle_post_upload_session(req);
+    case Route::PostUploadComplete:
+      return handle_post_upload_complete(req);
+    case Route::PutUploadChunk:
+      return handle_put_upload_chunk(req);
+    case Route::GetUploadSession:
+      return compressed(req, handle_get_upload_session(req));
+    case Route::DeleteUploadSession:
+      return handle_delete_upload_session(req);
+    case Route::GetDatabaseStats:
+      return compressed(req, handle_get_database_stats(req));
+    case Route::GetCacheStats:
+      return compressed(req, handle_get_cache_stats(req));
+    case Route::GetMetrics:
+      return compressed(req, handle_get_metrics(req));
+    case Route::GetQueryProfile:
+      return compressed(req, handle_get_query_profile(req));
+    case Route::GetTraces:
+      return compressed(req, handle_get_traces(req));
+    case Route::DeleteFileMetadata:
+      return handle_delete_file_metadata(req);
+    default:
+      return create_success_response(boost::beast::http::status::not_found, req.version(),
+                                     "text/plain", "Not found");
+    }
   }
 }
\ No newline at end of file
@@ -0,0 +1,124 @@
+#include "session_deadline.hpp"
+#include "env_config.hpp"
+#include <sys/socket.h>
+
+namespace bytebucket
+{
+  SessionLimits SessionLimits::fromEnvironment()
+  {
+    SessionLimits limits;
+    if (auto seconds = readEnvCount("BYTEBUCKET_IDLE_TIMEOUT_S"); seconds && *seconds > 0)
+      limits.idleTimeout = std::chrono::seconds(*seconds);
+    if (auto seconds = readEnvCount("BYTEBUCKET_HEADER_TIMEOUT_S"); seconds && *seconds > 0)
+      limits.headerTimeout = std::chrono::seconds(*seconds);
+    if (auto seconds = readEnvCount("BYTEBUCKET_BODY_GRACE_S"))
+      limits.bodyGrace = std::chrono::seconds(*seconds);
+    if (auto rate = readEnvCount("BYTEBUCKET_MIN_BODY_RATE"))
+      limits.minBodyBytesPerSecond = *rate;
+    if (auto seconds = readEnvCount("BYTEBUCKET_WRITE_TIMEOUT_S"); seconds && *seconds > 0)
+      limits.writeTimeout = std::chrono::seconds(*seconds);
+    if (auto requests = readEnvCount("BYTEBUCKET_MAX_REQUESTS_PER_CONNECTION"))
+      limits.maxRequestsPerConnection = *requests;
+    return limits;
+  }
+
+  std::chrono::steady_clock::time_point SessionLimits::bodyDeadline(std::chrono::steady_clock::time_point bodyStarted,
+                                                                    uint64_t bytes) const
+  {
+    if (minBodyBytesPerSecond == 0)
+      return std::chrono::steady_clock::time_point::max();
+    // whole milliseconds; at any sane rate the rounding is far below the watchdog's resolution
+    auto allowance = std::chrono::milliseconds(bytes * 1000 / minBodyBytesPerSecond);
+    return bodyStarted + bodyGrace + allowance;
+  }
+
+  std::shared_ptr<DeadlineWatchdog> DeadlineWatchdog::create(Clock::duration resolution)
+  {
+    return std::shared_ptr<DeadlineWatchdog>(new DeadlineWatchdog(resolution));
+  }
+
+  DeadlineWatchdog::DeadlineWatchdog(Clock::duration resolution) : resolution(resolution)
+  {
+    thread = std::thread([this]()
+                         { run(); });
+  }
+
+  DeadlineWatchdog::~DeadlineWatchdog()
+  {
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      stopping = true;
+    }
+    wake.notify_one();
+    if (thread.joinable())
+      thread.join();
+  }
+
+  void DeadlineWatchdog::add(Entry *entry)
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    entries.insert(entry);
+  }
+
+  void DeadlineWatchdog::remove(Entry *entry)
+  {
+    // under the lock, so the watchdog never shuts down an fd the session has already closed
+    std::lock_guard<std::mutex> lock(mutex);
+    entries.erase(entry);
+  }
+
+  void DeadlineWatchdog::run()
+  {
+    std::unique_lock<std::mutex> lock(mutex);
+    while (!stopping)
+    {
+      wake.wait_for(lock, resolution);
+      int64_t now = Clock::now().time_since_epoch().count();
+      for (Entry *entry : entries)
+      {
+        int64_t deadline = entry->deadline.load(std::memory_order_acquire);
+        if (deadline == 0 || deadline > now || entry->fired.exchange(true))
+          continue;
+
+        // wakes the session's blocked read or write, which then fails
+        ::shutdown(entry->fd, SHUT_RDWR);
+        expired.fetch_add(1, std::memory_order_relaxed);
+        Metrics::connectionTimedOut(static_cast<TimeoutPhase>(entry->phase.load(std::memory_order_relaxed)));
+      }
+    }
+  }
+
+  SocketDeadline::SocketDeadline(std::shared_ptr<DeadlineWatchdog> watchdog, boost::asio::ip::tcp::socket &socket)
+      : watchdog(std::move(watchdog))
+  {
+    entry.fd = socket.native_handle();
+    if (this->watchdog)
+      this->watchdog->add(&entry);
+  }
+
+  SocketDeadline::~SocketDeadline()
+  {
+    if (watchdog)
+      watchdog->remove(&entry);
+  }
+
+  void SocketDeadline::expiresAt(Clock::time_point deadline, TimeoutPhase phase)
+  {
+    entry.phase.store(static_cast<uint8_t>(phase), std::memory_order_relaxed);
+    // 0 means disarmed, and no steady_clock reading is that early
+    entry.deadline.store(deadline == Clock::time_point::max() ? 0 : deadline.time_since_epoch().count(),
+                         std::memory_order_release);
+  }
+
+  void SocketDeadline::cancel()
+  {
+    entry.deadline.store(0, std::memory_order_release);
+  }
+
+  std::optional<TimeoutPhase> SocketDeadline::expired() const
+  {
+    if (!entry.fired.load(std::memory_order_acquire))
+      return std::nullopt;
+    return static_cast<TimeoutPhase>(entry.phase.load(std::memory_order_relaxed));
+  }
+}
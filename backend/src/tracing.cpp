@@ -0,0 +1,208 @@
+#include "tracing.hpp"
+#include "json_escape.hpp"
+#include <atomic>
+#include <cstdio>
+#include <deque>
+
+namespace bytebucket
+{
+  static std::atomic<uint32_t> sampleEvery{0};
+  static std::atomic<uint64_t> nextTraceId{1};
+  static std::atomic<uint32_t> nextThreadNumber{1};
+
+  static std::mutex keptMutex;
+  static std::deque<std::shared_ptr<Trace>> kept;
+
+  // owns the trace begun on this thread; threadTrace() may point elsewhere inside a TraceScope
+  static thread_local std::shared_ptr<Trace> begunTrace;
+
+  static uint32_t threadNumber()
+  {
+    static thread_local uint32_t number = nextThreadNumber.fetch_add(1, std::memory_order_relaxed);
+    return number;
+  }
+
+  // xorshift, seeded per thread, so sampling doesn't contend on a shared counter
+  static uint32_t sampleRandom()
+  {
+    static thread_local uint32_t state = 0x9e3779b9u * threadNumber();
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+    return state;
+  }
+
+  static Trace::Clock::time_point processEpoch()
+  {
+    static const Trace::Clock::time_point epoch = Trace::Clock::now();
+    return epoch;
+  }
+
+  Trace::Trace(uint64_t id, std::string label)
+      : traceId(id), requestLabel(std::move(label)), startedAt(Clock::now()), finishedAt(startedAt)
+  {
+  }
+
+  void Trace::record(const Span &span)
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (recorded.size() >= MAX_SPANS)
+    {
+      dropped++;
+      return;
+    }
+    recorded.push_back(span);
+  }
+
+  std::vector<Trace::Span> Trace::spans() const
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    return recorded;
+  }
+
+  uint64_t Trace::droppedSpans() const
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    return dropped;
+  }
+
+  void Tracer::setSampling(uint32_t every)
+  {
+    sampleEvery.store(every, std::memory_order_relaxed);
+  }
+
+  uint32_t Tracer::sampling()
+  {
+    return sampleEvery.load(std::memory_order_relaxed);
+  }
+
+  Trace *&Tracer::threadTrace()
+  {
+    static thread_local Trace *trace = nullptr;
+    return trace;
+  }
+
+  std::shared_ptr<Trace> Tracer::begin(std::string_view method, std::string_view target,
+                                       std::optional<uint64_t> forcedId)
+  {
+    if (!forcedId)
+    {
+      uint32_t every = sampleEvery.load(std::memory_order_relaxed);
+      if (every == 0 || sampleRandom() % every != 0)
+        return nullptr;
+    }
+
+    processEpoch();
+    uint64_t id = forcedId && *forcedId != 0 ? *forcedId : nextTraceId.fetch_add(1, std::memory_order_relaxed);
+    std::string label;
+    label.reserve(method.size() + 1 + target.size());
+    label.append(method).append(1, ' ').append(target);
+    begunTrace = std::make_shared<Trace>(id, std::move(label));
+    threadTrace() = begunTrace.get();
+    return begunTrace;
+  }
+
+  void Tracer::end()
+  {
+    if (!begunTrace)
+      return;
+    begunTrace->finishedAt = Trace::Clock::now();
+    {
+      std::lock_guard<std::mutex> lock(keptMutex);
+      kept.push_back(std::move(begunTrace));
+      if (kept.size() > KEPT_TRACES)
+        kept.pop_front();
+    }
+    begunTrace.reset();
+    threadTrace() = nullptr;
+  }
+
+  std::shared_ptr<Trace> Tracer::current()
+  {
+    Trace *trace = threadTrace();
+    return trace ? trace->shared_from_this() : nullptr;
+  }
+
+  void Tracer::clear()
+  {
+    std::lock_guard<std::mutex> lock(keptMutex);
+    kept.clear();
+  }
+
+  // Chrome trace timestamps are microseconds; keep sub-microsecond spans visible
+  static void appendMicros(std::string &out, Trace::Clock::duration duration)
+  {
+    char formatted[32];
+    std::snprintf(formatted, sizeof(formatted), "%.3f",
+                  std::chrono::duration<double, std::micro>(duration).count());
+    out += formatted;
+  }
+
+  static void appendEvent(std::string &out, std::string_view name, std::string_view category,
+                          Trace::Clock::time_point start, Trace::Clock::duration duration, uint32_t thread,
+                          uint64_t traceId)
+  {
+    if (out.back() != '[')
+      out += ',';
+    out += "{\"name\":";
+    appendJsonString(out, name);
+    out += ",\"cat\":";
+    appendJsonString(out, category);
+    out += ",\"ph\":\"X\",\"ts\":";
+    appendMicros(out, start - processEpoch());
+    out += ",\"dur\":";
+    appendMicros(out, duration);
+    out += ",\"pid\":1,\"tid\":" + std::to_string(thread);
+    out += ",\"args\":{\"trace\":" + std::to_string(traceId) + "}}";
+  }
+
+  std::string Tracer::renderChromeTrace(std::optional<uint64_t> traceId)
+  {
+    std::vector<std::shared_ptr<Trace>> traces;
+    {
+      std::lock_guard<std::mutex> lock(keptMutex);
+      for (const auto &trace : kept)
+        if (!traceId || trace->id() == *traceId)
+          traces.push_back(trace);
+    }
+
+    std::string out = "{\"traceEvents\":[";
+    for (const auto &trace : traces)
+    {
+      // the whole request first, on the thread of its first span, so viewers nest the rest under it
+      auto spans = trace->spans();
+      uint32_t thread = spans.empty() ? 0 : spans.front().thread;
+      appendEvent(out, trace->label(), "request", trace->started(), trace->finished() - trace->started(),
+                  thread, trace->id());
+      for (const auto &span : spans)
+        appendEvent(out, span.name, span.category, span.start, span.duration, span.thread, trace->id());
+    }
+    out += "],\"displayTimeUnit\":\"ms\"}";
+    return out;
+  }
+
+  TraceSpan::TraceSpan(const char *name, const char *category)
+      : trace(Tracer::threadTrace()), name(name), category(category)
+  {
+    if (trace)
+      started = Trace::Clock::now();
+  }
+
+  TraceSpan::~TraceSpan()
+  {
+    if (trace)
+      trace->record(Trace::Span{name, category, started, Trace::Clock::now() - started, threadNumber()});
+  }
+
+  TraceScope::TraceScope(std::shared_ptr<Trace> trace) : trace(std::move(trace)), previous(Tracer::threadTrace())
+  {
+    if (this->trace)
+      Tracer::threadTrace() = this->trace.get();
+  }
+
+  TraceScope::~TraceScope()
+  {
+    if (trace)
+      Tracer::threadTrace() = previous;
+  }
+}
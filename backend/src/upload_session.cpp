@@ -0,0 +1,291 @@
+#include "upload_session.hpp"
+#include "file_storage.hpp"
+#include "metrics.hpp"
+#include <algorithm>
+
+namespace bytebucket
+{
+  template <typename T>
+  static UploadResult<T> uploadFailure(UploadError error, const std::string &message)
+  {
+    UploadResult<T> result;
+    result.error = error;
+    result.errorMessage = message;
+    return result;
+  }
+
+  UploadSessions::UploadSessions(std::chrono::seconds idleTimeout) : idleTimeout(idleTimeout) {}
+
+  UploadResult<UploadSessionInfo> UploadSessions::create(
+      const std::string &filename,
+      const std::string &contentType,
+      std::optional<int> folderId,
+      int64_t size)
+  {
+    if (filename.empty())
+      return uploadFailure<UploadSessionInfo>(UploadError::InvalidRange, "Filename cannot be empty");
+    if (size < 0)
+      return uploadFailure<UploadSessionInfo>(UploadError::InvalidRange, "Size cannot be negative");
+
+    expireIdleSessions();
+
+    auto fileId = FileStorage::createPartialFile(size);
+    if (!fileId.has_value())
+      return uploadFailure<UploadSessionInfo>(UploadError::StorageFailed, "Failed to allocate upload storage");
+
+    auto session = std::make_shared<Session>();
+    session->info.id = fileId.value();
+    session->info.filename = filename;
+    session->info.contentType = contentType;
+    session->info.folderId = folderId;
+    session->info.size = size;
+    session->lastActivity = std::chrono::steady_clock::now();
+
+    UploadResult<UploadSessionInfo> result;
+    result.value = snapshot(*session);
+
+    std::lock_guard<std::mutex> lock(mutex);
+    sessions.emplace(session->info.id, std::move(session));
+    return result;
+  }
+
+  UploadResult<UploadSessionInfo> UploadSessions::writeChunk(const std::string &id, int64_t offset, const char *data, size_t length)
+  {
+    auto session = find(id);
+    if (!session)
+      return uploadFailure<UploadSessionInfo>(UploadError::NotFound, "Upload not found");
+
+    int64_t end;
+    {
+      std::lock_guard<std::mutex> lock(session->mutex);
+      if (session->expired)
+        return uploadFailure<UploadSessionInfo>(UploadError::NotFound, "Upload not found");
+      if (session->committing)
+        return uploadFailure<UploadSessionInfo>(UploadError::Conflict, "Upload is already being finalized");
+      // compared against the room left so a huge offset can't overflow the sum
+      if (offset < 0 || offset > session->info.size ||
+          length > static_cast<uint64_t>(session->info.size - offset))
+        return uploadFailure<UploadSessionInfo>(UploadError::InvalidRange, "Chunk is outside the declared file size");
+      end = offset + static_cast<int64_t>(length);
+      session->inFlight++;
+    }
+
+    // disjoint chunks write in parallel; only bookkeeping is under the session lock
+    bool written = true;
+    if (length > 0)
+    {
+      StorageTimer timer(StorageOp::Write);
+      written = FileStorage::writePartialFile(id, offset, data, length);
+    }
+
+    std::lock_guard<std::mutex> lock(session->mutex);
+    session->inFlight--;
+    session->lastActivity = std::chrono::steady_clock::now();
+    if (!written)
+      return uploadFailure<UploadSessionInfo>(UploadError::StorageFailed, "Failed to write chunk");
+
+    if (length > 0)
+    {
+      addRange(*session, offset, end);
+      session->info.revision++;
+    }
+
+    UploadResult<UploadSessionInfo> result;
+    result.value = snapshot(*session);
+    return result;
+  }
+
+  UploadResult<UploadSessionInfo> UploadSessions::status(const std::string &id)
+  {
+    auto session = find(id);
+    if (!session)
+      return uploadFailure<UploadSessionInfo>(UploadError::NotFound, "Upload not found");
+
+    std::lock_guard<std::mutex> lock(session->mutex);
+    if (session->expired)
+      return uploadFailure<UploadSessionInfo>(UploadError::NotFound, "Upload not found");
+    UploadResult<UploadSessionInfo> result;
+    result.value = snapshot(*session);
+    return result;
+  }
+
+  UploadResult<UploadSessionInfo> UploadSessions::commit(const std::string &id)
+  {
+    auto session = find(id);
+    if (!session)
+      return uploadFailure<UploadSessionInfo>(UploadError::NotFound, "Upload not found");
+
+    UploadSessionInfo info;
+    {
+      std::lock_guard<std::mutex> lock(session->mutex);
+      if (session->expired)
+        return uploadFailure<UploadSessionInfo>(UploadError::NotFound, "Upload not found");
+      if (session->committing)
+        return uploadFailure<UploadSessionInfo>(UploadError::Conflict, "Upload is already being finalized");
+      if (session->inFlight > 0)
+        return uploadFailure<UploadSessionInfo>(UploadError::Conflict, "Chunks are still being written");
+      if (!snapshot(*session).complete())
+        return uploadFailure<UploadSessionInfo>(UploadError::Incomplete, "Upload is missing chunks");
+      session->committing = true;
+      info = snapshot(*session);
+    }
+
+    if (!FileStorage::commitPartialFile(info.id, info.filename, info.contentType, info.size))
+    {
+      std::lock_guard<std::mutex> lock(session->mutex);
+      session->committing = false;
+      return uploadFailure<UploadSessionInfo>(UploadError::StorageFailed, "Failed to commit uploaded file");
+    }
+
+    {
+      std::lock_guard<std::mutex> lock(session->mutex);
+      session->committed = true;
+    }
+
+    UploadResult<UploadSessionInfo> result;
+    result.value = std::move(info);
+    return result;
+  }
+
+  void UploadSessions::finish(const std::string &id)
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    sessions.erase(id);
+  }
+
+  UploadResult<bool> UploadSessions::abort(const std::string &id)
+  {
+    std::shared_ptr<Session> session;
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      auto it = sessions.find(id);
+      if (it == sessions.end())
+        return uploadFailure<bool>(UploadError::NotFound, "Upload not found");
+      session = std::move(it->second);
+      sessions.erase(it);
+    }
+
+    bool committed;
+    {
+      std::lock_guard<std::mutex> lock(session->mutex);
+      committed = session->committed;
+    }
+    if (committed)
+      FileStorage::deleteFile(id);
+    else
+      FileStorage::deletePartialFile(id);
+
+    UploadResult<bool> result;
+    result.value = true;
+    return result;
+  }
+
+  UploadResult<UploadSessionInfo> UploadSessions::restore(const UploadSessionInfo &info)
+  {
+    if (info.id.empty() || info.filename.empty() || info.size < 0)
+      return uploadFailure<UploadSessionInfo>(UploadError::InvalidRange, "Recorded upload is invalid");
+    auto partSize = FileStorage::partialFileSize(info.id);
+    if (!partSize.has_value() || partSize.value() != info.size)
+      return uploadFailure<UploadSessionInfo>(UploadError::NotFound, "Upload's partial file is missing");
+
+    auto session = std::make_shared<Session>();
+    session->info = info; // revision included, so later updates still supersede the stored row
+    session->info.receivedBytes = 0;
+    session->info.ranges.clear();
+    for (const auto &[start, end] : info.ranges)
+    {
+      if (start < 0 || start > end || end > info.size)
+        return uploadFailure<UploadSessionInfo>(UploadError::InvalidRange, "Recorded upload range is outside the file");
+      if (start < end)
+        addRange(*session, start, end);
+    }
+    session->lastActivity = std::chrono::steady_clock::now();
+
+    UploadResult<UploadSessionInfo> result;
+    result.value = snapshot(*session);
+
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!sessions.emplace(info.id, std::move(session)).second)
+      return uploadFailure<UploadSessionInfo>(UploadError::Conflict, "Upload is already active");
+    return result;
+  }
+
+  std::shared_ptr<UploadSessions::Session> UploadSessions::find(const std::string &id)
+  {
+    expireIdleSessions();
+
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = sessions.find(id);
+    return it == sessions.end() ? nullptr : it->second;
+  }
+
+  void UploadSessions::expireIdleSessions()
+  {
+    auto now = std::chrono::steady_clock::now();
+    std::vector<std::string> expired;
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      // every access comes through here, but a sweep walks all sessions, so they
+      // run at most once per sweep interval
+      if (now < nextSweep)
+        return;
+      nextSweep = now + std::min<std::chrono::steady_clock::duration>(idleTimeout, std::chrono::minutes(1));
+
+      auto cutoff = now - idleTimeout;
+      for (auto it = sessions.begin(); it != sessions.end();)
+      {
+        std::lock_guard<std::mutex> sessionLock(it->second->mutex);
+        if (it->second->committing || it->second->inFlight > 0 || it->second->lastActivity >= cutoff)
+        {
+          ++it;
+          continue;
+        }
+        // a request that found the session before it was dropped sees this flag
+        // instead of writing into a deleted file
+        it->second->expired = true;
+        expired.push_back(it->first);
+        it = sessions.erase(it);
+      }
+    }
+
+    for (const auto &id : expired)
+      FileStorage::deletePartialFile(id);
+  }
+
+  void UploadSessions::addRange(Session &session, int64_t start, int64_t end)
+  {
+    auto &received = session.received;
+
+    // fold in a range that starts before and reaches this one
+    auto it = received.upper_bound(start);
+    if (it != received.begin())
+    {
+      auto previous = std::prev(it);
+      if (previous->second >= start)
+      {
+        start = previous->first;
+        end = std::max(end, previous->second);
+        it = received.erase(previous);
+      }
+    }
+
+    // and every range that starts inside or right after it
+    while (it != received.end() && it->first <= end)
+    {
+      end = std::max(end, it->second);
+      it = received.erase(it);
+    }
+
+    received.emplace(start, end);
+  }
+
+  UploadSessionInfo UploadSessions::snapshot(const Session &session)
+  {
+    UploadSessionInfo info = session.info;
+    info.receivedBytes = 0;
+    info.ranges.assign(session.received.begin(), session.received.end());
+    for (const auto &[start, end] : session.received)
+      info.receivedBytes += end - start;
+    return info;
+  }
+}
@@ -0,0 +1,223 @@
+#include "zip_archive_body.hpp"
+#include <condition_variable>
+#include <deque>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <optional>
+#include <thread>
+
+namespace bytebucket
+{
+  // gzip blobs are written by GzipCompressor: a 10-byte header with no optional
+  // fields, the raw deflate stream, then CRC-32 and size as an 8-byte trailer
+  static constexpr size_t GZIP_HEADER_SIZE = 10;
+  static constexpr size_t GZIP_TRAILER_SIZE = 8;
+  // flush encoder output to the socket in roughly this size
+  static constexpr size_t OUTPUT_TARGET = 128 * 1024;
+
+  struct ZipArchiveBody::writer::ReadAhead
+  {
+    struct Chunk
+    {
+      size_t entry = 0;
+      std::string data;
+      bool begin = false;
+      bool end = false;
+      std::optional<uint32_t> crc; // on a passthrough entry's first chunk
+      bool failed = false;
+      bool finished = false;
+    };
+
+    explicit ReadAhead(size_t capacity) : capacity(capacity == 0 ? 1 : capacity) {}
+
+    // Blocks while the queue is full; false once the consumer has gone away
+    bool push(Chunk chunk)
+    {
+      std::unique_lock<std::mutex> lock(mutex);
+      notFull.wait(lock, [this]()
+                   { return cancelled || chunks.size() < capacity; });
+      if (cancelled)
+        return false;
+      chunks.push_back(std::move(chunk));
+      notEmpty.notify_one();
+      return true;
+    }
+
+    Chunk pop()
+    {
+      std::unique_lock<std::mutex> lock(mutex);
+      notEmpty.wait(lock, [this]()
+                    { return !chunks.empty(); });
+      Chunk chunk = std::move(chunks.front());
+      chunks.pop_front();
+      notFull.notify_one();
+      return chunk;
+    }
+
+    void cancel()
+    {
+      {
+        std::lock_guard<std::mutex> lock(mutex);
+        cancelled = true;
+      }
+      notFull.notify_all();
+    }
+
+    void run(const std::vector<ZipArchiveEntry> &entries)
+    {
+      for (size_t i = 0; i < entries.size(); ++i)
+      {
+        if (!readEntry(i, entries[i]))
+          return;
+      }
+      Chunk finished;
+      finished.finished = true;
+      push(std::move(finished));
+    }
+
+    // false when reading failed (after queueing the failure) or the consumer left
+    bool readEntry(size_t index, const ZipArchiveEntry &entry)
+    {
+      Chunk chunk;
+      chunk.entry = index;
+      chunk.begin = true;
+
+      if (entry.source.empty())
+      {
+        chunk.end = true;
+        return push(std::move(chunk));
+      }
+
+      std::ifstream file(entry.source, std::ios::binary);
+      std::error_code ec;
+      uint64_t fileSize = std::filesystem::file_size(entry.source, ec);
+      if (!file.is_open() || ec)
+        return fail(entry, "can't open blob");
+
+      uint64_t start = 0;
+      uint64_t end = fileSize;
+      if (entry.codec == "gzip")
+      {
+        unsigned char header[GZIP_HEADER_SIZE];
+        unsigned char trailer[GZIP_TRAILER_SIZE];
+        if (fileSize < GZIP_HEADER_SIZE + GZIP_TRAILER_SIZE ||
+            !file.read(reinterpret_cast<char *>(header), GZIP_HEADER_SIZE) ||
+            header[0] != 0x1f || header[1] != 0x8b || header[2] != 8 || header[3] != 0)
+          return fail(entry, "unexpected gzip header");
+
+        file.seekg(static_cast<std::streamoff>(fileSize - GZIP_TRAILER_SIZE));
+        if (!file.read(reinterpret_cast<char *>(trailer), GZIP_TRAILER_SIZE))
+          return fail(entry, "can't read gzip trailer");
+
+        chunk.crc = static_cast<uint32_t>(trailer[0]) | (static_cast<uint32_t>(trailer[1]) << 8) |
+                    (static_cast<uint32_t>(trailer[2]) << 16) | (static_cast<uint32_t>(trailer[3]) << 24);
+        start = GZIP_HEADER_SIZE;
+        end = fileSize - GZIP_TRAILER_SIZE;
+        file.seekg(static_cast<std::streamoff>(start));
+      }
+
+      uint64_t remaining = end - start;
+      do
+      {
+        size_t length = static_cast<size_t>(std::min<uint64_t>(remaining, CHUNK_SIZE));
+        chunk.data.resize(length);
+        if (length > 0 && !file.read(chunk.data.data(), static_cast<std::streamsize>(length)))
+          return fail(entry, "short read");
+        remaining -= length;
+        chunk.end = remaining == 0;
+        if (!push(std::move(chunk)))
+          return false;
+
+        chunk = Chunk{};
+        chunk.entry = index;
+      } while (remaining > 0);
+      return true;
+    }
+
+    bool fail(const ZipArchiveEntry &entry, const char *reason)
+    {
+      std::cerr << "Archive read error for " << entry.path << ": " << reason << std::endl;
+      Chunk failed;
+      failed.failed = true;
+      push(std::move(failed));
+      return false;
+    }
+
+    const size_t capacity;
+    std::deque<Chunk> chunks;
+    std::mutex mutex;
+    std::condition_variable notEmpty;
+    std::condition_variable notFull;
+    bool cancelled = false;
+    std::thread reader;
+  };
+
+  ZipArchiveBody::writer::~writer()
+  {
+    if (readAhead)
+    {
+      readAhead->cancel();
+      if (readAhead->reader.joinable())
+        readAhead->reader.join();
+    }
+  }
+
+  void ZipArchiveBody::writer::init(boost::beast::error_code &ec)
+  {
+    encoder = std::make_unique<ZipEncoder>(body.deflateLevel);
+    readAhead = std::make_shared<ReadAhead>(body.readAheadChunks);
+    readAhead->reader = std::thread([state = readAhead.get(), &entries = body.entries]()
+                                    { state->run(entries); });
+    ec = {};
+  }
+
+  boost::optional<std::pair<ZipArchiveBody::writer::const_buffers_type, bool>>
+  ZipArchiveBody::writer::get(boost::beast::error_code &ec)
+  {
+    ec = {};
+    output.clear();
+
+    while (!done && output.size() < OUTPUT_TARGET)
+    {
+      auto chunk = readAhead->pop();
+      if (chunk.failed)
+      {
+        ec = boost::beast::errc::make_error_code(boost::beast::errc::io_error);
+        return boost::none;
+      }
+      if (chunk.finished)
+      {
+        encoder->finish(output);
+        done = true;
+        break;
+      }
+
+      const ZipArchiveEntry &entry = body.entries[chunk.entry];
+      if (chunk.begin)
+      {
+        ZipMethod method = ZipMethod::Stored;
+        if (entry.codec == "gzip")
+          method = ZipMethod::DeflatePassthrough;
+        else if (entry.deflate && !entry.source.empty())
+          method = ZipMethod::Deflate;
+
+        if (!encoder->beginEntry(entry.path, method, entry.size, entry.modified, chunk.crc, output))
+        {
+          ec = boost::beast::errc::make_error_code(boost::beast::errc::invalid_argument);
+          return boost::none;
+        }
+      }
+
+      if (!encoder->write(chunk.data, output) || (chunk.end && !encoder->endEntry(output)))
+      {
+        ec = boost::beast::errc::make_error_code(boost::beast::errc::value_too_large);
+        return boost::none;
+      }
+    }
+
+    if (output.empty())
+      return boost::none;
+    return {{const_buffers_type(output.data(), output.size()), !done}};
+  }
+}
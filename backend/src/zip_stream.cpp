@@ -0,0 +1,295 @@
+#include "zip_stream.hpp"
+#include <ctime>
+
+namespace bytebucket
+{
+  static constexpr uint32_t LOCAL_HEADER_SIGNATURE = 0x04034b50;
+  static constexpr uint32_t DATA_DESCRIPTOR_SIGNATURE = 0x08074b50;
+  static constexpr uint32_t CENTRAL_HEADER_SIGNATURE = 0x02014b50;
+  static constexpr uint32_t ZIP64_END_SIGNATURE = 0x06064b50;
+  static constexpr uint32_t ZIP64_LOCATOR_SIGNATURE = 0x07064b50;
+  static constexpr uint32_t END_SIGNATURE = 0x06054b50;
+
+  static constexpr uint16_t FLAG_DATA_DESCRIPTOR = 0x0008;
+  static constexpr uint16_t FLAG_UTF8 = 0x0800;
+  static constexpr uint16_t VERSION_DEFAULT = 20;
+  static constexpr uint16_t VERSION_ZIP64 = 45;
+  static constexpr uint16_t MADE_BY_UNIX = 3 << 8;
+
+  static constexpr uint32_t MAX32 = 0xFFFFFFFF;
+  static constexpr uint16_t MAX16 = 0xFFFF;
+  // deflate can grow incompressible data slightly, so entries near 4 GiB go ZIP64 early
+  static constexpr uint64_t ZIP64_ENTRY_THRESHOLD = 0xF0000000;
+  static constexpr size_t DEFLATE_CHUNK = 64 * 1024;
+
+  static void put16(std::string &out, uint16_t value)
+  {
+    out.push_back(static_cast<char>(value & 0xFF));
+    out.push_back(static_cast<char>((value >> 8) & 0xFF));
+  }
+
+  static void put32(std::string &out, uint32_t value)
+  {
+    for (int shift = 0; shift < 32; shift += 8)
+      out.push_back(static_cast<char>((value >> shift) & 0xFF));
+  }
+
+  static void put64(std::string &out, uint64_t value)
+  {
+    for (int shift = 0; shift < 64; shift += 8)
+      out.push_back(static_cast<char>((value >> shift) & 0xFF));
+  }
+
+  static void toDosTime(std::chrono::system_clock::time_point when, uint16_t &dosTime, uint16_t &dosDate)
+  {
+    std::time_t seconds = std::chrono::system_clock::to_time_t(when);
+    std::tm utc{};
+    gmtime_r(&seconds, &utc);
+    if (utc.tm_year < 80) // DOS dates start in 1980
+    {
+      dosTime = 0;
+      dosDate = (1 << 5) | 1;
+      return;
+    }
+    dosTime = static_cast<uint16_t>((utc.tm_hour << 11) | (utc.tm_min << 5) | (utc.tm_sec / 2));
+    dosDate = static_cast<uint16_t>(((utc.tm_year - 80) << 9) | ((utc.tm_mon + 1) << 5) | utc.tm_mday);
+  }
+
+  ZipEncoder::ZipEncoder(int deflateLevel) : level(deflateLevel)
+  {
+  }
+
+  ZipEncoder::~ZipEncoder()
+  {
+    if (deflateReady)
+      deflateEnd(&stream);
+  }
+
+  void ZipEncoder::emit(std::string &out, std::string_view bytes)
+  {
+    out.append(bytes.data(), bytes.size());
+    offset += bytes.size();
+  }
+
+  bool ZipEncoder::beginEntry(const std::string &path, ZipMethod method, uint64_t size,
+                              std::chrono::system_clock::time_point modified,
+                              std::optional<uint32_t> crc, std::string &out)
+  {
+    if (current.has_value() || (method == ZipMethod::DeflatePassthrough && !crc.has_value()))
+      return false;
+
+    CentralRecord record{};
+    record.path = path;
+    record.method = method;
+    toDosTime(modified, record.dosTime, record.dosDate);
+    record.crc = crc.value_or(0);
+    record.uncompressedSize = method == ZipMethod::DeflatePassthrough ? size : 0;
+    record.localHeaderOffset = offset;
+    // an empty stored entry is fully known now and needs no descriptor
+    record.descriptor = !(method == ZipMethod::Stored && size == 0);
+    record.zip64Local = size >= ZIP64_ENTRY_THRESHOLD;
+
+    if (method == ZipMethod::Deflate)
+    {
+      if (!deflateReady)
+      {
+        // negative windowBits: raw deflate, as ZIP expects
+        if (deflateInit2(&stream, level, Z_DEFLATED, -15, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+          return false;
+        deflateReady = true;
+      }
+      else if (deflateReset(&stream) != Z_OK)
+        return false;
+    }
+
+    std::string header;
+    put32(header, LOCAL_HEADER_SIGNATURE);
+    put16(header, record.zip64Local ? VERSION_ZIP64 : VERSION_DEFAULT);
+    put16(header, FLAG_UTF8 | (record.descriptor ? FLAG_DATA_DESCRIPTOR : 0));
+    put16(header, method == ZipMethod::Stored ? 0 : 8);
+    put16(header, record.dosTime);
+    put16(header, record.dosDate);
+    put32(header, 0); // CRC and sizes follow in the data descriptor
+    put32(header, record.zip64Local ? MAX32 : 0);
+    put32(header, record.zip64Local ? MAX32 : 0);
+    put16(header, static_cast<uint16_t>(path.size()));
+    put16(header, record.zip64Local ? 20 : 0);
+    header += path;
+    if (record.zip64Local)
+    {
+      put16(header, 0x0001);
+      put16(header, 16);
+      put64(header, 0);
+      put64(header, 0);
+    }
+    emit(out, header);
+
+    current = std::move(record);
+    return true;
+  }
+
+  bool ZipEncoder::write(std::string_view data, std::string &out)
+  {
+    if (!current.has_value())
+      return false;
+
+    switch (current->method)
+    {
+    case ZipMethod::Stored:
+      current->crc = static_cast<uint32_t>(crc32_z(current->crc, reinterpret_cast<const Bytef *>(data.data()), data.size()));
+      current->uncompressedSize += data.size();
+      current->compressedSize += data.size();
+      emit(out, data);
+      return true;
+    case ZipMethod::Deflate:
+      current->crc = static_cast<uint32_t>(crc32_z(current->crc, reinterpret_cast<const Bytef *>(data.data()), data.size()));
+      current->uncompressedSize += data.size();
+      return deflateInto(data, Z_NO_FLUSH, out);
+    case ZipMethod::DeflatePassthrough:
+      current->compressedSize += data.size();
+      emit(out, data);
+      return true;
+    }
+    return false;
+  }
+
+  bool ZipEncoder::deflateInto(std::string_view data, int flush, std::string &out)
+  {
+    stream.next_in = reinterpret_cast<Bytef *>(const_cast<char *>(data.data()));
+    stream.avail_in = static_cast<uInt>(data.size());
+    do
+    {
+      size_t used = out.size();
+      out.resize(used + DEFLATE_CHUNK);
+      stream.next_out = reinterpret_cast<Bytef *>(&out[used]);
+      stream.avail_out = static_cast<uInt>(DEFLATE_CHUNK);
+
+      int returnCode = deflate(&stream, flush);
+      size_t produced = DEFLATE_CHUNK - stream.avail_out;
+      out.resize(used + produced);
+      offset += produced;
+      current->compressedSize += produced;
+      if (returnCode == Z_STREAM_ERROR)
+        return false;
+      if (returnCode == Z_STREAM_END)
+        return true;
+    } while (stream.avail_out == 0 || stream.avail_in > 0);
+    return true;
+  }
+
+  bool ZipEncoder::endEntry(std::string &out)
+  {
+    if (!current.has_value())
+      return false;
+    if (current->method == ZipMethod::Deflate && !deflateInto({}, Z_FINISH, out))
+      return false;
+
+    if (current->descriptor)
+    {
+      std::string descriptor;
+      put32(descriptor, DATA_DESCRIPTOR_SIGNATURE);
+      put32(descriptor, current->crc);
+      if (current->zip64Local)
+      {
+        put64(descriptor, current->compressedSize);
+        put64(descriptor, current->uncompressedSize);
+      }
+      else
+      {
+        // the entry outgrew the classic fields without having announced ZIP64
+        if (current->compressedSize >= MAX32 || current->uncompressedSize >= MAX32)
+          return false;
+        put32(descriptor, static_cast<uint32_t>(current->compressedSize));
+        put32(descriptor, static_cast<uint32_t>(current->uncompressedSize));
+      }
+      emit(out, descriptor);
+    }
+
+    entries.push_back(std::move(current.value()));
+    current.reset();
+    return true;
+  }
+
+  void ZipEncoder::finish(std::string &out)
+  {
+    uint64_t directoryOffset = offset;
+
+    for (const auto &entry : entries)
+    {
+      bool bigUncompressed = entry.uncompressedSize >= MAX32;
+      bool bigCompressed = entry.compressedSize >= MAX32;
+      bool bigOffset = entry.localHeaderOffset >= MAX32;
+      uint16_t extraSize = static_cast<uint16_t>((bigUncompressed + bigCompressed + bigOffset) * 8);
+      bool zip64 = extraSize > 0 || entry.zip64Local;
+      bool directory = !entry.path.empty() && entry.path.back() == '/';
+
+      std::string header;
+      put32(header, CENTRAL_HEADER_SIGNATURE);
+      put16(header, MADE_BY_UNIX | VERSION_ZIP64);
+      put16(header, zip64 ? VERSION_ZIP64 : VERSION_DEFAULT);
+      put16(header, FLAG_UTF8 | (entry.descriptor ? FLAG_DATA_DESCRIPTOR : 0));
+      put16(header, entry.method == ZipMethod::Stored ? 0 : 8);
+      put16(header, entry.dosTime);
+      put16(header, entry.dosDate);
+      put32(header, entry.crc);
+      put32(header, bigCompressed ? MAX32 : static_cast<uint32_t>(entry.compressedSize));
+      put32(header, bigUncompressed ? MAX32 : static_cast<uint32_t>(entry.uncompressedSize));
+      put16(header, static_cast<uint16_t>(entry.path.size()));
+      put16(header, extraSize > 0 ? static_cast<uint16_t>(extraSize + 4) : 0);
+      put16(header, 0); // comment
+      put16(header, 0); // disk
+      put16(header, 0); // internal attributes
+      // unix mode in the high half; 0x10 marks a directory for DOS readers
+      put32(header, directory ? ((040755u << 16) | 0x10) : (0100644u << 16));
+      put32(header, bigOffset ? MAX32 : static_cast<uint32_t>(entry.localHeaderOffset));
+      header += entry.path;
+      if (extraSize > 0)
+      {
+        put16(header, 0x0001);
+        put16(header, extraSize);
+        if (bigUncompressed)
+          put64(header, entry.uncompressedSize);
+        if (bigCompressed)
+          put64(header, entry.compressedSize);
+        if (bigOffset)
+          put64(header, entry.localHeaderOffset);
+      }
+      emit(out, header);
+    }
+
+    uint64_t directorySize = offset - directoryOffset;
+    uint64_t count = entries.size();
+    bool zip64End = count >= MAX16 || directoryOffset >= MAX32 || directorySize >= MAX32;
+
+    std::string end;
+    if (zip64End)
+    {
+      uint64_t zip64EndOffset = offset;
+      put32(end, ZIP64_END_SIGNATURE);
+      put64(end, 44); // size of the rest of this record
+      put16(end, MADE_BY_UNIX | VERSION_ZIP64);
+      put16(end, VERSION_ZIP64);
+      put32(end, 0);
+      put32(end, 0);
+      put64(end, count);
+      put64(end, count);
+      put64(end, directorySize);
+      put64(end, directoryOffset);
+
+      put32(end, ZIP64_LOCATOR_SIGNATURE);
+      put32(end, 0);
+      put64(end, zip64EndOffset);
+      put32(end, 1);
+    }
+
+    put32(end, END_SIGNATURE);
+    put16(end, 0);
+    put16(end, 0);
+    put16(end, zip64End ? MAX16 : static_cast<uint16_t>(count));
+    put16(end, zip64End ? MAX16 : static_cast<uint16_t>(count));
+    put32(end, zip64End ? MAX32 : static_cast<uint32_t>(directorySize));
+    put32(end, zip64End ? MAX32 : static_cast<uint32_t>(directoryOffset));
+    put16(end, 0); // comment
+    emit(out, end);
+  }
+}
@@ -0,0 +1,192 @@
+#include <catch2/catch_test_macros.hpp>
+#include "access_log.hpp"
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace bytebucket;
+
+static std::vector<std::string> readLines(const std::string &path)
+{
+  std::vector<std::string> lines;
+  std::ifstream in(path);
+  for (std::string line; std::getline(in, line);)
+    lines.push_back(line);
+  return lines;
+}
+
+static void removeLogs(const std::string &path)
+{
+  std::error_code ec;
+  std::filesystem::remove(path, ec);
+  for (int i = 1; i <= 5; ++i)
+    std::filesystem::remove(path + "." + std::to_string(i), ec);
+}
+
+static LogRecord accessRecord(std::string_view target, unsigned status = 200)
+{
+  LogRecord record;
+  record.time = std::chrono::system_clock::now();
+  record.status = static_cast<uint16_t>(status);
+  record.bytesIn = 10;
+  record.bytesOut = 20;
+  record.durationMicros = 30;
+  LogRecord::copy(record.method, "GET");
+  LogRecord::copy(record.remote, "127.0.0.1");
+  LogRecord::copy(record.route, "/download/{id}");
+  LogRecord::copy(record.target, target);
+  return record;
+}
+
+TEST_CASE("AccessLog", "[access_log]")
+{
+  const std::string path = "test_access.log";
+  removeLogs(path);
+
+  SECTION("Records are written as JSON lines once flushed")
+  {
+    AccessLog::Options options;
+    options.path = path;
+    auto log = AccessLog::create(options);
+    REQUIRE(log != nullptr);
+
+    REQUIRE(log->push(accessRecord("/download/7", 404)));
+    REQUIRE(log->event("startup", "ready"));
+    log->flush();
+
+    auto lines = readLines(path);
+    REQUIRE(lines.size() == 2);
+    REQUIRE(lines[0].rfind("{\"time\":\"", 0) == 0);
+    REQUIRE(lines[0].find("\"remote\":\"127.0.0.1\",\"method\":\"GET\",\"target\":\"/download/7\","
+                          "\"route\":\"/download/{id}\",\"status\":404,\"bytes_in\":10,\"bytes_out\":20,"
+                          "\"duration_us\":30}") != std::string::npos);
+    REQUIRE(lines[1].find("\"event\":\"startup\",\"message\":\"ready\"}") != std::string::npos);
+    REQUIRE(log->stats().written == 2);
+  }
+
+  SECTION("Strings are escaped and truncated to fit")
+  {
+    AccessLog::Options options;
+    options.path = path;
+    auto log = AccessLog::create(options);
+    REQUIRE(log != nullptr);
+
+    REQUIRE(log->push(accessRecord("/a\"b\\c\n" + std::string(500, 'x'))));
+    log->flush();
+
+    auto lines = readLines(path);
+    REQUIRE(lines.size() == 1);
+    REQUIRE(lines[0].find("\"target\":\"/a\\\"b\\\\c\\u000a") != std::string::npos);
+    REQUIRE(lines[0].find(std::string(152, 'x') + "\",") != std::string::npos);
+    REQUIRE(lines[0].find(std::string(153, 'x')) == std::string::npos);
+  }
+
+  SECTION("Truncation doesn't split a UTF-8 sequence")
+  {
+    // 158 ASCII bytes leave one byte of room, not enough for the two-byte 'é'
+    LogRecord record;
+    LogRecord::copy(record.target, std::string(158, 'x') + "\xc3\xa9tail");
+    REQUIRE(std::string_view(record.target.data()) == std::string(158, 'x'));
+
+    LogRecord::copy(record.target, std::string(157, 'x') + "\xc3\xa9tail");
+    REQUIRE(std::string_view(record.target.data()) == std::string(157, 'x') + "\xc3\xa9");
+  }
+
+  SECTION("Records from many threads all arrive")
+  {
+    AccessLog::Options options;
+    options.path = path;
+    options.ringCapacity = 4096;
+    auto log = AccessLog::create(options);
+    REQUIRE(log != nullptr);
+
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 8; ++t)
+      threads.emplace_back([&log]()
+                           {
+        for (int i = 0; i < 1000; ++i)
+          log->push(accessRecord("/health")); });
+    for (auto &thread : threads)
+      thread.join();
+    log->flush();
+
+    REQUIRE(log->stats().dropped == 0);
+    REQUIRE(log->stats().written == 8000);
+    REQUIRE(readLines(path).size() == 8000);
+  }
+
+  SECTION("A full ring drops records and the log says so")
+  {
+    AccessLog::Options options;
+    options.path = path;
+    options.ringCapacity = 2;
+    options.flushInterval = std::chrono::hours(1);
+    auto log = AccessLog::create(options);
+    REQUIRE(log != nullptr);
+
+    REQUIRE(log->push(accessRecord("/1")));
+    REQUIRE(log->push(accessRecord("/2")));
+    REQUIRE_FALSE(log->push(accessRecord("/3")));
+    REQUIRE_FALSE(log->push(accessRecord("/4")));
+    log->flush();
+
+    auto lines = readLines(path);
+    REQUIRE(lines.size() == 3);
+    REQUIRE(lines[2].find("\"event\":\"log_dropped\",\"message\":\"2 records dropped") != std::string::npos);
+    REQUIRE(log->stats().dropped == 2);
+
+    // the ring has room again once drained
+    REQUIRE(log->push(accessRecord("/5")));
+  }
+
+  SECTION("The file rotates once it passes maxBytes")
+  {
+    AccessLog::Options options;
+    options.path = path;
+    options.maxBytes = 1024;
+    options.keepFiles = 2;
+    auto log = AccessLog::create(options);
+    REQUIRE(log != nullptr);
+
+    for (int i = 0; i < 30; ++i)
+    {
+      log->push(accessRecord("/download/" + std::to_string(i)));
+      log->flush();
+    }
+
+    REQUIRE(log->stats().rotations >= 2);
+    REQUIRE(std::filesystem::exists(path + ".1"));
+    REQUIRE(std::filesystem::exists(path + ".2"));
+    REQUIRE_FALSE(std::filesystem::exists(path + ".3"));
+    REQUIRE(std::filesystem::file_size(path) <= 1024);
+    auto lines = readLines(path);
+    REQUIRE_FALSE(lines.empty());
+    REQUIRE(lines.back().find("/download/29") != std::string::npos);
+  }
+
+  SECTION("Destroying the log writes what's still queued")
+  {
+    AccessLog::Options options;
+    options.path = path;
+    options.flushInterval = std::chrono::hours(1);
+    {
+      auto log = AccessLog::create(options);
+      REQUIRE(log != nullptr);
+      REQUIRE(log->push(accessRecord("/last")));
+    }
+    auto lines = readLines(path);
+    REQUIRE(lines.size() == 1);
+    REQUIRE(lines[0].find("/last") != std::string::npos);
+  }
+
+  SECTION("An unwritable path fails to create")
+  {
+    AccessLog::Options options;
+    options.path = "no_such_directory/access.log";
+    REQUIRE(AccessLog::create(options) == nullptr);
+  }
+
+  removeLogs(path);
+}
@@ -0,0 +1,130 @@
+#include <catch2/catch_test_macros.hpp>
+#include "admission_control.hpp"
+#include "request_handler.hpp"
+#include <future>
+#include <thread>
+
+using namespace bytebucket;
+using boost::beast::http::verb;
+
+TEST_CASE("Route classes", "[admission]")
+{
+  REQUIRE(AdmissionControl::classify(verb::post, "/upload") == RouteClass::Upload);
+  REQUIRE(AdmissionControl::classify(verb::post, "/upload?folder_id=3") == RouteClass::Upload);
+  REQUIRE(AdmissionControl::classify(verb::post, "/uploads") == RouteClass::Upload);
+  REQUIRE(AdmissionControl::classify(verb::put, "/uploads/abc/chunks/0") == RouteClass::Upload);
+  REQUIRE(AdmissionControl::classify(verb::post, "/uploads/abc/complete") == RouteClass::Upload);
+  REQUIRE(AdmissionControl::classify(verb::get, "/uploads/abc") == RouteClass::Metadata);
+
+  REQUIRE(AdmissionControl::classify(verb::get, "/download/7") == RouteClass::Download);
+  REQUIRE(AdmissionControl::classify(verb::get, "/folder/2/archive") == RouteClass::Download);
+  REQUIRE(AdmissionControl::classify(verb::get, "/folder/2") == RouteClass::Metadata);
+
+  REQUIRE(AdmissionControl::classify(verb::post, "/files/7/tags") == RouteClass::Metadata);
+  REQUIRE(AdmissionControl::classify(verb::delete_, "/folder/2") == RouteClass::Metadata);
+
+  REQUIRE(AdmissionControl::classify(verb::get, "/health") == RouteClass::Control);
+  REQUIRE(AdmissionControl::classify(verb::get, "/metrics") == RouteClass::Control);
+  REQUIRE(AdmissionControl::classify(verb::get, "/debug/traces?id=4") == RouteClass::Control);
+  REQUIRE(AdmissionControl::classify(verb::options, "/upload") == RouteClass::Control);
+}
+
+TEST_CASE("Admission limits", "[admission]")
+{
+  AdmissionLimits limits;
+  limits.maxConnections = 2;
+  limits.maxUploads = 1;
+  limits.maxDownloads = 0;
+  limits.maxQueued = 1;
+  limits.queueWait = std::chrono::milliseconds(20);
+  auto admission = AdmissionControl::create(limits);
+
+  SECTION("Connections over the cap are refused until one closes")
+  {
+    auto first = admission->admitConnection();
+    auto second = admission->admitConnection();
+    REQUIRE(first);
+    REQUIRE(second);
+    REQUIRE_FALSE(admission->admitConnection());
+
+    second.reset();
+    REQUIRE(admission->admitConnection());
+    REQUIRE(admission->stats().connections.rejected == 1);
+  }
+
+  SECTION("A full class sheds after waiting out the queue")
+  {
+    auto upload = admission->admitRequest(RouteClass::Upload);
+    REQUIRE(upload);
+
+    auto started = std::chrono::steady_clock::now();
+    REQUIRE_FALSE(admission->admitRequest(RouteClass::Upload));
+    REQUIRE(std::chrono::steady_clock::now() - started >= std::chrono::milliseconds(20));
+
+    // other classes have their own limits
+    REQUIRE(admission->admitRequest(RouteClass::Metadata));
+
+    auto stats = admission->stats().requests[static_cast<size_t>(RouteClass::Upload)];
+    REQUIRE(stats.limit == 1);
+    REQUIRE(stats.inFlight == 1);
+    REQUIRE(stats.rejected == 1);
+  }
+
+  SECTION("A queued request takes the slot that frees up")
+  {
+    limits.queueWait = std::chrono::seconds(5);
+    admission = AdmissionControl::create(limits);
+    auto upload = admission->admitRequest(RouteClass::Upload);
+
+    auto queued = std::async(std::launch::async, [&admission]()
+                             { return admission->admitRequest(RouteClass::Upload).has_value(); });
+    while (admission->stats().requests[static_cast<size_t>(RouteClass::Upload)].queued == 0)
+      std::this_thread::yield();
+
+    // the queue holds one, so a third is shed without waiting
+    auto started = std::chrono::steady_clock::now();
+    REQUIRE_FALSE(admission->admitRequest(RouteClass::Upload));
+    REQUIRE(std::chrono::steady_clock::now() - started < std::chrono::seconds(1));
+
+    upload.reset();
+    REQUIRE(queued.get());
+    REQUIRE(admission->stats().requests[static_cast<size_t>(RouteClass::Upload)].waited == 1);
+  }
+
+  SECTION("Unlimited and control classes always admit")
+  {
+    std::vector<AdmissionControl::Ticket> held;
+    for (int i = 0; i < 500; ++i)
+    {
+      auto download = admission->admitRequest(RouteClass::Download);
+      REQUIRE(download);
+      held.push_back(std::move(*download));
+    }
+    REQUIRE(admission->stats().requests[static_cast<size_t>(RouteClass::Download)].inFlight == 500);
+    REQUIRE(admission->admitRequest(RouteClass::Control));
+  }
+
+  SECTION("Limits and queue depths are reported by /metrics")
+  {
+    setAdmissionControl(admission);
+    auto upload = admission->admitRequest(RouteClass::Upload);
+
+    boost::beast::http::request<boost::beast::http::string_body> req{verb::get, "/metrics", 11};
+    std::string body = handle_get_metrics(req).body();
+    setAdmissionControl(nullptr);
+
+    REQUIRE(body.find("bytebucket_admission_limit{class=\"connections\"} 2") != std::string::npos);
+    REQUIRE(body.find("bytebucket_admission_in_flight{class=\"upload\"} 1") != std::string::npos);
+    REQUIRE(body.find("bytebucket_admission_queue_depth{class=\"download\"} 0") != std::string::npos);
+    REQUIRE(body.find("bytebucket_admission_rejected_total{class=\"metadata\"} 0") != std::string::npos);
+  }
+}
+
+TEST_CASE("Overloaded responses", "[admission]")
+{
+  auto response = create_overloaded_response(11, std::chrono::seconds(3));
+
+  REQUIRE(response.result() == boost::beast::http::status::service_unavailable);
+  REQUIRE(response[boost::beast::http::field::retry_after] == "3");
+  REQUIRE(response[boost::beast::http::field::content_type] == "application/json");
+}
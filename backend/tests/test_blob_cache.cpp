@@ -0,0 +1,126 @@
+#include <catch2/catch_test_macros.hpp>
+#include "blob_cache.hpp"
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace bytebucket;
+
+static BlobCache::Blob makeBlob(size_t size, char fill = 'x')
+{
+  return std::make_shared<const std::vector<char>>(size, fill);
+}
+
+TEST_CASE("BlobCache", "[blob_cache]")
+{
+  SECTION("Hits return the stored blob and are counted")
+  {
+    auto cache = BlobCache::create(1024, 512, 1);
+    REQUIRE(cache->get("a") == nullptr);
+    REQUIRE(cache->put("a", makeBlob(100, 'a')));
+
+    auto blob = cache->get("a");
+    REQUIRE(blob != nullptr);
+    REQUIRE(blob->size() == 100);
+    REQUIRE((*blob)[0] == 'a');
+
+    auto stats = cache->stats();
+    REQUIRE(stats.hits == 1);
+    REQUIRE(stats.misses == 1);
+    REQUIRE(stats.insertions == 1);
+    REQUIRE(stats.entries == 1);
+    REQUIRE(stats.bytes == 100);
+  }
+
+  SECTION("Blobs over the entry limit aren't cached")
+  {
+    auto cache = BlobCache::create(1024, 100, 1);
+    REQUIRE_FALSE(cache->put("big", makeBlob(101)));
+    REQUIRE(cache->get("big") == nullptr);
+    REQUIRE(cache->stats().entries == 0);
+  }
+
+  SECTION("The byte budget is never exceeded")
+  {
+    auto cache = BlobCache::create(1000, 300, 1);
+    for (int i = 0; i < 20; ++i)
+      cache->put("k" + std::to_string(i), makeBlob(250));
+
+    auto stats = cache->stats();
+    REQUIRE(stats.bytes <= 1000);
+    REQUIRE(stats.entries == 4);
+    REQUIRE(stats.evictions == 16);
+    REQUIRE(cache->get("k19") != nullptr);
+    REQUIRE(cache->get("k0") == nullptr);
+  }
+
+  SECTION("Blobs read twice survive a scan of one-off blobs")
+  {
+    auto cache = BlobCache::create(1000, 100, 1);
+    cache->put("hot", makeBlob(100));
+    REQUIRE(cache->get("hot") != nullptr);
+
+    for (int i = 0; i < 50; ++i)
+      cache->put("scan" + std::to_string(i), makeBlob(100));
+
+    REQUIRE(cache->get("hot") != nullptr);
+  }
+
+  SECTION("Replacing a key keeps the byte count right")
+  {
+    auto cache = BlobCache::create(1000, 500, 1);
+    cache->put("a", makeBlob(100));
+    cache->get("a");
+    cache->put("a", makeBlob(300, 'b'));
+
+    auto stats = cache->stats();
+    REQUIRE(stats.entries == 1);
+    REQUIRE(stats.bytes == 300);
+    REQUIRE((*cache->get("a"))[0] == 'b');
+  }
+
+  SECTION("Erase and clear invalidate entries")
+  {
+    auto cache = BlobCache::create(4096, 512);
+    cache->put("a", makeBlob(10));
+    cache->put("b", makeBlob(10));
+    cache->put("c", makeBlob(10));
+
+    cache->erase("a");
+    cache->erase("missing");
+    REQUIRE(cache->get("a") == nullptr);
+    REQUIRE(cache->stats().invalidations == 1);
+
+    cache->clear();
+    auto stats = cache->stats();
+    REQUIRE(stats.entries == 0);
+    REQUIRE(stats.bytes == 0);
+    REQUIRE(stats.invalidations == 3);
+  }
+
+  SECTION("Concurrent readers and writers keep the counters consistent")
+  {
+    auto cache = BlobCache::create(64 * 1024, 1024, 8);
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 8; ++t)
+    {
+      threads.emplace_back([&cache, t]()
+                           {
+        for (int i = 0; i < 2000; ++i)
+        {
+          std::string key = "k" + std::to_string((i * 7 + t) % 200);
+          if (!cache->get(key))
+            cache->put(key, makeBlob(512));
+          if (i % 97 == 0)
+            cache->erase(key);
+        } });
+    }
+    for (auto &thread : threads)
+      thread.join();
+
+    auto stats = cache->stats();
+    REQUIRE(stats.hits + stats.misses == 8 * 2000);
+    REQUIRE(stats.bytes == stats.entries * 512);
+    REQUIRE(stats.bytes <= stats.capacityBytes);
+  }
+}
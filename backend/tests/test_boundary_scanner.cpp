@@ -0,0 +1,108 @@
+#include <catch2/catch_test_macros.hpp>
+#include "boundary_scanner.hpp"
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <random>
+#include <string>
+
+using namespace bytebucket;
+
+TEST_CASE("BoundaryScanner finds the same matches as std::string_view::find", "[boundary_scanner]")
+{
+  SECTION("Edge cases")
+  {
+    BoundaryScanner scanner("--abc");
+    REQUIRE(scanner.find("") == std::string_view::npos);
+    REQUIRE(scanner.find("--ab") == std::string_view::npos);
+    REQUIRE(scanner.find("--abc") == 0);
+    REQUIRE(scanner.find("x--abc", 1) == 1);
+    REQUIRE(scanner.find("--abc", 1) == std::string_view::npos);
+    REQUIRE(scanner.find("--abc", 10) == std::string_view::npos);
+
+    BoundaryScanner single("x");
+    REQUIRE(single.find("aaxa") == 2);
+    REQUIRE(single.find("aaaa") == std::string_view::npos);
+
+    BoundaryScanner empty("");
+    REQUIRE(empty.find("abc", 2) == 2);
+  }
+
+  SECTION("Matches at every offset around the 16-byte block edges")
+  {
+    std::string needle = "------WebKitFormBoundary7MA4YWxkTrZu0gW";
+    BoundaryScanner scanner(needle);
+    for (size_t offset = 0; offset < 80; ++offset)
+    {
+      std::string haystack(offset, 'x');
+      haystack += needle;
+      haystack += std::string(offset % 17, 'y');
+      REQUIRE(scanner.find(haystack) == offset);
+      REQUIRE(scanner.find(haystack, offset + 1) == std::string_view::npos);
+    }
+  }
+
+  SECTION("Randomised comparison over a small alphabet")
+  {
+    // a two-letter alphabet forces many partial first/last byte matches
+    std::mt19937 rng(1234);
+    std::uniform_int_distribution<int> letter(0, 1);
+    std::uniform_int_distribution<size_t> length(0, 300);
+
+    for (int round = 0; round < 500; ++round)
+    {
+      std::string needle(1 + round % 24, 'a');
+      for (auto &c : needle)
+        c = static_cast<char>('a' + letter(rng));
+      std::string haystack(length(rng), 'a');
+      for (auto &c : haystack)
+        c = static_cast<char>('a' + letter(rng));
+
+      BoundaryScanner scanner(needle);
+      std::string_view view(haystack);
+      for (size_t from = 0; from <= haystack.size(); from += 7)
+        REQUIRE(scanner.find(view, from) == view.find(needle, from));
+    }
+  }
+}
+
+// Hidden by default; run with: bytebucket_tests "[.benchmark][boundary_scanner]"
+// BYTEBUCKET_BENCH_MB sets the payload size (default 1024).
+TEST_CASE("BoundaryScanner throughput", "[.benchmark][boundary_scanner]")
+{
+  size_t megabytes = 1024;
+  if (const char *env = std::getenv("BYTEBUCKET_BENCH_MB"))
+    megabytes = std::strtoul(env, nullptr, 10);
+
+  std::string payload(megabytes * 1024 * 1024, '\0');
+  std::mt19937_64 rng(42);
+  for (size_t i = 0; i + 8 <= payload.size(); i += 8)
+  {
+    uint64_t value = rng();
+    std::memcpy(&payload[i], &value, 8);
+  }
+
+  std::string needle = "\r\n------WebKitFormBoundary7MA4YWxkTrZu0gW";
+  payload.replace(payload.size() - needle.size(), needle.size(), needle);
+  std::string_view view(payload);
+  BoundaryScanner scanner(needle);
+
+  auto measure = [&](const char *label, auto &&search)
+  {
+    auto start = std::chrono::steady_clock::now();
+    size_t found = search();
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::cout << label << ": " << (static_cast<double>(payload.size()) / (1024.0 * 1024.0 * 1024.0)) / seconds
+              << " GB/s" << std::endl;
+    return found;
+  };
+
+  size_t expected = measure("std::string_view::find", [&]()
+                            { return view.find(needle); });
+  size_t actual = measure("BoundaryScanner::find", [&]()
+                          { return scanner.find(view); });
+  REQUIRE(actual == expected);
+  REQUIRE(actual == payload.size() - needle.size());
+}
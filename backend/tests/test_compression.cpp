@@ -0,0 +1,178 @@
+#include <catch2/catch_test_macros.hpp>
+#include "compression.hpp"
+#include "database.hpp"
+#include "file_storage.hpp"
+#include "request_handler.hpp"
+#include "test_helpers.hpp"
+#include "test_helpers_database.hpp"
+#include <future>
+#include <random>
+#include <string>
+
+using namespace bytebucket;
+
+static std::string gunzip(const std::string &compressed)
+{
+  z_stream stream{};
+  REQUIRE(inflateInit2(&stream, 15 + 16) == Z_OK);
+  stream.next_in = reinterpret_cast<Bytef *>(const_cast<char *>(compressed.data()));
+  stream.avail_in = static_cast<uInt>(compressed.size());
+
+  std::string out;
+  int returnCode = Z_OK;
+  while (returnCode == Z_OK)
+  {
+    char buffer[16384];
+    stream.next_out = reinterpret_cast<Bytef *>(buffer);
+    stream.avail_out = sizeof(buffer);
+    returnCode = inflate(&stream, Z_NO_FLUSH);
+    out.append(buffer, sizeof(buffer) - stream.avail_out);
+  }
+  inflateEnd(&stream);
+  REQUIRE(returnCode == Z_STREAM_END);
+  return out;
+}
+
+TEST_CASE("Accept-Encoding negotiation", "[compression]")
+{
+  REQUIRE(acceptsEncoding("gzip", "gzip"));
+  REQUIRE(acceptsEncoding("deflate, gzip;q=0.5, br", "gzip"));
+  REQUIRE(acceptsEncoding(" GZIP ", "gzip"));
+  REQUIRE(acceptsEncoding("*", "gzip"));
+  REQUIRE_FALSE(acceptsEncoding("", "gzip"));
+  REQUIRE_FALSE(acceptsEncoding("br, deflate", "gzip"));
+  REQUIRE_FALSE(acceptsEncoding("gzip;q=0", "gzip"));
+  REQUIRE_FALSE(acceptsEncoding("*, gzip;q=0", "gzip"));
+  REQUIRE_FALSE(acceptsEncoding("*;q=0", "gzip"));
+  REQUIRE(acceptsEncoding("*;q=0, gzip;q=0.1", "gzip"));
+}
+
+TEST_CASE("Compressible content types", "[compression]")
+{
+  REQUIRE(isCompressibleType("application/json"));
+  REQUIRE(isCompressibleType("application/json; charset=utf-8"));
+  REQUIRE(isCompressibleType("text/csv"));
+  REQUIRE(isCompressibleType("Text/Plain"));
+  REQUIRE(isCompressibleType("image/svg+xml"));
+  REQUIRE(isCompressibleType("application/ld+json"));
+  REQUIRE_FALSE(isCompressibleType("image/jpeg"));
+  REQUIRE_FALSE(isCompressibleType("application/zip"));
+  REQUIRE_FALSE(isCompressibleType("application/octet-stream"));
+  REQUIRE_FALSE(isCompressibleType(""));
+}
+
+TEST_CASE("GzipCompressor", "[compression]")
+{
+  std::string listing;
+  for (int i = 0; i < 2000; ++i)
+    listing += R"({"id":)" + std::to_string(i) + R"(,"name":"report.csv","tags":["finance"]},)";
+
+  SECTION("Round trips and shrinks repetitive JSON")
+  {
+    auto compressed = GzipCompressor::compress(listing, 6);
+    REQUIRE(compressed.has_value());
+    REQUIRE(compressed->size() < listing.size() / 5);
+    REQUIRE(gunzip(compressed.value()) == listing);
+  }
+
+  SECTION("The per-thread compressor is reused across levels and streams")
+  {
+    auto &first = GzipCompressor::forThread();
+    REQUIRE(&first == &GzipCompressor::forThread());
+
+    auto fast = GzipCompressor::compress(listing, 1);
+    auto small = GzipCompressor::compress(listing, 9);
+    auto empty = GzipCompressor::compress("", 4);
+    REQUIRE(fast.has_value());
+    REQUIRE(small.has_value());
+    REQUIRE(empty.has_value());
+    REQUIRE(small->size() <= fast->size());
+    REQUIRE(gunzip(fast.value()) == listing);
+    REQUIRE(gunzip(small.value()) == listing);
+    REQUIRE(gunzip(empty.value()).empty());
+  }
+
+  SECTION("Streaming writes produce one valid stream")
+  {
+    auto &compressor = GzipCompressor::forThread();
+    std::string out;
+    REQUIRE(compressor.begin(6));
+    for (size_t offset = 0; offset < listing.size(); offset += 7000)
+      REQUIRE(compressor.write(std::string_view(listing).substr(offset, 7000), out));
+    REQUIRE(compressor.finish(out));
+    REQUIRE(gunzip(out) == listing);
+  }
+
+  SECTION("Incompressible input still round trips")
+  {
+    std::string noise(200000, '\0');
+    std::mt19937 rng(7);
+    for (auto &c : noise)
+      c = static_cast<char>(rng());
+    auto compressed = GzipCompressor::compress(noise, 6);
+    REQUIRE(compressed.has_value());
+    REQUIRE(gunzip(compressed.value()) == noise);
+  }
+
+  SECTION("Each thread gets its own compressor")
+  {
+    auto *main_compressor = &GzipCompressor::forThread();
+    auto other = std::async(std::launch::async, []()
+                            { return &GzipCompressor::forThread(); });
+    REQUIRE(other.get() != main_compressor);
+  }
+}
+
+TEST_CASE("Download encoding negotiation", "[compression][download]")
+{
+  test::DatabaseTestHelper::ScopedWorkingDirectory scratch("download_encoding");
+  auto db = Database::create();
+  REQUIRE(db);
+  int folder_id = test::DatabaseTestHelper::createTestFolder(db, "Reports").value();
+
+  std::string csv = "date,region,amount\n";
+  for (int i = 0; i < 5000; ++i)
+    csv += "2024-02-" + std::to_string(1 + i % 28) + ",south," + std::to_string(i * 3) + "\n";
+  int file_id = test::DatabaseTestHelper::uploadTestFile(folder_id, "sales.csv", csv, "text/csv");
+
+  auto record = db->getFileById(file_id);
+  REQUIRE(record.success());
+  REQUIRE(record.value->codec == "gzip");
+  auto stored = FileStorage::readFile(record.value->storageId);
+  REQUIRE(stored.has_value());
+  std::string at_rest(stored->begin(), stored->end());
+
+  auto download = [&](std::optional<std::string> accept_encoding)
+  {
+    boost::beast::http::request<boost::beast::http::string_body> req{
+        boost::beast::http::verb::get, "/download/" + std::to_string(file_id), 11};
+    if (accept_encoding.has_value())
+      req.set(boost::beast::http::field::accept_encoding, accept_encoding.value());
+    return test::write_response(handle_get_download(req));
+  };
+
+  SECTION("A client that takes gzip gets the stored bytes unchanged")
+  {
+    auto res = download("gzip, deflate, br");
+    REQUIRE(res.result() == boost::beast::http::status::ok);
+    REQUIRE(res[boost::beast::http::field::content_encoding] == "gzip");
+    REQUIRE(res[boost::beast::http::field::vary] == "Accept-Encoding");
+    REQUIRE(res[boost::beast::http::field::content_type] == "text/csv");
+    REQUIRE(res.body() == at_rest);
+    REQUIRE(gunzip(res.body()) == csv);
+  }
+
+  SECTION("A client without gzip gets the inflated body")
+  {
+    for (auto accept_encoding : {std::optional<std::string>{}, std::optional<std::string>{"identity"},
+                                 std::optional<std::string>{"gzip;q=0"}})
+    {
+      auto res = download(accept_encoding);
+      REQUIRE(res.result() == boost::beast::http::status::ok);
+      REQUIRE(res.find(boost::beast::http::field::content_encoding) == res.end());
+      REQUIRE(res[boost::beast::http::field::vary] == "Accept-Encoding");
+      REQUIRE(res[boost::beast::http::field::content_length] == std::to_string(csv.size()));
+      REQUIRE(res.body() == csv);
+    }
+  }
+}
@@ -0,0 +1,92 @@
+#include <catch2/catch_test_macros.hpp>
+#include "test_helpers.hpp"
+#include "connection_drain.hpp"
+#include <boost/asio/read.hpp>
+#include <boost/asio/write.hpp>
+#include <future>
+#include <thread>
+
+using namespace bytebucket;
+using boost::asio::ip::tcp;
+
+TEST_CASE("Connection drain", "[drain]")
+{
+  auto drain = ConnectionDrain::create();
+  test::SocketPair pair;
+
+  SECTION("Idle sessions are closed at once")
+  {
+    auto session = std::async(std::launch::async, [&]()
+                              {
+      ConnectionDrain::Session registration(drain, pair.server);
+      REQUIRE(registration.idle());
+      pair.server.wait(tcp::socket::wait_read);
+      char byte;
+      boost::system::error_code ec;
+      pair.server.read_some(boost::asio::buffer(&byte, 1), ec);
+      return ec; });
+    while (drain->activeSessions() == 0)
+      std::this_thread::yield();
+    // let the session reach its wait
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+
+    auto started = std::chrono::steady_clock::now();
+    auto result = drain->drain(std::chrono::seconds(5));
+
+    REQUIRE(session.get());
+    REQUIRE(std::chrono::steady_clock::now() - started < std::chrono::seconds(2));
+    REQUIRE(result.idleClosed == 1);
+    REQUIRE(result.forced == 0);
+    REQUIRE(result.complete);
+  }
+
+  SECTION("Busy sessions are waited for, and don't wait for another request")
+  {
+    std::promise<void> finish;
+    auto session = std::async(std::launch::async, [&]()
+                              {
+      ConnectionDrain::Session registration(drain, pair.server);
+      finish.get_future().wait();
+      boost::asio::write(pair.server, boost::asio::buffer("done", 4));
+      return registration.idle(); });
+    while (drain->activeSessions() == 0)
+      std::this_thread::yield();
+
+    auto drained = std::async(std::launch::async, [&]()
+                              { return drain->drain(std::chrono::seconds(5)); });
+    while (!drain->draining())
+      std::this_thread::yield();
+    finish.set_value();
+
+    REQUIRE_FALSE(session.get());
+    auto result = drained.get();
+    REQUIRE(result.idleClosed == 0);
+    REQUIRE(result.forced == 0);
+    REQUIRE(result.complete);
+
+    char reply[4];
+    boost::asio::read(pair.client, boost::asio::buffer(reply));
+    REQUIRE(std::string(reply, 4) == "done");
+  }
+
+  SECTION("Sessions still busy at the deadline are cut off")
+  {
+    auto session = std::async(std::launch::async, [&]()
+                              {
+      ConnectionDrain::Session registration(drain, pair.server);
+      // a body that never finishes arriving
+      char byte;
+      boost::system::error_code ec;
+      pair.server.read_some(boost::asio::buffer(&byte, 1), ec);
+      return ec; });
+    while (drain->activeSessions() == 0)
+      std::this_thread::yield();
+
+    auto result = drain->drain(std::chrono::milliseconds(50));
+
+    REQUIRE(result.forced == 1);
+    REQUIRE(result.complete);
+    REQUIRE(session.get());
+    REQUIRE(drain->activeSessions() == 0);
+  }
+}
@@ -0,0 +1,101 @@
+#include <catch2/catch_test_macros.hpp>
+#include "test_helpers_database.hpp"
+#include "connection_pool.hpp"
+#include "request_handler.hpp"
+#include <chrono>
+#include <future>
+
+using namespace bytebucket;
+using namespace bytebucket::test;
+
+TEST_CASE("Connection pool", "[database][pool]")
+{
+  std::string db_path = "test_connection_pool.db";
+  DatabaseTestHelper::cleanupDatabase(db_path);
+
+  // creates the schema; pooled connections are read-only
+  auto writer_db = Database::create(db_path);
+  REQUIRE(writer_db != nullptr);
+
+  SECTION("A lease keeps its snapshot while another connection writes")
+  {
+    auto pool = ConnectionPool::create(db_path, 2);
+    REQUIRE(pool != nullptr);
+
+    auto lease = pool->acquire();
+    REQUIRE(lease != nullptr);
+    auto before = lease->getFoldersByParent(std::nullopt);
+    REQUIRE(before.success());
+    size_t count_before = before.value->size();
+
+    REQUIRE(writer_db->insertFolder("AfterSnapshot").success());
+
+    auto during = lease->getFoldersByParent(std::nullopt);
+    REQUIRE(during.success());
+    REQUIRE(during.value->size() == count_before);
+
+    lease.reset();
+
+    auto fresh = pool->acquire();
+    REQUIRE(fresh != nullptr);
+    auto after = fresh->getFoldersByParent(std::nullopt);
+    REQUIRE(after.success());
+    REQUIRE(after.value->size() == count_before + 1);
+  }
+
+  SECTION("Pooled connections reject writes")
+  {
+    auto pool = ConnectionPool::create(db_path, 1);
+    REQUIRE(pool != nullptr);
+
+    auto lease = pool->acquire();
+    REQUIRE(lease != nullptr);
+    auto result = lease->insertFolder("ShouldFail");
+    REQUIRE_FALSE(result.success());
+  }
+
+  SECTION("Acquire waits for a lease to be released")
+  {
+    auto pool = ConnectionPool::create(db_path, 1);
+    REQUIRE(pool != nullptr);
+
+    auto lease = pool->acquire();
+    REQUIRE(lease != nullptr);
+    REQUIRE(pool->stats().idle == 0);
+
+    auto waiting = std::async(std::launch::async, [&pool]()
+                              { return pool->acquire() != nullptr; });
+    REQUIRE(waiting.wait_for(std::chrono::milliseconds(50)) == std::future_status::timeout);
+
+    lease.reset();
+    REQUIRE(waiting.get());
+
+    auto stats = pool->stats();
+    REQUIRE(stats.size == 1);
+    REQUIRE(stats.idle == 1);
+    REQUIRE(stats.acquisitions == 2);
+    REQUIRE(stats.waits == 1);
+  }
+
+  writer_db.reset();
+  DatabaseTestHelper::cleanupDatabase(db_path);
+}
+
+TEST_CASE("Writes without a writer don't borrow pooled connections", "[database][pool]")
+{
+  DatabaseTestHelper::ScopedWorkingDirectory scratch("pool_without_writer");
+  REQUIRE(Database::create() != nullptr);
+  auto pool = ConnectionPool::create("bytebucket.db", 1);
+  REQUIRE(pool != nullptr);
+  setConnectionPool(pool);
+
+  boost::beast::http::request<boost::beast::http::string_body> req{boost::beast::http::verb::post, "/folder", 11};
+  req.set(boost::beast::http::field::content_type, "application/json");
+  req.body() = R"({"name":"Written"})";
+  req.prepare_payload();
+  auto response = handle_post_folder(req);
+  setConnectionPool(nullptr);
+
+  REQUIRE(response.result() == boost::beast::http::status::created);
+  REQUIRE(response.body().find("Written") != std::string::npos);
+}
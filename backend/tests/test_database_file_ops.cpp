@@ -172,6 +172,59 @@ TEST_CASE("Database file operations", "[database][files]")
     REQUIRE(file2_result.value.value() > file1_result.value.value());
     REQUIRE(file3_result.value.value() > file2_result.value.value());
   }
+
+  SECTION("Add several files in one call returns the stored rows")
+  {
+    std::vector<NewFile> files = {
+        {"batch1.txt", folder_id.value(), 10, "text/plain", "storage_batch1"},
+        {"batch2.bin", folder_id.value(), 5000000000LL, "application/octet-stream", "storage_batch2"}};
+    auto result = test_db->addFiles(files);
+
+    REQUIRE(result.success());
+    REQUIRE(result.value->size() == 2);
+    const auto &first = (*result.value)[0];
+    const auto &second = (*result.value)[1];
+    REQUIRE(first.name == "batch1.txt");
+    REQUIRE(first.storageId == "storage_batch1");
+    REQUIRE(second.size == 5000000000LL);
+    REQUIRE(second.contentType == "application/octet-stream");
+    REQUIRE(second.id > first.id);
+
+    auto stored = test_db->getFileById(second.id);
+    REQUIRE(stored.success());
+    REQUIRE(stored.value->storageId == "storage_batch2");
+    REQUIRE(stored.value->createdAt == second.createdAt);
+  }
+
+  SECTION("Blob codec is stored and defaults to identity")
+  {
+    auto plain = test_db->addFile("plain.txt", folder_id.value(), 10, "text/plain", "storage_plain");
+    auto packed = test_db->addFile("packed.csv", folder_id.value(), 5000, "text/csv", "storage_packed", "gzip");
+    auto batch = test_db->addFiles({{"batch.log", folder_id.value(), 900, "text/plain", "storage_batch_gz", "gzip"}});
+    REQUIRE(plain.success());
+    REQUIRE(packed.success());
+    REQUIRE(batch.success());
+
+    REQUIRE(test_db->getFileById(plain.value.value()).value->codec == "identity");
+    auto packed_record = test_db->getFileById(packed.value.value());
+    REQUIRE(packed_record.value->codec == "gzip");
+    REQUIRE(packed_record.value->size == 5000);
+    REQUIRE((*batch.value)[0].codec == "gzip");
+  }
+
+  SECTION("Add several files in one call inserts none when one fails")
+  {
+    REQUIRE(test_db->addFile("existing.txt", folder_id.value(), 1, "text/plain", "storage_taken").success());
+
+    std::vector<NewFile> files = {
+        {"fresh.txt", folder_id.value(), 1, "text/plain", "storage_fresh"},
+        {"clash.txt", folder_id.value(), 1, "text/plain", "storage_taken"}};
+    auto result = test_db->addFiles(files);
+
+    REQUIRE_FALSE(result.success());
+    REQUIRE(result.error == DatabaseError::UniqueConstraint);
+    REQUIRE_FALSE(test_db->getFileByStorageId("storage_fresh").success());
+  }
 }
 
 TEST_CASE("Database file operations edge cases", "[database][files][edge]")
@@ -555,27 +608,33 @@ TEST_CASE("Database file operations with special cases", "[database][files][spec
     }
   }
 
-  // TODO: change size type
-  // SECTION("File operations with extreme sizes")
-  // {
-  //   // Zero size file
-  //   auto zero_result = test_db->addFile("zero.txt", folder_id.value(), 0, "text/plain", "storage_zero");
-  //   REQUIRE(zero_result.success());
+  SECTION("File operations with extreme sizes")
+  {
+    // Zero size file
+    auto zero_result = test_db->addFile("zero.txt", folder_id.value(), 0, "text/plain", "storage_zero");
+    REQUIRE(zero_result.success());
+
+    // Very large file (simulating 1TB)
+    auto large_result = test_db->addFile("huge.bin", folder_id.value(), 1099511627776, "application/octet-stream", "storage_huge");
+    REQUIRE(large_result.success());
 
-  //   // Very large file (simulating 1TB)
-  //   auto large_result = test_db->addFile("huge.bin", folder_id.value(), 1099511627776, "application/octet-stream", "storage_huge");
-  //   REQUIRE(large_result.success());
+    // Just past the 32-bit boundary
+    auto boundary_result = test_db->addFile("boundary.bin", folder_id.value(), 2147483648LL, "application/octet-stream", "storage_boundary");
+    REQUIRE(boundary_result.success());
 
-  //   // Verify retrieval
-  //   auto zero_file = test_db->getFileById(zero_result.value.value());
-  //   auto large_file = test_db->getFileById(large_result.value.value());
+    // Verify retrieval
+    auto zero_file = test_db->getFileById(zero_result.value.value());
+    auto large_file = test_db->getFileById(large_result.value.value());
+    auto boundary_file = test_db->getFileById(boundary_result.value.value());
 
-  //   REQUIRE(zero_file.success());
-  //   REQUIRE(large_file.success());
+    REQUIRE(zero_file.success());
+    REQUIRE(large_file.success());
+    REQUIRE(boundary_file.success());
 
-  //   REQUIRE(zero_file.value.value().size == 0);
-  //   REQUIRE(large_file.value.value().size == 1099511627776);
-  // }
+    REQUIRE(zero_file.value.value().size == 0);
+    REQUIRE(large_file.value.value().size == 1099511627776);
+    REQUIRE(boundary_file.value.value().size == 2147483648LL);
+  }
 
   SECTION("File operations stress test")
   {
@@ -553,4 +553,49 @@ TEST_CASE("Database folder operations - Delete with Cascade", "[database][folder
     REQUIRE(delete_result.error == DatabaseError::UnknownError);
     REQUIRE(delete_result.errorMessage == "DELETE action resulted in no changes");
   }
-}
\ No newline at end of file
+}
+TEST_CASE("Database folder operations - Subtree", "[database][folders][subtree]")
+{
+  TestDatabase test_db("folders_subtree");
+
+  auto root_id = DatabaseTestHelper::createTestFolder(test_db.get(), "Project");
+  auto docs_id = test_db->insertFolder("docs", root_id).value.value();
+  auto api_id = test_db->insertFolder("api", docs_id).value.value();
+  auto other_id = DatabaseTestHelper::createTestFolder(test_db.get(), "Other");
+
+  DatabaseTestHelper::createTestFile(test_db.get(), root_id.value(), "README.md", 10, "text/markdown", "storage_readme");
+  DatabaseTestHelper::createTestFile(test_db.get(), api_id, "index.html", 20, "text/html", "storage_index");
+  DatabaseTestHelper::createTestFile(test_db.get(), other_id.value(), "elsewhere.txt", 30, "text/plain", "storage_other");
+
+  SECTION("Returns the folder, its descendants, and their files")
+  {
+    auto result = test_db->getFolderSubtree(root_id.value());
+    REQUIRE(result.success());
+    const auto &subtree = result.value.value();
+
+    REQUIRE(subtree.folders.size() == 3);
+    REQUIRE(subtree.folders[0].id == root_id.value());
+    REQUIRE(subtree.folders[1].id == docs_id);
+    REQUIRE(subtree.folders[2].id == api_id);
+
+    std::set<std::string> names;
+    for (const auto &file : subtree.files)
+      names.insert(file.name);
+    REQUIRE(names == std::set<std::string>{"README.md", "index.html"});
+  }
+
+  SECTION("A leaf folder is its own subtree")
+  {
+    auto result = test_db->getFolderSubtree(api_id);
+    REQUIRE(result.success());
+    REQUIRE(result.value->folders.size() == 1);
+    REQUIRE(result.value->files.size() == 1);
+    REQUIRE(result.value->files[0].name == "index.html");
+  }
+
+  SECTION("Unknown folder fails")
+  {
+    auto result = test_db->getFolderSubtree(999999);
+    REQUIRE_FALSE(result.success());
+  }
+}
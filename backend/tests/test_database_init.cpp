@@ -119,6 +119,263 @@ TEST_CASE("Database schema creation", "[database][schema]")
   }
 }
 
+TEST_CASE("Database schema migration", "[database][schema][migration]")
+{
+  SECTION("Existing metadata gets a numeric column and backfill")
+  {
+    std::string db_path = "test_db_metadata_migration.db";
+    DatabaseTestHelper::cleanupDatabase(db_path);
+
+    // database laid out before value_num existed
+    sqlite3 *raw_db = nullptr;
+    REQUIRE(sqlite3_open(db_path.c_str(), &raw_db) == SQLITE_OK);
+    const char *old_schema = R"(
+      CREATE TABLE folders (id INTEGER PRIMARY KEY AUTOINCREMENT, name TEXT NOT NULL, parent_id INTEGER);
+      CREATE TABLE files (id INTEGER PRIMARY KEY AUTOINCREMENT, name TEXT NOT NULL, folder_id INTEGER NOT NULL,
+        created_at TEXT DEFAULT CURRENT_TIMESTAMP, updated_at TEXT DEFAULT CURRENT_TIMESTAMP,
+        size INTEGER, content_type TEXT, storage_id TEXT UNIQUE NOT NULL);
+      CREATE TABLE file_metadata (file_id INTEGER NOT NULL, key TEXT NOT NULL, value TEXT, PRIMARY KEY (file_id, key));
+      INSERT INTO folders (id, name) VALUES (1, 'root');
+      INSERT INTO files (id, name, folder_id, size, content_type, storage_id) VALUES (1, 'a.jpg', 1, 10, 'image/jpeg', 's1');
+      INSERT INTO file_metadata (file_id, key, value) VALUES (1, 'iso', '1600'), (1, 'camera', 'Canon');
+    )";
+    REQUIRE(sqlite3_exec(raw_db, old_schema, nullptr, nullptr, nullptr) == SQLITE_OK);
+    sqlite3_close(raw_db);
+
+    auto db = Database::create(db_path);
+    REQUIRE(db != nullptr);
+    REQUIRE(db->getSchemaVersion().value == Database::SCHEMA_VERSION);
+
+    FileQuery query;
+    query.predicates.push_back({"iso", MetadataOp::GreaterThan, "800"});
+    auto result = db->findFilesByMetadata(query);
+    REQUIRE(result.success());
+    REQUIRE(result.value->size() == 1);
+    REQUIRE(result.value->front().name == "a.jpg");
+
+    db.reset();
+    DatabaseTestHelper::cleanupDatabase(db_path);
+  }
+
+  SECTION("Legacy TEXT timestamps are readable before and after batched migration")
+  {
+    std::string db_path = "test_db_timestamp_migration.db";
+    DatabaseTestHelper::cleanupDatabase(db_path);
+
+    sqlite3 *raw_db = nullptr;
+    REQUIRE(sqlite3_open(db_path.c_str(), &raw_db) == SQLITE_OK);
+    const char *old_schema = R"(
+      CREATE TABLE folders (id INTEGER PRIMARY KEY AUTOINCREMENT, name TEXT NOT NULL, parent_id INTEGER);
+      CREATE TABLE files (id INTEGER PRIMARY KEY AUTOINCREMENT, name TEXT NOT NULL, folder_id INTEGER NOT NULL,
+        created_at TEXT DEFAULT CURRENT_TIMESTAMP, updated_at TEXT DEFAULT CURRENT_TIMESTAMP,
+        size INTEGER, content_type TEXT, storage_id TEXT UNIQUE NOT NULL);
+      INSERT INTO folders (id, name) VALUES (1, 'root');
+      INSERT INTO files (name, folder_id, created_at, updated_at, size, content_type, storage_id) VALUES
+        ('a.txt', 1, '2024-08-07 14:30:25', '2024-08-08 09:00:00', 1, 'text/plain', 's1'),
+        ('b.txt', 1, '2024-08-07 14:30:26', '2024-08-07 14:30:26', 1, 'text/plain', 's2'),
+        ('c.txt', 1, '2024-08-07 14:30:27', '2024-08-07 14:30:27', 1, 'text/plain', 's3');
+    )";
+    REQUIRE(sqlite3_exec(raw_db, old_schema, nullptr, nullptr, nullptr) == SQLITE_OK);
+    sqlite3_close(raw_db);
+
+    auto db = Database::create(db_path);
+    REQUIRE(db != nullptr);
+
+    auto expected_created = parseSqliteToChrono("2024-08-07 14:30:25").value();
+    auto expected_updated = parseSqliteToChrono("2024-08-08 09:00:00").value();
+
+    // unmigrated rows fall back to the TEXT columns
+    auto before = db->getFileById(1);
+    REQUIRE(before.success());
+    REQUIRE(before.value->createdAt == expected_created);
+    REQUIRE(before.value->updatedAt == expected_updated);
+
+    auto first_batch = db->migrateLegacyTimestamps(2);
+    REQUIRE(first_batch.success());
+    REQUIRE(first_batch.value.value() == 2);
+
+    auto second_batch = db->migrateLegacyTimestamps(2);
+    REQUIRE(second_batch.success());
+    REQUIRE(second_batch.value.value() == 1);
+
+    auto done = db->migrateLegacyTimestamps(2);
+    REQUIRE(done.success());
+    REQUIRE(done.value.value() == 0);
+
+    auto after = db->getFileById(1);
+    REQUIRE(after.success());
+    REQUIRE(after.value->createdAt == expected_created);
+    REQUIRE(after.value->updatedAt == expected_updated);
+
+    // new rows written after the upgrade use the epoch-ms columns directly
+    REQUIRE(db->addFile("d.txt", 1, 1, "text/plain", "s4").success());
+    auto newest = db->getFileByStorageId("s4");
+    REQUIRE(newest.success());
+    REQUIRE(newest.value->createdAt > expected_created);
+
+    db.reset();
+    DatabaseTestHelper::cleanupDatabase(db_path);
+  }
+
+  SECTION("Fresh databases have nothing to migrate")
+  {
+    TestDatabase test_db("timestamp_fresh");
+    auto result = test_db->migrateLegacyTimestamps();
+    REQUIRE(result.success());
+    REQUIRE(result.value.value() == 0);
+  }
+}
+
+// Whether the named index exists, read with a plain connection
+static bool indexExists(const std::string &db_path, const char *name)
+{
+  sqlite3 *raw_db = nullptr;
+  REQUIRE(sqlite3_open(db_path.c_str(), &raw_db) == SQLITE_OK);
+  sqlite3_stmt *stmt = nullptr;
+  REQUIRE(sqlite3_prepare_v2(raw_db, "SELECT 1 FROM sqlite_master WHERE type = 'index' AND name = ?;", -1, &stmt, nullptr) == SQLITE_OK);
+  sqlite3_bind_text(stmt, 1, name, -1, SQLITE_STATIC);
+  bool found = sqlite3_step(stmt) == SQLITE_ROW;
+  sqlite3_finalize(stmt);
+  sqlite3_close(raw_db);
+  return found;
+}
+
+static void executeRaw(const std::string &db_path, const char *sql)
+{
+  sqlite3 *raw_db = nullptr;
+  REQUIRE(sqlite3_open(db_path.c_str(), &raw_db) == SQLITE_OK);
+  REQUIRE(sqlite3_exec(raw_db, sql, nullptr, nullptr, nullptr) == SQLITE_OK);
+  sqlite3_close(raw_db);
+}
+
+TEST_CASE("Database schema versioning", "[database][schema][migration]")
+{
+  std::string db_path = "test_db_schema_version.db";
+  DatabaseTestHelper::cleanupDatabase(db_path);
+  REQUIRE(Database::create(db_path) != nullptr);
+
+  SECTION("New databases are created at the current version")
+  {
+    auto db = Database::create(db_path);
+    REQUIRE(db != nullptr);
+    auto version = db->getSchemaVersion();
+    REQUIRE(version.success());
+    REQUIRE(version.value == Database::SCHEMA_VERSION);
+  }
+
+  SECTION("Opening an up to date database runs no schema statements")
+  {
+    // a re-run of the base schema would put this back
+    executeRaw(db_path, "DROP INDEX idx_tags_name;");
+
+    REQUIRE(Database::create(db_path) != nullptr);
+    REQUIRE_FALSE(indexExists(db_path, "idx_tags_name"));
+  }
+
+  SECTION("Only migrations past the recorded version run")
+  {
+    executeRaw(db_path, "DROP INDEX idx_tags_name; DROP INDEX idx_files_created_at_ms; PRAGMA user_version = 4;");
+
+    auto db = Database::create(db_path);
+    REQUIRE(db != nullptr);
+    REQUIRE(db->getSchemaVersion().value == Database::SCHEMA_VERSION);
+    REQUIRE(indexExists(db_path, "idx_files_created_at_ms"));
+    REQUIRE_FALSE(indexExists(db_path, "idx_tags_name"));
+  }
+
+  SECTION("Databases from a newer build are refused")
+  {
+    std::string newer = "PRAGMA user_version = " + std::to_string(Database::SCHEMA_VERSION + 1) + ";";
+    executeRaw(db_path, newer.c_str());
+
+    REQUIRE(Database::create(db_path) == nullptr);
+  }
+
+  DatabaseTestHelper::cleanupDatabase(db_path);
+}
+
+TEST_CASE("Database tuning", "[database][tuning]")
+{
+  std::string db_path = "test_db_tuning.db";
+  DatabaseTestHelper::cleanupDatabase(db_path);
+
+  SECTION("Requested pragmas are applied and reported back")
+  {
+    DatabaseTuning tuning;
+    tuning.mmapSize = 0;
+    tuning.cacheSize = -2048;
+    tuning.tempStore = TempStore::File;
+    tuning.busyTimeoutMs = 1234;
+
+    auto db = Database::create(db_path, tuning);
+    REQUIRE(db != nullptr);
+
+    auto status = db->getTuningStatus();
+    REQUIRE(status.success());
+    REQUIRE(status.value->applied.mmapSize == 0);
+    REQUIRE(status.value->applied.cacheSize == -2048);
+    REQUIRE(status.value->applied.tempStore == TempStore::File);
+    REQUIRE(status.value->applied.busyTimeoutMs == 1234);
+    REQUIRE(status.value->pageSize > 0);
+    REQUIRE(status.value->pageCount > 0);
+  }
+
+  SECTION("Read-only connections apply the same tuning")
+  {
+    REQUIRE(Database::create(db_path) != nullptr);
+
+    DatabaseTuning tuning;
+    tuning.cacheSize = 500;
+    tuning.busyTimeoutMs = 42;
+    auto reader = Database::createReadOnly(db_path, tuning);
+    REQUIRE(reader != nullptr);
+
+    auto status = reader->getTuningStatus();
+    REQUIRE(status.success());
+    REQUIRE(status.value->applied.cacheSize == 500);
+    REQUIRE(status.value->applied.busyTimeoutMs == 42);
+  }
+
+  SECTION("Cache counters track page reads and reset")
+  {
+    auto db = Database::create(db_path);
+    REQUIRE(db != nullptr);
+    REQUIRE(db->insertFolder("Cached").success());
+
+    db->getCacheCounters(true);
+    for (int i = 0; i < 10; ++i)
+      REQUIRE(db->getFoldersByParent(std::nullopt).success());
+
+    auto counters = db->getCacheCounters(true);
+    REQUIRE(counters.hits + counters.misses > 0);
+
+    auto after_reset = db->getCacheCounters();
+    REQUIRE(after_reset.hits == 0);
+    REQUIRE(after_reset.misses == 0);
+  }
+
+  SECTION("Environment overrides defaults and ignores invalid values")
+  {
+    setenv("BYTEBUCKET_SQLITE_MMAP_SIZE", "1048576", 1);
+    setenv("BYTEBUCKET_SQLITE_CACHE_SIZE", "not-a-number", 1);
+    setenv("BYTEBUCKET_SQLITE_TEMP_STORE", "file", 1);
+    setenv("BYTEBUCKET_SQLITE_BUSY_TIMEOUT_MS", "250", 1);
+
+    auto tuning = DatabaseTuning::fromEnvironment();
+    REQUIRE(tuning.mmapSize == 1048576);
+    REQUIRE(tuning.cacheSize == DatabaseTuning{}.cacheSize);
+    REQUIRE(tuning.tempStore == TempStore::File);
+    REQUIRE(tuning.busyTimeoutMs == 250);
+
+    unsetenv("BYTEBUCKET_SQLITE_MMAP_SIZE");
+    unsetenv("BYTEBUCKET_SQLITE_CACHE_SIZE");
+    unsetenv("BYTEBUCKET_SQLITE_TEMP_STORE");
+    unsetenv("BYTEBUCKET_SQLITE_BUSY_TIMEOUT_MS");
+  }
+
+  DatabaseTestHelper::cleanupDatabase(db_path);
+}
+
 TEST_CASE("SQLite timestamp parsing", "[database][parsing]")
 {
   SECTION("Parse valid SQLite timestamp")
@@ -709,3 +709,134 @@ TEST_CASE("Database metadata operations - Validation", "[database][metadata][val
     REQUIRE(found);
   }
 }
+
+TEST_CASE("Database metadata operations - Find files by metadata", "[database][metadata][query]")
+{
+  TestDatabase test_db("metadata_query");
+
+  auto folder_id = DatabaseTestHelper::createTestFolder(test_db.get(), "QueryFolder");
+  auto photo_a = DatabaseTestHelper::createTestFile(test_db.get(), folder_id.value(), "a.jpg", 300, "image/jpeg", "storage_query_a");
+  auto photo_b = DatabaseTestHelper::createTestFile(test_db.get(), folder_id.value(), "b.jpg", 100, "image/jpeg", "storage_query_b");
+  auto photo_c = DatabaseTestHelper::createTestFile(test_db.get(), folder_id.value(), "c.jpg", 200, "image/jpeg", "storage_query_c");
+
+  REQUIRE(test_db->setFileMetadata(photo_a.value(), "camera", "Canon").success());
+  REQUIRE(test_db->setFileMetadata(photo_a.value(), "iso", "1600").success());
+  REQUIRE(test_db->setFileMetadata(photo_b.value(), "camera", "Nikon").success());
+  REQUIRE(test_db->setFileMetadata(photo_b.value(), "iso", "400").success());
+  REQUIRE(test_db->setFileMetadata(photo_c.value(), "camera", "Canon").success());
+  REQUIRE(test_db->setFileMetadata(photo_c.value(), "iso", "900").success());
+
+  SECTION("Filter by exact value")
+  {
+    FileQuery query;
+    query.predicates.push_back({"camera", MetadataOp::Equals, "Canon"});
+
+    auto result = test_db->findFilesByMetadata(query);
+    REQUIRE(result.success());
+    REQUIRE(result.value->size() == 2);
+    REQUIRE((*result.value)[0].name == "a.jpg");
+    REQUIRE((*result.value)[1].name == "c.jpg");
+  }
+
+  SECTION("Numeric range compares numbers, not text")
+  {
+    FileQuery query;
+    query.predicates.push_back({"iso", MetadataOp::GreaterThan, "800"});
+
+    auto result = test_db->findFilesByMetadata(query);
+    REQUIRE(result.success());
+    REQUIRE(result.value->size() == 2);
+
+    std::set<int> ids;
+    for (const auto &file : *result.value)
+      ids.insert(file.id);
+    REQUIRE(ids == std::set<int>{photo_a.value(), photo_c.value()});
+  }
+
+  SECTION("Multiple predicates are intersected")
+  {
+    FileQuery query;
+    query.predicates.push_back({"camera", MetadataOp::Equals, "Canon"});
+    query.predicates.push_back({"iso", MetadataOp::LessOrEqual, "900"});
+
+    auto result = test_db->findFilesByMetadata(query);
+    REQUIRE(result.success());
+    REQUIRE(result.value->size() == 1);
+    REQUIRE(result.value->front().id == photo_c.value());
+  }
+
+  SECTION("Sort by size descending with limit and offset")
+  {
+    FileQuery query;
+    query.predicates.push_back({"camera", MetadataOp::Exists, ""});
+    query.sortBy = FileSortField::Size;
+    query.descending = true;
+    query.limit = 2;
+    query.offset = 1;
+
+    auto result = test_db->findFilesByMetadata(query);
+    REQUIRE(result.success());
+    REQUIRE(result.value->size() == 2);
+    REQUIRE((*result.value)[0].name == "c.jpg");
+    REQUIRE((*result.value)[1].name == "b.jpg");
+  }
+
+  SECTION("Sort by numeric metadata value")
+  {
+    FileQuery query;
+    query.predicates.push_back({"iso", MetadataOp::Exists, ""});
+    query.sortBy = FileSortField::Metadata;
+    query.sortKey = "iso";
+
+    auto result = test_db->findFilesByMetadata(query);
+    REQUIRE(result.success());
+    REQUIRE(result.value->size() == 3);
+    REQUIRE((*result.value)[0].id == photo_b.value());
+    REQUIRE((*result.value)[1].id == photo_c.value());
+    REQUIRE((*result.value)[2].id == photo_a.value());
+  }
+
+  SECTION("Updating a value keeps the numeric column in sync")
+  {
+    REQUIRE(test_db->setFileMetadata(photo_b.value(), "iso", "3200").success());
+
+    FileQuery query;
+    query.predicates.push_back({"iso", MetadataOp::GreaterOrEqual, "3200"});
+
+    auto result = test_db->findFilesByMetadata(query);
+    REQUIRE(result.success());
+    REQUIRE(result.value->size() == 1);
+    REQUIRE(result.value->front().id == photo_b.value());
+  }
+
+  SECTION("Query without predicates is rejected")
+  {
+    FileQuery query;
+
+    auto result = test_db->findFilesByMetadata(query);
+    REQUIRE_FALSE(result.success());
+    REQUIRE(result.errorMessage == "At least one metadata predicate is required");
+  }
+
+  SECTION("Lookups use the key/value index")
+  {
+    sqlite3 *raw_db = nullptr;
+    REQUIRE(sqlite3_open("test_db_metadata_query.db", &raw_db) == SQLITE_OK);
+
+    const char *plan_sql = "EXPLAIN QUERY PLAN SELECT file_id FROM file_metadata WHERE key = 'camera' AND value = 'Canon';";
+    sqlite3_stmt *stmt = nullptr;
+    REQUIRE(sqlite3_prepare_v2(raw_db, plan_sql, -1, &stmt, nullptr) == SQLITE_OK);
+
+    bool uses_index = false;
+    while (sqlite3_step(stmt) == SQLITE_ROW)
+    {
+      std::string detail = reinterpret_cast<const char *>(sqlite3_column_text(stmt, 3));
+      if (detail.find("idx_file_metadata_key_value") != std::string::npos)
+        uses_index = true;
+    }
+    sqlite3_finalize(stmt);
+    sqlite3_close(raw_db);
+
+    REQUIRE(uses_index);
+  }
+}
@@ -0,0 +1,175 @@
+#include <catch2/catch_test_macros.hpp>
+#include "test_helpers_database.hpp"
+#include "database_writer.hpp"
+#include <filesystem>
+#include <thread>
+#include <vector>
+
+using namespace bytebucket;
+using namespace bytebucket::test;
+
+TEST_CASE("Database writer", "[database][writer]")
+{
+  std::string db_path = "test_db_writer.db";
+  DatabaseTestHelper::cleanupDatabase(db_path);
+
+  SECTION("Submitted write resolves with its result")
+  {
+    auto writer = DatabaseWriter::create(db_path);
+    REQUIRE(writer != nullptr);
+
+    auto folder = writer->submit([](Database &db)
+                                 { return db.insertFolder("WriterFolder"); })
+                      .get();
+    REQUIRE(folder.success());
+    REQUIRE(folder.value.has_value());
+
+    // committed before the future resolved, so a separate connection sees it
+    auto reader = Database::create(db_path);
+    auto fetched = reader->getFolderById(folder.value.value());
+    REQUIRE(fetched.success());
+    REQUIRE(fetched.value->name == "WriterFolder");
+  }
+
+  SECTION("Concurrent writers are all applied")
+  {
+    auto writer = DatabaseWriter::create(db_path);
+    REQUIRE(writer != nullptr);
+
+    const int thread_count = 8;
+    const int writes_per_thread = 50;
+    std::vector<std::thread> threads;
+    std::atomic<int> failures{0};
+
+    for (int t = 0; t < thread_count; ++t)
+    {
+      threads.emplace_back([&, t]()
+                           {
+        for (int i = 0; i < writes_per_thread; ++i)
+        {
+          std::string name = "folder_" + std::to_string(t) + "_" + std::to_string(i);
+          auto result = writer->submit([name](Database &db)
+                                       { return db.insertFolder(name); })
+                            .get();
+          if (!result.success())
+            failures++;
+        } });
+    }
+    for (auto &thread : threads)
+      thread.join();
+
+    REQUIRE(failures == 0);
+
+    auto reader = Database::create(db_path);
+    auto folders = reader->getFoldersByParent(std::nullopt);
+    REQUIRE(folders.success());
+    // root folder plus everything inserted above
+    REQUIRE(folders.value->size() == thread_count * writes_per_thread + 1);
+
+    auto stats = writer->stats();
+    REQUIRE(stats.writes == thread_count * writes_per_thread);
+    REQUIRE(stats.transactions <= stats.writes);
+    REQUIRE(stats.failedCommits == 0);
+  }
+
+  SECTION("Failed write is rolled back without affecting its batch")
+  {
+    auto writer = DatabaseWriter::create(db_path);
+    REQUIRE(writer != nullptr);
+
+    auto ok_future = writer->submit([](Database &db)
+                                    { return db.insertFolder("KeepMe"); });
+    auto failing_future = writer->submit([](Database &db)
+                                         {
+      // first statement succeeds, second violates the foreign key
+      db.insertFolder("RollMeBack");
+      return db.insertFolder("Orphan", 99999); });
+
+    auto ok = ok_future.get();
+    auto failing = failing_future.get();
+
+    REQUIRE(ok.success());
+    REQUIRE_FALSE(failing.success());
+    REQUIRE(failing.error == DatabaseError::ForeignKeyConstraint);
+
+    auto reader = Database::create(db_path);
+    auto folders = reader->getFoldersByParent(std::nullopt);
+    REQUIRE(folders.success());
+
+    bool found_kept = false;
+    bool found_rolled_back = false;
+    for (const auto &folder : *folders.value)
+    {
+      if (folder.name == "KeepMe")
+        found_kept = true;
+      if (folder.name == "RollMeBack")
+        found_rolled_back = true;
+    }
+    REQUIRE(found_kept);
+    REQUIRE_FALSE(found_rolled_back);
+  }
+
+  SECTION("A write that can't be isolated in its savepoint fails its batch")
+  {
+    auto writer = DatabaseWriter::create(db_path);
+    REQUIRE(writer != nullptr);
+
+    // releasing the writer's savepoint from inside the write leaves nothing to release after it
+    auto escaped = writer->submit([](Database &db)
+                                  {
+      auto folder = db.insertFolder("Unisolated");
+      db.releaseSavepoint("pending_write");
+      return folder; })
+                       .get();
+    REQUIRE_FALSE(escaped.success());
+    REQUIRE(escaped.errorMessage == "Failed to isolate a write from its batch");
+
+    auto reader = Database::create(db_path);
+    auto folders = reader->getFoldersByParent(std::nullopt);
+    REQUIRE(folders.success());
+    for (const auto &folder : folders.value.value())
+      REQUIRE(folder.name != "Unisolated");
+
+    // the writer carries on with the next batch
+    REQUIRE(writer->submit([](Database &db)
+                           { return db.insertFolder("AfterFailedBatch"); })
+                .get()
+                .success());
+  }
+
+  SECTION("Writes after stop fail instead of hanging")
+  {
+    auto writer = DatabaseWriter::create(db_path);
+    REQUIRE(writer != nullptr);
+
+    auto before = writer->submit([](Database &db)
+                                 { return db.insertFolder("BeforeStop"); });
+    writer->stop();
+    REQUIRE(before.get().success());
+
+    auto after = writer->submit([](Database &db)
+                                { return db.insertFolder("AfterStop"); })
+                     .get();
+    REQUIRE_FALSE(after.success());
+    REQUIRE(after.errorMessage == "Database writer is stopped");
+  }
+
+  SECTION("A stopped writer checkpoints the WAL into the database")
+  {
+    auto writer = DatabaseWriter::create(db_path);
+    REQUIRE(writer != nullptr);
+    REQUIRE_FALSE(writer->checkpoint().success());
+
+    for (int i = 0; i < 20; ++i)
+      writer->submit([i](Database &db)
+                     { return db.insertFolder("Checkpointed" + std::to_string(i)); });
+    writer->stop();
+    REQUIRE(std::filesystem::file_size(db_path + "-wal") > 0);
+
+    REQUIRE(writer->checkpoint().success());
+    // truncated, so a restart has no WAL to replay
+    REQUIRE(std::filesystem::file_size(db_path + "-wal") == 0);
+  }
+
+  DatabaseTestHelper::cleanupDatabase(db_path);
+}
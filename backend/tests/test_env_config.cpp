@@ -0,0 +1,45 @@
+#include <catch2/catch_test_macros.hpp>
+#include "env_config.hpp"
+#include <cstdlib>
+
+using namespace bytebucket;
+
+TEST_CASE("Integer settings from the environment", "[env_config]")
+{
+  const char *name = "BYTEBUCKET_TEST_SETTING";
+
+  SECTION("Unset and empty values fall back")
+  {
+    unsetenv(name);
+    REQUIRE_FALSE(readEnvCount(name).has_value());
+    REQUIRE(readEnvCount(name, 30, 1) == 30);
+
+    setenv(name, "", 1);
+    REQUIRE(readEnvCount(name, 30, 1) == 30);
+  }
+
+  SECTION("Whole numbers are read as given")
+  {
+    setenv(name, "45", 1);
+    REQUIRE(readEnvCount(name) == 45u);
+    REQUIRE(readEnvCount(name, 30, 1) == 45);
+    REQUIRE(readEnvInteger(name) == 45);
+  }
+
+  SECTION("Garbage, negative and too-small values fall back")
+  {
+    setenv(name, "thirty", 1);
+    REQUIRE(readEnvCount(name, 30, 1) == 30);
+    setenv(name, "12abc", 1);
+    REQUIRE(readEnvCount(name, 30, 1) == 30);
+    setenv(name, "-1", 1);
+    REQUIRE_FALSE(readEnvCount(name).has_value());
+    REQUIRE(readEnvCount(name, 64, 0) == 64);
+    REQUIRE(readEnvInteger(name) == -1);
+    setenv(name, "0", 1);
+    REQUIRE(readEnvCount(name, 30, 1) == 30);
+    REQUIRE(readEnvCount(name, 30, 0) == 0);
+  }
+
+  unsetenv(name);
+}
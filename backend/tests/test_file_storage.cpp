@@ -3,6 +3,10 @@
 #include <fstream>
 #include <vector>
 #include "file_storage.hpp"
+#include "inflating_file_body.hpp"
+#include <boost/beast/http.hpp>
+#include <random>
+#include <string>
 
 TEST_CASE("FileStorage tests", "[file_storage]")
 {
@@ -155,4 +159,120 @@ TEST_CASE("FileStorage tests", "[file_storage]")
     std::filesystem::remove(*file_path);
     std::filesystem::remove(file_path->string() + ".meta");
   }
-}
\ No newline at end of file
+}
+
+// Serialises a response the way the session would and returns everything after the headers
+static std::string serializeBody(boost::beast::http::response<bytebucket::InflatingFileBody> &res)
+{
+  boost::beast::http::response_serializer<bytebucket::InflatingFileBody> serializer{res};
+  serializer.split(true);
+  std::string body;
+  boost::beast::error_code ec;
+  bool in_body = false;
+  while (!serializer.is_done())
+  {
+    serializer.next(ec, [&](boost::beast::error_code &, const auto &buffers)
+                    {
+      size_t consumed = 0;
+      for (auto buffer : boost::beast::buffers_range_ref(buffers))
+      {
+        if (in_body)
+          body.append(static_cast<const char *>(buffer.data()), buffer.size());
+        consumed += buffer.size();
+      }
+      serializer.consume(consumed); });
+    REQUIRE(!ec);
+    in_body = serializer.is_header_done();
+  }
+  return body;
+}
+
+TEST_CASE("Compressed blob storage", "[file_storage][compression]")
+{
+  using namespace bytebucket;
+
+  std::string csv = "date,region,amount\n";
+  for (int i = 0; i < 5000; ++i)
+    csv += "2024-01-" + std::to_string(1 + i % 28) + ",north," + std::to_string(i * 7) + "\n";
+
+  SECTION("Text content is stored gzipped and inflates back to the original")
+  {
+    auto blob = FileStorage::saveBlob("sales.csv", csv, "text/csv");
+    REQUIRE(blob.has_value());
+    REQUIRE(blob->codec == "gzip");
+
+    auto stored = FileStorage::readFile(blob->fileId);
+    REQUIRE(stored.has_value());
+    REQUIRE(stored->size() < csv.size() / 3);
+
+    auto path = FileStorage::getFilePath(blob->fileId);
+    REQUIRE(path.has_value());
+    boost::beast::http::response<InflatingFileBody> res{boost::beast::http::status::ok, 11};
+    boost::beast::error_code ec;
+    res.body().open(path->c_str(), csv.size(), ec);
+    REQUIRE(!ec);
+    res.prepare_payload();
+    REQUIRE(res[boost::beast::http::field::content_length] == std::to_string(csv.size()));
+    REQUIRE(serializeBody(res) == csv);
+
+    FileStorage::deleteFile(blob->fileId);
+  }
+
+  SECTION("Untyped content is compressed only when a sample shrinks")
+  {
+    auto text_blob = FileStorage::saveBlob("export.dat", csv, "application/octet-stream");
+    REQUIRE(text_blob.has_value());
+    REQUIRE(text_blob->codec == "gzip");
+
+    std::string noise(100000, '\0');
+    std::mt19937 rng(99);
+    for (auto &c : noise)
+      c = static_cast<char>(rng());
+    auto noise_blob = FileStorage::saveBlob("noise.bin", noise, "application/octet-stream");
+    REQUIRE(noise_blob.has_value());
+    REQUIRE(noise_blob->codec == "identity");
+    auto stored = FileStorage::readFile(noise_blob->fileId);
+    REQUIRE(std::string(stored->begin(), stored->end()) == noise);
+
+    FileStorage::deleteFile(text_blob->fileId);
+    FileStorage::deleteFile(noise_blob->fileId);
+  }
+
+  SECTION("Small blobs and disabled compression stay plain")
+  {
+    auto small = FileStorage::saveBlob("tiny.txt", "hello hello hello", "text/plain");
+    REQUIRE(small.has_value());
+    REQUIRE(small->codec == "identity");
+
+    FileStorage::setBlobCompression(false);
+    auto plain = FileStorage::saveBlob("sales.csv", csv, "text/csv");
+    FileStorage::setBlobCompression(true);
+    REQUIRE(plain.has_value());
+    REQUIRE(plain->codec == "identity");
+
+    FileStorage::deleteFile(small->fileId);
+    FileStorage::deleteFile(plain->fileId);
+  }
+
+  SECTION("A truncated blob fails the response instead of ending it early")
+  {
+    auto blob = FileStorage::saveBlob("sales.csv", csv, "text/csv");
+    REQUIRE(blob.has_value());
+    auto path = FileStorage::getFilePath(blob->fileId);
+    std::filesystem::resize_file(*path, std::filesystem::file_size(*path) / 2);
+
+    boost::beast::http::response<InflatingFileBody> res{boost::beast::http::status::ok, 11};
+    boost::beast::error_code ec;
+    res.body().open(path->c_str(), csv.size(), ec);
+    REQUIRE(!ec);
+    res.prepare_payload();
+
+    boost::beast::http::response_serializer<InflatingFileBody> serializer{res};
+    while (!ec && !serializer.is_done())
+      serializer.next(ec, [&](boost::beast::error_code &, const auto &buffers)
+                      { serializer.consume(boost::beast::buffer_bytes(buffers)); });
+    REQUIRE(ec == boost::beast::http::error::partial_message);
+
+    FileStorage::deleteFile(blob->fileId);
+  }
+}
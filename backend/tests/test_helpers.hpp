@@ -1,15 +1,83 @@
 #pragma once
 
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/ip/tcp.hpp>
+#include <boost/beast/core/buffers_range.hpp>
 #include <boost/beast/http.hpp>
 #include "request_handler.hpp"
 #include "multipart_parser.hpp"
 #include "file_storage.hpp"
 #include <sstream>
+#include <stdexcept>
+#include <string>
 
 namespace bytebucket
 {
   namespace test
   {
+    // A connected loopback pair: server is the side a session would own
+    struct SocketPair
+    {
+      boost::asio::io_context ioc;
+      boost::asio::ip::tcp::socket server{ioc};
+      boost::asio::ip::tcp::socket client{ioc};
+
+      SocketPair()
+      {
+        boost::asio::ip::tcp::acceptor acceptor{ioc, {boost::asio::ip::make_address("127.0.0.1"), 0}};
+        client.connect(acceptor.local_endpoint());
+        acceptor.accept(server);
+      }
+    };
+
+    // A SyncWriteStream that appends everything written to a string
+    struct StringWriteStream
+    {
+      std::string &wire;
+
+      template <class ConstBufferSequence>
+      std::size_t write_some(const ConstBufferSequence &buffers, boost::beast::error_code &ec)
+      {
+        ec = {};
+        std::size_t written = 0;
+        for (auto buffer : boost::beast::buffers_range_ref(buffers))
+        {
+          wire.append(static_cast<const char *>(buffer.data()), buffer.size());
+          written += buffer.size();
+        }
+        return written;
+      }
+
+      template <class ConstBufferSequence>
+      std::size_t write_some(const ConstBufferSequence &buffers)
+      {
+        boost::beast::error_code ec;
+        return write_some(buffers, ec);
+      }
+    };
+
+    // Writes a handler's response the way the session would put it on the wire and
+    // parses it back, so streamed bodies (chunked archives, inflated downloads) can be
+    // checked whole
+    inline boost::beast::http::response<boost::beast::http::string_body>
+    write_response(boost::beast::http::message_generator &&generator)
+    {
+      std::string wire;
+      StringWriteStream stream{wire};
+      boost::beast::write(stream, generator);
+
+      boost::beast::http::response_parser<boost::beast::http::string_body> parser;
+      parser.eager(true);
+      parser.body_limit(boost::none);
+      boost::beast::error_code ec;
+      std::size_t parsed = 0;
+      while (!ec && !parser.is_done() && parsed < wire.size())
+        parsed += parser.put(boost::asio::buffer(wire.data() + parsed, wire.size() - parsed), ec);
+      if (!parser.is_done())
+        throw std::runtime_error("Incomplete response: " + ec.message());
+      return parser.release();
+    }
+
     // Helper function to create error responses (matching request_handler)
     inline boost::beast::http::response<boost::beast::http::string_body>
     create_error_response(boost::beast::http::status status, unsigned version, const std::string &error_message)
@@ -4,6 +4,7 @@
 #include <filesystem>
 #include <memory>
 #include "database.hpp"
+#include "request_handler.hpp"
 
 namespace bytebucket
 {
@@ -67,6 +68,35 @@ namespace bytebucket
         std::shared_ptr<Database> db;
       };
 
+      // Runs a test in a fresh temporary directory. Handlers open "bytebucket.db" and
+      // the blob store relative to the working directory, so this keeps them off real data.
+      class ScopedWorkingDirectory
+      {
+      public:
+        explicit ScopedWorkingDirectory(const std::string &test_name)
+            : previous(std::filesystem::current_path()),
+              directory(std::filesystem::temp_directory_path() / ("bytebucket_" + test_name))
+        {
+          std::filesystem::remove_all(directory);
+          std::filesystem::create_directories(directory);
+          std::filesystem::current_path(directory);
+        }
+
+        ~ScopedWorkingDirectory()
+        {
+          std::filesystem::current_path(previous);
+          std::error_code ec;
+          std::filesystem::remove_all(directory, ec);
+        }
+
+        ScopedWorkingDirectory(const ScopedWorkingDirectory &) = delete;
+        ScopedWorkingDirectory &operator=(const ScopedWorkingDirectory &) = delete;
+
+      private:
+        std::filesystem::path previous;
+        std::filesystem::path directory;
+      };
+
       // Helper to create a test folder - updated for DatabaseResult
       static std::optional<int> createTestFolder(std::shared_ptr<Database> db,
                                                  const std::string &name = "TestFolder")
@@ -77,6 +107,26 @@ namespace bytebucket
         return result.value;
       }
 
+      // Uploads one file into a folder through the real upload handler and returns its id
+      static int uploadTestFile(int folderId, const std::string &filename, const std::string &content,
+                                const std::string &contentType)
+      {
+        boost::beast::http::request<boost::beast::http::string_body> req{
+            boost::beast::http::verb::post, "/upload?folder_id=" + std::to_string(folderId), 11};
+        req.set(boost::beast::http::field::content_type, "multipart/form-data; boundary=----BB");
+        req.body() = "------BB\r\n"
+                     "Content-Disposition: form-data; name=\"file\"; filename=\"" + filename + "\"\r\n"
+                     "Content-Type: " + contentType + "\r\n\r\n" +
+                     content + "\r\n------BB--\r\n";
+        req.prepare_payload();
+
+        auto res = bytebucket::handle_post_upload(req);
+        REQUIRE(res.result() == boost::beast::http::status::ok);
+        size_t idAt = res.body().find(R"("id":)");
+        REQUIRE(idAt != std::string::npos);
+        return std::stoi(res.body().substr(idAt + 5));
+      }
+
       // Helper to create multiple test folders - updated for DatabaseResult
       static std::vector<int> createTestFolders(std::shared_ptr<Database> db,
                                                 const std::vector<std::string> &names)
@@ -96,7 +146,7 @@ namespace bytebucket
       static std::optional<int> createTestFile(std::shared_ptr<Database> db,
                                                int folder_id,
                                                const std::string &name = "test.txt",
-                                               int size = 1024,
+                                               int64_t size = 1024,
                                                const std::string &content_type = "text/plain",
                                                const std::string &storage_id = "storage123")
       {
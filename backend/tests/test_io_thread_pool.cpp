@@ -0,0 +1,46 @@
+#include <catch2/catch_test_macros.hpp>
+#include "io_thread_pool.hpp"
+#include <atomic>
+#include <future>
+#include <string>
+#include <vector>
+
+using namespace bytebucket;
+
+TEST_CASE("IoThreadPool", "[io_pool]")
+{
+  SECTION("Results come back through the futures")
+  {
+    auto pool = IoThreadPool::create(3);
+    REQUIRE(pool != nullptr);
+    REQUIRE(pool->size() == 3);
+
+    std::vector<std::future<int>> results;
+    for (int i = 0; i < 50; ++i)
+      results.push_back(pool->submit([i]()
+                                     { return i * i; }));
+    for (int i = 0; i < 50; ++i)
+      REQUIRE(results[i].get() == i * i);
+  }
+
+  SECTION("Zero threads still runs tasks")
+  {
+    auto pool = IoThreadPool::create(0);
+    REQUIRE(pool->size() == 1);
+    REQUIRE(pool->submit([]()
+                         { return std::string("done"); })
+                .get() == "done");
+  }
+
+  SECTION("Destruction finishes queued tasks")
+  {
+    std::atomic<int> ran{0};
+    {
+      auto pool = IoThreadPool::create(2);
+      for (int i = 0; i < 100; ++i)
+        pool->submit([&ran]()
+                     { ++ran; });
+    }
+    REQUIRE(ran == 100);
+  }
+}
@@ -0,0 +1,129 @@
+#include <catch2/catch_test_macros.hpp>
+#include "metrics.hpp"
+#include <boost/beast/http.hpp>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace bytebucket;
+
+// Sync write stream that accepts at most maxWrite bytes per call
+struct StringWriteStream
+{
+  std::string data;
+  size_t maxWrite = 7;
+
+  template <class ConstBufferSequence>
+  size_t write_some(const ConstBufferSequence &buffers, boost::beast::error_code &ec)
+  {
+    ec = {};
+    size_t written = 0;
+    for (auto it = boost::asio::buffer_sequence_begin(buffers);
+         it != boost::asio::buffer_sequence_end(buffers) && written < maxWrite; ++it)
+    {
+      boost::asio::const_buffer buffer(*it);
+      size_t take = std::min(buffer.size(), maxWrite - written);
+      data.append(static_cast<const char *>(buffer.data()), take);
+      written += take;
+    }
+    return written;
+  }
+};
+
+// Value of the first sample line starting with prefix, or -1
+static double sampleValue(const std::string &text, const std::string &prefix)
+{
+  size_t at = text.find("\n" + prefix);
+  if (at == std::string::npos)
+    return -1;
+  size_t end = text.find('\n', at + 1);
+  std::string line = text.substr(at + 1, end - at - 1);
+  return std::stod(line.substr(line.rfind(' ') + 1));
+}
+
+TEST_CASE("Metrics histogram buckets", "[metrics]")
+{
+  SECTION("Every value falls inside its bucket")
+  {
+    for (uint64_t micros : {0ull, 1ull, 3ull, 4ull, 5ull, 7ull, 8ull, 100ull, 1000ull, 123456ull, 60000000ull})
+    {
+      size_t bucket = Metrics::bucketFor(micros);
+      REQUIRE(micros < Metrics::bucketUpperBound(bucket));
+      if (bucket > 0)
+        REQUIRE(micros >= Metrics::bucketUpperBound(bucket - 1));
+    }
+  }
+
+  SECTION("Buckets are contiguous and increasing")
+  {
+    for (size_t bucket = 1; bucket < Metrics::HISTOGRAM_BUCKETS; ++bucket)
+    {
+      REQUIRE(Metrics::bucketUpperBound(bucket) > Metrics::bucketUpperBound(bucket - 1));
+      REQUIRE(Metrics::bucketFor(Metrics::bucketUpperBound(bucket - 1)) == bucket);
+    }
+  }
+
+  SECTION("Huge values land in the last bucket")
+  {
+    REQUIRE(Metrics::bucketFor(~0ull) == Metrics::HISTOGRAM_BUCKETS - 1);
+  }
+}
+
+TEST_CASE("Metrics exposition", "[metrics]")
+{
+  const std::string requests = "bytebucket_http_requests_total{method=\"GET\",route=\"/tags\",code=\"200\"} ";
+  const std::string slow = "bytebucket_http_request_duration_seconds_bucket{method=\"GET\",route=\"/tags\",le=\"0.001024\"} ";
+  double before = std::max(0.0, sampleValue(Metrics::renderPrometheus(), requests));
+  double slow_before = std::max(0.0, sampleValue(Metrics::renderPrometheus(), slow));
+
+  SECTION("Counts recorded on other threads survive those threads exiting")
+  {
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; ++t)
+    {
+      threads.emplace_back([]()
+                           {
+        for (int i = 0; i < 250; ++i)
+          Metrics::recordRequest(Route::GetTags, 200, 100, 1000, std::chrono::microseconds(500)); });
+    }
+    for (auto &thread : threads)
+      thread.join();
+
+    std::string text = Metrics::renderPrometheus();
+    REQUIRE(sampleValue(text, requests) == before + 1000);
+    // 500us is under the 1.024ms bucket bound
+    REQUIRE(sampleValue(text, slow) == slow_before + 1000);
+    REQUIRE(text.find("# TYPE bytebucket_http_request_duration_seconds histogram") != std::string::npos);
+  }
+
+  SECTION("Connections and storage operations are reported")
+  {
+    Metrics::connectionOpened();
+    Metrics::recordStorage(StorageOp::Read, std::chrono::milliseconds(2));
+    std::string text = Metrics::renderPrometheus();
+    Metrics::connectionClosed();
+
+    REQUIRE(sampleValue(text, "bytebucket_http_active_connections ") >= 1);
+    REQUIRE(sampleValue(text, "bytebucket_storage_operation_duration_seconds_count{op=\"read\"} ") >= 1);
+  }
+}
+
+TEST_CASE("Metered write stream", "[metrics]")
+{
+  StringWriteStream sink;
+  MeteredWriteStream<StringWriteStream> metered{sink};
+
+  boost::beast::http::response<boost::beast::http::string_body> res{boost::beast::http::status::not_found, 11};
+  res.body() = "missing";
+  res.prepare_payload();
+  boost::beast::http::write(metered, res);
+
+  REQUIRE(metered.status() == 404);
+  REQUIRE(metered.bytesWritten() == sink.data.size());
+
+  metered.reset();
+  REQUIRE(metered.status() == 0);
+  res.result(boost::beast::http::status::created);
+  boost::beast::http::write(metered, res);
+  REQUIRE(metered.status() == 201);
+}
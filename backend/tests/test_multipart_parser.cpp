@@ -250,6 +250,54 @@ TEST_CASE("MultipartParser tests", "[multipart_parser]")
                        expected_content.begin()));
   }
 
+  SECTION("View parsing points into the original body")
+  {
+    std::string boundary = "XyZ";
+    std::string body = "--XyZ\r\n"
+                       "content-disposition: form-data; name=\"folder_id\"\r\n"
+                       "\r\n"
+                       "7\r\n";
+    for (int i = 0; i < 100; ++i)
+    {
+      body += "--XyZ\r\n"
+              "Content-Disposition: form-data; name=\"file\"; filename=\"f" +
+              std::to_string(i) + ".txt\"\r\n"
+                                  "CONTENT-TYPE: text/plain\r\n"
+                                  "\r\n"
+                                  "payload " +
+              std::to_string(i) + "\r\n";
+    }
+    body += "--XyZ--\r\n";
+
+    auto view = MultipartParser::parseView(body, boundary);
+    REQUIRE(view.has_value());
+    REQUIRE(view->fields.size() == 1);
+    REQUIRE(view->fields[0].name == "folder_id");
+    REQUIRE(view->fields[0].value == "7");
+    REQUIRE(view->files.size() == 100);
+
+    const char *body_begin = body.data();
+    const char *body_end = body.data() + body.size();
+    for (size_t i = 0; i < view->files.size(); ++i)
+    {
+      const auto &file = view->files[i];
+      REQUIRE(file.filename == "f" + std::to_string(i) + ".txt");
+      REQUIRE(file.content_type == "text/plain"); // header names are case-insensitive
+      REQUIRE(file.content == "payload " + std::to_string(i));
+      REQUIRE(file.content.data() >= body_begin);
+      REQUIRE(file.content.data() + file.content.size() <= body_end);
+    }
+
+    // owned copies match what parse returns
+    auto owned = view->toOwned();
+    auto parsed = MultipartParser::parse(body, boundary);
+    REQUIRE(parsed.has_value());
+    REQUIRE(owned.files.size() == parsed->files.size());
+    REQUIRE(owned.files[42].filename == parsed->files[42].filename);
+    REQUIRE(owned.files[42].content == parsed->files[42].content);
+    REQUIRE(owned.fields[0].value == parsed->fields[0].value);
+  }
+
   SECTION("Trim utility function")
   {
     REQUIRE(MultipartParser::trim("  hello  ") == "hello");
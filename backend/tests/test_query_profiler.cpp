@@ -0,0 +1,95 @@
+#include <catch2/catch_test_macros.hpp>
+#include "test_helpers_database.hpp"
+#include "query_profiler.hpp"
+#include <algorithm>
+
+using namespace bytebucket;
+using namespace bytebucket::test;
+
+static const QueryProfiler::QueryStats *findQuery(const std::vector<QueryProfiler::QueryStats> &queries, const std::string &prefix)
+{
+  auto found = std::find_if(queries.begin(), queries.end(), [&](const QueryProfiler::QueryStats &query)
+                            { return query.sql.rfind(prefix, 0) == 0; });
+  return found == queries.end() ? nullptr : &*found;
+}
+
+TEST_CASE("Query normalisation", "[query_profiler]")
+{
+  SECTION("Whitespace collapses and literals become placeholders")
+  {
+    REQUIRE(QueryProfiler::normalise("SELECT id,\n       name FROM files\n WHERE id = 42 AND name = 'it''s';") ==
+            "SELECT id, name FROM files WHERE id = ? AND name = ?");
+  }
+
+  SECTION("Identifiers keep their digits")
+  {
+    REQUIRE(QueryProfiler::normalise("SELECT t1.id FROM files t1 LIMIT 10") == "SELECT t1.id FROM files t1 LIMIT ?");
+  }
+
+  SECTION("IN lists of any length aggregate together")
+  {
+    REQUIRE(QueryProfiler::normalise("SELECT * FROM tags WHERE id IN (?, ?, ?)") ==
+            QueryProfiler::normalise("SELECT * FROM tags WHERE id IN (1,2)"));
+  }
+}
+
+TEST_CASE("Query profiling", "[query_profiler][database]")
+{
+  const std::string db_path = "test_db_query_profiler.db";
+  DatabaseTestHelper::cleanupDatabase(db_path);
+
+  SECTION("Statements on traced connections are aggregated")
+  {
+    auto profiler = QueryProfiler::create(db_path, std::chrono::hours(1));
+    Database::setQueryProfiler(profiler);
+    auto db = Database::create(db_path);
+    Database::setQueryProfiler(nullptr);
+    REQUIRE(db != nullptr);
+
+    auto folder_id = db->insertFolder("Profiled").value.value();
+    for (int i = 0; i < 3; ++i)
+      REQUIRE(db->getFolderById(folder_id).success());
+
+    auto queries = profiler->snapshot();
+    REQUIRE_FALSE(queries.empty());
+    auto folder_query = findQuery(queries, "SELECT id, name, parent_id FROM folders WHERE id = ?");
+    REQUIRE(folder_query != nullptr);
+    REQUIRE(folder_query->calls == 3);
+    REQUIRE(folder_query->rows == 3);
+    REQUIRE(folder_query->totalNanoseconds >= folder_query->maxNanoseconds);
+    REQUIRE(folder_query->slowCalls == 0);
+
+    for (size_t i = 1; i < queries.size(); ++i)
+      REQUIRE(queries[i - 1].totalNanoseconds >= queries[i].totalNanoseconds);
+
+    profiler->reset();
+    REQUIRE(profiler->snapshot().empty());
+  }
+
+  SECTION("Slow statements get their query plan")
+  {
+    auto profiler = QueryProfiler::create(db_path, std::chrono::milliseconds(0));
+    Database::setQueryProfiler(profiler);
+    auto db = Database::create(db_path);
+    Database::setQueryProfiler(nullptr);
+    REQUIRE(db != nullptr);
+
+    auto folder_id = db->insertFolder("Planned").value.value();
+    REQUIRE(db->getFolderById(folder_id).success());
+
+    auto queries = profiler->snapshot();
+    auto folder_query = findQuery(queries, "SELECT id, name, parent_id FROM folders WHERE id = ?");
+    REQUIRE(folder_query != nullptr);
+    REQUIRE(folder_query->slowCalls == 1);
+    REQUIRE(folder_query->plan.find("folders") != std::string::npos);
+  }
+
+  SECTION("Connections opened without a profiler aren't traced")
+  {
+    auto db = Database::create(db_path);
+    REQUIRE(db != nullptr);
+    REQUIRE(Database::getQueryProfiler() == nullptr);
+  }
+
+  DatabaseTestHelper::cleanupDatabase(db_path);
+}
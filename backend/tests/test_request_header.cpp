@@ -0,0 +1,137 @@
+#include <catch2/catch_test_macros.hpp>
+#include <boost/beast/http.hpp>
+#include "request_handler.hpp"
+#include "database.hpp"
+#include "metrics.hpp"
+#include "test_helpers_database.hpp"
+
+using namespace bytebucket;
+using namespace bytebucket::test;
+using namespace boost::beast::http;
+
+// Only the headers are set; check_request_header is asked before any body arrives
+static request<string_body> header_only(verb method, const std::string &target, std::optional<uint64_t> length)
+{
+  request<string_body> req{method, target, 11};
+  req.set(field::host, "localhost");
+  if (length.has_value())
+    req.content_length(length.value());
+  return req;
+}
+
+static request<string_body> upload_header(const std::string &target, uint64_t length)
+{
+  auto req = header_only(verb::post, target, length);
+  req.set(field::content_type, "multipart/form-data; boundary=----BB");
+  return req;
+}
+
+TEST_CASE("Oversized bodies are refused from the headers", "[request_header]")
+{
+  DatabaseTestHelper::ScopedWorkingDirectory scratch("request_header_size");
+  REQUIRE(Database::create());
+
+  auto oversized = upload_header("/upload", MAX_REQUEST_BODY_SIZE + 1);
+  auto rejection = check_request_header(oversized, MAX_REQUEST_BODY_SIZE + 1);
+  REQUIRE(rejection.has_value());
+  REQUIRE(rejection->result() == status::payload_too_large);
+  REQUIRE(rejection->body() == R"({"error":"Request body exceeds the 100 MB limit"})");
+
+  // the size check comes before routing, so it holds for any target
+  auto folder = header_only(verb::post, "/folder", MAX_REQUEST_BODY_SIZE + 1);
+  REQUIRE(check_request_header(folder, MAX_REQUEST_BODY_SIZE + 1)->result() == status::payload_too_large);
+
+  auto at_limit = upload_header("/upload", MAX_REQUEST_BODY_SIZE);
+  REQUIRE_FALSE(check_request_header(at_limit, MAX_REQUEST_BODY_SIZE).has_value());
+}
+
+TEST_CASE("100 Continue is only sent for uploads that will be accepted", "[request_header]")
+{
+  DatabaseTestHelper::ScopedWorkingDirectory scratch("request_header_continue");
+  auto db = Database::create();
+  REQUIRE(db);
+  int folder_id = DatabaseTestHelper::createTestFolder(db, "Uploads").value();
+
+  // the session writes 100 Continue only when the header check passes and the client asked for it
+  auto sends_continue = [](const request<string_body> &req)
+  {
+    return !check_request_header(req, 1024).has_value() && expects_continue(req);
+  };
+
+  auto accepted = upload_header("/upload?folder_id=" + std::to_string(folder_id), 1024);
+  accepted.set(field::expect, "100-continue");
+  REQUIRE(sends_continue(accepted));
+
+  auto missing_folder = upload_header("/upload?folder_id=424242", 1024);
+  missing_folder.set(field::expect, "100-continue");
+  auto rejection = check_request_header(missing_folder, 1024);
+  REQUIRE(rejection.has_value());
+  REQUIRE(rejection->result() == status::not_found);
+  REQUIRE_FALSE(sends_continue(missing_folder));
+
+  auto bad_type = header_only(verb::post, "/upload", 1024);
+  bad_type.set(field::content_type, "text/plain");
+  bad_type.set(field::expect, "100-continue");
+  REQUIRE(check_request_header(bad_type, 1024)->result() == status::bad_request);
+  REQUIRE_FALSE(sends_continue(bad_type));
+
+  SECTION("Clients that don't wait aren't sent one")
+  {
+    auto eager = upload_header("/upload", 1024);
+    REQUIRE_FALSE(check_request_header(eager, 1024).has_value());
+    REQUIRE_FALSE(expects_continue(eager));
+
+    // 100 Continue doesn't exist in HTTP/1.0
+    auto http10 = upload_header("/upload", 1024);
+    http10.version(10);
+    http10.set(field::expect, "100-continue");
+    REQUIRE_FALSE(expects_continue(http10));
+  }
+
+  SECTION("The expectation is matched case-insensitively")
+  {
+    auto shouted = upload_header("/upload", 1024);
+    shouted.set(field::expect, "100-Continue");
+    REQUIRE(sends_continue(shouted));
+  }
+}
+
+TEST_CASE("Bodies sent to unknown routes are refused before they're read", "[request_header]")
+{
+  DatabaseTestHelper::ScopedWorkingDirectory scratch("request_header_routes");
+  REQUIRE(Database::create());
+
+  auto unknown = header_only(verb::post, "/nonexistent", 4096);
+  REQUIRE(match_route(unknown) == Route::NotFound);
+  auto rejection = check_request_header(unknown, 4096);
+  REQUIRE(rejection.has_value());
+  REQUIRE(rejection->result() == status::not_found);
+  REQUIRE(rejection->body() == "Not found");
+
+  // known path, wrong method: still nowhere for the body to go
+  auto wrong_method = header_only(verb::put, "/folder", 16);
+  REQUIRE(check_request_header(wrong_method, 16)->result() == status::not_found);
+
+  auto chunked = header_only(verb::post, "/nonexistent", std::nullopt);
+  chunked.chunked(true);
+  REQUIRE(check_request_header(chunked, std::nullopt)->result() == status::not_found);
+
+  SECTION("Requests without a body are left to the handler")
+  {
+    auto empty = header_only(verb::get, "/nonexistent", std::nullopt);
+    REQUIRE_FALSE(check_request_header(empty, std::nullopt).has_value());
+    auto zero = header_only(verb::post, "/nonexistent", 0);
+    REQUIRE_FALSE(check_request_header(zero, 0).has_value());
+  }
+
+  SECTION("Bodies for known routes are read")
+  {
+    auto folder = header_only(verb::post, "/folder", 16);
+    REQUIRE(match_route(folder) == Route::PostFolder);
+    REQUIRE_FALSE(check_request_header(folder, 16).has_value());
+
+    auto tags = header_only(verb::post, "/files/abc/tags", 16);
+    REQUIRE(match_route(tags) == Route::PostFileTags);
+    REQUIRE_FALSE(check_request_header(tags, 16).has_value());
+  }
+}
@@ -1,7 +1,9 @@
 #include <catch2/catch_test_macros.hpp>
 #include <boost/beast/http.hpp>
 #include "request_handler.hpp"
+#include "metrics.hpp"
 #include "test_helpers.hpp"
+#include "test_helpers_database.hpp"
 
 TEST_CASE("Root endpoint tests", "[root]")
 {
@@ -53,3 +55,24 @@ TEST_CASE("Root endpoint tests", "[root]")
     REQUIRE(response.result() == status::not_found);
   }
 }
+
+TEST_CASE("Nested file routes aren't taken for file deletes", "[root]")
+{
+  using namespace boost::beast::http;
+
+  // the handlers really run, so they get an empty scratch database where these ids don't exist
+  bytebucket::test::DatabaseTestHelper::ScopedWorkingDirectory scratch("nested_file_routes");
+
+  auto route_of = [](const char *target)
+  {
+    request<string_body> req{verb::delete_, target, 11};
+    req.set(field::host, "localhost");
+    bytebucket::Route route;
+    bytebucket::handle_request(std::move(req), route);
+    return route;
+  };
+
+  REQUIRE(route_of("/files/5") == bytebucket::Route::DeleteFile);
+  REQUIRE(route_of("/files/5/tags/3") == bytebucket::Route::DeleteFileTag);
+  REQUIRE(route_of("/files/5/metadata/author") == bytebucket::Route::DeleteFileMetadata);
+}
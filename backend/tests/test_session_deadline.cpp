@@ -0,0 +1,79 @@
+#include <catch2/catch_test_macros.hpp>
+#include "test_helpers.hpp"
+#include "session_deadline.hpp"
+#include <boost/asio/connect.hpp>
+#include <boost/asio/read.hpp>
+#include <boost/asio/write.hpp>
+#include <vector>
+
+using namespace bytebucket;
+using boost::asio::ip::tcp;
+
+TEST_CASE("Body deadlines", "[deadline]")
+{
+  SessionLimits limits;
+  limits.bodyGrace = std::chrono::seconds(10);
+  limits.minBodyBytesPerSecond = 1000;
+  auto started = std::chrono::steady_clock::now();
+
+  SECTION("The grace period comes before the rate")
+  {
+    REQUIRE(limits.bodyDeadline(started, 0) == started + std::chrono::seconds(10));
+    REQUIRE(limits.bodyDeadline(started, 5000) == started + std::chrono::seconds(15));
+  }
+
+  SECTION("No minimum rate means no deadline")
+  {
+    limits.minBodyBytesPerSecond = 0;
+    REQUIRE(limits.bodyDeadline(started, 5000) == std::chrono::steady_clock::time_point::max());
+  }
+}
+
+TEST_CASE("Deadline watchdog", "[deadline]")
+{
+  auto watchdog = DeadlineWatchdog::create(std::chrono::milliseconds(10));
+  test::SocketPair pair;
+  SocketDeadline deadline(watchdog, pair.server);
+
+  SECTION("A read the client never answers fails once the deadline passes")
+  {
+    deadline.expiresAfter(std::chrono::milliseconds(50), TimeoutPhase::Header);
+    auto started = std::chrono::steady_clock::now();
+
+    char byte;
+    boost::system::error_code ec;
+    boost::asio::read(pair.server, boost::asio::buffer(&byte, 1), ec);
+
+    REQUIRE(ec);
+    REQUIRE(std::chrono::steady_clock::now() - started < std::chrono::seconds(5));
+    REQUIRE(deadline.expired() == TimeoutPhase::Header);
+    REQUIRE(watchdog->expiredCount() == 1);
+    REQUIRE(Metrics::renderPrometheus().find("bytebucket_http_connection_timeouts_total{phase=\"header\"}") != std::string::npos);
+  }
+
+  SECTION("A cancelled deadline leaves the socket alone")
+  {
+    deadline.expiresAfter(std::chrono::milliseconds(20), TimeoutPhase::Idle);
+    deadline.cancel();
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+    REQUIRE_FALSE(deadline.expired());
+    boost::asio::write(pair.client, boost::asio::buffer("x", 1));
+    char byte = 0;
+    boost::asio::read(pair.server, boost::asio::buffer(&byte, 1));
+    REQUIRE(byte == 'x');
+  }
+
+  SECTION("Writes to a client that stops reading time out")
+  {
+    DeadlineWriteStream<tcp::socket> guarded(pair.server, deadline, std::chrono::milliseconds(50));
+    // far more than the socket buffers hold, so the write blocks
+    std::vector<char> payload(64 * 1024 * 1024, 'a');
+
+    boost::system::error_code ec;
+    boost::asio::write(guarded, boost::asio::buffer(payload), ec);
+
+    REQUIRE(ec);
+    REQUIRE(deadline.expired() == TimeoutPhase::Write);
+  }
+}
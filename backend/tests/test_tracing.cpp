@@ -0,0 +1,166 @@
+#include <catch2/catch_test_macros.hpp>
+#include "test_helpers_database.hpp"
+#include "tracing.hpp"
+#include "database_writer.hpp"
+#include "io_thread_pool.hpp"
+#include <algorithm>
+#include <string>
+
+using namespace bytebucket;
+using namespace bytebucket::test;
+
+static const Trace::Span *findSpan(const std::vector<Trace::Span> &spans, const std::string &name)
+{
+  auto found = std::find_if(spans.begin(), spans.end(), [&](const Trace::Span &span)
+                            { return name == span.name; });
+  return found == spans.end() ? nullptr : &*found;
+}
+
+TEST_CASE("Tracing", "[tracing]")
+{
+  Tracer::clear();
+  Tracer::setSampling(0);
+
+  SECTION("Unsampled requests record nothing")
+  {
+    REQUIRE(Tracer::begin("GET", "/health", std::nullopt) == nullptr);
+    REQUIRE(Tracer::current() == nullptr);
+    {
+      TraceSpan span("ignored", "test");
+    }
+    Tracer::end();
+    REQUIRE(Tracer::renderChromeTrace() == R"({"traceEvents":[],"displayTimeUnit":"ms"})");
+  }
+
+  SECTION("Forced requests keep nested spans under their id")
+  {
+    auto trace = Tracer::begin("GET", "/folder/3", 42);
+    REQUIRE(trace != nullptr);
+    REQUIRE(trace->id() == 42);
+    REQUIRE(Tracer::current() == trace);
+    {
+      TraceSpan outer("outer", "test");
+      TraceSpan inner("inner", "test");
+    }
+    Tracer::end();
+    REQUIRE(Tracer::current() == nullptr);
+
+    auto spans = trace->spans();
+    REQUIRE(spans.size() == 2);
+    REQUIRE(std::string(spans[0].name) == "inner");
+    REQUIRE(std::string(spans[1].name) == "outer");
+    REQUIRE(spans[1].start <= spans[0].start);
+    REQUIRE(spans[1].duration >= spans[0].duration);
+    REQUIRE(trace->finished() >= spans[1].start + spans[1].duration);
+
+    std::string json = Tracer::renderChromeTrace(42);
+    REQUIRE(json.rfind(R"({"traceEvents":[{"name":"GET /folder/3","cat":"request","ph":"X")", 0) == 0);
+    REQUIRE(json.find(R"("name":"outer","cat":"test","ph":"X")") != std::string::npos);
+    REQUIRE(json.find(R"("args":{"trace":42})") != std::string::npos);
+    REQUIRE(Tracer::renderChromeTrace(7) == R"({"traceEvents":[],"displayTimeUnit":"ms"})");
+  }
+
+  SECTION("A forced id of 0 gets a generated one")
+  {
+    auto first = Tracer::begin("GET", "/", 0);
+    Tracer::end();
+    auto second = Tracer::begin("GET", "/", 0);
+    Tracer::end();
+    REQUIRE(first != nullptr);
+    REQUIRE(second != nullptr);
+    REQUIRE(first->id() != second->id());
+  }
+
+  SECTION("Sampling every request traces all of them")
+  {
+    Tracer::setSampling(1);
+    for (int i = 0; i < 10; ++i)
+    {
+      REQUIRE(Tracer::begin("GET", "/health", std::nullopt) != nullptr);
+      Tracer::end();
+    }
+    Tracer::setSampling(0);
+  }
+
+  SECTION("Only the most recent traces are kept")
+  {
+    for (uint64_t id = 1; id <= Tracer::KEPT_TRACES + 5; ++id)
+    {
+      Tracer::begin("GET", "/", id);
+      Tracer::end();
+    }
+    REQUIRE(Tracer::renderChromeTrace(5).find("traceEvents\":[]") != std::string::npos);
+    REQUIRE(Tracer::renderChromeTrace(6).find("\"trace\":6") != std::string::npos);
+  }
+
+  SECTION("Spans past the limit are counted, not kept")
+  {
+    auto trace = Tracer::begin("GET", "/", 1);
+    for (size_t i = 0; i < Trace::MAX_SPANS + 3; ++i)
+      TraceSpan span("many", "test");
+    Tracer::end();
+    REQUIRE(trace->spans().size() == Trace::MAX_SPANS);
+    REQUIRE(trace->droppedSpans() == 3);
+  }
+
+  SECTION("Labels are escaped")
+  {
+    Tracer::begin("GET", "/a\"b\\c", 9);
+    Tracer::end();
+    REQUIRE(Tracer::renderChromeTrace(9).find(R"("name":"GET /a\"b\\c")") != std::string::npos);
+  }
+
+  Tracer::clear();
+}
+
+TEST_CASE("Tracing across threads", "[tracing]")
+{
+  Tracer::clear();
+
+  SECTION("Writes on the writer thread join the request's trace")
+  {
+    const std::string db_path = "test_db_tracing.db";
+    DatabaseTestHelper::cleanupDatabase(db_path);
+    {
+      auto writer = DatabaseWriter::create(db_path);
+      REQUIRE(writer != nullptr);
+
+      auto trace = Tracer::begin("POST", "/folder", 11);
+      {
+        TraceSpan span("request_thread", "test");
+        auto inserted = writer->submit([](Database &db)
+                                       { return db.insertFolder("Traced"); })
+                            .get();
+        REQUIRE(inserted.success());
+      }
+      Tracer::end();
+
+      auto spans = trace->spans();
+      auto insert = findSpan(spans, "Database::insertFolder");
+      auto request = findSpan(spans, "request_thread");
+      REQUIRE(insert != nullptr);
+      REQUIRE(request != nullptr);
+      REQUIRE(std::string(insert->category) == "db");
+      REQUIRE(insert->thread != request->thread);
+    }
+    DatabaseTestHelper::cleanupDatabase(db_path);
+  }
+
+  SECTION("I/O pool tasks join the request's trace")
+  {
+    auto pool = IoThreadPool::create(2);
+    auto trace = Tracer::begin("POST", "/upload", 12);
+    pool->submit([]()
+                 { TraceSpan span("io_task", "test"); return 0; })
+        .get();
+    Tracer::end();
+    REQUIRE(findSpan(trace->spans(), "io_task") != nullptr);
+
+    // and leave nothing behind on the pool thread
+    auto untraced = pool->submit([]()
+                                 { return Tracer::current() == nullptr; });
+    REQUIRE(untraced.get());
+  }
+
+  Tracer::clear();
+}
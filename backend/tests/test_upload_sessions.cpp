@@ -0,0 +1,309 @@
+#include <catch2/catch_test_macros.hpp>
+#include <atomic>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include <limits>
+#include "upload_session.hpp"
+#include "file_storage.hpp"
+#include "request_handler.hpp"
+#include "test_helpers_database.hpp"
+
+using namespace bytebucket;
+using namespace bytebucket::test;
+
+static std::string readStoredFile(const std::string &file_id)
+{
+  auto content = FileStorage::readFile(file_id);
+  REQUIRE(content.has_value());
+  return std::string(content->begin(), content->end());
+}
+
+TEST_CASE("Resumable upload sessions", "[upload][sessions]")
+{
+  UploadSessions sessions;
+
+  std::string payload;
+  for (int i = 0; i < 1000; ++i)
+    payload += static_cast<char>('a' + i % 26);
+
+  SECTION("Chunks written out of order assemble the original file")
+  {
+    auto created = sessions.create("letters.txt", "text/plain", std::nullopt, static_cast<int64_t>(payload.size()));
+    REQUIRE(created.success());
+    std::string id = created.value->id;
+    REQUIRE(created.value->receivedBytes == 0);
+    REQUIRE_FALSE(created.value->complete());
+
+    REQUIRE(sessions.writeChunk(id, 600, payload.data() + 600, 400).success());
+    REQUIRE(sessions.writeChunk(id, 0, payload.data(), 300).success());
+
+    auto partial = sessions.status(id);
+    REQUIRE(partial.success());
+    REQUIRE(partial.value->receivedBytes == 700);
+    REQUIRE(partial.value->ranges.size() == 2);
+    REQUIRE(partial.value->ranges[0] == std::make_pair<int64_t, int64_t>(0, 300));
+    REQUIRE(partial.value->ranges[1] == std::make_pair<int64_t, int64_t>(600, 1000));
+
+    // the gap is what the client resends after a dropped connection
+    auto filled = sessions.writeChunk(id, 300, payload.data() + 300, 300);
+    REQUIRE(filled.success());
+    REQUIRE(filled.value->ranges.size() == 1);
+    REQUIRE(filled.value->complete());
+
+    auto committed = sessions.commit(id);
+    REQUIRE(committed.success());
+    sessions.finish(id);
+
+    REQUIRE(readStoredFile(id) == payload);
+    REQUIRE(sessions.status(id).error == UploadError::NotFound);
+    FileStorage::deleteFile(id);
+  }
+
+  SECTION("Parallel chunks from many threads")
+  {
+    auto created = sessions.create("parallel.bin", "application/octet-stream", std::nullopt, static_cast<int64_t>(payload.size()));
+    REQUIRE(created.success());
+    std::string id = created.value->id;
+
+    const int chunk_size = 100;
+    std::vector<std::thread> threads;
+    std::atomic<int> failures{0};
+    for (int offset = 0; offset < static_cast<int>(payload.size()); offset += chunk_size)
+    {
+      threads.emplace_back([&, offset]()
+                           {
+        if (!sessions.writeChunk(id, offset, payload.data() + offset, chunk_size).success())
+          failures++; });
+    }
+    for (auto &thread : threads)
+      thread.join();
+
+    REQUIRE(failures == 0);
+    REQUIRE(sessions.commit(id).success());
+    sessions.finish(id);
+    REQUIRE(readStoredFile(id) == payload);
+    FileStorage::deleteFile(id);
+  }
+
+  SECTION("Incomplete uploads can't be finalized")
+  {
+    auto created = sessions.create("half.txt", "text/plain", std::nullopt, 10);
+    REQUIRE(created.success());
+    std::string id = created.value->id;
+
+    REQUIRE(sessions.writeChunk(id, 0, "01234", 5).success());
+    auto committed = sessions.commit(id);
+    REQUIRE_FALSE(committed.success());
+    REQUIRE(committed.error == UploadError::Incomplete);
+
+    REQUIRE(sessions.abort(id).success());
+  }
+
+  SECTION("Chunks past the declared size are rejected")
+  {
+    auto created = sessions.create("small.txt", "text/plain", std::nullopt, 4);
+    REQUIRE(created.success());
+    std::string id = created.value->id;
+
+    auto result = sessions.writeChunk(id, 2, "abcd", 4);
+    REQUIRE_FALSE(result.success());
+    REQUIRE(result.error == UploadError::InvalidRange);
+
+    result = sessions.writeChunk(id, -1, "a", 1);
+    REQUIRE_FALSE(result.success());
+    REQUIRE(result.error == UploadError::InvalidRange);
+
+    // an offset near the top of the range must not wrap around past the size check
+    result = sessions.writeChunk(id, std::numeric_limits<int64_t>::max(), "a", 1);
+    REQUIRE_FALSE(result.success());
+    REQUIRE(result.error == UploadError::InvalidRange);
+
+    result = sessions.writeChunk(id, 4, "", 0);
+    REQUIRE(result.success());
+
+    REQUIRE(sessions.abort(id).success());
+  }
+
+  SECTION("Abort removes the partial file")
+  {
+    auto created = sessions.create("abandoned.txt", "text/plain", std::nullopt, 8);
+    REQUIRE(created.success());
+    std::string id = created.value->id;
+
+    auto part_path = FileStorage::getStorageDir() / (id + ".part");
+    REQUIRE(std::filesystem::exists(part_path));
+    REQUIRE(std::filesystem::file_size(part_path) == 8);
+
+    REQUIRE(sessions.abort(id).success());
+    REQUIRE_FALSE(std::filesystem::exists(part_path));
+    REQUIRE(sessions.writeChunk(id, 0, "a", 1).error == UploadError::NotFound);
+  }
+
+  SECTION("Chunks after commit are refused")
+  {
+    auto created = sessions.create("done.txt", "text/plain", std::nullopt, 3);
+    REQUIRE(created.success());
+    std::string id = created.value->id;
+
+    REQUIRE(sessions.writeChunk(id, 0, "abc", 3).success());
+    REQUIRE(sessions.commit(id).success());
+
+    auto late = sessions.writeChunk(id, 0, "xyz", 3);
+    REQUIRE(late.error == UploadError::Conflict);
+
+    // aborting after commit (e.g. the file row failed) removes the committed blob
+    REQUIRE(sessions.abort(id).success());
+    REQUIRE_FALSE(FileStorage::fileExists(id));
+  }
+}
+
+TEST_CASE("Idle upload sessions are dropped when sessions are accessed", "[upload][sessions]")
+{
+  UploadSessions sessions(std::chrono::seconds(1));
+
+  auto created = sessions.create("idle.txt", "text/plain", std::nullopt, 8);
+  REQUIRE(created.success());
+  std::string id = created.value->id;
+  auto part_path = FileStorage::getStorageDir() / (id + ".part");
+  REQUIRE(std::filesystem::exists(part_path));
+
+  std::this_thread::sleep_for(std::chrono::milliseconds(1100));
+
+  // no new session is created; looking this one up is enough to reap it
+  REQUIRE(sessions.status(id).error == UploadError::NotFound);
+  REQUIRE_FALSE(std::filesystem::exists(part_path));
+}
+
+TEST_CASE("Upload session requests are validated when the session is created", "[upload][sessions]")
+{
+  DatabaseTestHelper::ScopedWorkingDirectory scratch("upload_session_requests");
+  REQUIRE(Database::create());
+
+  auto post = [](const std::string &body)
+  {
+    boost::beast::http::request<boost::beast::http::string_body> req{boost::beast::http::verb::post, "/uploads", 11};
+    req.body() = body;
+    return handle_post_upload_session(req).result();
+  };
+
+  REQUIRE(post(R"({"filename": "a.bin", "size": -5})") == boost::beast::http::status::bad_request);
+  REQUIRE(post(R"({"filename": "a.bin", "size": 99999999999999999999})") == boost::beast::http::status::bad_request);
+  REQUIRE(post(R"({"filename": "a.bin", "size": 4, "folder_id": -1})") == boost::beast::http::status::bad_request);
+  // would truncate to folder 1 if it were narrowed without a range check
+  REQUIRE(post(R"({"filename": "a.bin", "size": 4, "folder_id": 4294967297})") == boost::beast::http::status::bad_request);
+  REQUIRE(post(R"({"filename": "a.bin", "size": 4, "folder_id": 424242})") == boost::beast::http::status::not_found);
+}
+
+TEST_CASE("Upload sessions are recorded in the database", "[upload][sessions][database]")
+{
+  DatabaseTestHelper::ScopedWorkingDirectory scratch("upload_session_rows");
+  auto db = Database::create();
+  REQUIRE(db);
+
+  UploadSessionRecord record;
+  record.id = "abc";
+  record.filename = "disk.img";
+  record.contentType = "application/octet-stream";
+  record.size = 1000;
+  REQUIRE(db->addUploadSession(record).success());
+  REQUIRE_FALSE(db->addUploadSession(record).success());
+
+  REQUIRE(db->updateUploadSessionRanges("abc", {{0, 300}, {600, 1000}}, 2).value == true);
+  // an older update arriving late doesn't replace newer ranges
+  REQUIRE(db->updateUploadSessionRanges("abc", {{0, 300}}, 1).value == false);
+  // a session that's already gone isn't brought back by a late update
+  REQUIRE(db->updateUploadSessionRanges("gone", {{0, 1}}, 1).value == false);
+
+  auto sessions = db->getUploadSessions();
+  REQUIRE(sessions.success());
+  REQUIRE(sessions.value->size() == 1);
+  const auto &stored = sessions.value->front();
+  REQUIRE(stored.filename == "disk.img");
+  REQUIRE_FALSE(stored.folderId.has_value());
+  REQUIRE(stored.size == 1000);
+  REQUIRE(stored.ranges == std::vector<std::pair<int64_t, int64_t>>{{0, 300}, {600, 1000}});
+  REQUIRE(stored.revision == 2);
+
+  REQUIRE(db->deleteUploadSession("abc").value == true);
+  REQUIRE(db->getUploadSessions().value->empty());
+}
+
+TEST_CASE("Upload sessions pick up where they were after a restart", "[upload][sessions]")
+{
+  DatabaseTestHelper::ScopedWorkingDirectory scratch("upload_session_restart");
+
+  std::string payload = "0123456789abcdefghij";
+  std::string id;
+  UploadSessionInfo recorded;
+  {
+    UploadSessions before;
+    auto created = before.create("resumed.txt", "text/plain", std::nullopt, static_cast<int64_t>(payload.size()));
+    REQUIRE(created.success());
+    id = created.value->id;
+    REQUIRE(before.writeChunk(id, 0, payload.data(), 8).success());
+    recorded = before.status(id).value.value();
+    REQUIRE(recorded.revision == 1);
+  }
+
+  UploadSessions after;
+  auto restored = after.restore(recorded);
+  REQUIRE(restored.success());
+  REQUIRE(restored.value->receivedBytes == 8);
+  REQUIRE(after.restore(recorded).error == UploadError::Conflict);
+
+  auto finished = after.writeChunk(id, 8, payload.data() + 8, payload.size() - 8);
+  REQUIRE(finished.value->complete());
+  // carries on from the recorded revision, so its update supersedes the stored row
+  REQUIRE(finished.value->revision == 2);
+  REQUIRE(after.commit(id).success());
+  after.finish(id);
+  REQUIRE(readStoredFile(id) == payload);
+
+  // the partial file went with the commit, so the record can't come back again
+  REQUIRE(after.restore(recorded).error == UploadError::NotFound);
+}
+
+TEST_CASE("Restoring upload sessions drops what can't be resumed", "[upload][sessions]")
+{
+  DatabaseTestHelper::ScopedWorkingDirectory scratch("upload_session_restore");
+  auto db = Database::create();
+  REQUIRE(db);
+
+  auto live = FileStorage::createPartialFile(10);
+  auto orphan = FileStorage::createPartialFile(10);
+  REQUIRE(live.has_value());
+  REQUIRE(orphan.has_value());
+  REQUIRE(FileStorage::writePartialFile(live.value(), 0, "01234", 5));
+
+  UploadSessionRecord record;
+  record.id = live.value();
+  record.filename = "live.txt";
+  record.contentType = "text/plain";
+  record.size = 10;
+  record.ranges = {{0, 5}};
+  REQUIRE(db->addUploadSession(record).success());
+
+  record.id = "no_partial_file";
+  REQUIRE(db->addUploadSession(record).success());
+
+  REQUIRE(restore_upload_sessions() == 1);
+  REQUIRE(FileStorage::partialFileSize(live.value()) == 10);
+  REQUIRE_FALSE(FileStorage::partialFileSize(orphan.value()).has_value());
+
+  auto rows = db->getUploadSessions();
+  REQUIRE(rows.value->size() == 1);
+  REQUIRE(rows.value->front().id == live.value());
+
+  using namespace boost::beast::http;
+  request<string_body> status_req{verb::get, "/uploads/" + live.value(), 11};
+  auto status_res = handle_get_upload_session(status_req);
+  REQUIRE(status_res.result() == status::ok);
+  REQUIRE(status_res.body().find(R"("received_bytes":5)") != std::string::npos);
+
+  request<string_body> cancel_req{verb::delete_, "/uploads/" + live.value(), 11};
+  REQUIRE(handle_delete_upload_session(cancel_req).result() == status::ok);
+  REQUIRE(db->getUploadSessions().value->empty());
+}
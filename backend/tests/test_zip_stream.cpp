@@ -0,0 +1,389 @@
+#include <catch2/catch_test_macros.hpp>
+#include "zip_stream.hpp"
+#include "zip_archive_body.hpp"
+#include "file_storage.hpp"
+#include "database.hpp"
+#include "request_handler.hpp"
+#include "test_helpers.hpp"
+#include "test_helpers_database.hpp"
+#include <boost/beast/core/buffers_range.hpp>
+#include <boost/beast/http/serializer.hpp>
+#include <map>
+#include <random>
+#include <string>
+
+using namespace bytebucket;
+
+static uint32_t get16(const std::string &data, size_t at)
+{
+  return static_cast<uint8_t>(data[at]) | (static_cast<uint8_t>(data[at + 1]) << 8);
+}
+
+static uint32_t get32(const std::string &data, size_t at)
+{
+  return get16(data, at) | (get16(data, at + 2) << 16);
+}
+
+static uint64_t get64(const std::string &data, size_t at)
+{
+  return get32(data, at) | (static_cast<uint64_t>(get32(data, at + 4)) << 32);
+}
+
+static std::string inflateRaw(const std::string &compressed)
+{
+  z_stream stream{};
+  REQUIRE(inflateInit2(&stream, -15) == Z_OK);
+  stream.next_in = reinterpret_cast<Bytef *>(const_cast<char *>(compressed.data()));
+  stream.avail_in = static_cast<uInt>(compressed.size());
+
+  std::string out;
+  int returnCode = Z_OK;
+  while (returnCode == Z_OK)
+  {
+    char buffer[16384];
+    stream.next_out = reinterpret_cast<Bytef *>(buffer);
+    stream.avail_out = sizeof(buffer);
+    returnCode = inflate(&stream, Z_NO_FLUSH);
+    out.append(buffer, sizeof(buffer) - stream.avail_out);
+  }
+  inflateEnd(&stream);
+  REQUIRE(returnCode == Z_STREAM_END);
+  return out;
+}
+
+// Reads an archive through its central directory, following the ZIP64 end
+// record when the classic one is saturated, checking each entry's CRC, and
+// returns path -> decoded contents
+static std::map<std::string, std::string> readZip(const std::string &zip)
+{
+  REQUIRE(zip.size() >= 22);
+  size_t end = zip.size() - 22;
+  REQUIRE(get32(zip, end) == 0x06054b50);
+  uint64_t count = get16(zip, end + 10);
+  size_t at = get32(zip, end + 16);
+  if (count == 0xFFFF || at == 0xFFFFFFFF)
+  {
+    // the locator sits right before the classic record and points at the ZIP64 one
+    REQUIRE(end >= 20);
+    size_t locator = end - 20;
+    REQUIRE(get32(zip, locator) == 0x07064b50);
+    size_t zip64End = get64(zip, locator + 8);
+    REQUIRE(get32(zip, zip64End) == 0x06064b50);
+    REQUIRE(zip64End + 56 == locator);
+    count = get64(zip, zip64End + 32);
+    REQUIRE(get64(zip, zip64End + 24) == count);
+    REQUIRE(get64(zip, zip64End + 48) + get64(zip, zip64End + 40) == zip64End);
+    at = get64(zip, zip64End + 48);
+  }
+
+  std::map<std::string, std::string> contents;
+  for (uint64_t i = 0; i < count; ++i)
+  {
+    REQUIRE(get32(zip, at) == 0x02014b50);
+    uint32_t method = get16(zip, at + 10);
+    uint32_t crc = get32(zip, at + 16);
+    uint32_t compressedSize = get32(zip, at + 20);
+    uint32_t size = get32(zip, at + 24);
+    uint32_t nameLength = get16(zip, at + 28);
+    uint32_t extraLength = get16(zip, at + 30);
+    uint32_t commentLength = get16(zip, at + 32);
+    size_t local = get32(zip, at + 42);
+    std::string path = zip.substr(at + 46, nameLength);
+    at += 46 + nameLength + extraLength + commentLength;
+
+    REQUIRE(get32(zip, local) == 0x04034b50);
+    REQUIRE(zip.substr(local + 30, get16(zip, local + 26)) == path);
+    size_t data = local + 30 + get16(zip, local + 26) + get16(zip, local + 28);
+    std::string raw = zip.substr(data, compressedSize);
+    std::string decoded = method == 8 ? inflateRaw(raw) : raw;
+
+    REQUIRE(decoded.size() == size);
+    REQUIRE(static_cast<uint32_t>(crc32_z(0, reinterpret_cast<const Bytef *>(decoded.data()), decoded.size())) == crc);
+    contents[path] = decoded;
+  }
+  return contents;
+}
+
+static std::string serializeArchive(boost::beast::http::response<ZipArchiveBody> &res)
+{
+  boost::beast::http::response_serializer<ZipArchiveBody> serializer{res};
+  serializer.split(true);
+  std::string body;
+  boost::beast::error_code ec;
+  bool in_body = false;
+  while (!serializer.is_done())
+  {
+    serializer.next(ec, [&](boost::beast::error_code &, const auto &buffers)
+                    {
+      size_t consumed = 0;
+      for (auto buffer : boost::beast::buffers_range_ref(buffers))
+      {
+        if (in_body)
+          body.append(static_cast<const char *>(buffer.data()), buffer.size());
+        consumed += buffer.size();
+      }
+      serializer.consume(consumed); });
+    REQUIRE(!ec);
+    in_body = serializer.is_header_done();
+  }
+  return body;
+}
+
+TEST_CASE("ZIP encoder", "[zip]")
+{
+  auto now = std::chrono::system_clock::now();
+  std::string text;
+  for (int i = 0; i < 5000; ++i)
+    text += "line " + std::to_string(i) + "\n";
+
+  SECTION("Stored, deflated and directory entries round-trip")
+  {
+    ZipEncoder encoder(6);
+    std::string zip;
+    REQUIRE(encoder.beginEntry("docs/", ZipMethod::Stored, 0, now, std::nullopt, zip));
+    REQUIRE(encoder.endEntry(zip));
+    REQUIRE(encoder.beginEntry("docs/plain.txt", ZipMethod::Stored, 5, now, std::nullopt, zip));
+    REQUIRE(encoder.write("hello", zip));
+    REQUIRE(encoder.endEntry(zip));
+    REQUIRE(encoder.beginEntry("docs/lines.txt", ZipMethod::Deflate, text.size(), now, std::nullopt, zip));
+    REQUIRE(encoder.write(std::string_view(text).substr(0, 1000), zip));
+    REQUIRE(encoder.write(std::string_view(text).substr(1000), zip));
+    REQUIRE(encoder.endEntry(zip));
+    encoder.finish(zip);
+    REQUIRE(encoder.bytesWritten() == zip.size());
+
+    auto contents = readZip(zip);
+    REQUIRE(contents.size() == 3);
+    REQUIRE(contents["docs/"].empty());
+    REQUIRE(contents["docs/plain.txt"] == "hello");
+    REQUIRE(contents["docs/lines.txt"] == text);
+    REQUIRE(zip.size() < text.size());
+  }
+
+  SECTION("Passthrough entries need the decoded CRC")
+  {
+    ZipEncoder encoder;
+    std::string zip;
+    REQUIRE_FALSE(encoder.beginEntry("a.txt", ZipMethod::DeflatePassthrough, 1, now, std::nullopt, zip));
+  }
+
+  SECTION("Entries can't overlap")
+  {
+    ZipEncoder encoder;
+    std::string zip;
+    REQUIRE(encoder.beginEntry("a.txt", ZipMethod::Stored, 1, now, std::nullopt, zip));
+    REQUIRE_FALSE(encoder.beginEntry("b.txt", ZipMethod::Stored, 1, now, std::nullopt, zip));
+  }
+
+  SECTION("A large declared size announces ZIP64 in the local header and descriptor")
+  {
+    // at the encoder's ZIP64 threshold; the data itself stays small
+    const uint64_t declared = 0xF0000000;
+    ZipEncoder encoder;
+    std::string zip;
+    REQUIRE(encoder.beginEntry("big.bin", ZipMethod::Stored, declared, now, std::nullopt, zip));
+    REQUIRE(encoder.write("abc", zip));
+    REQUIRE(encoder.endEntry(zip));
+    encoder.finish(zip);
+
+    REQUIRE(get16(zip, 4) == 45);
+    REQUIRE(get32(zip, 18) == 0xFFFFFFFF);
+    REQUIRE(get32(zip, 22) == 0xFFFFFFFF);
+    REQUIRE(get16(zip, 28) == 20);
+    REQUIRE(get16(zip, 30 + 7) == 0x0001);
+
+    size_t descriptor = 30 + 7 + 20 + 3;
+    REQUIRE(get32(zip, descriptor) == 0x08074b50);
+    REQUIRE(get32(zip, descriptor + 4) == static_cast<uint32_t>(crc32_z(0, reinterpret_cast<const Bytef *>("abc"), 3)));
+    REQUIRE(get64(zip, descriptor + 8) == 3);
+    REQUIRE(get64(zip, descriptor + 16) == 3);
+    // the central directory record follows the 24-byte ZIP64 descriptor
+    REQUIRE(get32(zip, descriptor + 24) == 0x02014b50);
+    REQUIRE(get16(zip, descriptor + 24 + 6) == 45);
+
+    REQUIRE(readZip(zip)["big.bin"] == "abc");
+  }
+
+  SECTION("65535 entries or more switch to the ZIP64 end record")
+  {
+    ZipEncoder encoder;
+    std::string zip;
+    const int count = 70000;
+    for (int i = 0; i < count; ++i)
+    {
+      REQUIRE(encoder.beginEntry("e" + std::to_string(i), ZipMethod::Stored, 0, now, std::nullopt, zip));
+      REQUIRE(encoder.endEntry(zip));
+    }
+    encoder.finish(zip);
+    REQUIRE(encoder.bytesWritten() == zip.size());
+
+    // the classic record is saturated and defers to the ZIP64 one
+    size_t end = zip.size() - 22;
+    REQUIRE(get16(zip, end + 8) == 0xFFFF);
+    REQUIRE(get16(zip, end + 10) == 0xFFFF);
+
+    auto contents = readZip(zip);
+    REQUIRE(contents.size() == count);
+    REQUIRE(contents.count("e0") == 1);
+    REQUIRE(contents.count("e69999") == 1);
+  }
+}
+
+TEST_CASE("ZIP archive body", "[zip][file_storage]")
+{
+  FileStorage::initializeStorage();
+  auto now = std::chrono::system_clock::now();
+
+  std::string csv;
+  for (int i = 0; i < 20000; ++i)
+    csv += std::to_string(i) + ",name_" + std::to_string(i % 97) + "\n";
+  std::string noise(ZipArchiveBody::CHUNK_SIZE * 2 + 123, '\0');
+  std::mt19937 rng(7);
+  for (auto &c : noise)
+    c = static_cast<char>(rng());
+
+  auto csv_blob = FileStorage::saveBlob("data.csv", csv, "text/csv");
+  auto noise_blob = FileStorage::saveBlob("noise.bin", noise, "application/octet-stream");
+  REQUIRE(csv_blob.has_value());
+  REQUIRE(noise_blob.has_value());
+  REQUIRE(csv_blob->codec == "gzip");
+  REQUIRE(noise_blob->codec == "identity");
+
+  auto entry = [&](std::string path, const StoredBlob &blob, uint64_t size, bool deflate)
+  {
+    ZipArchiveEntry e;
+    e.path = std::move(path);
+    e.source = FileStorage::getStorageDir() / blob.fileId;
+    e.codec = blob.codec;
+    e.size = size;
+    e.deflate = deflate;
+    e.modified = now;
+    return e;
+  };
+
+  SECTION("Blobs stream into the archive whatever their codec")
+  {
+    boost::beast::http::response<ZipArchiveBody> res{boost::beast::http::status::ok, 11};
+    ZipArchiveEntry dir;
+    dir.path = "sub/";
+    dir.modified = now;
+    res.body().entries.push_back(dir);
+    res.body().entries.push_back(entry("data.csv", *csv_blob, csv.size(), true));
+    res.body().entries.push_back(entry("sub/noise.bin", *noise_blob, noise.size(), false));
+    res.body().entries.push_back(entry("sub/noise-deflated.bin", *noise_blob, noise.size(), true));
+    res.body().readAheadChunks = 1;
+
+    auto contents = readZip(serializeArchive(res));
+    REQUIRE(contents.size() == 4);
+    REQUIRE(contents["sub/"].empty());
+    REQUIRE(contents["data.csv"] == csv);
+    REQUIRE(contents["sub/noise.bin"] == noise);
+    REQUIRE(contents["sub/noise-deflated.bin"] == noise);
+  }
+
+  SECTION("An empty archive is still valid")
+  {
+    boost::beast::http::response<ZipArchiveBody> res{boost::beast::http::status::ok, 11};
+    REQUIRE(readZip(serializeArchive(res)).empty());
+  }
+
+  SECTION("A missing blob fails the response")
+  {
+    boost::beast::http::response<ZipArchiveBody> res{boost::beast::http::status::ok, 11};
+    ZipArchiveEntry missing;
+    missing.path = "gone.txt";
+    missing.source = FileStorage::getStorageDir() / "does_not_exist";
+    missing.size = 10;
+    res.body().entries.push_back(missing);
+
+    boost::beast::http::response_serializer<ZipArchiveBody> serializer{res};
+    boost::beast::error_code ec;
+    while (!ec && !serializer.is_done())
+    {
+      serializer.next(ec, [&](boost::beast::error_code &, const auto &buffers)
+                      { serializer.consume(boost::beast::buffer_bytes(buffers)); });
+    }
+    REQUIRE(ec);
+  }
+
+  FileStorage::deleteFile(csv_blob->fileId);
+  FileStorage::deleteFile(noise_blob->fileId);
+}
+
+TEST_CASE("Folder archive endpoint", "[zip][archive]")
+{
+  test::DatabaseTestHelper::ScopedWorkingDirectory scratch("folder_archive");
+  auto db = Database::create();
+  REQUIRE(db);
+
+  int projects = db->insertFolder("Projects").value.value();
+  int docs = db->insertFolder("docs", projects).value.value();
+  int img = db->insertFolder("img", docs).value.value();
+  db->insertFolder("empty", projects);
+  int elsewhere = db->insertFolder("Elsewhere").value.value();
+
+  std::string csv;
+  for (int i = 0; i < 5000; ++i)
+    csv += std::to_string(i) + ",row_" + std::to_string(i % 13) + "\n";
+  std::string pixels(3000, '\0');
+  std::mt19937 rng(11);
+  for (auto &c : pixels)
+    c = static_cast<char>(rng());
+
+  test::DatabaseTestHelper::uploadTestFile(projects, "readme.txt", "top level", "text/plain");
+  // same name in the same folder: the second one is numbered rather than overwriting
+  test::DatabaseTestHelper::uploadTestFile(projects, "readme.txt", "second readme", "text/plain");
+  test::DatabaseTestHelper::uploadTestFile(docs, "notes.csv", csv, "text/csv");
+  test::DatabaseTestHelper::uploadTestFile(img, "pixel.bin", pixels, "application/octet-stream");
+  test::DatabaseTestHelper::uploadTestFile(elsewhere, "outside.txt", "not in the archive", "text/plain");
+
+  auto get = [](const std::string &target, unsigned version = 11)
+  {
+    boost::beast::http::request<boost::beast::http::string_body> req{boost::beast::http::verb::get, target, version};
+    return test::write_response(handle_get_folder_archive(req));
+  };
+
+  SECTION("The archive mirrors the stored tree under the requested folder")
+  {
+    auto res = get("/folder/" + std::to_string(projects) + "/archive");
+    REQUIRE(res.result() == boost::beast::http::status::ok);
+    REQUIRE(res[boost::beast::http::field::content_type] == "application/zip");
+    REQUIRE(res[boost::beast::http::field::content_disposition] == "attachment; filename=\"Projects.zip\"");
+
+    auto contents = readZip(res.body());
+    std::map<std::string, std::string> expected{
+        {"readme.txt", "top level"},
+        {"readme (2).txt", "second readme"},
+        {"docs/", ""},
+        {"docs/notes.csv", csv},
+        {"docs/img/", ""},
+        {"docs/img/pixel.bin", pixels},
+        {"empty/", ""},
+    };
+    REQUIRE(contents == expected);
+
+    // one entry per stored folder below the root and per stored file in the subtree
+    auto subtree = db->getFolderSubtree(projects);
+    REQUIRE(subtree.success());
+    REQUIRE(contents.size() == subtree.value->folders.size() - 1 + subtree.value->files.size());
+  }
+
+  SECTION("A subfolder's archive is rooted at that folder")
+  {
+    auto contents = readZip(get("/folder/" + std::to_string(docs) + "/archive").body());
+    std::map<std::string, std::string> expected{
+        {"notes.csv", csv},
+        {"img/", ""},
+        {"img/pixel.bin", pixels},
+    };
+    REQUIRE(contents == expected);
+  }
+
+  SECTION("Unknown folders and old clients are refused")
+  {
+    REQUIRE(get("/folder/424242/archive").result() == boost::beast::http::status::not_found);
+    REQUIRE(get("/folder/abc/archive").result() == boost::beast::http::status::bad_request);
+    REQUIRE(get("/folder/" + std::to_string(projects) + "/archive", 10).result() ==
+            boost::beast::http::status::http_version_not_supported);
+  }
+}
@@ -17,7 +17,7 @@ export interface FileResponse {
   id: number;
   name: string;
   folder_id: number;
-  size: number;
+  size: number; // bytes; 64-bit on the server, exact here up to 2^53
   content_type: string;
   storage_id: string;
   created_at: string;